@@ -0,0 +1,288 @@
+/***************************************************************************/ /**
+ * @file alarm_wheel.c
+ * @brief Hierarchical software alarm wheel keyed on UTC seconds
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "alarm_wheel.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define LEVEL_OVERFLOW ALARM_WHEEL_LEVELS         // Timer sits on the overflow list
+#define LEVEL_EXPIRED  (ALARM_WHEEL_LEVELS + 1u)  // Timer sits on the expired list
+
+#define LEVEL_SHIFT(level) (ALARM_WHEEL_SLOT_BITS * (uint32_t)(level))
+#define TOP_SHIFT          LEVEL_SHIFT(ALARM_WHEEL_LEVELS)
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static void wheel_link(alarm_wheel_timer_t **head, alarm_wheel_timer_t *timer);
+static void wheel_unlink(alarm_wheel_t *wheel, alarm_wheel_timer_t *timer);
+static void wheel_file(alarm_wheel_t *wheel, alarm_wheel_timer_t *timer);
+static void wheel_refile_list(alarm_wheel_t *wheel, alarm_wheel_timer_t **head);
+static void wheel_move_list(alarm_wheel_t *wheel, alarm_wheel_timer_t **from, alarm_wheel_timer_t **to);
+static uint32_t wheel_run_expired(alarm_wheel_t *wheel, alarm_wheel_timer_t **rearmed);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void alarm_wheel_init(alarm_wheel_t *wheel, uint32_t now)
+{
+  uint32_t level;
+  uint32_t slot;
+
+  wheel->now   = now;
+  wheel->count = 0;
+  for (level = 0; level < ALARM_WHEEL_LEVELS; level++) {
+    wheel->occupied[level] = 0;
+    for (slot = 0; slot < ALARM_WHEEL_SLOTS; slot++) {
+      wheel->slots[level][slot] = NULL;
+    }
+  }
+  wheel->overflow = NULL;
+  wheel->expired  = NULL;
+}
+
+void alarm_wheel_insert(alarm_wheel_t *wheel,
+                        alarm_wheel_timer_t *timer,
+                        uint32_t expiry,
+                        alarm_wheel_callback_t callback,
+                        void *context)
+{
+  if (alarm_wheel_timer_pending(timer)) {
+    wheel_unlink(wheel, timer);
+  } else {
+    wheel->count++;
+  }
+  timer->expiry   = expiry;
+  timer->callback = callback;
+  timer->context  = context;
+  wheel_file(wheel, timer);
+}
+
+bool alarm_wheel_cancel(alarm_wheel_t *wheel, alarm_wheel_timer_t *timer)
+{
+  if (!alarm_wheel_timer_pending(timer)) {
+    return false;
+  }
+  wheel_unlink(wheel, timer);
+  wheel->count--;
+  return true;
+}
+
+uint32_t alarm_wheel_advance(alarm_wheel_t *wheel, uint32_t now)
+{
+  alarm_wheel_timer_t *rearmed = NULL;
+  uint32_t fired               = wheel_run_expired(wheel, &rearmed);
+  uint32_t next;
+  uint32_t level;
+
+  while (now > wheel->now) {
+    if (!alarm_wheel_next_expiry(wheel, &next) || (next > now)) {
+      // Nothing occupied before the target, so every timer keeps sharing its
+      // higher digits with the new time and stays correctly filed.
+      wheel->now = now;
+      break;
+    }
+    wheel->now = next;
+
+    // Cascade top down: overflow first, then every level whose lower digits
+    // just rolled over to zero. Level 0 always "cascades" into the expired list.
+    if ((next & ((1ULL << TOP_SHIFT) - 1u)) == 0) {
+      wheel_refile_list(wheel, &wheel->overflow);
+    }
+    for (level = ALARM_WHEEL_LEVELS; level-- > 0;) {
+      if ((next & ((1ULL << LEVEL_SHIFT(level)) - 1u)) == 0) {
+        wheel_refile_list(wheel, &wheel->slots[level][(next >> LEVEL_SHIFT(level)) & ALARM_WHEEL_SLOT_MASK]);
+      }
+    }
+    fired += wheel_run_expired(wheel, &rearmed);
+  }
+  // Timers the callbacks re-armed at or before the current time
+  wheel_move_list(wheel, &rearmed, &wheel->expired);
+  return fired;
+}
+
+bool alarm_wheel_next_expiry(const alarm_wheel_t *wheel, uint32_t *expiry)
+{
+  uint64_t best  = UINT64_MAX;
+  uint64_t start = 0;
+  uint32_t level;
+
+  if (wheel->expired != NULL) {
+    *expiry = wheel->now;
+    return true;
+  }
+  for (level = 0; level < ALARM_WHEEL_LEVELS; level++) {
+    if (wheel->occupied[level] == 0) {
+      continue;
+    }
+    // Slot start: the current higher digits, this level's lowest occupied
+    // digit and zeros below. For level 0 that is the exact expiry.
+    start = ((uint64_t)wheel->now >> LEVEL_SHIFT(level + 1u)) << LEVEL_SHIFT(level + 1u);
+    start |= (uint64_t)__builtin_ctzll(wheel->occupied[level]) << LEVEL_SHIFT(level);
+    if (start < best) {
+      best = start;
+    }
+  }
+  if (wheel->overflow != NULL) {
+    start = (((uint64_t)wheel->now >> TOP_SHIFT) + 1u) << TOP_SHIFT;
+    if (start < best) {
+      best = start;
+    }
+  }
+  if (best > UINT32_MAX) {
+    return false;
+  }
+  *expiry = (uint32_t)best;
+  return true;
+}
+
+void alarm_wheel_step(alarm_wheel_t *wheel, uint32_t now)
+{
+  alarm_wheel_timer_t *pending = NULL;
+  alarm_wheel_timer_t *timer;
+  uint32_t level;
+  uint32_t slot;
+
+  // Detach everything into one chain, then re-file against the new time.
+  for (level = 0; level < ALARM_WHEEL_LEVELS; level++) {
+    for (slot = 0; slot < ALARM_WHEEL_SLOTS; slot++) {
+      while ((timer = wheel->slots[level][slot]) != NULL) {
+        wheel_unlink(wheel, timer);
+        timer->next = pending;
+        pending     = timer;
+      }
+    }
+  }
+  while ((timer = wheel->overflow) != NULL) {
+    wheel_unlink(wheel, timer);
+    timer->next = pending;
+    pending     = timer;
+  }
+  while ((timer = wheel->expired) != NULL) {
+    wheel_unlink(wheel, timer);
+    timer->next = pending;
+    pending     = timer;
+  }
+
+  wheel->now = now;
+  while ((timer = pending) != NULL) {
+    pending = timer->next;
+    wheel_file(wheel, timer);
+  }
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static void wheel_link(alarm_wheel_timer_t **head, alarm_wheel_timer_t *timer)
+{
+  timer->next = *head;
+  if (*head != NULL) {
+    (*head)->pprev = &timer->next;
+  }
+  *head        = timer;
+  timer->pprev = head;
+}
+
+static void wheel_unlink(alarm_wheel_t *wheel, alarm_wheel_timer_t *timer)
+{
+  *timer->pprev = timer->next;
+  if (timer->next != NULL) {
+    timer->next->pprev = timer->pprev;
+  }
+  timer->next  = NULL;
+  timer->pprev = NULL;
+  if ((timer->level < ALARM_WHEEL_LEVELS) && (wheel->slots[timer->level][timer->slot] == NULL)) {
+    wheel->occupied[timer->level] &= ~(1ULL << timer->slot);
+  }
+}
+
+/*******************************************************************************
+ * File a timer on the lowest level whose span still covers it, i.e. the first
+ * level above which expiry and the current time share all digits.
+ ******************************************************************************/
+static void wheel_file(alarm_wheel_t *wheel, alarm_wheel_timer_t *timer)
+{
+  uint32_t level;
+
+  if (timer->expiry <= wheel->now) {
+    timer->level = LEVEL_EXPIRED;
+    wheel_link(&wheel->expired, timer);
+    return;
+  }
+  for (level = 0; level < ALARM_WHEEL_LEVELS; level++) {
+    if (((uint64_t)timer->expiry >> LEVEL_SHIFT(level + 1u)) == ((uint64_t)wheel->now >> LEVEL_SHIFT(level + 1u))) {
+      timer->level = (uint8_t)level;
+      timer->slot  = (uint8_t)((timer->expiry >> LEVEL_SHIFT(level)) & ALARM_WHEEL_SLOT_MASK);
+      wheel_link(&wheel->slots[level][timer->slot], timer);
+      wheel->occupied[level] |= (1ULL << timer->slot);
+      return;
+    }
+  }
+  timer->level = LEVEL_OVERFLOW;
+  wheel_link(&wheel->overflow, timer);
+}
+
+static void wheel_refile_list(alarm_wheel_t *wheel, alarm_wheel_timer_t **head)
+{
+  alarm_wheel_timer_t *list = NULL;
+  alarm_wheel_timer_t *timer;
+
+  while ((timer = *head) != NULL) {
+    wheel_unlink(wheel, timer);
+    timer->next = list;
+    list        = timer;
+  }
+  while ((timer = list) != NULL) {
+    list = timer->next;
+    wheel_file(wheel, timer);
+  }
+}
+
+// Move a list keeping every timer pending, so it can still be cancelled
+static void wheel_move_list(alarm_wheel_t *wheel, alarm_wheel_timer_t **from, alarm_wheel_timer_t **to)
+{
+  alarm_wheel_timer_t *timer;
+
+  while ((timer = *from) != NULL) {
+    wheel_unlink(wheel, timer);
+    wheel_link(to, timer);
+  }
+}
+
+/*******************************************************************************
+ * Run the timers due now. The due list is taken first: a callback that re-arms
+ * at or before the current time files its timer on the expired list again, it
+ * is set aside on @p rearmed and fires on the next alarm_wheel_advance().
+ ******************************************************************************/
+static uint32_t wheel_run_expired(alarm_wheel_t *wheel, alarm_wheel_timer_t **rearmed)
+{
+  alarm_wheel_timer_t *due = NULL;
+  alarm_wheel_timer_t *timer;
+  uint32_t fired = 0;
+
+  wheel_move_list(wheel, &wheel->expired, &due);
+  // Unlink before the call so the callback may re-arm the same timer.
+  while ((timer = due) != NULL) {
+    wheel_unlink(wheel, timer);
+    wheel->count--;
+    timer->callback(timer, timer->context);
+    fired++;
+  }
+  wheel_move_list(wheel, &wheel->expired, rearmed);
+  return fired;
+}
@@ -0,0 +1,113 @@
+/***************************************************************************/ /**
+ * @file alarm_wheel.h
+ * @brief Hierarchical software alarm wheel keyed on UTC seconds
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef ALARM_WHEEL_H_
+#define ALARM_WHEEL_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+#define ALARM_WHEEL_SLOT_BITS 6u                             ///< 64 slots per level
+#define ALARM_WHEEL_SLOTS     (1u << ALARM_WHEEL_SLOT_BITS)
+#define ALARM_WHEEL_SLOT_MASK (ALARM_WHEEL_SLOTS - 1u)
+#define ALARM_WHEEL_LEVELS    4u                             ///< 64^4 s (~194 days) before overflow list
+
+// -----------------------------------------------------------------------------
+// Data Types
+struct alarm_wheel_timer;
+typedef void (*alarm_wheel_callback_t)(struct alarm_wheel_timer *timer, void *context);
+
+/// One software alarm. Storage is owned by the caller, the wheel only links it.
+typedef struct alarm_wheel_timer {
+  struct alarm_wheel_timer *next;
+  struct alarm_wheel_timer **pprev; ///< NULL while the timer is not pending
+  uint32_t expiry;                  ///< UTC seconds
+  uint8_t level;
+  uint8_t slot;
+  alarm_wheel_callback_t callback;
+  void *context;
+} alarm_wheel_timer_t;
+
+typedef struct {
+  uint32_t now;                                                      ///< Last processed UTC second
+  uint32_t count;                                                    ///< Pending timers
+  uint64_t occupied[ALARM_WHEEL_LEVELS];                             ///< Non-empty slot bitmap per level
+  alarm_wheel_timer_t *slots[ALARM_WHEEL_LEVELS][ALARM_WHEEL_SLOTS];
+  alarm_wheel_timer_t *overflow;                                     ///< Beyond the top level span
+  alarm_wheel_timer_t *expired;                                      ///< Due, fired on next advance
+} alarm_wheel_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Initialize an empty wheel whose current time is @p now (UTC seconds).
+ ******************************************************************************/
+void alarm_wheel_init(alarm_wheel_t *wheel, uint32_t now);
+
+/***************************************************************************/ /**
+ * Schedule @p timer to fire at @p expiry, O(1).
+ * A timer that is already pending is rescheduled. An expiry that is not in the
+ * future fires on the next alarm_wheel_advance() call, also when a callback
+ * re-arms its own timer that way.
+ ******************************************************************************/
+void alarm_wheel_insert(alarm_wheel_t *wheel,
+                        alarm_wheel_timer_t *timer,
+                        uint32_t expiry,
+                        alarm_wheel_callback_t callback,
+                        void *context);
+
+/***************************************************************************/ /**
+ * Remove a pending timer, O(1).
+ *
+ * @return true if the timer was pending
+ ******************************************************************************/
+bool alarm_wheel_cancel(alarm_wheel_t *wheel, alarm_wheel_timer_t *timer);
+
+/***************************************************************************/ /**
+ * Move the wheel forward to @p now and run every callback that became due.
+ * Empty stretches are skipped through the slot bitmaps, so a long sleep does
+ * not cost one iteration per second. Going backwards is ignored, use
+ * alarm_wheel_step() when the clock itself was stepped.
+ *
+ * @return number of callbacks run
+ ******************************************************************************/
+uint32_t alarm_wheel_advance(alarm_wheel_t *wheel, uint32_t now);
+
+/***************************************************************************/ /**
+ * Earliest time the wheel needs servicing: either a level 0 expiry or the
+ * boundary at which a higher level slot has to be cascaded. This is the value
+ * to program into the hardware alarm.
+ *
+ * @return false if no timer is pending
+ ******************************************************************************/
+bool alarm_wheel_next_expiry(const alarm_wheel_t *wheel, uint32_t *expiry);
+
+/***************************************************************************/ /**
+ * Re-base the wheel after the clock was stepped to @p now. Every pending timer
+ * is re-filed against its absolute expiry, those already due fire on the next
+ * alarm_wheel_advance(). O(pending timers), meant for the rare step only.
+ ******************************************************************************/
+void alarm_wheel_step(alarm_wheel_t *wheel, uint32_t now);
+
+static inline bool alarm_wheel_timer_pending(const alarm_wheel_timer_t *timer)
+{
+  return timer->pprev != NULL;
+}
+
+#endif /* ALARM_WHEEL_H_ */
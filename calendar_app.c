@@ -20,6 +20,21 @@
 #include "sl_si91x_clock_manager.h"
 #include "calendar_app.h"
 #include "sntp_app.h"
+#include "time_types.h"
+#if defined(HRTIME_STAMP) && (HRTIME_STAMP == ENABLE)
+#include "si91x_device.h"
+#include "hrtime.h"
+#endif
+#if defined(CLOCK_SOURCE_SELECT) && (CLOCK_SOURCE_SELECT == ENABLE)
+#include "clock_select.h"
+#include "nvm_store.h"
+#endif
+#if defined(CALIBRATION_TUNING) && (CALIBRATION_TUNING == ENABLE)
+#include "calib_ctrl.h"
+#endif
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+#include "holdover.h"
+#endif
 
 /*******************************************************************************
  ***************************  Defines / Macros  ********************************
@@ -30,6 +45,8 @@
 #define SECONDS_IN_HOUR     3600u      // Total seconds in one hour
 #define UNIX_TEST_TIMESTAMP 1723186800u // Unix Time Stamp for 09/08/2024, 15:00:00
 #define TAIPEI_TIME_ZONE_SHIFT 28800u
+#define CALENDAR_FIRST_YEAR 1900       // Year of Century 1, the RTC covers four centuries
+#define CALENDAR_CENTURIES  4
 #define MS_DEBUG_DELAY      1000u      // Debug prints after every 1000 counts (callback trigger)
 
 #define TEST_CENTURY      2u
@@ -52,19 +69,139 @@
 #define ALARM_SECONDS      15u
 #define ALARM_MILLISECONDS 100u
 
-#define CAL_RC_CLOCK 2u
-#define KHZ_XTAL_CLOCK 4u
+#define CLOCK_SELECT_WINDOW     21600u // Seconds each source is compared against NTP
+#define CLOCK_SELECT_BUDGET_PPB 50000u // Worst case frequency error allowed (50 ppm, ~4 s/day)
+#define RO_CLOCK_CURRENT_NA     200u   // Power cost of each source, replace with board measurements
+#define RC_CLOCK_CURRENT_NA     400u
+#define XTAL_CLOCK_CURRENT_NA   800u
+
+#define CALIBRATION_INITIAL_LEVEL 4u     // RC every 30 s, RO every 1 s
+#define CALIBRATION_BUDGET_PPB    20000u // Residual frequency error that triggers calibration
+#define CALIBRATION_MIN_BASELINE  3600u  // Seconds per estimate, NTP gives whole seconds only
+
+#define CALENDAR_SLEW_RATE_PPM     TIME_SLEW_RATE_PPM // Largest rate change while slewing, 128 ms take 256 s
+#define CALENDAR_STEP_THRESHOLD_US TIME_SLEW_STEP_US  // Offsets beyond this step the calendar
+#define CALENDAR_FOLD_US           1000000            // Correction moved into the RTC seconds once this large
+
+#define CALENDAR_HOLDOVER_TOLERANCE_PPB (2u * CLOCK_SELECT_BUDGET_PPB) // Untrimmed source, until the drift is learned
+#define CALENDAR_HOLDOVER_BASELINE      3600u // Seconds per frequency estimate, shorter is noise bound
+
+#define CALENDAR_QUALITY_HORIZON_S 3600u // Error growth is published for this far ahead, refreshes come sooner
+
+#if defined(CALIBRATION_TUNING) && (CALIBRATION_TUNING == ENABLE) \
+  && !(defined(CLOCK_CALIBRATION) && (CLOCK_CALIBRATION == ENABLE))
+#error "CALIBRATION_TUNING adjusts the clock calibration, enable CLOCK_CALIBRATION"
+#endif
+
+#if (CALENDAR_CLOCK_TYPE != CALENDAR_RO_CLOCK) && (CALENDAR_CLOCK_TYPE != CALENDAR_RC_CLOCK) \
+  && (CALENDAR_CLOCK_TYPE != CALENDAR_XTAL_CLOCK)
+#error "CALENDAR_CLOCK_TYPE must be CALENDAR_RO_CLOCK, CALENDAR_RC_CLOCK or CALENDAR_XTAL_CLOCK"
+#endif
 
 #define SOC_PLL_CLK  ((uint32_t)(180000000)) // 180MHz default SoC PLL Clock as source to Processor
 #define INTF_PLL_CLK ((uint32_t)(180000000)) // 180MHz default Interface PLL Clock as source to all peripherals
 
 #define PRINT_PERIOD (5)
 #define SET_PLL_CLOCK PLL_REF_CLK_VAL_XTAL
+
+#define ALARM_WHEEL_STACK_SIZE 2048u
+
+#define MICROS_PER_SECOND    1000000u
+#define HRTIME_RTC_AGREEMENT 2000u // Max us between interpolated and RTC time
+#define HRTIME_COUNTER()     (DWT->CYCCNT)
+
+#if defined(HRTIME_STAMP) && (HRTIME_STAMP == ENABLE) && !(defined(SEC_INTR) && (SEC_INTR == ENABLE))
+#error "HRTIME_STAMP calibrates on the one second trigger, enable SEC_INTR"
+#endif
+
+#if defined(ALARM_EXAMPLE) && (ALARM_EXAMPLE == ENABLE) && defined(ALARM_WHEEL) && (ALARM_WHEEL == ENABLE)
+#error "ALARM_EXAMPLE and ALARM_WHEEL both own the RTC alarm, enable only one"
+#endif
+
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE) && !(defined(TIME_STEERING) && (TIME_STEERING == ENABLE))
+#error "HOLDOVER_ENGINE applies its prediction through the slew, enable TIME_STEERING"
+#endif
 /*******************************************************************************
  *****************************  Local Variable  ********************************
  ******************************************************************************/
 time_t calendar_start;
 osSemaphoreId_t sem_calendar_update = NULL;
+static uint8_t calendar_clock       = CALENDAR_CLOCK_TYPE;
+static uint32_t calendar_steps      = 0; ///< Successful calendar_set_utc() calls
+static time_slew_t calendar_slew;          ///< RTC to calendar_get_utc_us(), under osKernelLock()
+static int64_t calendar_folded_us   = 0;   ///< Correction moved into the RTC since the last step
+static calendar_step_callback_t calendar_step_callback = NULL;
+static void *calendar_step_context                     = NULL;
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+static holdover_t holdover;                ///< Trained against RTC minus calendar_folded_us
+static bool holdover_active = false;
+#endif
+static time_quality_t calendar_reference;  ///< Last calendar_update_quality(), for the refreshes
+static time_quality_store_t calendar_quality;
+#if defined(CLOCK_SOURCE_SELECT) && (CLOCK_SOURCE_SELECT == ENABLE)
+static clock_select_t clock_select;
+static bool clock_select_running = false;
+static const uint8_t calendar_clock_of[CLOCK_SOURCE_COUNT] = {
+  [CLOCK_SOURCE_RO]   = CALENDAR_RO_CLOCK,
+  [CLOCK_SOURCE_RC]   = CALENDAR_RC_CLOCK,
+  [CLOCK_SOURCE_XTAL] = CALENDAR_XTAL_CLOCK,
+};
+static const char *clock_source_name[CLOCK_SOURCE_COUNT] = {
+  [CLOCK_SOURCE_RO]   = "RO",
+  [CLOCK_SOURCE_RC]   = "RC",
+  [CLOCK_SOURCE_XTAL] = "XTAL",
+};
+#endif
+#if defined(HRTIME_STAMP) && (HRTIME_STAMP == ENABLE)
+static hrtime_t hrtime;
+#endif
+#if defined(CLOCK_CALIBRATION) && (CLOCK_CALIBRATION == ENABLE)
+typedef struct {
+  uint8_t rc_trigger;
+  uint8_t ro_trigger;
+  const char *name;
+} calibration_level_t;
+
+// Indexed by calibration level, level 0 keeps only on-demand calibration
+static const calibration_level_t calibration_level[] = {
+  { SL_RC_FOUR_MIN, SL_RO_EIGHT_SEC, "on demand" },
+  { SL_RC_FOUR_MIN, SL_RO_EIGHT_SEC, "RC 4 min, RO 8 s" },
+  { SL_RC_TWO_MIN, SL_RO_FOUR_SEC, "RC 2 min, RO 4 s" },
+  { SL_RC_ONE_MIN, SL_RO_TWO_SEC, "RC 1 min, RO 2 s" },
+  { SL_RC_THIRTY_SEC, SL_RO_ONE_SEC, "RC 30 s, RO 1 s" },
+  { SL_RC_FIFTEEN_SEC, SL_RO_ONE_SEC, "RC 15 s, RO 1 s" },
+  { SL_RC_FIVE_SEC, SL_RO_ONE_SEC, "RC 5 s, RO 1 s" },
+};
+#define CALIBRATION_LEVELS (sizeof(calibration_level) / sizeof(calibration_level[0]))
+#endif
+#if defined(CALIBRATION_TUNING) && (CALIBRATION_TUNING == ENABLE)
+static calib_ctrl_t calib_ctrl;
+#endif
+#if defined(ALARM_WHEEL) && (ALARM_WHEEL == ENABLE)
+static alarm_wheel_t alarm_wheel;
+static osMutexId_t alarm_wheel_mutex    = NULL;
+static osSemaphoreId_t sem_alarm_wheel  = NULL;
+static uint32_t alarm_armed_utc         = 0;
+
+static const osMutexAttr_t alarm_wheel_mutex_attributes = {
+  .name      = "alarm_wheel",
+  .attr_bits = osMutexRecursive,
+  .cb_mem    = 0,
+  .cb_size   = 0,
+};
+
+static const osThreadAttr_t alarm_wheel_thread_attributes = {
+  .name       = "alarm_wheel",
+  .attr_bits  = 0,
+  .cb_mem     = 0,
+  .cb_size    = 0,
+  .stack_mem  = 0,
+  .stack_size = ALARM_WHEEL_STACK_SIZE,
+  .priority   = osPriorityBelowNormal,
+  .tz_module  = 0,
+  .reserved   = 0,
+};
+#endif
 /*******************************************************************************
  **********************  Local Function prototypes   ***************************
  ******************************************************************************/
@@ -82,38 +219,469 @@ boolean_t is_sec_callback_triggered = false;
 static void on_msec_callback(void);
 boolean_t is_msec_callback_triggered = false;
 #endif
+#if defined(ALARM_WHEEL) && (ALARM_WHEEL == ENABLE)
+static void on_wheel_alarm_callback(void);
+static void alarm_wheel_task(void *argument);
+static void alarm_wheel_rearm(void);
+#endif
+static uint64_t calendar_read_raw_us(void);
+static uint64_t calendar_steer(uint64_t raw_us);
+static sl_status_t calendar_write_rtc(time_t utc, uint64_t *raw_us);
+static void calendar_stepped(time_t utc, int64_t step_us);
+static void calendar_publish_quality(uint8_t state);
+#if defined(TIME_STEERING) && (TIME_STEERING == ENABLE)
+static time_slew_action_t calendar_correct(uint64_t sample_us, int64_t offset_us);
+static void calendar_fold(void);
+#endif
 static void default_clock_configuration(void);
+static bool calendar_clock_valid(uint8_t clock);
+static uint8_t calendar_initial_clock(void);
+#if defined(CLOCK_SOURCE_SELECT) && (CLOCK_SOURCE_SELECT == ENABLE)
+static void calendar_clock_select_sample(uint32_t sntp_utc, int32_t offset_ms);
+static void calendar_switch_clock(uint8_t clock, uint32_t utc);
+#endif
+#if defined(CLOCK_CALIBRATION) && (CLOCK_CALIBRATION == ENABLE)
+static sl_status_t calendar_apply_calibration(uint8_t level);
+#endif
+#if defined(CALIBRATION_TUNING) && (CALIBRATION_TUNING == ENABLE)
+static void calendar_calibration_sample(uint32_t sntp_utc, int32_t offset_ms);
+#endif
 /*******************************************************************************
  **************************   GLOBAL FUNCTIONS   *******************************
  ******************************************************************************/
 void unix_time_to_calendar(time_t unix, sl_calendar_datetime_config_t *date)
 {
-  struct tm *time = gmtime(&unix);
+  civil_time_t time = civil_from_unix(unix_time_from_s((int64_t)unix));
 
-  date->Century = ((time->tm_year / 100) % 4) + 1;
-  date->Year    = (time->tm_year % 100);
-  date->Month   = (time->tm_mon + 1);
-  date->Day     = time->tm_mday;
-  date->Hour    = time->tm_hour;
-  date->Minute  = time->tm_min;
-  date->Second  = time->tm_sec;
+  date->Century = (uint8_t)(((time.year - CALENDAR_FIRST_YEAR) / 100 + 1) % CALENDAR_CENTURIES);
+  date->Year    = (uint8_t)(time.year % 100);
+  date->Month   = time.month;
+  date->Day     = time.day;
+  date->Hour    = time.hour;
+  date->Minute  = time.minute;
+  date->Second  = time.second;
   date->MilliSeconds = 0;
-  date->DayOfWeek = time->tm_wday;
+  date->DayOfWeek = time.weekday;
 }
 
 time_t calendar_time_to_unix(const sl_calendar_datetime_config_t date)
 {
-  struct tm time_s;
+  civil_time_t time = { 0 };
 
-  time_s.tm_year = (date.Year + 100);  // tm_year start from 1900
-  time_s.tm_mon  = (date.Month - 1);
-  time_s.tm_mday = date.Day;
-  time_s.tm_hour = date.Hour;
-  time_s.tm_min  = date.Minute;
-  time_s.tm_sec  = date.Second;
-  return mktime(&time_s);
+  // Century 1 is the 1900s, the field wraps after four
+  time.year   = CALENDAR_FIRST_YEAR + ((date.Century + CALENDAR_CENTURIES - 1) % CALENDAR_CENTURIES) * 100 + date.Year;
+  time.month  = date.Month;
+  time.day    = date.Day;
+  time.hour   = date.Hour;
+  time.minute = date.Minute;
+  time.second = date.Second;
+  return (time_t)unix_time_s(civil_to_unix(time));
 }
 
+time_t calendar_get_utc(void)
+{
+  sl_calendar_datetime_config_t rtc_time;
+
+  sl_si91x_calendar_get_date_time(&rtc_time);
+  return calendar_time_to_unix(rtc_time) - TAIPEI_TIME_ZONE_SHIFT;
+}
+
+uint64_t calendar_get_utc_us(void)
+{
+  return calendar_steer(calendar_read_raw_us());
+}
+
+bool calendar_get_utc_us_interpolated(uint64_t *utc_us)
+{
+#if defined(HRTIME_STAMP) && (HRTIME_STAMP == ENABLE)
+  uint64_t raw_us;
+
+  if (!hrtime_read_us(&hrtime, HRTIME_COUNTER(), &raw_us)) {
+    return false;
+  }
+  *utc_us = calendar_steer(raw_us);
+  return true;
+#else
+  UNUSED_PARAMETER(utc_us);
+  return false;
+#endif
+}
+
+sl_status_t calendar_set_utc(time_t utc)
+{
+  uint64_t before_us = calendar_get_utc_us();
+  uint64_t raw_us;
+  sl_status_t status;
+  int32_t lock;
+
+  status = calendar_write_rtc(utc, &raw_us);
+  if (status != SL_STATUS_OK) {
+    return status;
+  }
+  lock = osKernelLock();
+  time_slew_rebase(&calendar_slew, raw_us, (uint64_t)utc * MICROS_PER_SECOND);
+  osKernelRestoreLock(lock);
+  calendar_stepped(utc, (int64_t)((uint64_t)utc * MICROS_PER_SECOND - before_us));
+  return SL_STATUS_OK;
+}
+
+uint32_t calendar_step_count(void)
+{
+  return calendar_steps;
+}
+
+time_slew_action_t calendar_adjust(uint64_t sample_us, int64_t offset_us, uint32_t error_us)
+{
+#if defined(TIME_STEERING) && (TIME_STEERING == ENABLE)
+  time_slew_action_t action;
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+  uint64_t raw_us = calendar_read_raw_us();
+  uint64_t sample_raw_us;
+  int64_t correction_us;
+  int64_t folded_us;
+  int32_t lock;
+
+  // The model learns the free running oscillator, as it was at the sample
+  lock          = osKernelLock();
+  sample_raw_us = (uint64_t)((int64_t)sample_us - time_slew_correction_us(&calendar_slew, raw_us));
+  correction_us = time_slew_correction_us(&calendar_slew, sample_raw_us);
+  folded_us     = calendar_folded_us;
+  osKernelRestoreLock(lock);
+#else
+  UNUSED_PARAMETER(error_us);
+#endif
+
+  action = calendar_correct(sample_us, offset_us);
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+  // A step restarted the model, the sample belongs to the old time
+  if (action == TIME_SLEW_SLEWING) {
+    holdover_update(&holdover,
+                    (uint64_t)((int64_t)sample_raw_us - folded_us),
+                    offset_us + folded_us + correction_us,
+                    error_us);
+    holdover_active = false;
+  }
+#endif
+  return action;
+#else
+  UNUSED_PARAMETER(sample_us);
+  UNUSED_PARAMETER(offset_us);
+  UNUSED_PARAMETER(error_us);
+  return TIME_SLEW_STALE;
+#endif
+}
+
+void calendar_holdover(void)
+{
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+  uint64_t raw_us = calendar_read_raw_us();
+  uint64_t now_us;
+  int64_t correction_us;
+  int64_t offset_us;
+  bool predicted;
+  int32_t lock;
+
+  lock          = osKernelLock();
+  correction_us = calendar_folded_us + time_slew_correction_us(&calendar_slew, raw_us);
+  now_us        = (uint64_t)((int64_t)raw_us + time_slew_correction_us(&calendar_slew, raw_us));
+  predicted     = holdover_predict(&holdover, (uint64_t)((int64_t)raw_us - calendar_folded_us), &offset_us);
+  osKernelRestoreLock(lock);
+  if (!predicted) {
+    return;
+  }
+  holdover_active = true;
+  // Predicted for the oscillator, the calendar is ahead of it by the correction
+  calendar_correct(now_us, offset_us - correction_us);
+  if (calendar_reference.state != TIME_QUALITY_UNSYNCED) {
+    calendar_publish_quality(TIME_QUALITY_HOLDOVER);
+  }
+#endif
+}
+
+bool calendar_in_holdover(void)
+{
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+  return holdover_active;
+#else
+  return false;
+#endif
+}
+
+uint32_t calendar_uncertainty_us(void)
+{
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+  uint64_t raw_us = calendar_read_raw_us();
+  uint64_t bound_us;
+  int64_t remaining_us;
+  int32_t lock;
+
+  lock         = osKernelLock();
+  bound_us     = holdover_bound_us(&holdover, (uint64_t)((int64_t)raw_us - calendar_folded_us));
+  remaining_us = time_slew_remaining_us(&calendar_slew, raw_us, NULL);
+  osKernelRestoreLock(lock);
+  bound_us += (uint64_t)((remaining_us < 0) ? -remaining_us : remaining_us);
+  return (bound_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)bound_us;
+#else
+  return UINT32_MAX;
+#endif
+}
+
+void calendar_update_quality(const time_quality_t *reference)
+{
+  calendar_reference = *reference;
+  calendar_publish_quality(reference->state);
+}
+
+void calendar_get_quality(time_quality_t *quality)
+{
+  time_quality_read(&calendar_quality, quality);
+}
+
+int64_t calendar_correction_us(void)
+{
+  uint64_t raw_us = calendar_read_raw_us();
+  int64_t correction_us;
+  int32_t lock;
+
+  lock          = osKernelLock();
+  correction_us = calendar_folded_us + time_slew_correction_us(&calendar_slew, raw_us);
+  osKernelRestoreLock(lock);
+  return correction_us;
+}
+
+void calendar_on_step(calendar_step_callback_t callback, void *context)
+{
+  calendar_step_context  = context;
+  calendar_step_callback = callback;
+}
+
+#if defined(ALARM_WHEEL) && (ALARM_WHEEL == ENABLE)
+sl_status_t calendar_alarm_start(alarm_wheel_timer_t *timer,
+                                 uint32_t utc,
+                                 alarm_wheel_callback_t callback,
+                                 void *context)
+{
+  if (alarm_wheel_mutex == NULL) {
+    return SL_STATUS_NOT_READY;
+  }
+  osMutexAcquire(alarm_wheel_mutex, osWaitForever);
+  alarm_wheel_insert(&alarm_wheel, timer, utc, callback, context);
+  alarm_wheel_rearm();
+  osMutexRelease(alarm_wheel_mutex);
+  return SL_STATUS_OK;
+}
+
+sl_status_t calendar_alarm_cancel(alarm_wheel_timer_t *timer)
+{
+  bool pending;
+
+  if (alarm_wheel_mutex == NULL) {
+    return SL_STATUS_NOT_READY;
+  }
+  osMutexAcquire(alarm_wheel_mutex, osWaitForever);
+  pending = alarm_wheel_cancel(&alarm_wheel, timer);
+  // The RTC alarm may stay armed for the cancelled expiry, the wheel thread
+  // then wakes once for nothing and re-arms for the real next one.
+  osMutexRelease(alarm_wheel_mutex);
+  return pending ? SL_STATUS_OK : SL_STATUS_NOT_FOUND;
+}
+#endif
+
+// Function to read the RTC as UTC microseconds, before any correction
+static uint64_t calendar_read_raw_us(void)
+{
+  sl_calendar_datetime_config_t rtc_time;
+  uint64_t rtc_micros;
+#if defined(HRTIME_STAMP) && (HRTIME_STAMP == ENABLE)
+  uint64_t micros;
+  bool valid = hrtime_read_us(&hrtime, HRTIME_COUNTER(), &micros);
+#endif
+
+  sl_si91x_calendar_get_date_time(&rtc_time);
+  rtc_micros = (uint64_t)(calendar_time_to_unix(rtc_time) - TAIPEI_TIME_ZONE_SHIFT) * MICROS_PER_SECOND
+               + (uint64_t)rtc_time.MilliSeconds * 1000u;
+#if defined(HRTIME_STAMP) && (HRTIME_STAMP == ENABLE)
+  // The cycle counter halts in deep sleep, until the next second edge
+  // re-anchors it the interpolation lags. Trust it only while it agrees.
+  if (valid && (micros + HRTIME_RTC_AGREEMENT > rtc_micros) && (micros < rtc_micros + HRTIME_RTC_AGREEMENT)) {
+    return micros;
+  }
+#endif
+  return rtc_micros;
+}
+
+// Function to apply the correction, the kernel lock keeps readers of other
+// threads from seeing a half updated slew or an older last value
+static uint64_t calendar_steer(uint64_t raw_us)
+{
+  uint64_t micros;
+  int32_t lock;
+
+  lock   = osKernelLock();
+  micros = time_slew_read(&calendar_slew, raw_us);
+  osKernelRestoreLock(lock);
+  return micros;
+}
+
+// Function to write the RTC seconds, the sub-second count restarts at 0
+static sl_status_t calendar_write_rtc(time_t utc, uint64_t *raw_us)
+{
+  sl_calendar_datetime_config_t datetime_config;
+  sl_status_t status;
+
+  unix_time_to_calendar(utc + TAIPEI_TIME_ZONE_SHIFT, &datetime_config);
+  status = sl_si91x_calendar_set_date_time(&datetime_config);
+  if (status != SL_STATUS_OK) {
+    DEBUGOUT("sl_si91x_calendar_set_date_time: Invalid Parameters, Error Code : %lu \r\n", status);
+    return status;
+  }
+  *raw_us = calendar_read_raw_us();
+  return SL_STATUS_OK;
+}
+
+// Function to tell everything that depends on a continuous calendar
+static void calendar_stepped(time_t utc, int64_t step_us)
+{
+  calendar_steps++;
+  calendar_folded_us = 0;
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+  holdover_restart(&holdover);
+#endif
+#if defined(CALIBRATION_TUNING) && (CALIBRATION_TUNING == ENABLE)
+  calib_ctrl_restart(&calib_ctrl);
+#endif
+#if defined(ALARM_WHEEL) && (ALARM_WHEEL == ENABLE)
+  if (alarm_wheel_mutex != NULL) {
+    osMutexAcquire(alarm_wheel_mutex, osWaitForever);
+    alarm_wheel_step(&alarm_wheel, (uint32_t)utc);
+    alarm_armed_utc = 0;
+    alarm_wheel_rearm();
+    osMutexRelease(alarm_wheel_mutex);
+  }
+#endif
+  if (calendar_reference.state != TIME_QUALITY_UNSYNCED) {
+    // The snapshot times move with the calendar
+    calendar_reference.sync_us = (uint64_t)((int64_t)calendar_reference.sync_us + step_us);
+    calendar_publish_quality(calendar_in_holdover() ? TIME_QUALITY_HOLDOVER : calendar_reference.state);
+  }
+  if (calendar_step_callback != NULL) {
+    calendar_step_callback(step_us, calendar_step_context);
+  }
+}
+
+// Function to refresh the error bound of the snapshot and publish it. The
+// bound is convex in time, so its chord to the horizon stays above it for
+// every read until the next refresh.
+static void calendar_publish_quality(uint8_t state)
+{
+  time_quality_t quality = calendar_reference;
+  uint64_t raw_us        = calendar_read_raw_us();
+  uint64_t elapsed_s;
+  uint64_t grown_us;
+  uint64_t ahead_us;
+  uint64_t bound_us;
+  int64_t remaining_us;
+  bool learned = false;
+  int32_t lock;
+
+  lock              = osKernelLock();
+  quality.update_us = (uint64_t)((int64_t)raw_us + time_slew_correction_us(&calendar_slew, raw_us));
+  remaining_us      = time_slew_remaining_us(&calendar_slew, raw_us, NULL);
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+  if (holdover.have_anchor) {
+    raw_us   = (uint64_t)((int64_t)raw_us - calendar_folded_us);
+    grown_us = holdover_bound_us(&holdover, raw_us) - holdover.anchor_error_us;
+    ahead_us = holdover_bound_us(&holdover, raw_us + (uint64_t)CALENDAR_QUALITY_HORIZON_S * MICROS_PER_SECOND)
+               - holdover.anchor_error_us;
+    learned = true;
+  }
+#endif
+  osKernelRestoreLock(lock);
+  if (!learned) {
+    // Nothing measured yet, grow with the tolerance, or as RFC 5905 does
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+    quality.growth_ppb = CALENDAR_HOLDOVER_TOLERANCE_PPB;
+#else
+    quality.growth_ppb = TIME_QUALITY_PHI_PPB;
+#endif
+    elapsed_s = (quality.update_us > quality.sync_us) ? ((quality.update_us - quality.sync_us) / MICROS_PER_SECOND) : 0u;
+    grown_us  = (elapsed_s * quality.growth_ppb) / 1000u;
+  } else {
+    quality.growth_ppb = (uint32_t)(((ahead_us - grown_us) * 1000u) / CALENDAR_QUALITY_HORIZON_S);
+  }
+  bound_us = (uint64_t)calendar_reference.error_us + grown_us
+             + (uint64_t)((remaining_us < 0) ? -remaining_us : remaining_us);
+  quality.error_us = (bound_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)bound_us;
+  quality.state    = state;
+  time_quality_publish(&calendar_quality, &quality);
+}
+
+#if defined(TIME_STEERING) && (TIME_STEERING == ENABLE)
+// Function to slew or step by one offset, learning nothing from it
+static time_slew_action_t calendar_correct(uint64_t sample_us, int64_t offset_us)
+{
+  uint64_t raw_us = calendar_read_raw_us();
+  uint64_t before_us;
+  uint64_t now_us;
+  time_slew_action_t action;
+  int32_t lock;
+
+  lock      = osKernelLock();
+  before_us = (uint64_t)((int64_t)raw_us + time_slew_correction_us(&calendar_slew, raw_us));
+  action    = time_slew_adjust(&calendar_slew, raw_us, sample_us, offset_us);
+  now_us    = (uint64_t)((int64_t)raw_us + time_slew_correction_us(&calendar_slew, raw_us));
+  osKernelRestoreLock(lock);
+  if (action == TIME_SLEW_STEPPED) {
+    // The RTC seconds follow, the fraction stays in the correction
+    if (calendar_write_rtc((time_t)(now_us / MICROS_PER_SECOND), &raw_us) == SL_STATUS_OK) {
+      lock = osKernelLock();
+      time_slew_rebase(&calendar_slew, raw_us, now_us);
+      osKernelRestoreLock(lock);
+    }
+    calendar_stepped((time_t)(now_us / MICROS_PER_SECOND), (int64_t)(now_us - before_us));
+  } else if (action == TIME_SLEW_SLEWING) {
+    calendar_fold();
+  }
+  return action;
+}
+
+// Function to move whole seconds of correction into the RTC, so RTC seconds
+// and alarms keep within a second of the corrected time. Not a step: the
+// corrected time continues from where it was.
+static void calendar_fold(void)
+{
+  uint64_t before_raw_us = calendar_read_raw_us();
+  uint64_t after_raw_us;
+  int64_t correction_us;
+  int32_t lock;
+
+  lock          = osKernelLock();
+  correction_us = time_slew_correction_us(&calendar_slew, before_raw_us);
+  osKernelRestoreLock(lock);
+  if ((correction_us < CALENDAR_FOLD_US) && (correction_us > -CALENDAR_FOLD_US)) {
+    return;
+  }
+  if (calendar_write_rtc((time_t)(before_raw_us / MICROS_PER_SECOND) + (time_t)(correction_us / CALENDAR_FOLD_US),
+                         &after_raw_us)
+      != SL_STATUS_OK) {
+    return;
+  }
+  lock = osKernelLock();
+  time_slew_shift(&calendar_slew, (int64_t)(after_raw_us - before_raw_us));
+  osKernelRestoreLock(lock);
+  calendar_folded_us += (int64_t)(after_raw_us - before_raw_us);
+#if defined(ALARM_WHEEL) && (ALARM_WHEEL == ENABLE)
+  if (alarm_wheel_mutex != NULL) {
+    osMutexAcquire(alarm_wheel_mutex, osWaitForever);
+    alarm_armed_utc = 0;
+    alarm_wheel_rearm();
+    osMutexRelease(alarm_wheel_mutex);
+  }
+#endif
+  DEBUGOUT("Calendar: %ld ms of correction moved into the RTC\r\n", (int32_t)((after_raw_us - before_raw_us) / 1000));
+}
+#endif
+
 // Function to configure clock on powerup
 static void default_clock_configuration(void)
 {
@@ -139,23 +707,204 @@ static void default_clock_configuration(void)
   }
 }
 
+static bool calendar_clock_valid(uint8_t clock)
+{
+  return (clock == CALENDAR_RO_CLOCK) || (clock == CALENDAR_RC_CLOCK) || (clock == CALENDAR_XTAL_CLOCK);
+}
+
+// Function to pick the calendar clock: persisted choice, source under test or default
+static uint8_t calendar_initial_clock(void)
+{
+#if defined(CLOCK_SOURCE_SELECT) && (CLOCK_SOURCE_SELECT == ENABLE)
+  static const uint32_t current_na[CLOCK_SOURCE_COUNT] = {
+    [CLOCK_SOURCE_RO]   = RO_CLOCK_CURRENT_NA,
+    [CLOCK_SOURCE_RC]   = RC_CLOCK_CURRENT_NA,
+    [CLOCK_SOURCE_XTAL] = XTAL_CLOCK_CURRENT_NA,
+  };
+  clock_select_record_t record;
+
+  if ((nvm_store_read(NVM_STORE_KEY_CLOCK_SELECT, &record, sizeof(record)) == SL_STATUS_OK)
+      && (record.version == CLOCK_SELECT_RECORD_VERSION) && (record.selected < CLOCK_SOURCE_COUNT)
+      && (record.budget_ppb == CLOCK_SELECT_BUDGET_PPB)) {
+    DEBUGOUT("Calendar clock %s from stored characterization\r\n", clock_source_name[record.selected]);
+    return calendar_clock_of[record.selected];
+  }
+  clock_select_init(&clock_select, CLOCK_SELECT_WINDOW, CLOCK_SELECT_BUDGET_PPB, current_na);
+  clock_select_running = true;
+  DEBUGOUT("Characterizing calendar clock sources against NTP, starting with %s\r\n",
+           clock_source_name[clock_select_source(&clock_select)]);
+  return calendar_clock_of[clock_select_source(&clock_select)];
+#else
+  return CALENDAR_CLOCK_TYPE;
+#endif
+}
+
+#if defined(CLOCK_SOURCE_SELECT) && (CLOCK_SOURCE_SELECT == ENABLE)
+// Function to feed one NTP comparison to a running characterization
+static void calendar_clock_select_sample(uint32_t sntp_utc, int32_t offset_ms)
+{
+  const clock_source_result_t *result;
+  clock_select_action_t action;
+  uint32_t i;
+
+  if (!clock_select_running) {
+    return;
+  }
+  action = clock_select_add_sample(&clock_select, sntp_utc, offset_ms);
+  if (action == CLOCK_SELECT_CONTINUE) {
+    return;
+  }
+  if (action == CLOCK_SELECT_DONE) {
+    clock_select_running = false;
+    for (i = 0; i < CLOCK_SOURCE_COUNT; i++) {
+      result = &clock_select.record.result[i];
+      DEBUGOUT("Clock %-4s: %ld ppb +- %lu, wander %lu us, %lu nA, %u samples%s\r\n",
+               clock_source_name[i],
+               result->freq_ppb,
+               result->uncertainty_ppb,
+               result->wander_us,
+               result->current_na,
+               result->samples,
+               result->meets_budget ? ", within budget" : "");
+    }
+    DEBUGOUT("Selected calendar clock %s\r\n", clock_source_name[clock_select.record.selected]);
+    nvm_store_write(NVM_STORE_KEY_CLOCK_SELECT, &clock_select.record, sizeof(clock_select.record));
+  }
+  calendar_switch_clock(calendar_clock_of[clock_select_source(&clock_select)], sntp_utc);
+}
+
+// Function to move the running calendar to another clock source
+static void calendar_switch_clock(uint8_t clock, uint32_t utc)
+{
+  sl_status_t status;
+
+  sl_si91x_calendar_rtc_stop();
+  status = sl_si91x_calendar_set_configuration(clock);
+  sl_si91x_calendar_rtc_start();
+  if (status != SL_STATUS_OK) {
+    DEBUGOUT("sl_si91x_calendar_set_configuration: Invalid Parameters, Error Code : %lu \r\n", status);
+    return;
+  }
+  calendar_clock = clock;
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+  holdover_retune(&holdover);
+#endif
+  calendar_set_utc((time_t)utc);
+  DEBUGOUT("Calendar switched to clock %u\r\n", calendar_clock);
+}
+#endif
+
+#if defined(CLOCK_CALIBRATION) && (CLOCK_CALIBRATION == ENABLE)
+// Function to calibrate RC/RO now and program the periodic triggers of a level
+static sl_status_t calendar_apply_calibration(uint8_t level)
+{
+  clock_calibration_config_t clock_calibration_config;
+  sl_status_t status;
+
+  if (level >= CALIBRATION_LEVELS) {
+    level = CALIBRATION_LEVELS - 1u;
+  }
+  clock_calibration_config.rc_enable_calibration          = true;
+  clock_calibration_config.rc_enable_periodic_calibration = (level != 0);
+  clock_calibration_config.rc_trigger_time                = calibration_level[level].rc_trigger;
+  clock_calibration_config.ro_enable_calibration          = true;
+  clock_calibration_config.ro_enable_periodic_calibration = (level != 0);
+  clock_calibration_config.ro_trigger_time                = calibration_level[level].ro_trigger;
+  status = sl_si91x_calendar_rcclk_calibration(&clock_calibration_config);
+  if (status != SL_STATUS_OK) {
+    DEBUGOUT("sl_si91x_calendar_rcclk_calibration: Invalid Parameters, Error Code : %lu \r\n", status);
+  }
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+  // The trim moved the frequency the model learned
+  holdover_retune(&holdover);
+#endif
+  return status;
+}
+#endif
+
+#if defined(CALIBRATION_TUNING) && (CALIBRATION_TUNING == ENABLE)
+// Function to feed one NTP comparison to the calibration controller
+static void calendar_calibration_sample(uint32_t sntp_utc, int32_t offset_ms)
+{
+  calib_ctrl_action_t action;
+
+#if defined(CLOCK_SOURCE_SELECT) && (CLOCK_SOURCE_SELECT == ENABLE)
+  if (clock_select_running) {
+    // Changing calibration would skew the characterization
+    return;
+  }
+#endif
+  action = calib_ctrl_add_sample(&calib_ctrl, sntp_utc, offset_ms);
+  if (action == CALIB_CTRL_KEEP) {
+    return;
+  }
+  if (action == CALIB_CTRL_APPLY) {
+    DEBUGOUT("Residual %ld ppb, calibration %s\r\n", calib_ctrl.freq_ppb, calibration_level[calib_ctrl.level].name);
+  } else {
+    DEBUGOUT("Residual %ld ppb over budget, calibrating\r\n", calib_ctrl.freq_ppb);
+  }
+  calendar_apply_calibration(calib_ctrl.level);
+}
+#endif
+
 void calendar_compare_time(char* data)
 {
-  static uint32 last_sntp_time = 0;
-  sl_calendar_datetime_config_t rtc_time;
-  sl_si91x_calendar_get_date_time(&rtc_time);
   uint32_t sntp_time = sntp_get_time_to_calendar(data);
 
+  calendar_compare_offset(sntp_time, (int32_t)((int64_t)(calendar_get_utc_us() / 1000u) - (int64_t)sntp_time * 1000));
+}
+
+void calendar_compare_offset(uint32_t sntp_time, int32_t offset_ms)
+{
+  static uint32 last_sntp_time = 0;
+#if defined(TIME_STEERING) && (TIME_STEERING == ENABLE)
+  uint32_t remaining_ms;
+  int64_t remaining_us;
+#endif
+
   if(sntp_time == last_sntp_time)
   {
     DEBUGOUT("SNTP get time as last one. Pass\r\n");
     return;
   }
   last_sntp_time = sntp_time;
-  sntp_time += TAIPEI_TIME_ZONE_SHIFT;
-  uint32_t rtc_count = (uint32_t)calendar_time_to_unix(rtc_time);
-  int32_t diff =  rtc_count - sntp_time;
-  DEBUGOUT("RTC  time %11lu\r\nSNTP time %11lu\r\n     Diff %11ld\r\n",rtc_count, sntp_time, diff );
+#if defined(TIME_STEERING) && (TIME_STEERING == ENABLE)
+  // Calibration and clock selection look at the oscillator, not the steering
+  offset_ms -= (int32_t)(calendar_correction_us() / 1000);
+#endif
+#if defined(CALIBRATION_TUNING) && (CALIBRATION_TUNING == ENABLE)
+  calendar_calibration_sample(sntp_time, offset_ms);
+#endif
+#if defined(CLOCK_SOURCE_SELECT) && (CLOCK_SOURCE_SELECT == ENABLE)
+  calendar_clock_select_sample(sntp_time, offset_ms);
+#endif
+  DEBUGOUT("SNTP time %11lu\r\n     Diff %8ld ms\r\n", sntp_time + TAIPEI_TIME_ZONE_SHIFT, offset_ms);
+#if defined(HRTIME_STAMP) && (HRTIME_STAMP == ENABLE)
+  DEBUGOUT("hrtime: %lu Hz, max edge error %lu us, %lu rejected, %lu second interrupts (1 ms trigger: %lu)\r\n",
+           hrtime.rate,
+           (uint32_t)(((uint64_t)hrtime.max_residual * MICROS_PER_SECOND) / hrtime.rate),
+           hrtime.rejected,
+           hrtime.edges,
+           hrtime.edges * 1000u);
+#endif
+#if defined(TIME_STEERING) && (TIME_STEERING == ENABLE)
+  remaining_us = time_slew_remaining_us(&calendar_slew, calendar_read_raw_us(), &remaining_ms);
+  DEBUGOUT("Slew: %ld us left for %lu ms, %lu slews, %lu steps, %lu stale, %lu clamped\r\n",
+           (int32_t)remaining_us,
+           remaining_ms,
+           calendar_slew.slews,
+           calendar_slew.steps,
+           calendar_slew.stale,
+           calendar_slew.clamped);
+#endif
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+  DEBUGOUT("Holdover: %ld ppb, aging %ld ppb/day, deviation %lu ppb, %lu estimates, uncertainty %lu us\r\n",
+           holdover.freq_ppb,
+           holdover.aging_ppb,
+           holdover.freq_dev_ppb,
+           holdover.estimates,
+           calendar_uncertainty_us());
+#endif
 }
 
 /*******************************************************************************
@@ -176,10 +925,24 @@ void calendar_init(time_t sntp_get_time)
   // default clock configuration by application common for whole system
   default_clock_configuration();
 
+#if defined(HRTIME_STAMP) && (HRTIME_STAMP == ENABLE)
+  // Free-running core cycle counter as the interpolation timebase
+  hrtime_init(&hrtime, SOC_PLL_CLK);
+  // Already counting for the boot timeline, left running
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+  calendar_clock = calendar_initial_clock();
+  if (!calendar_clock_valid(calendar_clock)) {
+    DEBUGOUT("Invalid calendar clock %u, using %u\r\n", calendar_clock, CALENDAR_CLOCK_TYPE);
+    calendar_clock = CALENDAR_CLOCK_TYPE;
+  }
+
   do
   {
     //Configuration of clock and initialization of calendar
-    status = sl_si91x_calendar_set_configuration(KHZ_XTAL_CLOCK); // todo: try KHZ_XTAL_CLK_SEL (4)
+    status = sl_si91x_calendar_set_configuration(calendar_clock);
     if (status != SL_STATUS_OK) {
       DEBUGOUT("sl_si91x_calendar_set_configuration: Invalid Parameters, Error Code : %lu \r\n", status);
       break;
@@ -211,6 +974,11 @@ void calendar_init(time_t sntp_get_time)
       break;
     }
     DEBUGOUT("Successfully set calendar datetime\r\n");
+    time_slew_init(&calendar_slew, CALENDAR_SLEW_RATE_PPM, CALENDAR_STEP_THRESHOLD_US);
+    time_slew_rebase(&calendar_slew, calendar_read_raw_us(), (uint64_t)sntp_get_time * MICROS_PER_SECOND);
+#if defined(HOLDOVER_ENGINE) && (HOLDOVER_ENGINE == ENABLE)
+    holdover_init(&holdover, CALENDAR_HOLDOVER_TOLERANCE_PPB, CALENDAR_HOLDOVER_BASELINE);
+#endif
     // Printing datetime for Calendar
     status = sl_si91x_calendar_get_date_time(&get_datetime);
     if (status != SL_STATUS_OK) {
@@ -224,18 +992,17 @@ void calendar_init(time_t sntp_get_time)
 #if defined(CLOCK_CALIBRATION) && (CLOCK_CALIBRATION == ENABLE)
     //Clock Calibration
     sl_si91x_calendar_calibration_init();
-    clock_calibration_config_t clock_calibration_config;
-    clock_calibration_config.rc_enable_calibration          = true;
-    clock_calibration_config.rc_enable_periodic_calibration = true;
-    clock_calibration_config.rc_trigger_time                = SL_RC_THIRTY_SEC;
-    clock_calibration_config.ro_enable_calibration          = true;
-    clock_calibration_config.ro_enable_periodic_calibration = true;
-    clock_calibration_config.ro_trigger_time                = SL_RO_ONE_SEC;
-    status = sl_si91x_calendar_rcclk_calibration(&clock_calibration_config);
+    status = calendar_apply_calibration(CALIBRATION_INITIAL_LEVEL);
     if (status != SL_STATUS_OK) {
-      DEBUGOUT("sl_si91x_calendar_rcclk_calibration: Invalid Parameters, Error Code : %lu \r\n", status);
       break;
     }
+#if defined(CALIBRATION_TUNING) && (CALIBRATION_TUNING == ENABLE)
+    calib_ctrl_init(&calib_ctrl,
+                    CALIBRATION_BUDGET_PPB,
+                    CALIBRATION_MIN_BASELINE,
+                    CALIBRATION_INITIAL_LEVEL,
+                    (uint8_t)(CALIBRATION_LEVELS - 1u));
+#endif
     DEBUGOUT("Successfully performed clock calibration \r\n");
     sl_si91x_calendar_rtc_start();
 #endif
@@ -281,6 +1048,19 @@ void calendar_init(time_t sntp_get_time)
     DEBUGOUT("\r\n");
 #endif
 
+#if defined(ALARM_WHEEL) && (ALARM_WHEEL == ENABLE)
+    status = sl_si91x_calendar_register_alarm_trigger_callback(on_wheel_alarm_callback);
+    if (status != SL_STATUS_OK) {
+      DEBUGOUT("sl_si91x_calendar_register_alarm_trigger_callback: Invalid Parameters, Error Code : %lu \r\n", status);
+      break;
+    }
+    alarm_wheel_init(&alarm_wheel, (uint32_t)sntp_get_time);
+    sem_alarm_wheel   = osSemaphoreNew(1, 0, NULL);
+    alarm_wheel_mutex = osMutexNew(&alarm_wheel_mutex_attributes);
+    osThreadNew((osThreadFunc_t)alarm_wheel_task, NULL, &alarm_wheel_thread_attributes);
+    DEBUGOUT("Successfully started alarm wheel \r\n");
+#endif
+
 #if defined(SEC_INTR) && (SEC_INTR == ENABLE)
     //One second trigger
     status = sl_si91x_calendar_register_sec_trigger_callback(on_sec_callback);
@@ -383,6 +1163,79 @@ static void on_alarm_callback(void)
 }
 #endif
 
+#if defined(ALARM_WHEEL) && (ALARM_WHEEL == ENABLE)
+/*******************************************************************************
+ * Callback function of the RTC alarm when it is owned by the alarm wheel.
+ * Only wakes the wheel thread, callbacks never run in interrupt context.
+ * 
+ * @param none
+ * @return none
+ ******************************************************************************/
+static void on_wheel_alarm_callback(void)
+{
+  osSemaphoreRelease(sem_alarm_wheel);
+}
+
+/*******************************************************************************
+ * Alarm wheel thread: runs every software alarm that became due and programs
+ * the RTC alarm for the next one.
+ * 
+ * @param none
+ * @return none
+ ******************************************************************************/
+static void alarm_wheel_task(void *argument)
+{
+  UNUSED_PARAMETER(argument);
+
+  while (1) {
+    osSemaphoreAcquire(sem_alarm_wheel, osWaitForever);
+    osMutexAcquire(alarm_wheel_mutex, osWaitForever);
+    alarm_armed_utc = 0;
+    alarm_wheel_advance(&alarm_wheel, (uint32_t)calendar_get_utc());
+    alarm_wheel_rearm();
+    osMutexRelease(alarm_wheel_mutex);
+  }
+}
+
+/*******************************************************************************
+ * Program the RTC alarm for the earliest time the wheel needs servicing.
+ * Must be called with alarm_wheel_mutex held.
+ * 
+ * @param none
+ * @return none
+ ******************************************************************************/
+static void alarm_wheel_rearm(void)
+{
+  sl_calendar_datetime_config_t alarm_config;
+  uint32_t now = (uint32_t)calendar_get_utc();
+  uint32_t next;
+  sl_status_t status;
+
+  if (!alarm_wheel_next_expiry(&alarm_wheel, &next)) {
+    return;
+  }
+  if ((next == now) && (alarm_wheel.now == now)) {
+    // Re-armed by a callback in the second just processed, another pass now
+    // would only fire it again, it waits for the next second
+    next = now + 1u;
+  } else if (next <= now) {
+    // Already due, an alarm in the past would never match
+    osSemaphoreRelease(sem_alarm_wheel);
+    return;
+  }
+  if (next == alarm_armed_utc) {
+    return;
+  }
+  unix_time_to_calendar((time_t)next + TAIPEI_TIME_ZONE_SHIFT, &alarm_config);
+  status = sl_si91x_calendar_set_alarm(&alarm_config);
+  if (status != SL_STATUS_OK) {
+    DEBUGOUT("sl_si91x_calendar_set_alarm: Invalid Parameters, Error Code : %lu \r\n", status);
+    return;
+  }
+  alarm_armed_utc = next;
+}
+#endif
+
 /*******************************************************************************
  * Callback function of one second trigger
  * 
@@ -393,11 +1246,23 @@ static void on_alarm_callback(void)
 static void on_sec_callback(void)
 {
   static uint8_t count = 0;
+#if defined(HRTIME_STAMP) && (HRTIME_STAMP == ENABLE)
+  uint32_t edge_count = HRTIME_COUNTER();
+  uint32_t edge_second;
+#endif
+  sl_calendar_datetime_config_t get_time;
+  sl_si91x_calendar_get_date_time(&get_time);
+
+#if defined(HRTIME_STAMP) && (HRTIME_STAMP == ENABLE)
+  // The full Unix second of every edge, the integer conversion is cheap. A
+  // second-of-minute check would miss the first edge and any step by whole
+  // minutes, hrtime_second_edge() re-anchors on anything but the next second.
+  edge_second = (uint32_t)(calendar_time_to_unix(get_time) - TAIPEI_TIME_ZONE_SHIFT);
+  hrtime_second_edge(&hrtime, edge_second, edge_count);
+#endif
+
   if((++count) >= PRINT_PERIOD)
   {
-    sl_calendar_datetime_config_t get_time;
-    sl_si91x_calendar_get_date_time(&get_time);
-
     calendar_print_hhmmss(get_time);
     count = 0;
   }
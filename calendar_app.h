@@ -18,6 +18,10 @@
 #ifndef CALENDAR_APP_H_
 #define CALENDAR_APP_H_
 #include "time.h"
+#include "sl_status.h"
+#include "alarm_wheel.h"
+#include "time_slew.h"
+#include "time_quality.h"
 // -----------------------------------------------------------------------------
 // Macros
 #define ALARM_EXAMPLE     DISABLE ///< To enable alarm trigger
@@ -25,6 +29,17 @@
 #define SEC_INTR          ENABLE ///< To enable one second trigger
 #define MILLI_SEC_INTR    DISABLE ///< To enable one millisecond trigger
 #define TIME_CONVERSION   DISABLE ///< To enable time conversion
+#define ALARM_WHEEL       ENABLE  ///< To multiplex software alarms onto the RTC alarm
+#define HRTIME_STAMP      ENABLE  ///< To interpolate sub-millisecond time from the cycle counter
+#define CLOCK_SOURCE_SELECT ENABLE ///< To characterize RO/RC/XTAL against NTP and persist the choice
+#define CALIBRATION_TUNING ENABLE  ///< To pick RC/RO calibration periods from the NTP frequency error
+#define TIME_STEERING      ENABLE  ///< To slew NTP corrections into the calendar time, stepping only large errors
+#define HOLDOVER_ENGINE    ENABLE  ///< To extrapolate the learned oscillator drift while NTP is unreachable
+
+// -----------------------------------------------------------------------------
+// Data Types
+/// Called after the calendar time jumped, step_us is new minus old time
+typedef void (*calendar_step_callback_t)(int64_t step_us, void *context);
 
 // -----------------------------------------------------------------------------
 // Prototypes
@@ -43,6 +58,178 @@ void calendar_init(time_t sntp_get_time);
 
 void calendar_compare_time(char* data);
 
+/***************************************************************************/ /**
+ * Compare the calendar against one NTP measurement.
+ * 
+ * @param[in] sntp_utc NTP time of the measurement, UTC seconds
+ * @param[in] offset_ms calendar minus NTP time, milliseconds
+ * @return none
+ ******************************************************************************/
+void calendar_compare_offset(uint32_t sntp_utc, int32_t offset_ms);
+
+/***************************************************************************/ /**
+ * Read the calendar as UTC seconds (the RTC itself keeps local time).
+ * 
+ * @param none
+ * @return UTC seconds since the Unix epoch
+ ******************************************************************************/
+time_t calendar_get_utc(void);
+
+/***************************************************************************/ /**
+ * Read the calendar as UTC microseconds.
+ * With HRTIME_STAMP the sub-second part is interpolated from the core cycle
+ * counter, calibrated on every RTC second edge, so no millisecond interrupt
+ * is needed. Otherwise, or while the counter disagrees with the RTC (e.g.
+ * right after deep sleep), the RTC millisecond field is used.
+ * The result includes the corrections of calendar_adjust() and never
+ * decreases, except across a step.
+ * 
+ * @param none
+ * @return UTC microseconds since the Unix epoch
+ ******************************************************************************/
+uint64_t calendar_get_utc_us(void);
+
+/***************************************************************************/ /**
+ * Read the calendar as UTC microseconds from the cycle counter alone.
+ * Takes well under a microsecond, but unlike calendar_get_utc_us() there is
+ * no RTC cross-check, so use it only where that cost matters.
+ * 
+ * @param[out] utc_us UTC microseconds since the Unix epoch
+ * @return false without HRTIME_STAMP or before the counter is calibrated
+ ******************************************************************************/
+bool calendar_get_utc_us_interpolated(uint64_t *utc_us);
+
+/***************************************************************************/ /**
+ * Step the calendar to a new UTC time.
+ * Pending software alarms are re-filed against the new time and the RTC alarm
+ * is re-armed, alarms that were stepped over fire immediately.
+ * 
+ * @param[in] utc UTC seconds since the Unix epoch
+ * @return status of the calendar update
+ ******************************************************************************/
+sl_status_t calendar_set_utc(time_t utc);
+
+/***************************************************************************/ /**
+ * Count of calendar steps so far.
+ * Offsets measured against the calendar before a change of this count are
+ * relative to the old time.
+ * 
+ * @param none
+ * @return number of successful calendar_set_utc() calls
+ ******************************************************************************/
+uint32_t calendar_step_count(void);
+
+/***************************************************************************/ /**
+ * Correct the calendar by one filtered NTP offset.
+ * With TIME_STEERING, offsets up to CALENDAR_STEP_THRESHOLD_US are slewed in at
+ * no more than CALENDAR_SLEW_RATE_PPM, so calendar_get_utc_us() stays
+ * monotonic. Larger offsets step the calendar and call the step callback.
+ * Offsets measured before the previous correction are ignored.
+ * With HOLDOVER_ENGINE the slewed offsets also train the drift model.
+ * 
+ * @param[in] sample_us calendar_get_utc_us() when the offset was measured
+ * @param[in] offset_us NTP minus calendar time
+ * @param[in] error_us error bound of the offset
+ * @return what was done with the offset
+ ******************************************************************************/
+time_slew_action_t calendar_adjust(uint64_t sample_us, int64_t offset_us, uint32_t error_us);
+
+/***************************************************************************/ /**
+ * Steer the calendar by the learned drift while no NTP offsets arrive.
+ * Call it periodically during an outage, the next calendar_adjust() ends
+ * the holdover. The prediction goes through the same slew as NTP offsets.
+ * 
+ * @param none
+ * @return none
+ ******************************************************************************/
+void calendar_holdover(void);
+
+/***************************************************************************/ /**
+ * Whether the calendar is running on the drift model.
+ * 
+ * @param none
+ * @return true from calendar_holdover() to the next calendar_adjust()
+ ******************************************************************************/
+bool calendar_in_holdover(void);
+
+/***************************************************************************/ /**
+ * Bound of the calendar_get_utc_us() error. It is the error of the last NTP
+ * offset plus the slew still to come, growing with the measured stability
+ * of the oscillator since, or with its tolerance until that is learned.
+ * 
+ * @param none
+ * @return microseconds, UINT32_MAX before the first offset or without
+ *         HOLDOVER_ENGINE
+ ******************************************************************************/
+uint32_t calendar_uncertainty_us(void);
+
+/***************************************************************************/ /**
+ * Total correction applied by calendar_adjust() since the last step, so
+ * that offset_us plus this is the offset of the free running oscillator.
+ * 
+ * @param none
+ * @return corrected minus free running time, microseconds
+ ******************************************************************************/
+int64_t calendar_correction_us(void);
+
+/***************************************************************************/ /**
+ * Register the function called after every calendar step, one at a time.
+ * 
+ * @param[in] callback function to call, NULL to remove
+ * @param[in] context passed back to the callback
+ * @return none
+ ******************************************************************************/
+void calendar_on_step(calendar_step_callback_t callback, void *context);
+
+/***************************************************************************/ /**
+ * Publish the time quality after a reference update. The calendar adds the
+ * growth of its own error since the update and the slew still to come, and
+ * keeps the snapshot current through holdover and steps. Call it from the
+ * thread that calls calendar_adjust().
+ * 
+ * @param[in] reference state, leap, stratum, reference_id, sync_us and root
+ *            delay and dispersion of the update; error_us is the error bound
+ *            of the calendar at sync_us, the reference's own included
+ * @return none
+ ******************************************************************************/
+void calendar_update_quality(const time_quality_t *reference);
+
+/***************************************************************************/ /**
+ * Copy the time quality snapshot. Lock-free and constant time, so it may be
+ * called from any thread or interrupt. Evaluate it with time_quality_age_s(),
+ * time_quality_root_distance_us() and time_quality_error_us() at
+ * calendar_get_utc_us().
+ * 
+ * @param[out] quality TIME_QUALITY_UNSYNCED until the first update
+ * @return none
+ ******************************************************************************/
+void calendar_get_quality(time_quality_t *quality);
+
+/***************************************************************************/ /**
+ * Start a software alarm at an absolute UTC second.
+ * Any number of alarms share the single RTC alarm, which is always programmed
+ * for the earliest one. The callback runs in the alarm wheel thread and may
+ * restart or cancel alarms itself. Restarting a pending alarm reschedules it.
+ * 
+ * @param[in] timer caller owned alarm storage, must stay valid while pending
+ * @param[in] utc expiry in UTC seconds
+ * @param[in] callback function to run at expiry
+ * @param[in] context passed back to the callback
+ * @return SL_STATUS_NOT_READY until the calendar has been set
+ ******************************************************************************/
+sl_status_t calendar_alarm_start(alarm_wheel_timer_t *timer,
+                                 uint32_t utc,
+                                 alarm_wheel_callback_t callback,
+                                 void *context);
+
+/***************************************************************************/ /**
+ * Cancel a pending software alarm.
+ * 
+ * @param[in] timer alarm to cancel
+ * @return SL_STATUS_NOT_FOUND if the alarm was not pending
+ ******************************************************************************/
+sl_status_t calendar_alarm_cancel(alarm_wheel_timer_t *timer);
+
 /***************************************************************************/ /**
  * Function will run continuously and will wait for trigger
  * 
@@ -0,0 +1,116 @@
+/***************************************************************************/ /**
+ * @file calib_ctrl.c
+ * @brief RC/RO calibration period controller driven by NTP frequency error
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "calib_ctrl.h"
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void calib_ctrl_init(calib_ctrl_t *ctrl, uint32_t budget_ppb, uint32_t min_baseline, uint8_t level, uint8_t max_level)
+{
+  ctrl->budget_ppb   = budget_ppb;
+  ctrl->min_baseline = min_baseline;
+  ctrl->max_level    = max_level;
+  ctrl->level        = (level > max_level) ? max_level : level;
+  ctrl->min_level    = CALIB_CTRL_LEVEL_OFF;
+  ctrl->quiet        = 0;
+  ctrl->failed       = false;
+  ctrl->floor_quiet  = 0;
+  ctrl->floor_hold   = CALIB_CTRL_FLOOR_HOLD;
+  ctrl->freq_ppb     = 0;
+  ctrl->one_shots    = 0;
+  calib_ctrl_restart(ctrl);
+}
+
+calib_ctrl_action_t calib_ctrl_add_sample(calib_ctrl_t *ctrl, uint32_t reference_second, int32_t offset_ms)
+{
+  uint32_t baseline;
+  uint64_t error_ppb;
+  int64_t freq_ppb;
+
+  if (!ctrl->anchored) {
+    ctrl->anchored      = true;
+    ctrl->anchor_second = reference_second;
+    ctrl->anchor_offset = offset_ms;
+    return CALIB_CTRL_KEEP;
+  }
+  baseline = reference_second - ctrl->anchor_second;
+  if ((baseline == 0) || (baseline < ctrl->min_baseline / CALIB_CTRL_EARLY_DIVISOR)) {
+    return CALIB_CTRL_KEEP;
+  }
+
+  // ms per s is 10^6 ppb
+  freq_ppb  = ((int64_t)offset_ms - ctrl->anchor_offset) * 1000000 / (int64_t)baseline;
+  error_ppb = (uint64_t)((freq_ppb < 0) ? -freq_ppb : freq_ppb);
+  // A short baseline is noisy, before min_baseline only a clear excess counts,
+  // or a quiet estimate while nothing failed yet
+  if ((baseline < ctrl->min_baseline)
+      && (error_ppb <= (uint64_t)ctrl->budget_ppb + ctrl->budget_ppb / CALIB_CTRL_EARLY_MARGIN)
+      && (ctrl->failed || (error_ppb >= ctrl->budget_ppb / CALIB_CTRL_RELAX_DIVISOR))) {
+    return CALIB_CTRL_KEEP;
+  }
+  ctrl->freq_ppb = (int32_t)freq_ppb;
+
+  // Every estimate starts a fresh baseline, so one spanning a level change or
+  // a calibration never mixes two frequencies.
+  ctrl->anchor_second = reference_second;
+  ctrl->anchor_offset = offset_ms;
+
+  // Tighten with a guard band, the error keeps growing while it is estimated
+  if (error_ppb > ctrl->budget_ppb - ctrl->budget_ppb / CALIB_CTRL_GUARD_DIVISOR) {
+    ctrl->quiet       = 0;
+    ctrl->floor_quiet = 0;
+    if (ctrl->failed && (ctrl->floor_hold < UINT16_MAX / 2u)) {
+      ctrl->floor_hold *= 2u;
+    }
+    ctrl->failed = true;
+    if (ctrl->level < ctrl->max_level) {
+      ctrl->level++;
+      // Do not relax back into the level that just failed
+      if (ctrl->min_level < ctrl->level) {
+        ctrl->min_level = ctrl->level;
+      }
+      return CALIB_CTRL_APPLY;
+    }
+    ctrl->one_shots++;
+    return CALIB_CTRL_ONE_SHOT;
+  }
+  if (error_ppb < (ctrl->budget_ppb / CALIB_CTRL_RELAX_DIVISOR)) {
+    ctrl->quiet++;
+    if ((ctrl->level > ctrl->min_level) && ((ctrl->quiet >= CALIB_CTRL_RELAX_COUNT) || !ctrl->failed)) {
+      ctrl->quiet = 0;
+      ctrl->level = ctrl->failed ? (uint8_t)(ctrl->level - 1u) : ctrl->min_level;
+      return CALIB_CTRL_APPLY;
+    }
+    if ((ctrl->level == ctrl->min_level) && (ctrl->min_level > CALIB_CTRL_LEVEL_OFF)
+        && (++ctrl->floor_quiet >= ctrl->floor_hold)) {
+      // Conditions may have settled since the floor was raised
+      ctrl->floor_quiet = 0;
+      ctrl->min_level--;
+    }
+    return CALIB_CTRL_KEEP;
+  }
+  ctrl->quiet       = 0;
+  ctrl->floor_quiet = 0;
+  return CALIB_CTRL_KEEP;
+}
+
+void calib_ctrl_restart(calib_ctrl_t *ctrl)
+{
+  ctrl->anchored      = false;
+  ctrl->anchor_second = 0;
+  ctrl->anchor_offset = 0;
+}
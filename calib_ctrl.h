@@ -0,0 +1,92 @@
+/***************************************************************************/ /**
+ * @file calib_ctrl.h
+ * @brief RC/RO calibration period controller driven by NTP frequency error
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef CALIB_CTRL_H_
+#define CALIB_CTRL_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+#define CALIB_CTRL_LEVEL_OFF     0u ///< No periodic calibration, one-shot on demand only
+#define CALIB_CTRL_RELAX_DIVISOR 4u ///< Error below budget / 4 counts as quiet
+#define CALIB_CTRL_RELAX_COUNT   3u ///< Quiet evaluations in a row before relaxing a level
+#define CALIB_CTRL_GUARD_DIVISOR 4u ///< Error over budget - budget / 4 tightens a level
+#define CALIB_CTRL_FLOOR_HOLD    24u ///< Quiet evaluations at the floor before lowering it, doubles per failure
+#define CALIB_CTRL_EARLY_DIVISOR 4u ///< An estimate over min_baseline / 4 may tighten early ...
+#define CALIB_CTRL_EARLY_MARGIN  2u ///< ... if its error is over the budget by budget / 2
+
+// -----------------------------------------------------------------------------
+// Data Types
+/// Level 0 means periodic calibration off, higher levels calibrate more often.
+/// The caller maps levels to actual RC/RO trigger periods.
+typedef struct {
+  uint32_t budget_ppb;    ///< Residual frequency error allowed
+  uint32_t min_baseline;  ///< Seconds between two samples used for an estimate
+  uint8_t level;
+  uint8_t max_level;
+  uint8_t min_level;      ///< Floor of relaxing, one above the last level that went over budget
+  uint8_t quiet;          ///< Consecutive evaluations well under budget
+  bool failed;            ///< A level went over budget since the start
+  uint16_t floor_quiet;   ///< Consecutive quiet evaluations at the floor
+  uint16_t floor_hold;    ///< floor_quiet that lowers the floor
+  bool anchored;
+  uint32_t anchor_second; ///< Reference second of the estimate start
+  int32_t anchor_offset;  ///< Offset at the estimate start, milliseconds
+  int32_t freq_ppb;       ///< Last residual frequency error estimate
+  uint32_t one_shots;     ///< On-demand calibrations requested
+} calib_ctrl_t;
+
+typedef enum {
+  CALIB_CTRL_KEEP = 0, ///< Nothing to do
+  CALIB_CTRL_APPLY,    ///< Level changed, reprogram the periodic triggers
+  CALIB_CTRL_ONE_SHOT, ///< Error over budget with the level unchanged, calibrate once now
+} calib_ctrl_action_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Initialize the controller at @p level.
+ *
+ * @param[in] budget_ppb residual frequency error allowed
+ * @param[in] min_baseline seconds an estimate has to span; the offset
+ *            resolution divided by it is the estimate's noise floor
+ ******************************************************************************/
+void calib_ctrl_init(calib_ctrl_t *ctrl, uint32_t budget_ppb, uint32_t min_baseline, uint8_t level, uint8_t max_level);
+
+/***************************************************************************/ /**
+ * Feed one calendar versus NTP comparison. Once the baseline is long enough
+ * the residual frequency error is estimated and compared with the budget:
+ * above three quarters of it tightens a level and calibrates, a run of quiet
+ * estimates relaxes a level. Until the first excess a single quiet estimate
+ * relaxes straight to the floor. The level above one that went over budget
+ * becomes the floor, it is lowered again after CALIB_CTRL_FLOOR_HOLD quiet
+ * estimates at it, twice as many after every further excess. An error of one
+ * and a half times the budget is acted on after a quarter of the baseline.
+ *
+ * @param[in] reference_second NTP time of the sample, seconds
+ * @param[in] offset_ms calendar minus NTP, milliseconds
+ * @return what the caller has to do with the calibration hardware
+ ******************************************************************************/
+calib_ctrl_action_t calib_ctrl_add_sample(calib_ctrl_t *ctrl, uint32_t reference_second, int32_t offset_ms);
+
+/***************************************************************************/ /**
+ * Drop the estimate start, e.g. after the calendar was stepped.
+ ******************************************************************************/
+void calib_ctrl_restart(calib_ctrl_t *ctrl);
+
+#endif /* CALIB_CTRL_H_ */
@@ -0,0 +1,123 @@
+/***************************************************************************/ /**
+ * @file clock_filter.c
+ * @brief RFC 5905 clock filter, minimum delay selection over eight samples
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "clock_filter.h"
+#include "time_types.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define MICROS_PER_SECOND   1000000u
+#define CLOCK_FILTER_PHI    15u          // RFC 5905 frequency tolerance, ppm
+#define CLOCK_FILTER_CLAMP  1000000000LL // Offset differences beyond this are clamped before squaring
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static bool clock_filter_before(const clock_filter_stage_t *a, const clock_filter_stage_t *b);
+static uint32_t clock_filter_aged(const clock_filter_stage_t *stage, uint64_t now_us);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void clock_filter_reset(clock_filter_t *filter)
+{
+  filter->next          = 0;
+  filter->count         = 0;
+  filter->dispersion_us = 0;
+  filter->jitter_us     = 0;
+  filter->updates       = 0;
+}
+
+bool clock_filter_add(clock_filter_t *filter, const ntp_sample_t *sample)
+{
+  clock_filter_stage_t *stage        = &filter->stage[filter->next];
+  uint8_t order[CLOCK_FILTER_STAGES] = { 0 };
+  const clock_filter_stage_t *best;
+  uint64_t dispersion                = 0;
+  uint64_t sum_sq                    = 0;
+  int64_t diff;
+  uint8_t i;
+  uint8_t j;
+
+  stage->offset_us     = sample->offset_us;
+  stage->delay_us      = sample->delay_us;
+  stage->dispersion_us = sample->dispersion_us;
+  stage->local_us      = sample->local_us;
+  filter->next         = (uint8_t)((filter->next + 1u) % CLOCK_FILTER_STAGES);
+  if (filter->count < CLOCK_FILTER_STAGES) {
+    filter->count++;
+  }
+  filter->samples++;
+
+  // Until the register is full the filled stages are 0 .. count - 1.
+  // Insertion sort on delay, eight entries at most, the newer stage first on
+  // equal delays (broadcast samples all carry the same calibrated delay).
+  for (i = 0; i < filter->count; i++) {
+    for (j = i; (j > 0) && clock_filter_before(&filter->stage[i], &filter->stage[order[j - 1u]]); j--) {
+      order[j] = order[j - 1u];
+    }
+    order[j] = i;
+  }
+  best = &filter->stage[order[0]];
+
+  // Peer dispersion: each stage counts half as much as the one before it
+  for (i = 0; i < filter->count; i++) {
+    dispersion += clock_filter_aged(&filter->stage[order[i]], sample->local_us) >> (i + 1u);
+  }
+  filter->dispersion_us = (dispersion > UINT32_MAX) ? UINT32_MAX : (uint32_t)dispersion;
+
+  if (filter->count > 1u) {
+    for (i = 1; i < filter->count; i++) {
+      diff = filter->stage[order[i]].offset_us - best->offset_us;
+      if (diff > CLOCK_FILTER_CLAMP) {
+        diff = CLOCK_FILTER_CLAMP;
+      } else if (diff < -CLOCK_FILTER_CLAMP) {
+        diff = -CLOCK_FILTER_CLAMP;
+      }
+      sum_sq += (uint64_t)(diff * diff);
+    }
+    filter->jitter_us = time_isqrt(sum_sq / (filter->count - 1u));
+  } else {
+    filter->jitter_us = best->dispersion_us;
+  }
+
+  if ((filter->updates != 0) && (best->local_us <= filter->selected.local_us)) {
+    return false;
+  }
+  filter->selected = *best;
+  filter->updates++;
+  return true;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static bool clock_filter_before(const clock_filter_stage_t *a, const clock_filter_stage_t *b)
+{
+  if (a->delay_us != b->delay_us) {
+    return a->delay_us < b->delay_us;
+  }
+  return a->local_us > b->local_us;
+}
+
+static uint32_t clock_filter_aged(const clock_filter_stage_t *stage, uint64_t now_us)
+{
+  uint64_t age_us = (now_us > stage->local_us) ? (now_us - stage->local_us) : 0u;
+  uint64_t aged   = stage->dispersion_us + (age_us * CLOCK_FILTER_PHI) / MICROS_PER_SECOND;
+
+  return (aged > UINT32_MAX) ? UINT32_MAX : (uint32_t)aged;
+}
@@ -0,0 +1,70 @@
+/***************************************************************************/ /**
+ * @file clock_filter.h
+ * @brief RFC 5905 clock filter, minimum delay selection over eight samples
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef CLOCK_FILTER_H_
+#define CLOCK_FILTER_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include "ntp_packet.h"
+
+// -----------------------------------------------------------------------------
+// Macros
+#define CLOCK_FILTER_STAGES 8u ///< RFC 5905 NSTAGE
+
+// -----------------------------------------------------------------------------
+// Data Types
+/// One filter stage, a sample as it arrived
+typedef struct {
+  int64_t offset_us;      ///< Server minus local clock (theta)
+  uint32_t delay_us;      ///< Round trip delay (delta)
+  uint32_t dispersion_us; ///< Dispersion at arrival, aged when read
+  uint64_t local_us;      ///< Local clock at arrival
+} clock_filter_stage_t;
+
+typedef struct {
+  clock_filter_stage_t stage[CLOCK_FILTER_STAGES]; ///< Shift register, stage[next] is the oldest
+  uint8_t next;
+  uint8_t count;
+  clock_filter_stage_t selected; ///< Minimum delay stage of the last update
+  uint32_t dispersion_us;        ///< Peer dispersion, weighted sum over the stages
+  uint32_t jitter_us;            ///< RMS offset difference to the selected stage
+  uint32_t samples;
+  uint32_t updates;              ///< Samples passed on to the discipline
+} clock_filter_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Empty the filter. Call it whenever the local clock is stepped, the stored
+ * offsets are relative to the clock before the step.
+ ******************************************************************************/
+void clock_filter_reset(clock_filter_t *filter);
+
+/***************************************************************************/ /**
+ * Shift one sample in and select the stage with the smallest delay.
+ * Stage dispersions grow at 15 ppm with age before the weighted sum is taken.
+ * As in RFC 5905, a selected stage that is not newer than the last one passed
+ * on is not used again, so a delay spike never replaces a good sample with an
+ * older one.
+ *
+ * @param[in] filter filter state
+ * @param[in] sample new measurement
+ * @return true if @p filter->selected is a new sample for the discipline
+ ******************************************************************************/
+bool clock_filter_add(clock_filter_t *filter, const ntp_sample_t *sample);
+
+#endif /* CLOCK_FILTER_H_ */
@@ -0,0 +1,182 @@
+/***************************************************************************/ /**
+ * @file clock_select.c
+ * @brief Calendar clock source characterization against NTP
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "clock_select.h"
+#include "time_types.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define PPB_PER_MS_PER_S 1000000 // 1 ms/s is 10^6 ppb
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static void clock_select_fit(clock_select_t *select, clock_source_result_t *result);
+static void clock_select_choose(clock_select_t *select);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void clock_select_init(clock_select_t *select,
+                       uint32_t window,
+                       uint32_t budget_ppb,
+                       const uint32_t current_na[CLOCK_SOURCE_COUNT])
+{
+  uint32_t i;
+
+  select->source = CLOCK_SOURCE_RO;
+  select->window = window;
+  select->start  = 0;
+  select->count  = 0;
+
+  select->record.version    = CLOCK_SELECT_RECORD_VERSION;
+  select->record.budget_ppb = budget_ppb;
+  select->record.selected   = CLOCK_SOURCE_COUNT;
+  for (i = 0; i < CLOCK_SOURCE_COUNT; i++) {
+    select->record.result[i] = (clock_source_result_t){ .current_na = current_na[i] };
+  }
+}
+
+clock_select_action_t clock_select_add_sample(clock_select_t *select, uint32_t reference_second, int32_t offset_ms)
+{
+  if (select->source >= CLOCK_SOURCE_COUNT) {
+    return CLOCK_SELECT_DONE;
+  }
+  if (select->count == 0) {
+    select->start = reference_second;
+  }
+  select->sample[select->count].second = reference_second - select->start;
+  select->sample[select->count].offset = offset_ms;
+  select->count++;
+
+  if ((select->count < CLOCK_SELECT_MAX_SAMPLES) && ((reference_second - select->start) < select->window)) {
+    return CLOCK_SELECT_CONTINUE;
+  }
+
+  clock_select_fit(select, &select->record.result[select->source]);
+  select->count = 0;
+  select->source++;
+  if (select->source < CLOCK_SOURCE_COUNT) {
+    return CLOCK_SELECT_NEXT_SOURCE;
+  }
+  clock_select_choose(select);
+  return CLOCK_SELECT_DONE;
+}
+
+clock_source_t clock_select_source(const clock_select_t *select)
+{
+  if (select->source < CLOCK_SOURCE_COUNT) {
+    return select->source;
+  }
+  return (clock_source_t)select->record.selected;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+/*******************************************************************************
+ * Least squares line through offset(t). The slope is the frequency error, the
+ * residuals give the phase wander and the standard error of the slope.
+ * Everything is centered first so the sums stay well inside 64 bits.
+ ******************************************************************************/
+static void clock_select_fit(clock_select_t *select, clock_source_result_t *result)
+{
+  int64_t sum_x = 0;
+  int64_t sum_y = 0;
+  int64_t sxx   = 0;
+  int64_t sxy   = 0;
+  uint64_t sum_res2 = 0;
+  int64_t mean_x;
+  int64_t mean_y;
+  int64_t dx;
+  int64_t dy;
+  int64_t res;
+  int64_t slope_ppb;
+  uint32_t n = select->count;
+  uint32_t i;
+
+  result->samples = (uint16_t)n;
+  if (n < CLOCK_SELECT_MIN_SAMPLES) {
+    return;
+  }
+  for (i = 0; i < n; i++) {
+    sum_x += select->sample[i].second;
+    sum_y += select->sample[i].offset;
+  }
+  mean_x = sum_x / n;
+  mean_y = sum_y / n;
+  for (i = 0; i < n; i++) {
+    dx = (int64_t)select->sample[i].second - mean_x;
+    dy = (int64_t)select->sample[i].offset - mean_y;
+    sxx += dx * dx;
+    sxy += dx * dy;
+  }
+  if (sxx == 0) {
+    return;
+  }
+  // ms/s to ppb in two steps so sxy * 10^6 cannot overflow
+  slope_ppb = (sxy / sxx) * PPB_PER_MS_PER_S + ((sxy % sxx) * PPB_PER_MS_PER_S) / sxx;
+
+  for (i = 0; i < n; i++) {
+    dx  = (int64_t)select->sample[i].second - mean_x;
+    dy  = (int64_t)select->sample[i].offset - mean_y;
+    res = dy - (slope_ppb * dx) / PPB_PER_MS_PER_S;
+    sum_res2 += (uint64_t)(res * res);
+  }
+  result->freq_ppb        = (int32_t)slope_ppb;
+  result->uncertainty_ppb = (uint32_t)(((uint64_t)time_isqrt(sum_res2 / (n - 2u)) * PPB_PER_MS_PER_S) / time_isqrt((uint64_t)sxx));
+  result->wander_us       = time_isqrt(sum_res2 / n) * 1000u;
+  result->measured        = 1;
+}
+
+/*******************************************************************************
+ * Lowest power source whose worst case error fits the budget, or the most
+ * accurate one when none does.
+ ******************************************************************************/
+static void clock_select_choose(clock_select_t *select)
+{
+  clock_select_record_t *record = &select->record;
+  clock_source_result_t *result;
+  uint32_t best_power    = CLOCK_SOURCE_COUNT;
+  uint32_t best_accuracy = CLOCK_SOURCE_COUNT;
+  uint64_t worst_case[CLOCK_SOURCE_COUNT];
+  uint32_t i;
+
+  for (i = 0; i < CLOCK_SOURCE_COUNT; i++) {
+    result = &record->result[i];
+    if (!result->measured) {
+      continue;
+    }
+    worst_case[i] = (uint64_t)((result->freq_ppb < 0) ? -(int64_t)result->freq_ppb : result->freq_ppb)
+                    + 2u * (uint64_t)result->uncertainty_ppb;
+    result->meets_budget = (worst_case[i] <= record->budget_ppb);
+    if (result->meets_budget
+        && ((best_power == CLOCK_SOURCE_COUNT) || (result->current_na < record->result[best_power].current_na))) {
+      best_power = i;
+    }
+    if ((best_accuracy == CLOCK_SOURCE_COUNT) || (worst_case[i] < worst_case[best_accuracy])) {
+      best_accuracy = i;
+    }
+  }
+  if (best_power != CLOCK_SOURCE_COUNT) {
+    record->selected = (uint8_t)best_power;
+  } else if (best_accuracy != CLOCK_SOURCE_COUNT) {
+    record->selected = (uint8_t)best_accuracy;
+  } else {
+    record->selected = CLOCK_SOURCE_XTAL;
+  }
+}
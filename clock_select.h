@@ -0,0 +1,108 @@
+/***************************************************************************/ /**
+ * @file clock_select.h
+ * @brief Calendar clock source characterization against NTP
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef CLOCK_SELECT_H_
+#define CLOCK_SELECT_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+#define CLOCK_SELECT_MAX_SAMPLES    128u ///< Samples kept per source
+#define CLOCK_SELECT_MIN_SAMPLES    8u   ///< Fewer samples give no verdict
+#define CLOCK_SELECT_RECORD_VERSION 1u
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef enum {
+  CLOCK_SOURCE_RO = 0,
+  CLOCK_SOURCE_RC,
+  CLOCK_SOURCE_XTAL,
+  CLOCK_SOURCE_COUNT,
+} clock_source_t;
+
+/// Characterization result of one source
+typedef struct {
+  int32_t freq_ppb;         ///< Frequency error, positive when running fast
+  uint32_t uncertainty_ppb; ///< Standard error of freq_ppb
+  uint32_t wander_us;       ///< RMS phase residual around the linear fit
+  uint32_t current_na;      ///< Power cost recorded for the source
+  uint16_t samples;
+  uint8_t measured;
+  uint8_t meets_budget;
+} clock_source_result_t;
+
+/// Persisted outcome of a characterization run
+typedef struct {
+  uint32_t version;
+  uint32_t budget_ppb;
+  uint8_t selected; ///< clock_source_t
+  uint8_t reserved[3];
+  clock_source_result_t result[CLOCK_SOURCE_COUNT];
+} clock_select_record_t;
+
+typedef enum {
+  CLOCK_SELECT_CONTINUE = 0, ///< Keep feeding samples
+  CLOCK_SELECT_NEXT_SOURCE,  ///< Switch the calendar to clock_select_source()
+  CLOCK_SELECT_DONE,         ///< record.selected is final, persist it
+} clock_select_action_t;
+
+typedef struct {
+  uint32_t second; ///< Reference second, relative to the first sample
+  int32_t offset;  ///< Local minus reference, milliseconds
+} clock_select_sample_t;
+
+typedef struct {
+  clock_source_t source; ///< Source currently under test
+  uint32_t window;       ///< Seconds to observe each source
+  uint32_t start;        ///< Reference second of the first sample
+  uint16_t count;
+  clock_select_sample_t sample[CLOCK_SELECT_MAX_SAMPLES];
+  clock_select_record_t record;
+} clock_select_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Start a characterization run with the RO clock.
+ *
+ * @param[in] window seconds each source is observed
+ * @param[in] budget_ppb worst case frequency error (|error| + 2 sigma) allowed
+ * @param[in] current_na power cost of each source, indexed by clock_source_t
+ ******************************************************************************/
+void clock_select_init(clock_select_t *select,
+                       uint32_t window,
+                       uint32_t budget_ppb,
+                       const uint32_t current_na[CLOCK_SOURCE_COUNT]);
+
+/***************************************************************************/ /**
+ * Feed one comparison of the calendar against NTP taken on the source under
+ * test. The calendar should be set to NTP time when a source is switched in.
+ *
+ * @param[in] reference_second NTP time of the sample, seconds
+ * @param[in] offset_ms calendar minus NTP, milliseconds
+ * @return what the caller has to do next
+ ******************************************************************************/
+clock_select_action_t clock_select_add_sample(clock_select_t *select, uint32_t reference_second, int32_t offset_ms);
+
+/***************************************************************************/ /**
+ * Source the calendar should run on now: the one under test, or the selected
+ * one once the run is done.
+ ******************************************************************************/
+clock_source_t clock_select_source(const clock_select_t *select);
+
+#endif /* CLOCK_SELECT_H_ */
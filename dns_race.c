@@ -0,0 +1,197 @@
+/***************************************************************************/ /**
+ * @file dns_race.c
+ * @brief Concurrent A/AAAA resolution of the NTP server name
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "string.h"
+#include "dns_race.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define DNS_RACE_FLAG(family) (1u << (family))
+#define DNS_RACE_ALL_FLAGS    (DNS_RACE_FLAG(DNS_RACE_IPV4) | DNS_RACE_FLAG(DNS_RACE_IPV6))
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+static const osThreadAttr_t dns_race_thread_attributes = {
+  .name       = "dns_race",
+  .attr_bits  = 0,
+  .cb_mem     = 0,
+  .cb_size    = 0,
+  .stack_mem  = 0,
+  .stack_size = DNS_RACE_STACK_SIZE,
+  .priority   = osPriorityLow,
+  .tz_module  = 0,
+  .reserved   = 0,
+};
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static void dns_race_query(dns_race_t *race, dns_race_family_t family);
+static void dns_race_task_v4(void *argument);
+static void dns_race_task_v6(void *argument);
+static uint32_t dns_race_collect(dns_race_t *race, uint32_t wait_ms);
+static bool dns_race_usable(const dns_race_t *race, dns_race_family_t family);
+static uint32_t dns_race_elapsed_ms(uint32_t start);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+sl_status_t dns_race_start(dns_race_t *race, const char *host, uint32_t timeout_v4_ms, uint32_t timeout_v6_ms)
+{
+  if (race->done == NULL) {
+    race->done = osEventFlagsNew(NULL);
+    if (race->done == NULL) {
+      return SL_STATUS_ALLOCATION_FAILED;
+    }
+  } else if (race->answer[DNS_RACE_IPV4].pending || race->answer[DNS_RACE_IPV6].pending) {
+    // A query thread of the last race still writes into this state
+    return SL_STATUS_BUSY;
+  }
+  osEventFlagsClear(race->done, DNS_RACE_ALL_FLAGS);
+  race->host      = host;
+  race->done_mask = 0;
+  race->winner    = DNS_RACE_FAMILIES;
+  memset(race->answer, 0, sizeof(race->answer));
+  race->answer[DNS_RACE_IPV4].timeout_ms = timeout_v4_ms;
+  race->answer[DNS_RACE_IPV6].timeout_ms = timeout_v6_ms;
+  race->answer[DNS_RACE_IPV4].pending    = true;
+  race->answer[DNS_RACE_IPV6].pending    = true;
+  race->start                            = osKernelGetTickCount();
+
+  if (osThreadNew((osThreadFunc_t)dns_race_task_v4, race, &dns_race_thread_attributes) == NULL) {
+    race->answer[DNS_RACE_IPV4].status  = SL_STATUS_ALLOCATION_FAILED;
+    race->answer[DNS_RACE_IPV4].pending = false;
+    osEventFlagsSet(race->done, DNS_RACE_FLAG(DNS_RACE_IPV4));
+  }
+  if (osThreadNew((osThreadFunc_t)dns_race_task_v6, race, &dns_race_thread_attributes) == NULL) {
+    race->answer[DNS_RACE_IPV6].status  = SL_STATUS_ALLOCATION_FAILED;
+    race->answer[DNS_RACE_IPV6].pending = false;
+    osEventFlagsSet(race->done, DNS_RACE_FLAG(DNS_RACE_IPV6));
+  }
+  return SL_STATUS_OK;
+}
+
+sl_status_t dns_race_wait(dns_race_t *race, sl_ip_address_t *address)
+{
+  uint32_t budget = ((race->answer[DNS_RACE_IPV4].timeout_ms > race->answer[DNS_RACE_IPV6].timeout_ms)
+                       ? race->answer[DNS_RACE_IPV4].timeout_ms
+                       : race->answer[DNS_RACE_IPV6].timeout_ms)
+                    + DNS_RACE_MARGIN;
+  uint32_t elapsed;
+
+  while (race->winner == DNS_RACE_FAMILIES) {
+    if (dns_race_usable(race, DNS_RACE_IPV6)) {
+      race->winner = DNS_RACE_IPV6;
+    } else if (dns_race_usable(race, DNS_RACE_IPV4)) {
+      if (!(race->done_mask & DNS_RACE_FLAG(DNS_RACE_IPV6))) {
+        dns_race_collect(race, DNS_RACE_RESOLUTION_DELAY);
+      }
+      race->winner = dns_race_usable(race, DNS_RACE_IPV6) ? DNS_RACE_IPV6 : DNS_RACE_IPV4;
+    } else {
+      elapsed = dns_race_elapsed_ms(race->start);
+      if (((race->done_mask & DNS_RACE_ALL_FLAGS) == DNS_RACE_ALL_FLAGS) || (elapsed >= budget)) {
+        return SL_STATUS_NOT_FOUND;
+      }
+      dns_race_collect(race, budget - elapsed);
+    }
+  }
+  *address = race->answer[race->winner].address;
+  return SL_STATUS_OK;
+}
+
+sl_status_t dns_race_fallback(dns_race_t *race, uint32_t wait_ms, sl_ip_address_t *address)
+{
+  dns_race_family_t other;
+
+  if (race->winner == DNS_RACE_FAMILIES) {
+    return SL_STATUS_NOT_FOUND;
+  }
+  other = (race->winner == DNS_RACE_IPV4) ? DNS_RACE_IPV6 : DNS_RACE_IPV4;
+  if (!(race->done_mask & DNS_RACE_FLAG(other)) && (wait_ms != 0)) {
+    dns_race_collect(race, wait_ms);
+  }
+  if (!dns_race_usable(race, other)) {
+    return SL_STATUS_NOT_FOUND;
+  }
+  race->winner = other;
+  *address     = race->answer[other].address;
+  return SL_STATUS_OK;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static void dns_race_query(dns_race_t *race, dns_race_family_t family)
+{
+  dns_race_answer_t *answer = &race->answer[family];
+  sl_ip_address_t address   = { 0 };
+  sl_status_t status;
+
+  status = sl_net_host_get_by_name(race->host,
+                                   answer->timeout_ms,
+                                   (family == DNS_RACE_IPV6) ? SL_NET_DNS_TYPE_IPV6 : SL_NET_DNS_TYPE_IPV4,
+                                   &address);
+  answer->latency_ms   = dns_race_elapsed_ms(race->start);
+  answer->address      = address;
+  answer->address.type = (family == DNS_RACE_IPV6) ? SL_IPV6 : SL_IPV4;
+  answer->status       = status;
+  answer->pending      = false;
+  osEventFlagsSet(race->done, DNS_RACE_FLAG(family));
+}
+
+static void dns_race_task_v4(void *argument)
+{
+  dns_race_query((dns_race_t *)argument, DNS_RACE_IPV4);
+  osThreadExit();
+}
+
+static void dns_race_task_v6(void *argument)
+{
+  dns_race_query((dns_race_t *)argument, DNS_RACE_IPV6);
+  osThreadExit();
+}
+
+static uint32_t dns_race_collect(dns_race_t *race, uint32_t wait_ms)
+{
+  uint32_t ticks = (uint32_t)(((uint64_t)wait_ms * osKernelGetTickFreq()) / 1000u);
+  uint32_t flags = osEventFlagsWait(race->done, DNS_RACE_ALL_FLAGS, osFlagsWaitAny, ticks);
+
+  if (!(flags & osFlagsError)) {
+    race->done_mask |= flags;
+  }
+  return race->done_mask;
+}
+
+static bool dns_race_usable(const dns_race_t *race, dns_race_family_t family)
+{
+  static const uint8_t zero[16] = { 0 };
+  const dns_race_answer_t *answer = &race->answer[family];
+
+  if (!(race->done_mask & DNS_RACE_FLAG(family)) || (answer->status != SL_STATUS_OK)) {
+    return false;
+  }
+  if (family == DNS_RACE_IPV6) {
+    return memcmp(answer->address.ip.v6.bytes, zero, sizeof(zero)) != 0;
+  }
+  return memcmp(answer->address.ip.v4.bytes, zero, 4u) != 0;
+}
+
+static uint32_t dns_race_elapsed_ms(uint32_t start)
+{
+  return (uint32_t)(((uint64_t)(osKernelGetTickCount() - start) * 1000u) / osKernelGetTickFreq());
+}
@@ -0,0 +1,90 @@
+/***************************************************************************/ /**
+ * @file dns_race.h
+ * @brief Concurrent A/AAAA resolution of the NTP server name
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef DNS_RACE_H_
+#define DNS_RACE_H_
+#include "cmsis_os2.h"
+#include "sl_status.h"
+#include "sl_net.h"
+
+// -----------------------------------------------------------------------------
+// Macros
+#define DNS_RACE_STACK_SIZE       1536
+#define DNS_RACE_RESOLUTION_DELAY 50   ///< ms an IPv4 answer waits for IPv6, RFC 8305
+#define DNS_RACE_MARGIN           1000 ///< ms on top of the query timeouts before giving up
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef enum {
+  DNS_RACE_IPV4 = 0,
+  DNS_RACE_IPV6,
+  DNS_RACE_FAMILIES,
+} dns_race_family_t;
+
+typedef struct {
+  sl_ip_address_t address;
+  sl_status_t status;
+  uint32_t timeout_ms;
+  uint32_t latency_ms;   ///< Query start to answer
+  volatile bool pending; ///< Query thread still running
+} dns_race_answer_t;
+
+typedef struct {
+  const char *host;
+  uint32_t start;          ///< Tick count when the queries were issued
+  osEventFlagsId_t done;   ///< One flag per family, set when its answer is in
+  uint32_t done_mask;      ///< Flags collected so far
+  dns_race_family_t winner;
+  dns_race_answer_t answer[DNS_RACE_FAMILIES];
+} dns_race_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Issue the A and AAAA queries for @p host concurrently, one thread each.
+ *
+ * @param[in] race race state, must stay valid until both queries finished
+ * @param[in] host name to resolve
+ * @param[in] timeout_v4_ms timeout of the A query
+ * @param[in] timeout_v6_ms timeout of the AAAA query
+ * @return SL_STATUS_BUSY while queries of an earlier race are outstanding
+ ******************************************************************************/
+sl_status_t dns_race_start(dns_race_t *race, const char *host, uint32_t timeout_v4_ms, uint32_t timeout_v6_ms);
+
+/***************************************************************************/ /**
+ * Wait for the first usable answer. As in happy eyeballs, an IPv4 answer
+ * waits DNS_RACE_RESOLUTION_DELAY ms for a pending IPv6 answer, otherwise
+ * the first one wins. The other query keeps running as the fallback.
+ *
+ * @param[in] race race state
+ * @param[out] address winning address
+ * @return SL_STATUS_NOT_FOUND if neither family resolved
+ ******************************************************************************/
+sl_status_t dns_race_wait(dns_race_t *race, sl_ip_address_t *address);
+
+/***************************************************************************/ /**
+ * Answer of the family that did not win. On success it becomes the winner,
+ * so a later call offers the first family again.
+ *
+ * @param[in] race race state, after dns_race_wait()
+ * @param[in] wait_ms time to wait if that query is still outstanding
+ * @param[out] address fallback address
+ * @return SL_STATUS_NOT_FOUND if the other family did not resolve
+ ******************************************************************************/
+sl_status_t dns_race_fallback(dns_race_t *race, uint32_t wait_ms, sl_ip_address_t *address);
+
+#endif /* DNS_RACE_H_ */
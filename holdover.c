@@ -0,0 +1,199 @@
+/***************************************************************************/ /**
+ * @file holdover.c
+ * @brief Oscillator drift learning and extrapolation while no reference is heard
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "holdover.h"
+#include "time_types.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define MICROS_PER_SECOND 1000000u
+#define HOLDOVER_MAX_PPB  100000000 // 10 %, estimates beyond are clamped
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static int32_t holdover_clamp_ppb(int64_t ppb);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void holdover_init(holdover_t *holdover, uint32_t tolerance_ppb, uint32_t min_baseline_s)
+{
+  holdover->tolerance_ppb  = tolerance_ppb;
+  holdover->min_baseline_s = (min_baseline_s == 0) ? 1u : min_baseline_s;
+  holdover->freq_ppb       = 0;
+  holdover->aging_ppb      = 0;
+  holdover->freq_dev_ppb   = 0;
+  holdover->tau_s          = 0;
+  holdover->mid_local_us   = 0;
+  holdover_retune(holdover);
+  holdover_restart(holdover);
+}
+
+void holdover_update(holdover_t *holdover, uint64_t local_us, int64_t offset_us, uint32_t error_us)
+{
+  int64_t baseline_us;
+  int64_t freq_ppb;
+  int64_t predicted_ppb;
+  int64_t deviation_ppb;
+  uint64_t mid_us;
+  uint32_t baseline_s;
+
+  holdover->have_anchor      = true;
+  holdover->anchor_local_us  = local_us;
+  holdover->anchor_offset_us = offset_us;
+  holdover->anchor_error_us  = error_us;
+  if (!holdover->have_base) {
+    holdover->have_base      = true;
+    holdover->base_local_us  = local_us;
+    holdover->base_offset_us = offset_us;
+    return;
+  }
+  baseline_us = (int64_t)(local_us - holdover->base_local_us);
+  if (baseline_us < (int64_t)holdover->min_baseline_s * MICROS_PER_SECOND) {
+    return;
+  }
+  baseline_s = (uint32_t)(baseline_us / MICROS_PER_SECOND);
+  // The offset is reference minus local, a slow local clock makes it rise
+  freq_ppb = time_ratio_ppb(offset_us - holdover->base_offset_us, baseline_us);
+  mid_us   = holdover->base_local_us + (uint64_t)(baseline_us / 2);
+
+  if (holdover->estimates == 0) {
+    holdover->freq_ppb = holdover_clamp_ppb(freq_ppb);
+    holdover->tau_s    = baseline_s;
+  } else {
+    predicted_ppb = holdover->freq_ppb
+                    + ((int64_t)holdover->aging_ppb * (int64_t)((mid_us - holdover->mid_local_us) / MICROS_PER_SECOND))
+                        / HOLDOVER_SECONDS_DAY;
+    deviation_ppb = freq_ppb - predicted_ppb;
+    holdover->freq_ppb = holdover_clamp_ppb(predicted_ppb + (deviation_ppb >> HOLDOVER_FREQ_SHIFT));
+    deviation_ppb      = holdover_clamp_ppb((deviation_ppb < 0) ? -deviation_ppb : deviation_ppb);
+    if (holdover->estimates == 1u) {
+      holdover->freq_dev_ppb = (uint32_t)deviation_ppb;
+    } else {
+      holdover->freq_dev_ppb =
+        (uint32_t)((int64_t)holdover->freq_dev_ppb + ((deviation_ppb - holdover->freq_dev_ppb) >> HOLDOVER_DEV_SHIFT));
+    }
+    holdover->tau_s = (uint32_t)((int64_t)holdover->tau_s + (((int64_t)baseline_s - holdover->tau_s) >> HOLDOVER_FREQ_SHIFT));
+  }
+  holdover->mid_local_us = mid_us;
+  if (holdover->estimates < UINT32_MAX) {
+    holdover->estimates++;
+  }
+
+  // Aging shows only over hours, estimate to estimate it is lost in the noise
+  if (!holdover->have_aging_mark) {
+    holdover->have_aging_mark = true;
+    holdover->aging_local_us  = mid_us;
+    holdover->aging_freq_ppb  = holdover->freq_ppb;
+  } else if ((mid_us - holdover->aging_local_us) >= (uint64_t)HOLDOVER_AGING_BASELINE_S * MICROS_PER_SECOND) {
+    freq_ppb = ((int64_t)(holdover->freq_ppb - holdover->aging_freq_ppb) * HOLDOVER_SECONDS_DAY)
+               / (int64_t)((mid_us - holdover->aging_local_us) / MICROS_PER_SECOND);
+    if (freq_ppb > HOLDOVER_AGING_MAX) {
+      freq_ppb = HOLDOVER_AGING_MAX;
+    } else if (freq_ppb < -HOLDOVER_AGING_MAX) {
+      freq_ppb = -HOLDOVER_AGING_MAX;
+    }
+    holdover->aging_ppb += (int32_t)((freq_ppb - holdover->aging_ppb) >> HOLDOVER_FREQ_SHIFT);
+    holdover->aging_local_us = mid_us;
+    holdover->aging_freq_ppb = holdover->freq_ppb;
+  }
+  holdover->base_local_us  = local_us;
+  holdover->base_offset_us = offset_us;
+}
+
+bool holdover_predict(const holdover_t *holdover, uint64_t local_us, int64_t *offset_us)
+{
+  int64_t elapsed_us;
+  int64_t elapsed_s;
+  int64_t freq_ppb;
+
+  if (!holdover->have_anchor) {
+    return false;
+  }
+  elapsed_us = (int64_t)(local_us - holdover->anchor_local_us);
+  elapsed_s  = elapsed_us / MICROS_PER_SECOND;
+  // The frequency was learned at the middle of the last estimate, age it to the anchor
+  freq_ppb = holdover->freq_ppb
+             + ((int64_t)holdover->aging_ppb * ((int64_t)(holdover->anchor_local_us - holdover->mid_local_us) / MICROS_PER_SECOND))
+                 / HOLDOVER_SECONDS_DAY;
+  if (holdover->estimates == 0) {
+    freq_ppb = 0;
+  }
+  *offset_us = holdover->anchor_offset_us + time_scale_ppb(elapsed_us, (int32_t)freq_ppb)
+               + ((int64_t)holdover->aging_ppb * elapsed_s * elapsed_s) / (2 * (int64_t)HOLDOVER_SECONDS_DAY * 1000);
+  return true;
+}
+
+uint32_t holdover_bound_us(const holdover_t *holdover, uint64_t local_us)
+{
+  uint64_t elapsed_s;
+  uint64_t bound_us;
+
+  if (!holdover->have_anchor) {
+    return UINT32_MAX;
+  }
+  elapsed_s = (local_us > holdover->anchor_local_us) ? ((local_us - holdover->anchor_local_us) / MICROS_PER_SECOND) : 0u;
+  bound_us  = holdover->anchor_error_us + ((uint64_t)holdover_rate_ppb(holdover, local_us) * elapsed_s) / 1000u;
+  return (bound_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)bound_us;
+}
+
+uint32_t holdover_rate_ppb(const holdover_t *holdover, uint64_t local_us)
+{
+  uint64_t elapsed_s;
+  uint64_t rate_ppb;
+
+  if (holdover->estimates < 2u) {
+    return holdover->tolerance_ppb;
+  }
+  elapsed_s = (holdover->have_anchor && (local_us > holdover->anchor_local_us))
+                ? ((local_us - holdover->anchor_local_us) / MICROS_PER_SECOND)
+                : 0u;
+  // The frequency wanders off as a random walk, one deviation per tau
+  rate_ppb = (uint64_t)HOLDOVER_BOUND_FACTOR * (holdover->freq_dev_ppb + 1u);
+  if ((holdover->tau_s != 0) && (elapsed_s > holdover->tau_s)) {
+    rate_ppb = (rate_ppb * time_isqrt((elapsed_s << 16) / holdover->tau_s)) >> 8;
+  }
+  return (rate_ppb > holdover->tolerance_ppb) ? holdover->tolerance_ppb : (uint32_t)rate_ppb;
+}
+
+void holdover_restart(holdover_t *holdover)
+{
+  holdover->have_anchor = false;
+  holdover->have_base   = false;
+}
+
+void holdover_retune(holdover_t *holdover)
+{
+  holdover->have_base       = false;
+  holdover->estimates       = 0;
+  holdover->have_aging_mark = false;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static int32_t holdover_clamp_ppb(int64_t ppb)
+{
+  if (ppb > HOLDOVER_MAX_PPB) {
+    return HOLDOVER_MAX_PPB;
+  }
+  if (ppb < -HOLDOVER_MAX_PPB) {
+    return -HOLDOVER_MAX_PPB;
+  }
+  return (int32_t)ppb;
+}
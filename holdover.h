@@ -0,0 +1,117 @@
+/***************************************************************************/ /**
+ * @file holdover.h
+ * @brief Oscillator drift learning and extrapolation while no reference is heard
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef HOLDOVER_H_
+#define HOLDOVER_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+#define HOLDOVER_FREQ_SHIFT       2u     ///< Frequency average gain 1/4 per estimate
+#define HOLDOVER_DEV_SHIFT        3u     ///< Stability average gain 1/8 per estimate
+#define HOLDOVER_AGING_BASELINE_S 21600u ///< Frequency drift is measured over 6 h at least
+#define HOLDOVER_AGING_MAX        200    ///< ppb per day, more is temperature, not aging
+#define HOLDOVER_BOUND_FACTOR     3u     ///< Mean frequency deviations the bound allows
+#define HOLDOVER_SECONDS_DAY      86400u
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef struct {
+  uint32_t tolerance_ppb;   ///< Oscillator tolerance, the bound until the frequency is learned
+  uint32_t min_baseline_s;  ///< Samples closer than this give no frequency estimate
+  bool have_anchor;
+  uint64_t anchor_local_us; ///< Local clock of the last sample
+  int64_t anchor_offset_us; ///< Offset of the last sample, reference minus local
+  uint32_t anchor_error_us; ///< Error bound of the last sample
+  bool have_base;
+  uint64_t base_local_us;   ///< Start of the running frequency estimate
+  int64_t base_offset_us;
+  int32_t freq_ppb;         ///< Local clock frequency error, positive is slow
+  int32_t aging_ppb;        ///< Frequency change per day
+  uint32_t freq_dev_ppb;    ///< Mean deviation of the estimates from the prediction
+  uint32_t tau_s;           ///< Mean estimate baseline, the deviation applies per tau
+  uint32_t estimates;       ///< Frequency estimates since the last retune
+  uint64_t mid_local_us;    ///< Middle of the last estimate, where freq_ppb applies
+  bool have_aging_mark;
+  uint64_t aging_local_us;  ///< Start of the aging baseline
+  int32_t aging_freq_ppb;   ///< Frequency at its start
+} holdover_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Start with nothing learned.
+ *
+ * @param[in] tolerance_ppb frequency error the oscillator may have untrimmed
+ * @param[in] min_baseline_s shortest span of a frequency estimate, the
+ *            sample error divided by it is the estimate's noise floor
+ ******************************************************************************/
+void holdover_init(holdover_t *holdover, uint32_t tolerance_ppb, uint32_t min_baseline_s);
+
+/***************************************************************************/ /**
+ * Learn from a reference sample. Frequency, aging and the deviation of the
+ * frequency from its prediction are estimated from the offsets over time.
+ *
+ * @param[in] local_us local clock of the sample, not steered
+ * @param[in] offset_us reference minus local clock
+ * @param[in] error_us error bound of the offset
+ ******************************************************************************/
+void holdover_update(holdover_t *holdover, uint64_t local_us, int64_t offset_us, uint32_t error_us);
+
+/***************************************************************************/ /**
+ * Offset extrapolated from the last sample with the learned frequency and
+ * aging.
+ *
+ * @param[in] local_us local clock now, not steered
+ * @param[out] offset_us reference minus local clock
+ * @return false before the first sample
+ ******************************************************************************/
+bool holdover_predict(const holdover_t *holdover, uint64_t local_us, int64_t *offset_us);
+
+/***************************************************************************/ /**
+ * Bound of the error of holdover_predict(). It starts at the error of the
+ * last sample and grows with the measured frequency deviation, as a random
+ * walk over the estimate baseline, or with the tolerance while the
+ * frequency is not learned.
+ *
+ * @param[in] local_us local clock now, not steered
+ * @return microseconds, UINT32_MAX before the first sample or on overflow
+ ******************************************************************************/
+uint32_t holdover_bound_us(const holdover_t *holdover, uint64_t local_us);
+
+/***************************************************************************/ /**
+ * Frequency error holdover_bound_us() allows at a time, its growth rate.
+ *
+ * @param[in] local_us local clock, not steered
+ * @return ppb
+ ******************************************************************************/
+uint32_t holdover_rate_ppb(const holdover_t *holdover, uint64_t local_us);
+
+/***************************************************************************/ /**
+ * Forget the samples, e.g. after the local clock was stepped. The learned
+ * frequency, aging and deviation are kept.
+ ******************************************************************************/
+void holdover_restart(holdover_t *holdover);
+
+/***************************************************************************/ /**
+ * The oscillator was trimmed: the frequency is learned again, until then
+ * the bound grows with the tolerance.
+ ******************************************************************************/
+void holdover_retune(holdover_t *holdover);
+
+#endif /* HOLDOVER_H_ */
@@ -0,0 +1,93 @@
+/***************************************************************************/ /**
+ * @file hrtime.c
+ * @brief High resolution timestamps interpolated between RTC second edges
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "hrtime.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define MICROS_PER_SECOND 1000000u
+
+// Compiler barrier, the writer is an interrupt on the same core
+#define HRTIME_BARRIER() __asm__ volatile("" ::: "memory")
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void hrtime_init(hrtime_t *hrtime, uint32_t nominal_rate)
+{
+  hrtime->sequence     = 0;
+  hrtime->edge_second  = 0;
+  hrtime->edge_count   = 0;
+  hrtime->rate         = nominal_rate;
+  hrtime->edges        = 0;
+  hrtime->rejected     = 0;
+  hrtime->max_residual = 0;
+}
+
+void hrtime_second_edge(hrtime_t *hrtime, uint32_t second, uint32_t count)
+{
+  uint32_t interval = count - hrtime->edge_count;
+  uint32_t residual;
+
+  hrtime->sequence++;
+  HRTIME_BARRIER();
+  if ((hrtime->edges != 0) && (second == hrtime->edge_second + 1u)) {
+    residual = (interval > hrtime->rate) ? (interval - hrtime->rate) : (hrtime->rate - interval);
+    // Interrupt latency only moves an edge by microseconds, anything larger is
+    // a masked interrupt or a halted counter and must not pull the rate.
+    if ((uint64_t)residual * MICROS_PER_SECOND <= (uint64_t)hrtime->rate * HRTIME_RATE_TOLERANCE) {
+      hrtime->rate = (uint32_t)((int32_t)hrtime->rate + (((int32_t)interval - (int32_t)hrtime->rate) >> HRTIME_RATE_SHIFT));
+      if (residual > hrtime->max_residual) {
+        hrtime->max_residual = residual;
+      }
+    } else {
+      hrtime->rejected++;
+    }
+  }
+  hrtime->edge_second = second;
+  hrtime->edge_count  = count;
+  hrtime->edges++;
+  HRTIME_BARRIER();
+  hrtime->sequence++;
+}
+
+bool hrtime_read_us(const hrtime_t *hrtime, uint32_t count, uint64_t *micros)
+{
+  uint32_t sequence;
+  uint32_t edge_second;
+  uint32_t edge_count;
+  uint32_t rate;
+  uint32_t edges;
+  uint32_t elapsed;
+
+  do {
+    sequence = hrtime->sequence;
+    HRTIME_BARRIER();
+    edge_second = hrtime->edge_second;
+    edge_count  = hrtime->edge_count;
+    rate        = hrtime->rate;
+    edges       = hrtime->edges;
+    HRTIME_BARRIER();
+  } while ((sequence & 1u) || (sequence != hrtime->sequence));
+
+  elapsed = count - edge_count;
+  if ((edges == 0) || (rate == 0) || (elapsed >= 2u * rate)) {
+    return false;
+  }
+  *micros = (uint64_t)edge_second * MICROS_PER_SECOND + ((uint64_t)elapsed * MICROS_PER_SECOND) / rate;
+  return true;
+}
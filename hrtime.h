@@ -0,0 +1,66 @@
+/***************************************************************************/ /**
+ * @file hrtime.h
+ * @brief High resolution timestamps interpolated between RTC second edges
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef HRTIME_H_
+#define HRTIME_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+#define HRTIME_RATE_SHIFT     3u    ///< Rate filter gain 1/8 per second edge
+#define HRTIME_RATE_TOLERANCE 1000u ///< Edge intervals off by more ppm are not used for calibration
+
+// -----------------------------------------------------------------------------
+// Data Types
+/// Latest RTC second edge and the free-running counter value latched with it.
+/// Written by the second interrupt, read lock-free through the sequence count.
+typedef struct {
+  volatile uint32_t sequence; ///< Odd while an update is in progress
+  uint32_t edge_second;       ///< UTC second that started at the last edge
+  uint32_t edge_count;        ///< Counter value latched at that edge
+  uint32_t rate;              ///< Calibrated counts per RTC second
+  uint32_t edges;             ///< Second edges seen, i.e. interrupts taken
+  uint32_t rejected;          ///< Edge intervals rejected as outliers
+  uint32_t max_residual;      ///< Largest accepted interval error, counts
+} hrtime_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Initialize with the nominal counter rate, e.g. the core clock for DWT CYCCNT.
+ ******************************************************************************/
+void hrtime_init(hrtime_t *hrtime, uint32_t nominal_rate);
+
+/***************************************************************************/ /**
+ * Record an RTC second edge. Call from the one second interrupt with the
+ * counter latched as early as possible in the handler.
+ * Consecutive edges calibrate the counter rate against the RTC, any other
+ * second (first edge, step, missed edges) only re-anchors.
+ ******************************************************************************/
+void hrtime_second_edge(hrtime_t *hrtime, uint32_t second, uint32_t count);
+
+/***************************************************************************/ /**
+ * Interpolate a timestamp for counter value @p count.
+ *
+ * @param[out] micros microseconds since the Unix epoch
+ * @return false until an edge has been recorded, or when the counter is more
+ *         than two seconds past the last edge and may have wrapped
+ ******************************************************************************/
+bool hrtime_read_us(const hrtime_t *hrtime, uint32_t count, uint64_t *micros);
+
+#endif /* HRTIME_H_ */
@@ -0,0 +1,198 @@
+/***************************************************************************/ /**
+ * @file link_quality.c
+ * @brief Wi-Fi link quality histograms and the RSSI sampling gate
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "cmsis_os2.h"
+#include "string.h"
+#include "stdio.h"
+#include "link_quality.h"
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+static osMutexId_t link_quality_lock = NULL;
+static link_quality_t link_quality;
+static uint32_t window_start = 0; // Tick the running window opened
+static uint32_t window_count = 0; // Notifications in the running window
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static void link_quality_add_rssi(uint8_t rssi);
+static void link_quality_roll_window(void);
+static uint32_t link_quality_elapsed_ms(uint32_t start);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+sl_status_t link_quality_init(void)
+{
+  if (link_quality_lock == NULL) {
+    link_quality_lock = osMutexNew(NULL);
+    if (link_quality_lock == NULL) {
+      return SL_STATUS_ALLOCATION_FAILED;
+    }
+  }
+  osMutexAcquire(link_quality_lock, osWaitForever);
+  memset(&link_quality, 0, sizeof(link_quality));
+  link_quality.rssi_min = UINT8_MAX;
+  window_start          = osKernelGetTickCount();
+  window_count          = 0;
+  osMutexRelease(link_quality_lock);
+  return SL_STATUS_OK;
+}
+
+void link_quality_observe(const sl_si91x_module_state_stats_response_t *notification)
+{
+  if (link_quality_lock == NULL) {
+    return;
+  }
+  osMutexAcquire(link_quality_lock, osWaitForever);
+  link_quality_roll_window();
+  window_count++;
+  link_quality.events++;
+  link_quality.state[(notification->state_code >> 4) & (LINK_QUALITY_STATE_BUCKETS - 1u)]++;
+  link_quality.reason[(notification->reason_code < (LINK_QUALITY_REASONS - 1u)) ? notification->reason_code
+                                                                               : (LINK_QUALITY_REASONS - 1u)]++;
+  // Not associated, the field carries no signal
+  if (notification->rssi != 0) {
+    link_quality_add_rssi(notification->rssi);
+  }
+  osMutexRelease(link_quality_lock);
+}
+
+sl_status_t link_quality_sample_rssi(sl_wifi_interface_t interface)
+{
+  int32_t rssi = 0;
+  sl_status_t status;
+
+  status = sl_wifi_get_signal_strength(interface, &rssi);
+  if ((status != SL_STATUS_OK) || (link_quality_lock == NULL)) {
+    return status;
+  }
+  if (rssi < 0) {
+    rssi = -rssi;
+  }
+  osMutexAcquire(link_quality_lock, osWaitForever);
+  link_quality_add_rssi((rssi > UINT8_MAX) ? UINT8_MAX : (uint8_t)rssi);
+  osMutexRelease(link_quality_lock);
+  return SL_STATUS_OK;
+}
+
+bool link_quality_good(uint8_t gate_rssi)
+{
+  // Read without the lock, a torn average only moves one decision
+  if ((link_quality.readings == 0) || (link_quality_elapsed_ms(link_quality.rssi_tick) > LINK_QUALITY_STALE_MS)) {
+    return true;
+  }
+  return link_quality.rssi_avg_q4 <= ((uint16_t)gate_rssi << 4);
+}
+
+void link_quality_count_deferred(void)
+{
+  link_quality.deferred++;
+}
+
+void link_quality_get(link_quality_t *quality)
+{
+  if (link_quality_lock == NULL) {
+    memset(quality, 0, sizeof(*quality));
+    return;
+  }
+  osMutexAcquire(link_quality_lock, osWaitForever);
+  link_quality_roll_window();
+  *quality = link_quality;
+  osMutexRelease(link_quality_lock);
+}
+
+void link_quality_print(void)
+{
+  link_quality_t quality;
+  uint8_t i;
+
+  link_quality_get(&quality);
+  printf("Link quality: RSSI -%u dBm avg, -%u last, -%u..-%u, %lu readings, %lu deferred\r\n",
+         quality.rssi_avg_q4 >> 4,
+         quality.rssi_last,
+         (quality.readings != 0) ? quality.rssi_min : 0u,
+         quality.rssi_max,
+         quality.readings,
+         quality.deferred);
+  printf("  RSSI  ");
+  for (i = 0; i < LINK_QUALITY_RSSI_BUCKETS; i++) {
+    printf(" %lu", quality.rssi[i]);
+  }
+  printf("\r\n  State ");
+  for (i = 0; i < LINK_QUALITY_STATE_BUCKETS; i++) {
+    printf(" %lu", quality.state[i]);
+  }
+  printf("\r\n  Reason");
+  for (i = 0; i < LINK_QUALITY_REASONS; i++) {
+    printf(" %lu", quality.reason[i]);
+  }
+  printf("\r\n  %lu events, %lu in the last minute\r\n", quality.events, quality.window_events);
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// Lock held
+static void link_quality_add_rssi(uint8_t rssi)
+{
+  uint32_t bucket = 0;
+
+  if (rssi >= LINK_QUALITY_RSSI_FLOOR) {
+    bucket = 1u + (rssi - LINK_QUALITY_RSSI_FLOOR) / LINK_QUALITY_RSSI_WIDTH;
+    if (bucket >= LINK_QUALITY_RSSI_BUCKETS) {
+      bucket = LINK_QUALITY_RSSI_BUCKETS - 1u;
+    }
+  }
+  link_quality.rssi[bucket]++;
+  if (link_quality.readings == 0) {
+    link_quality.rssi_avg_q4 = (uint16_t)(rssi << 4);
+  } else {
+    link_quality.rssi_avg_q4 = (uint16_t)((int32_t)link_quality.rssi_avg_q4
+                                          + ((((int32_t)rssi << 4) - (int32_t)link_quality.rssi_avg_q4)
+                                             >> LINK_QUALITY_RSSI_SHIFT));
+  }
+  if (rssi < link_quality.rssi_min) {
+    link_quality.rssi_min = rssi;
+  }
+  if (rssi > link_quality.rssi_max) {
+    link_quality.rssi_max = rssi;
+  }
+  link_quality.rssi_last = rssi;
+  link_quality.rssi_tick = osKernelGetTickCount();
+  link_quality.readings++;
+}
+
+// Lock held. Close the running window once it is over, a gap of more
+// than one window leaves an empty last window.
+static void link_quality_roll_window(void)
+{
+  uint32_t elapsed = link_quality_elapsed_ms(window_start);
+
+  if (elapsed < LINK_QUALITY_WINDOW_MS) {
+    return;
+  }
+  link_quality.window_events = (elapsed < 2u * LINK_QUALITY_WINDOW_MS) ? window_count : 0u;
+  window_count               = 0;
+  window_start               = osKernelGetTickCount();
+}
+
+static uint32_t link_quality_elapsed_ms(uint32_t start)
+{
+  return (uint32_t)(((uint64_t)(osKernelGetTickCount() - start) * 1000u) / osKernelGetTickFreq());
+}
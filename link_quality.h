@@ -0,0 +1,93 @@
+/***************************************************************************/ /**
+ * @file link_quality.h
+ * @brief Wi-Fi link quality histograms and the RSSI sampling gate
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef LINK_QUALITY_H_
+#define LINK_QUALITY_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include "sl_status.h"
+#include "sl_wifi.h"
+#include "sl_si91x_types.h"
+
+// -----------------------------------------------------------------------------
+// Macros
+#define LINK_QUALITY_RSSI_FLOOR    40u    ///< -dBm, upper edge of the first RSSI bucket
+#define LINK_QUALITY_RSSI_WIDTH    10u    ///< dB per RSSI bucket
+#define LINK_QUALITY_RSSI_BUCKETS  7u     ///< <40, 40-49, ..., 80-89, >=90 -dBm
+#define LINK_QUALITY_STATE_BUCKETS 16u    ///< Module state code, high nibble
+#define LINK_QUALITY_REASONS       16u    ///< Reason codes 0-14 counted one by one, the last bucket takes the rest
+#define LINK_QUALITY_WINDOW_MS     60000u ///< Rate counter window
+#define LINK_QUALITY_RSSI_SHIFT    2u     ///< RSSI average gain 1/4 per reading
+#define LINK_QUALITY_STALE_MS      120000u ///< An RSSI average older than this does not gate
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef struct {
+  uint32_t rssi[LINK_QUALITY_RSSI_BUCKETS];
+  uint32_t state[LINK_QUALITY_STATE_BUCKETS];
+  uint32_t reason[LINK_QUALITY_REASONS];
+  uint32_t events;        ///< Module state notifications since boot
+  uint32_t readings;      ///< RSSI readings since boot, from either source
+  uint32_t window_events; ///< Notifications in the last full window
+  uint32_t deferred;      ///< Samples put off by the RSSI gate
+  uint16_t rssi_avg_q4;   ///< Averaged RSSI, -dBm in 1/16 dB
+  uint8_t rssi_last;      ///< Last RSSI, -dBm
+  uint8_t rssi_min;       ///< Strongest RSSI seen, -dBm
+  uint8_t rssi_max;       ///< Weakest RSSI seen, -dBm
+  uint32_t rssi_tick;     ///< Kernel tick of the last RSSI reading
+} link_quality_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+sl_status_t link_quality_init(void);
+
+/***************************************************************************/ /**
+ * Count one module state notification: state, reason and RSSI histograms
+ * and the event rate. Called from the Wi-Fi stats callback.
+ *
+ * @param[in] notification module state statistics
+ ******************************************************************************/
+void link_quality_observe(const sl_si91x_module_state_stats_response_t *notification);
+
+/***************************************************************************/ /**
+ * Read the RSSI of the association from the module and count it.
+ *
+ * @param[in] interface Wi-Fi interface
+ * @return status of sl_wifi_get_signal_strength()
+ ******************************************************************************/
+sl_status_t link_quality_sample_rssi(sl_wifi_interface_t interface);
+
+/***************************************************************************/ /**
+ * Whether the averaged RSSI is at least as strong as gate_rssi. A missing or
+ * stale average does not hold samples back.
+ *
+ * @param[in] gate_rssi weakest RSSI accepted, -dBm
+ ******************************************************************************/
+bool link_quality_good(uint8_t gate_rssi);
+
+void link_quality_count_deferred(void);
+
+/***************************************************************************/ /**
+ * Copy the current statistics.
+ *
+ * @param[out] quality statistics
+ ******************************************************************************/
+void link_quality_get(link_quality_t *quality);
+
+void link_quality_print(void);
+
+#endif /* LINK_QUALITY_H_ */
@@ -0,0 +1,162 @@
+/***************************************************************************/ /**
+ * @file link_state.c
+ * @brief Wi-Fi link up/down tracking for the sync scheduler
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "cmsis_os2.h"
+#include "sl_utility.h"
+#include "link_state.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define LINK_STATE_FLAG_UP   (1u << 0)
+#define LINK_STATE_FLAG_DOWN (1u << 1)
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+static osEventFlagsId_t link_state_flags = NULL;
+static volatile bool link_up             = false;
+static volatile bool link_recovering     = false;
+static volatile uint32_t link_changed    = 0; // Tick of the last transition
+static link_state_stats_t link_stats;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static sl_status_t link_state_join_handler(sl_wifi_event_t event, void *data, uint32_t data_length, void *arg);
+static bool link_state_wait(uint32_t flag, uint32_t timeout_ms);
+static uint32_t link_state_elapsed_ms(uint32_t start);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+sl_status_t link_state_init(bool up)
+{
+  // Without the flags the link keeps this state, the callers then poll as
+  // if nothing was tracked
+  link_up      = up;
+  link_changed = osKernelGetTickCount();
+  if (link_state_flags == NULL) {
+    link_state_flags = osEventFlagsNew(NULL);
+    if (link_state_flags == NULL) {
+      return SL_STATUS_ALLOCATION_FAILED;
+    }
+  }
+  osEventFlagsClear(link_state_flags, LINK_STATE_FLAG_UP | LINK_STATE_FLAG_DOWN);
+  osEventFlagsSet(link_state_flags, up ? LINK_STATE_FLAG_UP : LINK_STATE_FLAG_DOWN);
+  return sl_wifi_set_callback(SL_WIFI_JOIN_EVENTS, link_state_join_handler, NULL);
+}
+
+void link_state_set(bool up)
+{
+  uint32_t held_ms;
+
+  if ((link_state_flags == NULL) || (up == link_up)) {
+    return;
+  }
+  held_ms      = link_state_elapsed_ms(link_changed);
+  link_changed = osKernelGetTickCount();
+  link_up      = up;
+  if (up) {
+    link_stats.down_ms += held_ms;
+    link_stats.last_down_ms = held_ms;
+    link_recovering         = true;
+    osEventFlagsClear(link_state_flags, LINK_STATE_FLAG_DOWN);
+    osEventFlagsSet(link_state_flags, LINK_STATE_FLAG_UP);
+  } else {
+    link_stats.downs++;
+    osEventFlagsClear(link_state_flags, LINK_STATE_FLAG_UP);
+    osEventFlagsSet(link_state_flags, LINK_STATE_FLAG_DOWN);
+  }
+}
+
+bool link_state_is_up(void)
+{
+  return link_up;
+}
+
+bool link_state_wait_up(uint32_t timeout_ms)
+{
+  return link_state_wait(LINK_STATE_FLAG_UP, timeout_ms);
+}
+
+bool link_state_wait_down(uint32_t timeout_ms)
+{
+  return link_state_wait(LINK_STATE_FLAG_DOWN, timeout_ms);
+}
+
+uint32_t link_state_age_ms(void)
+{
+  return link_state_elapsed_ms(link_changed);
+}
+
+void link_state_count_rejoin(void)
+{
+  link_stats.rejoins++;
+}
+
+void link_state_count_skipped(void)
+{
+  link_stats.skipped++;
+}
+
+bool link_state_count_recovered(void)
+{
+  if (!link_recovering) {
+    return false;
+  }
+  link_recovering        = false;
+  link_stats.recovery_ms = link_state_elapsed_ms(link_changed);
+  return true;
+}
+
+const link_state_stats_t *link_state_stats(void)
+{
+  return &link_stats;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// Join failures include the loss of an established link once the module has
+// given up rejoining on its own
+static sl_status_t link_state_join_handler(sl_wifi_event_t event, void *data, uint32_t data_length, void *arg)
+{
+  UNUSED_PARAMETER(data);
+  UNUSED_PARAMETER(data_length);
+  UNUSED_PARAMETER(arg);
+
+  link_state_set(!SL_WIFI_CHECK_IF_EVENT_FAILED(event));
+  return SL_STATUS_OK;
+}
+
+static bool link_state_wait(uint32_t flag, uint32_t timeout_ms)
+{
+  uint32_t ticks = (uint32_t)(((uint64_t)timeout_ms * osKernelGetTickFreq()) / 1000u);
+  uint32_t flags;
+
+  if (link_state_flags == NULL) {
+    osDelay(ticks);
+    return link_up == (flag == LINK_STATE_FLAG_UP);
+  }
+  flags = osEventFlagsWait(link_state_flags, flag, osFlagsWaitAny | osFlagsNoClear, ticks);
+  return !(flags & osFlagsError) && (flags & flag);
+}
+
+static uint32_t link_state_elapsed_ms(uint32_t start)
+{
+  return (uint32_t)(((uint64_t)(osKernelGetTickCount() - start) * 1000u) / osKernelGetTickFreq());
+}
@@ -0,0 +1,90 @@
+/***************************************************************************/ /**
+ * @file link_state.h
+ * @brief Wi-Fi link up/down tracking for the sync scheduler
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef LINK_STATE_H_
+#define LINK_STATE_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include "sl_status.h"
+#include "sl_wifi.h"
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef struct {
+  uint32_t downs;        ///< Link losses since boot
+  uint32_t down_ms;      ///< Total time without link, finished outages only
+  uint32_t last_down_ms; ///< Length of the last finished outage
+  uint32_t rejoins;      ///< Joins started by the application after a loss
+  uint32_t skipped;      ///< Polls not attempted because the link was down
+  uint32_t recovery_ms;  ///< Link up to the first good sample, last outage
+} link_state_stats_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Create the link event flags and register for Wi-Fi join events.
+ *
+ * @param[in] up link state after the initial join
+ * @return SL_STATUS_ALLOCATION_FAILED if the event flags are not created, the
+ *         link then stays in state @p up
+ ******************************************************************************/
+sl_status_t link_state_init(bool up);
+
+/***************************************************************************/ /**
+ * Record a link transition. Safe from the Wi-Fi event callbacks, repeated
+ * reports of the same state are ignored.
+ *
+ * @param[in] up new link state
+ ******************************************************************************/
+void link_state_set(bool up);
+
+bool link_state_is_up(void);
+
+/***************************************************************************/ /**
+ * Block until the link is up.
+ *
+ * @param[in] timeout_ms longest wait
+ * @return true if the link is up
+ ******************************************************************************/
+bool link_state_wait_up(uint32_t timeout_ms);
+
+/***************************************************************************/ /**
+ * Sleep for the poll interval, returning early if the link goes down.
+ *
+ * @param[in] timeout_ms poll interval
+ * @return true if the link went down
+ ******************************************************************************/
+bool link_state_wait_down(uint32_t timeout_ms);
+
+/***************************************************************************/ /**
+ * Milliseconds the link has been in its current state.
+ ******************************************************************************/
+uint32_t link_state_age_ms(void);
+
+void link_state_count_rejoin(void);
+void link_state_count_skipped(void);
+
+/***************************************************************************/ /**
+ * Note a good sample, the first one after an outage sets recovery_ms.
+ *
+ * @return true for the first good sample after an outage
+ ******************************************************************************/
+bool link_state_count_recovered(void);
+
+const link_state_stats_t *link_state_stats(void);
+
+#endif /* LINK_STATE_H_ */
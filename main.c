@@ -17,6 +17,7 @@
 #include <sntp_app.h>
 #include "sl_component_catalog.h"
 #include "sl_system_init.h"
+#include "timeline.h"
 #if defined(SL_CATALOG_POWER_MANAGER_PRESENT)
 #include "sl_power_manager.h"
 #endif
@@ -31,7 +32,9 @@ int main(void)
   // Initialize Silicon Labs device, system, service(s) and protocol stack(s).
   // Note that if the kernel is present, processing task(s) will be created by
   // this call.
+  timeline_init();
   sl_system_init();
+  timeline_mark(TIMELINE_SYSTEM_INIT, 0);
 
   // Initialize the application. For example, create periodic timer(s) or
   // task(s) if the kernel is present.
@@ -0,0 +1,300 @@
+/***************************************************************************/ /**
+ * @file ntp_client.c
+ * @brief Native NTP client exchange over a UDP socket
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "cmsis_os2.h"
+#include "socket.h"
+#include "string.h"
+#include "stdio.h"
+#include "ntp_client.h"
+
+/*******************************************************************************
+ *******************************   DATA TYPES   ********************************
+ ******************************************************************************/
+typedef union {
+  struct sockaddr generic;
+  struct sockaddr_in v4;
+  struct sockaddr_in6 v6;
+} ntp_client_address_t;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static socklen_t ntp_client_server_address(const ntp_client_t *client, ntp_client_address_t *address);
+static void ntp_client_set_timeout(int socket_id, uint32_t timeout_ms);
+static uint32_t ntp_client_elapsed_ms(uint32_t start);
+static bool ntp_client_sane(const ntp_packet_t *packet);
+static bool ntp_client_matches(const ntp_client_t *client, const ntp_packet_t *reply);
+static uint32_t ntp_client_kiss_code(const ntp_packet_t *packet);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+sl_status_t ntp_client_open(ntp_client_t *client,
+                            const sl_ip_address_t *server,
+                            ntp_client_clock_t clock,
+                            uint32_t precision_us)
+{
+  memset(client, 0, sizeof(*client));
+  client->server       = *server;
+  client->clock        = clock;
+  client->precision_us  = precision_us;
+  client->listen_socket = -1;
+  client->socket        = socket((server->type == SL_IPV6) ? AF_INET6 : AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (client->socket < 0) {
+    printf("NTP client socket create failed: %d\r\n", client->socket);
+    return SL_STATUS_FAIL;
+  }
+  return SL_STATUS_OK;
+}
+
+sl_status_t ntp_client_exchange(ntp_client_t *client, int8_t poll, uint32_t timeout_ms, ntp_sample_t *sample)
+{
+  ntp_client_address_t server_address;
+  socklen_t address_length        = ntp_client_server_address(client, &server_address);
+  uint8_t buffer[NTP_PACKET_SIZE] = { 0 };
+  ntp_packet_t request            = { 0 };
+  ntp_packet_t reply;
+  uint32_t start;
+  uint32_t elapsed_ms;
+  uint64_t t1;
+  uint64_t t4;
+  int length;
+
+  request.version = NTP_VERSION;
+  request.mode    = NTP_MODE_CLIENT;
+  request.poll    = poll;
+  t1              = client->clock();
+  // T1 doubles as the cookie the server has to echo in its origin field
+  client->transmit = ntp_time_from_unix(unix_time_from_us((int64_t)t1));
+  request.transmit = client->transmit;
+  ntp_packet_encode(&request, buffer);
+
+  start = osKernelGetTickCount();
+  if (sendto(client->socket, buffer, NTP_PACKET_SIZE, 0, &server_address.generic, address_length) < 0) {
+    return SL_STATUS_FAIL;
+  }
+  client->sent++;
+
+  while (1) {
+    elapsed_ms = ntp_client_elapsed_ms(start);
+    if (elapsed_ms >= timeout_ms) {
+      return SL_STATUS_TIMEOUT;
+    }
+    ntp_client_set_timeout(client->socket, timeout_ms - elapsed_ms);
+    length = recvfrom(client->socket, buffer, sizeof(buffer), 0, NULL, NULL);
+    t4     = client->clock();
+    if (length <= 0) {
+      return SL_STATUS_TIMEOUT;
+    }
+    if (!ntp_packet_decode(buffer, (size_t)length, &reply) || !ntp_client_matches(client, &reply)) {
+      client->rejected++;
+      continue;
+    }
+    client->server_poll = reply.poll;
+    if (ntp_client_kiss_code(&reply) != 0) {
+      client->kisses++;
+      client->kiss = ntp_client_kiss_code(&reply);
+      return SL_STATUS_ABORT;
+    }
+    if (!ntp_client_sane(&reply)) {
+      client->rejected++;
+      continue;
+    }
+    client->received++;
+    client->t1 = t1;
+    client->t4 = t4;
+    memcpy(client->packet, buffer, NTP_PACKET_SIZE);
+    ntp_sample_compute(t1, t4, &reply, client->precision_us, sample);
+    return SL_STATUS_OK;
+  }
+}
+
+sl_status_t ntp_client_listen(ntp_client_t *client, const char *group)
+{
+  struct sockaddr_in local_address = { 0 };
+  int enable                       = 1;
+#ifdef IP_ADD_MEMBERSHIP
+  struct ip_mreq membership = { 0 };
+#endif
+
+  if (client->server.type == SL_IPV6) {
+    // Broadcasts are IPv4 only, and the sender check compares IPv4 addresses
+    return SL_STATUS_NOT_SUPPORTED;
+  }
+  client->listen_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (client->listen_socket < 0) {
+    printf("NTP listen socket create failed: %d\r\n", client->listen_socket);
+    return SL_STATUS_FAIL;
+  }
+  setsockopt(client->listen_socket, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+  local_address.sin_family      = AF_INET;
+  local_address.sin_port        = htons(NTP_PORT);
+  local_address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(client->listen_socket, (struct sockaddr *)&local_address, sizeof(local_address)) < 0) {
+    printf("NTP listen socket bind failed\r\n");
+    close(client->listen_socket);
+    client->listen_socket = -1;
+    return SL_STATUS_FAIL;
+  }
+  if (group != NULL) {
+#ifdef IP_ADD_MEMBERSHIP
+    membership.imr_multiaddr.s_addr = inet_addr(group);
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(client->listen_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0) {
+      printf("NTP multicast join %s failed, broadcasts only\r\n", group);
+    }
+#else
+    printf("NTP multicast join not supported, broadcasts only\r\n");
+#endif
+  }
+  return SL_STATUS_OK;
+}
+
+sl_status_t ntp_client_receive_broadcast(ntp_client_t *client,
+                                         uint32_t timeout_ms,
+                                         uint32_t one_way_us,
+                                         ntp_sample_t *sample)
+{
+  struct sockaddr_in sender = { 0 };
+  socklen_t sender_length;
+  uint8_t buffer[NTP_PACKET_SIZE];
+  ntp_packet_t packet;
+  uint32_t start = osKernelGetTickCount();
+  uint32_t elapsed_ms;
+  uint64_t t4;
+  int length;
+
+  while (1) {
+    elapsed_ms = ntp_client_elapsed_ms(start);
+    if (elapsed_ms >= timeout_ms) {
+      return SL_STATUS_TIMEOUT;
+    }
+    ntp_client_set_timeout(client->listen_socket, timeout_ms - elapsed_ms);
+    sender_length = sizeof(sender);
+    length        = recvfrom(client->listen_socket, buffer, sizeof(buffer), 0, (struct sockaddr *)&sender, &sender_length);
+    t4            = client->clock();
+    if (length <= 0) {
+      return SL_STATUS_TIMEOUT;
+    }
+    // Only the server the one way delay was calibrated against is followed
+    if (!ntp_packet_decode(buffer, (size_t)length, &packet) || (packet.mode != NTP_MODE_BROADCAST)
+        || (memcmp(&sender.sin_addr.s_addr, client->server.ip.v4.bytes, sizeof(sender.sin_addr.s_addr)) != 0)
+        || !ntp_client_sane(&packet)) {
+      client->rejected++;
+      continue;
+    }
+    client->received++;
+    client->t1 = 0;
+    client->t4 = t4;
+    memcpy(client->packet, buffer, NTP_PACKET_SIZE);
+    ntp_sample_from_broadcast(t4, &packet, one_way_us, client->precision_us, sample);
+    return SL_STATUS_OK;
+  }
+}
+
+uint32_t ntp_client_reference_id(const ntp_client_t *client)
+{
+  const uint8_t *bytes = client->server.ip.v4.bytes;
+  uint32_t hash        = 0;
+  uint32_t i;
+
+  if (client->server.type != SL_IPV6) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+  }
+  // RFC 5905 takes the first four octets of the MD5 of an IPv6 address, any
+  // stable 32 bit digest serves loop detection among our own peers
+  for (i = 0; i < sizeof(client->server.ip.v6.bytes); i++) {
+    hash = (hash * 31u) + client->server.ip.v6.bytes[i];
+  }
+  return hash;
+}
+
+void ntp_client_close(ntp_client_t *client)
+{
+  if (client->socket >= 0) {
+    close(client->socket);
+    client->socket = -1;
+  }
+  if (client->listen_socket >= 0) {
+    close(client->listen_socket);
+    client->listen_socket = -1;
+  }
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static socklen_t ntp_client_server_address(const ntp_client_t *client, ntp_client_address_t *address)
+{
+  memset(address, 0, sizeof(*address));
+  if (client->server.type == SL_IPV6) {
+    address->v6.sin6_family = AF_INET6;
+    address->v6.sin6_port   = htons(NTP_PORT);
+    memcpy(&address->v6.sin6_addr, client->server.ip.v6.bytes, sizeof(address->v6.sin6_addr));
+    return sizeof(address->v6);
+  }
+  address->v4.sin_family = AF_INET;
+  address->v4.sin_port   = htons(NTP_PORT);
+  memcpy(&address->v4.sin_addr.s_addr, client->server.ip.v4.bytes, sizeof(address->v4.sin_addr.s_addr));
+  return sizeof(address->v4);
+}
+
+static void ntp_client_set_timeout(int socket_id, uint32_t timeout_ms)
+{
+  struct timeval timeout;
+
+  timeout.tv_sec  = timeout_ms / 1000u;
+  timeout.tv_usec = (timeout_ms % 1000u) * 1000u;
+  setsockopt(socket_id, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+static uint32_t ntp_client_elapsed_ms(uint32_t start)
+{
+  return (uint32_t)(((uint64_t)(osKernelGetTickCount() - start) * 1000u) / osKernelGetTickFreq());
+}
+
+// RFC 5905 sanity checks shared by unicast replies and broadcasts
+static bool ntp_client_sane(const ntp_packet_t *packet)
+{
+  if ((packet->leap == NTP_LEAP_UNSYNC) || (packet->stratum == 0) || (packet->stratum > NTP_STRATUM_MAX)) {
+    return false;
+  }
+  if (packet->transmit.value == 0) {
+    return false;
+  }
+  return true;
+}
+
+static bool ntp_client_matches(const ntp_client_t *client, const ntp_packet_t *reply)
+{
+  if (reply->mode != NTP_MODE_SERVER) {
+    return false;
+  }
+  // Bogus or replayed: must echo the outstanding request
+  return reply->origin.value == client->transmit.value;
+}
+
+// RFC 5905 7.4: only the codes that tell the client to back off are acted on,
+// other kisses fail the sanity checks like any stratum 0 packet
+static uint32_t ntp_client_kiss_code(const ntp_packet_t *packet)
+{
+  if ((packet->stratum != 0)
+      || ((packet->reference_id != NTP_KISS_RATE) && (packet->reference_id != NTP_KISS_DENY)
+          && (packet->reference_id != NTP_KISS_RSTR))) {
+    return 0;
+  }
+  return packet->reference_id;
+}
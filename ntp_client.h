@@ -0,0 +1,116 @@
+/***************************************************************************/ /**
+ * @file ntp_client.h
+ * @brief Native NTP client exchange over a UDP socket
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef NTP_CLIENT_H_
+#define NTP_CLIENT_H_
+#include "sl_status.h"
+#include "sl_net.h"
+#include "ntp_packet.h"
+
+// -----------------------------------------------------------------------------
+// Data Types
+/// Local clock used for T1/T4, Unix microseconds
+typedef uint64_t (*ntp_client_clock_t)(void);
+
+typedef struct {
+  int socket;
+  int listen_socket;              ///< Broadcast/multicast reception, -1 when not listening
+  sl_ip_address_t server;
+  ntp_client_clock_t clock;
+  uint32_t precision_us;          ///< Resolution of the local clock
+  ntp_time_t transmit;            ///< Cookie of the outstanding request
+  uint32_t sent;
+  uint32_t received;
+  uint32_t rejected;              ///< Replies dropped by the sanity checks
+  uint32_t kisses;                ///< Kiss-o'-Death packets received
+  uint32_t kiss;                  ///< Code of the last Kiss-o'-Death, NTP_KISS_RATE, _DENY or _RSTR
+  int8_t server_poll;             ///< Poll exponent of the last matching reply or Kiss-o'-Death
+  uint64_t t1;                    ///< Local transmit time of the last accepted packet, 0 for a broadcast
+  uint64_t t4;                    ///< Local receive time of the last accepted packet
+  uint8_t packet[NTP_PACKET_SIZE]; ///< Last accepted packet as received, for trace capture
+} ntp_client_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Open a UDP socket towards an NTP server, IPv4 or IPv6 by the address type.
+ *
+ * @param[in] client client state
+ * @param[in] server server address
+ * @param[in] clock local clock for the exchange timestamps
+ * @param[in] precision_us resolution of that clock
+ * @return status of the socket creation
+ ******************************************************************************/
+sl_status_t ntp_client_open(ntp_client_t *client,
+                            const sl_ip_address_t *server,
+                            ntp_client_clock_t clock,
+                            uint32_t precision_us);
+
+/***************************************************************************/ /**
+ * Send one client request and wait for the matching reply.
+ * Replies that do not echo the request, are unsynchronized or come from an
+ * out of range stratum are dropped and the wait continues. A server asking
+ * for a longer interval answers with a poll exponent above @p poll, kept in
+ * client->server_poll.
+ *
+ * @param[in] client client state
+ * @param[in] poll poll exponent the request advertises, log2 seconds
+ * @param[in] timeout_ms time to wait for a usable reply
+ * @param[out] sample offset, delay and dispersion of the exchange
+ * @return SL_STATUS_TIMEOUT if no usable reply arrived, SL_STATUS_ABORT on a
+ *         RATE, DENY or RSTR Kiss-o'-Death, its code in client->kiss
+ ******************************************************************************/
+sl_status_t ntp_client_exchange(ntp_client_t *client, int8_t poll, uint32_t timeout_ms, ntp_sample_t *sample);
+
+/***************************************************************************/ /**
+ * Start receiving broadcast packets on the NTP port, and multicast packets
+ * sent to @p group when it is not NULL. Nothing is transmitted.
+ *
+ * @param[in] client client state, opened with ntp_client_open()
+ * @param[in] group multicast group, e.g. NTP_MULTICAST_GROUP, or NULL
+ * @return SL_STATUS_NOT_SUPPORTED for an IPv6 server
+ ******************************************************************************/
+sl_status_t ntp_client_listen(ntp_client_t *client, const char *group);
+
+/***************************************************************************/ /**
+ * Wait for one broadcast packet from the server of this client.
+ * Packets from other senders, or that fail the sanity checks, are dropped
+ * and the wait continues.
+ *
+ * @param[in] client client state, listening
+ * @param[in] timeout_ms time to wait for a usable packet
+ * @param[in] one_way_us server to client delay, half the unicast delay
+ * @param[out] sample offset of the packet
+ * @return SL_STATUS_TIMEOUT if no usable packet arrived
+ ******************************************************************************/
+sl_status_t ntp_client_receive_broadcast(ntp_client_t *client,
+                                         uint32_t timeout_ms,
+                                         uint32_t one_way_us,
+                                         ntp_sample_t *sample);
+
+/***************************************************************************/ /**
+ * Reference ID of the server for clients of our own: the IPv4 address, or a
+ * 32 bit digest of an IPv6 address.
+ ******************************************************************************/
+uint32_t ntp_client_reference_id(const ntp_client_t *client);
+
+/***************************************************************************/ /**
+ * Close the sockets.
+ ******************************************************************************/
+void ntp_client_close(ntp_client_t *client);
+
+#endif /* NTP_CLIENT_H_ */
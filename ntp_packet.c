@@ -0,0 +1,191 @@
+/***************************************************************************/ /**
+ * @file ntp_packet.c
+ * @brief NTPv4 packet encoding and on-wire sample computation
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "ntp_packet.h"
+#include "time_types.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define MICROS_PER_SECOND 1000000u
+#define NTP_PHI_PPM       15u // RFC 5905 frequency tolerance
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static void put_u32(uint8_t *buffer, uint32_t value);
+static uint32_t get_u32(const uint8_t *buffer);
+static uint32_t precision_to_us(int8_t precision);
+static int64_t ntp_since_local_ns(ntp_time_t timestamp, uint64_t local_us);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void ntp_packet_encode(const ntp_packet_t *packet, uint8_t *buffer)
+{
+  buffer[0] = (uint8_t)(((packet->leap & 0x3u) << 6) | ((packet->version & 0x7u) << 3) | (packet->mode & 0x7u));
+  buffer[1] = packet->stratum;
+  buffer[2] = (uint8_t)packet->poll;
+  buffer[3] = (uint8_t)packet->precision;
+  put_u32(&buffer[4], packet->root_delay);
+  put_u32(&buffer[8], packet->root_dispersion);
+  put_u32(&buffer[12], packet->reference_id);
+  ntp_timestamp_put(&buffer[NTP_FIELD_REFERENCE], packet->reference);
+  ntp_timestamp_put(&buffer[NTP_FIELD_ORIGIN], packet->origin);
+  ntp_timestamp_put(&buffer[NTP_FIELD_RECEIVE], packet->receive);
+  ntp_timestamp_put(&buffer[NTP_FIELD_TRANSMIT], packet->transmit);
+}
+
+bool ntp_packet_decode(const uint8_t *buffer, size_t length, ntp_packet_t *packet)
+{
+  if (length < NTP_PACKET_SIZE) {
+    return false;
+  }
+  packet->leap               = (uint8_t)(buffer[0] >> 6);
+  packet->version            = (uint8_t)((buffer[0] >> 3) & 0x7u);
+  packet->mode               = (uint8_t)(buffer[0] & 0x7u);
+  packet->stratum            = buffer[1];
+  packet->poll               = (int8_t)buffer[2];
+  packet->precision          = (int8_t)buffer[3];
+  packet->root_delay         = get_u32(&buffer[4]);
+  packet->root_dispersion    = get_u32(&buffer[8]);
+  packet->reference_id       = get_u32(&buffer[12]);
+  packet->reference          = ntp_time_make(get_u32(&buffer[16]), get_u32(&buffer[20]));
+  packet->origin             = ntp_time_make(get_u32(&buffer[24]), get_u32(&buffer[28]));
+  packet->receive            = ntp_time_make(get_u32(&buffer[32]), get_u32(&buffer[36]));
+  packet->transmit           = ntp_time_make(get_u32(&buffer[40]), get_u32(&buffer[44]));
+  return true;
+}
+
+uint32_t ntp_short_to_us(uint32_t value)
+{
+  return (uint32_t)(((uint64_t)value * MICROS_PER_SECOND) >> 16);
+}
+
+uint32_t ntp_short_from_us(uint32_t micros)
+{
+  uint64_t value = ((uint64_t)micros << 16) / MICROS_PER_SECOND;
+
+  return (value > UINT32_MAX) ? UINT32_MAX : (uint32_t)value;
+}
+
+void ntp_timestamp_put(uint8_t *field, ntp_time_t timestamp)
+{
+  put_u32(&field[0], ntp_time_seconds(timestamp));
+  put_u32(&field[4], ntp_time_fraction(timestamp));
+}
+
+int8_t ntp_precision_from_us(uint32_t micros)
+{
+  int8_t precision = 0;
+
+  while ((precision > -20) && (precision_to_us((int8_t)(precision - 1)) >= micros)) {
+    precision--;
+  }
+  return precision;
+}
+
+void ntp_sample_compute(uint64_t t1,
+                        uint64_t t4,
+                        const ntp_packet_t *reply,
+                        uint32_t local_precision_us,
+                        ntp_sample_t *sample)
+{
+  time_q32_t held   = ntp_time_diff(reply->transmit, reply->receive);
+  int64_t round_trip = (int64_t)t4 - (int64_t)t1;
+  int64_t delay;
+
+  if (round_trip < 0) {
+    round_trip = 0;
+  }
+  // theta = ((T2 - T1) + (T3 - T4)) / 2 in nanoseconds, the local clock may
+  // still be decades behind. delta = (T4 - T1) - (T3 - T2), T3 - T2 in Q32.32.
+  // Only the results are rounded to microseconds.
+  sample->offset_us = time_floor_div(ntp_since_local_ns(reply->receive, t1) / 2
+                                       + ntp_since_local_ns(reply->transmit, t4) / 2 + 500,
+                                     1000);
+  delay             = round_trip - time_q32_to_us(held);
+  // A server clock coarser than the round trip can make delta negative
+  sample->delay_us = (delay < 0) ? 0u : (uint32_t)delay;
+  sample->dispersion_us = precision_to_us(reply->precision) + local_precision_us
+                          + (uint32_t)((round_trip * NTP_PHI_PPM) / MICROS_PER_SECOND);
+  sample->local_us           = t4;
+  sample->root_delay_us      = ntp_short_to_us(reply->root_delay);
+  sample->root_dispersion_us = ntp_short_to_us(reply->root_dispersion);
+  sample->reference_id       = reply->reference_id;
+  sample->stratum            = reply->stratum;
+  sample->leap               = reply->leap;
+  sample->poll               = reply->poll;
+}
+
+void ntp_sample_from_broadcast(uint64_t t4,
+                               const ntp_packet_t *packet,
+                               uint32_t one_way_us,
+                               uint32_t local_precision_us,
+                               ntp_sample_t *sample)
+{
+  // theta = T3 + one way delay - T4
+  sample->offset_us          = time_floor_div(ntp_since_local_ns(packet->transmit, t4) + 500, 1000) + (int64_t)one_way_us;
+  sample->delay_us           = 2u * one_way_us;
+  sample->dispersion_us      = precision_to_us(packet->precision) + local_precision_us;
+  sample->local_us           = t4;
+  sample->root_delay_us      = ntp_short_to_us(packet->root_delay);
+  sample->root_dispersion_us = ntp_short_to_us(packet->root_dispersion);
+  sample->reference_id       = packet->reference_id;
+  sample->stratum            = packet->stratum;
+  sample->leap               = packet->leap;
+  sample->poll               = packet->poll;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static void put_u32(uint8_t *buffer, uint32_t value)
+{
+  buffer[0] = (uint8_t)(value >> 24);
+  buffer[1] = (uint8_t)(value >> 16);
+  buffer[2] = (uint8_t)(value >> 8);
+  buffer[3] = (uint8_t)value;
+}
+
+static uint32_t get_u32(const uint8_t *buffer)
+{
+  return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) | ((uint32_t)buffer[2] << 8) | buffer[3];
+}
+
+// Precision is log2 seconds, e.g. -20 is about one microsecond
+static uint32_t precision_to_us(int8_t precision)
+{
+  if (precision >= 0) {
+    return MICROS_PER_SECOND;
+  }
+  if (precision <= -20) {
+    return 1u;
+  }
+  return MICROS_PER_SECOND >> (uint32_t)(-precision);
+}
+
+// Server timestamp minus a local clock reading, across NTP eras. Until the
+// first sync the local clock counts from the boot tick near 1970, too far
+// from the server for a difference modulo 2^32 s, so the era is resolved
+// against TIME_PIVOT_UNIX_S then and the difference taken in full.
+static int64_t ntp_since_local_ns(ntp_time_t timestamp, uint64_t local_us)
+{
+  unix_time_t local = unix_time_from_us((int64_t)local_us);
+  unix_time_t pivot = (unix_time_s(local) < TIME_PIVOT_UNIX_S) ? unix_time_from_s(TIME_PIVOT_UNIX_S) : local;
+
+  return ntp_time_to_unix(timestamp, pivot).ns - local.ns;
+}
@@ -0,0 +1,140 @@
+/***************************************************************************/ /**
+ * @file ntp_packet.h
+ * @brief NTPv4 packet encoding and on-wire sample computation
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef NTP_PACKET_H_
+#define NTP_PACKET_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "time_types.h"
+
+// -----------------------------------------------------------------------------
+// Macros
+#define NTP_PACKET_SIZE       48u
+#define NTP_PORT              123u
+#define NTP_VERSION           4u
+#define NTP_MODE_CLIENT       3u
+#define NTP_MODE_SERVER       4u
+#define NTP_MODE_BROADCAST    5u
+#define NTP_LEAP_UNSYNC       3u
+#define NTP_STRATUM_MAX       15u
+#define NTP_MULTICAST_GROUP   "224.0.1.1"  ///< IANA NTP multicast address
+#define NTP_POLL_MAX          17           ///< RFC 5905 longest poll interval, log2 seconds
+
+// Kiss-o'-Death codes, carried as reference ID of a stratum 0 packet
+#define NTP_KISS_RATE 0x52415445u ///< "RATE", poll less often
+#define NTP_KISS_DENY 0x44454E59u ///< "DENY", access denied, stop
+#define NTP_KISS_RSTR 0x52535452u ///< "RSTR", access restricted, stop
+
+// Byte offsets of the header timestamps
+#define NTP_FIELD_REFERENCE 16u
+#define NTP_FIELD_ORIGIN    24u
+#define NTP_FIELD_RECEIVE   32u
+#define NTP_FIELD_TRANSMIT  40u
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef struct {
+  uint8_t leap;
+  uint8_t version;
+  uint8_t mode;
+  uint8_t stratum;
+  int8_t poll;
+  int8_t precision;
+  uint32_t root_delay;      ///< NTP short format, 16.16 seconds
+  uint32_t root_dispersion; ///< NTP short format, 16.16 seconds
+  uint32_t reference_id;
+  ntp_time_t reference;    ///< Timestamps as on the wire, era not resolved
+  ntp_time_t origin;
+  ntp_time_t receive;
+  ntp_time_t transmit;
+} ntp_packet_t;
+
+/// One client/server exchange reduced to RFC 5905 terms
+typedef struct {
+  int64_t offset_us;          ///< Server minus local clock (theta)
+  uint32_t delay_us;          ///< Round trip minus server processing (delta)
+  uint32_t dispersion_us;     ///< Error from precision of both ends
+  uint64_t local_us;          ///< Local clock at reception (T4)
+  uint32_t root_delay_us;
+  uint32_t root_dispersion_us;
+  uint32_t reference_id;
+  uint8_t stratum;
+  uint8_t leap;
+  int8_t poll;
+} ntp_sample_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Serialize @p packet into @p buffer (NTP_PACKET_SIZE bytes, network order).
+ ******************************************************************************/
+void ntp_packet_encode(const ntp_packet_t *packet, uint8_t *buffer);
+
+/***************************************************************************/ /**
+ * Parse a received datagram. Extension fields and MACs are ignored.
+ *
+ * @return false if the datagram is shorter than an NTP header
+ ******************************************************************************/
+bool ntp_packet_decode(const uint8_t *buffer, size_t length, ntp_packet_t *packet);
+
+uint32_t ntp_short_to_us(uint32_t value);
+uint32_t ntp_short_from_us(uint32_t micros);
+
+/***************************************************************************/ /**
+ * Write one timestamp into an encoded packet, e.g. at NTP_FIELD_RECEIVE.
+ ******************************************************************************/
+void ntp_timestamp_put(uint8_t *field, ntp_time_t timestamp);
+
+/***************************************************************************/ /**
+ * Precision field for a clock resolution, log2 seconds rounded up.
+ ******************************************************************************/
+int8_t ntp_precision_from_us(uint32_t micros);
+
+/***************************************************************************/ /**
+ * Reduce the four exchange timestamps to offset, delay and dispersion.
+ * T1/T4 are local clock readings, T2/T3 come from the server reply.
+ *
+ * @param[in] t1 local transmit time, Unix microseconds
+ * @param[in] t4 local receive time, Unix microseconds
+ * @param[in] reply server reply, receive (T2) and transmit (T3) are used
+ * @param[in] local_precision_us resolution of the local clock
+ * @param[out] sample result
+ ******************************************************************************/
+void ntp_sample_compute(uint64_t t1,
+                        uint64_t t4,
+                        const ntp_packet_t *reply,
+                        uint32_t local_precision_us,
+                        ntp_sample_t *sample);
+
+/***************************************************************************/ /**
+ * Reduce a broadcast or multicast packet to a sample. Only T3 and T4 exist,
+ * the path delay comes from an earlier unicast calibration.
+ *
+ * @param[in] t4 local receive time, Unix microseconds
+ * @param[in] packet broadcast packet, transmit (T3) is used
+ * @param[in] one_way_us calibrated server to client delay
+ * @param[in] local_precision_us resolution of the local clock
+ * @param[out] sample result, delay_us is twice @p one_way_us
+ ******************************************************************************/
+void ntp_sample_from_broadcast(uint64_t t4,
+                               const ntp_packet_t *packet,
+                               uint32_t one_way_us,
+                               uint32_t local_precision_us,
+                               ntp_sample_t *sample);
+
+#endif /* NTP_PACKET_H_ */
@@ -0,0 +1,161 @@
+/***************************************************************************/ /**
+ * @file ntp_server.c
+ * @brief Minimal NTP server answering LAN peers from the calendar
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "cmsis_os2.h"
+#include "socket.h"
+#include "string.h"
+#include "stdio.h"
+#include "ntp_server.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+// Compiler barrier, writer and reader threads share one core
+#define NTP_SERVER_BARRIER() __asm__ volatile("" ::: "memory")
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+static const osThreadAttr_t ntp_server_thread_attributes = {
+  .name       = "ntp_server",
+  .attr_bits  = 0,
+  .cb_mem     = 0,
+  .cb_size    = 0,
+  .stack_mem  = 0,
+  .stack_size = NTP_SERVER_STACK_SIZE,
+  .priority   = osPriorityAboveNormal,
+  .tz_module  = 0,
+  .reserved   = 0,
+};
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static void ntp_server_task(void *argument);
+static bool ntp_server_snapshot(ntp_server_t *server, uint8_t *response);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+sl_status_t ntp_server_start(ntp_server_t *server, ntp_server_clock_t clock, uint32_t precision_us)
+{
+  struct sockaddr_in local_address = { 0 };
+
+  memset(server, 0, sizeof(*server));
+  server->clock     = clock;
+  server->precision = ntp_precision_from_us(precision_us);
+  server->socket    = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (server->socket < 0) {
+    printf("NTP server socket create failed: %d\r\n", server->socket);
+    return SL_STATUS_FAIL;
+  }
+  local_address.sin_family      = AF_INET;
+  local_address.sin_port        = htons(NTP_PORT);
+  local_address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(server->socket, (struct sockaddr *)&local_address, sizeof(local_address)) < 0) {
+    printf("NTP server bind failed\r\n");
+    close(server->socket);
+    server->socket = -1;
+    return SL_STATUS_FAIL;
+  }
+  if (osThreadNew((osThreadFunc_t)ntp_server_task, server, &ntp_server_thread_attributes) == NULL) {
+    close(server->socket);
+    server->socket = -1;
+    return SL_STATUS_FAIL;
+  }
+  return SL_STATUS_OK;
+}
+
+void ntp_server_update(ntp_server_t *server, const ntp_server_source_t *source)
+{
+  ntp_packet_t header = { 0 };
+  uint32_t next       = server->sequence + 1u;
+  bool synced = (source->leap != NTP_LEAP_UNSYNC) && (source->stratum != 0) && (source->stratum < NTP_STRATUM_MAX);
+
+  header.leap            = source->leap;
+  header.version         = NTP_VERSION;
+  header.mode            = NTP_MODE_SERVER;
+  header.stratum         = (uint8_t)(source->stratum + 1u);
+  header.poll            = source->poll;
+  header.precision       = server->precision;
+  header.root_delay      = ntp_short_from_us(source->root_delay_us);
+  header.root_dispersion = ntp_short_from_us(source->root_dispersion_us);
+  header.reference_id    = source->reference_id;
+  header.reference       = ntp_time_from_unix(unix_time_from_us((int64_t)source->reference_us));
+  // The server thread stays on the other copy until the sequence moves
+  ntp_packet_encode(&header, server->response[next & 1u]);
+  server->synced[next & 1u] = synced;
+  NTP_SERVER_BARRIER();
+  server->sequence = next;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static void ntp_server_task(void *argument)
+{
+  ntp_server_t *server = (ntp_server_t *)argument;
+  struct sockaddr_in peer;
+  socklen_t peer_length;
+  uint8_t request[NTP_PACKET_SIZE];
+  uint8_t response[NTP_PACKET_SIZE];
+  uint64_t t2;
+  uint64_t t3;
+  int length;
+
+  while (1) {
+    peer_length = sizeof(peer);
+    length      = recvfrom(server->socket, request, sizeof(request), 0, (struct sockaddr *)&peer, &peer_length);
+    t2          = server->clock();
+    if (length < (int)NTP_PACKET_SIZE) {
+      continue;
+    }
+    server->requests++;
+    // Client mode only, and no answers while this device is not synchronized
+    if (((request[0] & 0x7u) != NTP_MODE_CLIENT) || !ntp_server_snapshot(server, response)) {
+      continue;
+    }
+    // Echo the client version, its transmit stamp becomes our origin
+    response[0] = (uint8_t)((response[0] & 0xC7u) | (request[0] & 0x38u));
+    memcpy(&response[NTP_FIELD_ORIGIN], &request[NTP_FIELD_TRANSMIT], 8u);
+    ntp_timestamp_put(&response[NTP_FIELD_RECEIVE], ntp_time_from_unix(unix_time_from_us((int64_t)t2)));
+    t3 = server->clock();
+    ntp_timestamp_put(&response[NTP_FIELD_TRANSMIT], ntp_time_from_unix(unix_time_from_us((int64_t)t3)));
+    if (sendto(server->socket, response, sizeof(response), 0, (struct sockaddr *)&peer, peer_length) >= 0) {
+      server->replies++;
+    }
+    if ((uint32_t)(t3 - t2) > server->max_service_us) {
+      server->max_service_us = (uint32_t)(t3 - t2);
+    }
+  }
+}
+
+// Copy the current reply header. The writer never touches it, a retry is
+// only needed when two updates complete during the copy.
+static bool ntp_server_snapshot(ntp_server_t *server, uint8_t *response)
+{
+  uint32_t sequence;
+  bool synced;
+
+  do {
+    sequence = server->sequence;
+    NTP_SERVER_BARRIER();
+    memcpy(response, server->response[sequence & 1u], NTP_PACKET_SIZE);
+    synced = server->synced[sequence & 1u];
+    NTP_SERVER_BARRIER();
+  } while (sequence != server->sequence);
+  return synced;
+}
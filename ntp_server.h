@@ -0,0 +1,82 @@
+/***************************************************************************/ /**
+ * @file ntp_server.h
+ * @brief Minimal NTP server answering LAN peers from the calendar
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef NTP_SERVER_H_
+#define NTP_SERVER_H_
+#include "sl_status.h"
+#include "ntp_packet.h"
+
+// -----------------------------------------------------------------------------
+// Macros
+#define NTP_SERVER_STACK_SIZE 1536
+
+// -----------------------------------------------------------------------------
+// Data Types
+/// Local clock the replies are stamped with, Unix microseconds
+typedef uint64_t (*ntp_server_clock_t)(void);
+
+/// Synchronization state of this device, as advertised to its peers
+typedef struct {
+  uint8_t leap;
+  uint8_t stratum;              ///< Stratum of the upstream server
+  int8_t poll;
+  uint32_t reference_id;        ///< IPv4 address of the upstream server
+  uint64_t reference_us;        ///< Local time of the last clock update
+  uint32_t root_delay_us;       ///< Upstream root delay plus the path to it
+  uint32_t root_dispersion_us;  ///< Upstream root dispersion plus local error
+} ntp_server_source_t;
+
+/// The reply header is kept twice, as in time_quality.h: the server thread
+/// reads the copy ntp_server_update() is not writing. It runs above the
+/// client thread, so a reader retrying until the writer finished could spin
+/// forever.
+typedef struct {
+  volatile uint32_t sequence;            ///< Updates so far, its low bit picks the current copy
+  bool synced[2];
+  uint8_t response[2][NTP_PACKET_SIZE];  ///< Reply headers, only the timestamps are filled per request
+  int socket;
+  ntp_server_clock_t clock;
+  int8_t precision;
+  uint32_t requests;
+  uint32_t replies;
+  uint32_t max_service_us;            ///< Longest receive to transmit stamp
+} ntp_server_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Bind UDP port 123 and start the server thread. Requests are dropped until
+ * the first ntp_server_update().
+ *
+ * @param[in] server server state, must stay valid
+ * @param[in] clock local clock for the receive and transmit stamps
+ * @param[in] precision_us resolution of that clock
+ * @return status of the socket and thread creation
+ ******************************************************************************/
+sl_status_t ntp_server_start(ntp_server_t *server, ntp_server_clock_t clock, uint32_t precision_us);
+
+/***************************************************************************/ /**
+ * Rebuild the reply header after a clock update, at stratum + 1. The server
+ * thread reads it lock-free, so replies never wait on the client thread.
+ * A source above stratum 14 stops the replies.
+ *
+ * @param[in] server server state
+ * @param[in] source current synchronization state
+ ******************************************************************************/
+void ntp_server_update(ntp_server_t *server, const ntp_server_source_t *source);
+
+#endif /* NTP_SERVER_H_ */
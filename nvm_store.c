@@ -0,0 +1,79 @@
+/***************************************************************************/ /**
+ * @file nvm_store.c
+ * @brief Application records kept in NVM3
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "nvm3_default.h"
+#include "rsi_debug.h"
+#include "nvm_store.h"
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+static bool nvm_store_ready = false;
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+sl_status_t nvm_store_init(void)
+{
+  Ecode_t ecode;
+
+  if (nvm_store_ready) {
+    return SL_STATUS_OK;
+  }
+  ecode = nvm3_initDefault();
+  if (ecode != ECODE_NVM3_OK) {
+    DEBUGOUT("nvm3_initDefault: Error Code : 0x%lx \r\n", ecode);
+    return SL_STATUS_FAIL;
+  }
+  nvm_store_ready = true;
+  return SL_STATUS_OK;
+}
+
+sl_status_t nvm_store_read(nvm_store_key_t key, void *data, size_t length)
+{
+  uint32_t type;
+  size_t stored_length;
+  Ecode_t ecode;
+
+  if (nvm_store_init() != SL_STATUS_OK) {
+    return SL_STATUS_FAIL;
+  }
+  ecode = nvm3_getObjectInfo(nvm3_defaultHandle, key, &type, &stored_length);
+  if ((ecode != ECODE_NVM3_OK) || (stored_length != length)) {
+    return SL_STATUS_NOT_FOUND;
+  }
+  ecode = nvm3_readData(nvm3_defaultHandle, key, data, length);
+  if (ecode != ECODE_NVM3_OK) {
+    DEBUGOUT("nvm3_readData: key 0x%x, Error Code : 0x%lx \r\n", key, ecode);
+    return SL_STATUS_FAIL;
+  }
+  return SL_STATUS_OK;
+}
+
+sl_status_t nvm_store_write(nvm_store_key_t key, const void *data, size_t length)
+{
+  Ecode_t ecode;
+
+  if (nvm_store_init() != SL_STATUS_OK) {
+    return SL_STATUS_FAIL;
+  }
+  ecode = nvm3_writeData(nvm3_defaultHandle, key, data, length);
+  if (ecode != ECODE_NVM3_OK) {
+    DEBUGOUT("nvm3_writeData: key 0x%x, Error Code : 0x%lx \r\n", key, ecode);
+    return SL_STATUS_FAIL;
+  }
+  return SL_STATUS_OK;
+}
@@ -0,0 +1,62 @@
+/***************************************************************************/ /**
+ * @file nvm_store.h
+ * @brief Application records kept in NVM3
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef NVM_STORE_H_
+#define NVM_STORE_H_
+#include <stddef.h>
+#include "sl_status.h"
+
+// -----------------------------------------------------------------------------
+// Data Types
+/// NVM3 object keys owned by the application
+typedef enum {
+  NVM_STORE_KEY_CLOCK_SELECT = 0x1001, ///< clock_select_record_t
+  NVM_STORE_KEY_WIFI_CACHE   = 0x1002, ///< wifi_cache_record_t
+} nvm_store_key_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Open the default NVM3 instance. Safe to call more than once.
+ *
+ * @param none
+ * @return status of the NVM3 initialization
+ ******************************************************************************/
+sl_status_t nvm_store_init(void);
+
+/***************************************************************************/ /**
+ * Read a record. A stored object of a different size (an older layout) is
+ * reported as not found.
+ *
+ * @param[in] key record key
+ * @param[out] data record buffer
+ * @param[in] length exact record size
+ * @return SL_STATUS_NOT_FOUND if no record of that size is stored
+ ******************************************************************************/
+sl_status_t nvm_store_read(nvm_store_key_t key, void *data, size_t length);
+
+/***************************************************************************/ /**
+ * Write a record, replacing any previous one.
+ *
+ * @param[in] key record key
+ * @param[in] data record contents
+ * @param[in] length record size
+ * @return status of the NVM3 write
+ ******************************************************************************/
+sl_status_t nvm_store_write(nvm_store_key_t key, const void *data, size_t length);
+
+#endif /* NVM_STORE_H_ */
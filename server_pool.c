@@ -0,0 +1,270 @@
+/***************************************************************************/ /**
+ * @file server_pool.c
+ * @brief NTP server addresses collected from DNS, scored and rotated
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include <string.h>
+#include "ntp_packet.h"
+#include "server_pool.h"
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static bool server_pool_same(const sl_ip_address_t *a, const sl_ip_address_t *b);
+static uint8_t server_pool_best_other(const server_pool_t *pool);
+static uint32_t server_pool_misses(const server_pool_entry_t *entry);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void server_pool_init(server_pool_t *pool, uint32_t ttl)
+{
+  memset(pool, 0, sizeof(*pool));
+  pool->ttl = ttl;
+}
+
+bool server_pool_add(server_pool_t *pool, const sl_ip_address_t *address, uint32_t now)
+{
+  server_pool_entry_t *entry;
+  uint8_t slot;
+  uint8_t i;
+
+  for (i = 0; i < pool->denied_count; i++) {
+    if (server_pool_same(&pool->denied[i], address)) {
+      return false;
+    }
+  }
+  for (i = 0; i < pool->count; i++) {
+    if (server_pool_same(&pool->entry[i].address, address)) {
+      pool->entry[i].seen = now;
+      return false;
+    }
+  }
+  if (pool->count < SERVER_POOL_MAX) {
+    slot = pool->count++;
+  } else {
+    // Only an entry doing worse than an unknown server is given up
+    slot = SERVER_POOL_MAX;
+    for (i = 0; i < pool->count; i++) {
+      if ((i != pool->current) && (server_pool_score(&pool->entry[i]) > SERVER_POOL_UNKNOWN_US)
+          && ((slot == SERVER_POOL_MAX)
+              || (server_pool_score(&pool->entry[i]) > server_pool_score(&pool->entry[slot])))) {
+        slot = i;
+      }
+    }
+    if (slot == SERVER_POOL_MAX) {
+      return false;
+    }
+  }
+  entry = &pool->entry[slot];
+  memset(entry, 0, sizeof(*entry));
+  entry->address = *address;
+  entry->seen    = now;
+  if (pool->count == 1u) {
+    pool->current = 0;
+  }
+  return true;
+}
+
+void server_pool_result(server_pool_t *pool, bool replied, uint32_t delay_us, uint8_t stratum)
+{
+  server_pool_entry_t *entry;
+
+  if (pool->current >= pool->count) {
+    return;
+  }
+  entry        = &pool->entry[pool->current];
+  entry->reach = (uint8_t)((entry->reach << 1) | (replied ? 1u : 0u));
+  if (entry->polls < UINT16_MAX) {
+    entry->polls++;
+  }
+  if (!replied) {
+    return;
+  }
+  entry->stratum = stratum;
+  if (entry->replies == 0) {
+    entry->delay_us = delay_us;
+  } else {
+    entry->delay_us = (uint32_t)((int32_t)entry->delay_us
+                                 + (((int32_t)delay_us - (int32_t)entry->delay_us) >> SERVER_POOL_DELAY_SHIFT));
+  }
+  if (entry->replies < UINT16_MAX) {
+    entry->replies++;
+  }
+}
+
+void server_pool_sent(server_pool_t *pool, uint32_t now)
+{
+  if (pool->current >= pool->count) {
+    return;
+  }
+  pool->entry[pool->current].sent   = true;
+  pool->entry[pool->current].sent_s = now;
+}
+
+uint32_t server_pool_wait_s(const server_pool_t *pool, uint32_t now)
+{
+  const server_pool_entry_t *entry;
+  uint32_t interval_s;
+  uint32_t elapsed_s;
+
+  if ((pool->current >= pool->count) || pool->entry[pool->current].denied) {
+    return UINT32_MAX;
+  }
+  entry = &pool->entry[pool->current];
+  if ((entry->min_poll <= 0) || !entry->sent) {
+    return 0;
+  }
+  interval_s = 1u << entry->min_poll;
+  elapsed_s  = now - entry->sent_s;
+  return (elapsed_s >= interval_s) ? 0 : (interval_s - elapsed_s);
+}
+
+void server_pool_min_poll(server_pool_t *pool, int8_t poll)
+{
+  server_pool_entry_t *entry;
+
+  if (pool->current >= pool->count) {
+    return;
+  }
+  entry = &pool->entry[pool->current];
+  if (poll > NTP_POLL_MAX) {
+    poll = NTP_POLL_MAX;
+  }
+  if (poll > entry->min_poll) {
+    entry->min_poll = poll;
+  }
+}
+
+void server_pool_kiss(server_pool_t *pool, uint32_t code, int8_t poll)
+{
+  server_pool_entry_t *entry;
+  int8_t doubled;
+
+  if (pool->current >= pool->count) {
+    return;
+  }
+  entry = &pool->entry[pool->current];
+  if (code != NTP_KISS_RATE) {
+    if (!entry->denied) {
+      pool->denied[pool->denied_next] = entry->address;
+      pool->denied_next               = (uint8_t)((pool->denied_next + 1u) % SERVER_POOL_DENIED_MAX);
+      if (pool->denied_count < SERVER_POOL_DENIED_MAX) {
+        pool->denied_count++;
+      }
+    }
+    entry->denied = true;
+    return;
+  }
+  // Every RATE kiss backs off further, whatever poll the server echoed
+  doubled = (int8_t)((entry->min_poll < SERVER_POOL_RATE_POLL) ? SERVER_POOL_RATE_POLL : (entry->min_poll + 1));
+  server_pool_min_poll(pool, (poll > doubled) ? poll : doubled);
+}
+
+bool server_pool_rotate(server_pool_t *pool)
+{
+  const server_pool_entry_t *current;
+  uint8_t best;
+  uint32_t best_score;
+  bool dead;
+
+  if ((pool->count < 2u) || (pool->current >= pool->count)) {
+    return false;
+  }
+  current    = &pool->entry[pool->current];
+  best       = server_pool_best_other(pool);
+  best_score = server_pool_score(&pool->entry[best]);
+  if (pool->entry[best].denied) {
+    return false;
+  }
+  dead = current->denied
+         || ((current->polls >= SERVER_POOL_DEAD_POLLS) && ((current->reach & ((1u << SERVER_POOL_DEAD_POLLS) - 1u)) == 0));
+  if (!dead && ((best_score + best_score / SERVER_POOL_HYSTERESIS) >= server_pool_score(current))) {
+    return false;
+  }
+  pool->current = best;
+  return true;
+}
+
+bool server_pool_needs_resolve(const server_pool_t *pool, uint32_t now)
+{
+  return (server_pool_wait_s(pool, now) == UINT32_MAX) || ((now - pool->resolved) >= (pool->ttl / 2u));
+}
+
+void server_pool_resolved(server_pool_t *pool, uint32_t now)
+{
+  uint8_t i = 0;
+
+  pool->resolved = now;
+  while (i < pool->count) {
+    if ((i == pool->current) || ((now - pool->entry[i].seen) <= 2u * pool->ttl)) {
+      i++;
+      continue;
+    }
+    memmove(&pool->entry[i], &pool->entry[i + 1u], (size_t)(pool->count - i - 1u) * sizeof(pool->entry[0]));
+    pool->count--;
+    if (pool->current > i) {
+      pool->current--;
+    }
+  }
+}
+
+uint32_t server_pool_score(const server_pool_entry_t *entry)
+{
+  uint32_t misses = server_pool_misses(entry);
+
+  if (entry->denied) {
+    return UINT32_MAX;
+  }
+  if (entry->replies == 0) {
+    return SERVER_POOL_UNKNOWN_US + misses * SERVER_POOL_MISS_US;
+  }
+  return entry->delay_us + (uint32_t)entry->stratum * SERVER_POOL_STRATUM_US + misses * SERVER_POOL_MISS_US;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static bool server_pool_same(const sl_ip_address_t *a, const sl_ip_address_t *b)
+{
+  if (a->type != b->type) {
+    return false;
+  }
+  if (a->type == SL_IPV6) {
+    return memcmp(a->ip.v6.bytes, b->ip.v6.bytes, sizeof(a->ip.v6.bytes)) == 0;
+  }
+  return memcmp(a->ip.v4.bytes, b->ip.v4.bytes, sizeof(a->ip.v4.bytes)) == 0;
+}
+
+static uint8_t server_pool_best_other(const server_pool_t *pool)
+{
+  uint8_t best = (pool->current == 0) ? 1u : 0u;
+  uint8_t i;
+
+  for (i = 0; i < pool->count; i++) {
+    if ((i != pool->current) && (server_pool_score(&pool->entry[i]) < server_pool_score(&pool->entry[best]))) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+// Polls without reply among the last eight, or fewer if not polled that often
+static uint32_t server_pool_misses(const server_pool_entry_t *entry)
+{
+  uint32_t polled = (entry->polls < 8u) ? entry->polls : 8u;
+  uint32_t mask   = (1u << polled) - 1u;
+
+  return polled - (uint32_t)__builtin_popcount(entry->reach & mask);
+}
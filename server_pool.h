@@ -0,0 +1,160 @@
+/***************************************************************************/ /**
+ * @file server_pool.h
+ * @brief NTP server addresses collected from DNS, scored and rotated
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef SERVER_POOL_H_
+#define SERVER_POOL_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include "sl_net.h"
+
+// -----------------------------------------------------------------------------
+// Macros
+#define SERVER_POOL_MAX           8u      ///< Addresses kept
+#define SERVER_POOL_DEAD_POLLS    3u      ///< Polls in a row without reply that retire the current server
+#define SERVER_POOL_UNKNOWN_US    100000u ///< Score of a server not measured yet
+#define SERVER_POOL_STRATUM_US    1000u   ///< Score added per stratum
+#define SERVER_POOL_MISS_US       50000u  ///< Score added per missed reply in the reach register
+#define SERVER_POOL_HYSTERESIS    4u      ///< Another server must score 1/4 better to take over
+#define SERVER_POOL_DELAY_SHIFT   2u      ///< Delay average gain 1/4 per reply
+#define SERVER_POOL_RATE_POLL     6       ///< Shortest interval after a RATE kiss, log2 seconds
+#define SERVER_POOL_DENIED_MAX    8u      ///< Demobilized addresses remembered
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef struct {
+  sl_ip_address_t address;
+  uint32_t seen;     ///< Time of the last DNS answer carrying this address, seconds
+  uint32_t delay_us; ///< Averaged round trip delay
+  uint16_t polls;
+  uint16_t replies;
+  uint8_t reach;     ///< RFC 5905 reachability register, bit 0 is the last poll
+  uint8_t stratum;
+  int8_t min_poll;   ///< Shortest interval the server accepts, log2 seconds, 0 for no limit
+  bool denied;       ///< Demobilized by a DENY or RSTR kiss, never polled again
+  bool sent;
+  uint32_t sent_s;   ///< Time of the last request, seconds
+} server_pool_entry_t;
+
+typedef struct {
+  server_pool_entry_t entry[SERVER_POOL_MAX];
+  uint8_t count;
+  uint8_t current;   ///< Entry in use, count when the pool is empty
+  uint32_t ttl;      ///< Seconds a DNS answer is trusted
+  uint32_t resolved; ///< Time of the last resolve, seconds
+  sl_ip_address_t denied[SERVER_POOL_DENIED_MAX]; ///< Demobilized addresses, the oldest is overwritten first
+  uint8_t denied_count;
+  uint8_t denied_next;
+} server_pool_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+void server_pool_init(server_pool_t *pool, uint32_t ttl);
+
+/***************************************************************************/ /**
+ * Merge one DNS answer. A demobilized address is ignored, a known one is
+ * refreshed, a new one takes a free slot or the slot of the worst scoring
+ * entry other than the current. The first address becomes the current
+ * server.
+ *
+ * @param[in] pool pool state
+ * @param[in] address resolved address
+ * @param[in] now current time, seconds
+ * @return true if the address was added
+ ******************************************************************************/
+bool server_pool_add(server_pool_t *pool, const sl_ip_address_t *address, uint32_t now);
+
+/***************************************************************************/ /**
+ * Record the outcome of one poll of the current server.
+ *
+ * @param[in] pool pool state
+ * @param[in] replied whether a usable reply arrived
+ * @param[in] delay_us round trip delay of the reply
+ * @param[in] stratum stratum of the reply
+ ******************************************************************************/
+void server_pool_result(server_pool_t *pool, bool replied, uint32_t delay_us, uint8_t stratum);
+
+/***************************************************************************/ /**
+ * Note a request to the current server, the start of its minimum interval.
+ *
+ * @param[in] pool pool state
+ * @param[in] now current time, seconds
+ ******************************************************************************/
+void server_pool_sent(server_pool_t *pool, uint32_t now);
+
+/***************************************************************************/ /**
+ * Time until the current server may be sent the next request.
+ *
+ * @param[in] pool pool state
+ * @param[in] now current time, seconds
+ * @return seconds, 0 if it may be polled now, UINT32_MAX if no server is
+ *         usable
+ ******************************************************************************/
+uint32_t server_pool_wait_s(const server_pool_t *pool, uint32_t now);
+
+/***************************************************************************/ /**
+ * Raise the minimum interval of the current server, e.g. to the poll
+ * exponent of a reply that is above the requested one. It is never lowered.
+ *
+ * @param[in] pool pool state
+ * @param[in] poll log2 seconds, capped at NTP_POLL_MAX
+ ******************************************************************************/
+void server_pool_min_poll(server_pool_t *pool, int8_t poll);
+
+/***************************************************************************/ /**
+ * Act on a Kiss-o'-Death of the current server. RATE at least doubles its
+ * minimum interval, and raises it to the poll exponent of the kiss. DENY and
+ * RSTR demobilize it: it scores worst, so its slot is the first to be given
+ * to a new address, and it is not polled or rotated to again. The address
+ * also goes on a list of the last SERVER_POOL_DENIED_MAX demobilized ones,
+ * which later DNS answers cannot add back.
+ *
+ * @param[in] pool pool state
+ * @param[in] code NTP_KISS_RATE, NTP_KISS_DENY or NTP_KISS_RSTR
+ * @param[in] poll poll exponent of the kiss
+ ******************************************************************************/
+void server_pool_kiss(server_pool_t *pool, uint32_t code, int8_t poll);
+
+/***************************************************************************/ /**
+ * Move to a better server. The current one is left after SERVER_POOL_DEAD_POLLS
+ * silent polls, once demobilized, or when another scores better by the
+ * hysteresis margin. Demobilized servers are not moved to.
+ *
+ * @param[in] pool pool state
+ * @return true if the current server changed
+ ******************************************************************************/
+bool server_pool_rotate(server_pool_t *pool);
+
+/***************************************************************************/ /**
+ * Whether the name should be resolved again: the answers are about to expire,
+ * half the TTL before, or no usable server is left.
+ ******************************************************************************/
+bool server_pool_needs_resolve(const server_pool_t *pool, uint32_t now);
+
+/***************************************************************************/ /**
+ * Note a completed resolve and drop the entries DNS stopped returning two
+ * TTLs ago, unless it is the current server. Demobilized entries age out the
+ * same way, the denied list keeps them from being added again.
+ ******************************************************************************/
+void server_pool_resolved(server_pool_t *pool, uint32_t now);
+
+/***************************************************************************/ /**
+ * Score of an entry, an estimated delay in microseconds, lower is better.
+ * UINT32_MAX once demobilized.
+ ******************************************************************************/
+uint32_t server_pool_score(const server_pool_entry_t *entry);
+
+#endif /* SERVER_POOL_H_ */
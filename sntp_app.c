@@ -38,24 +38,74 @@
 #include "sl_wifi_callback_framework.h"
 #include "sl_si91x_types.h"
 #include "string.h"
+#include "stdlib.h"
 #include "calendar_app.h"
+#include "ntp_client.h"
+#include "time_types.h"
+#include "clock_filter.h"
+#include "ntp_server.h"
+#include "dns_race.h"
+#include "server_pool.h"
+#include "wifi_cache.h"
+#include "link_state.h"
+#include "link_quality.h"
+#include "sync_plan.h"
+#include "timeline.h"
+#include "sntp_request.h"
 
 /******************************************************
  *                    Constants
  ******************************************************/
 
 #define SNTP_METHOD         SL_SNTP_UNICAST_MODE
-#define FLAGS               0
+#define SNTP_FLAG_IPV6      1 // config.flags of the embedded client for an IPv6 server
 #define NTP_SERVER_IP       "0.pool.ntp.org" // Mostly "162.159.200.123"
-#define DATA_BUFFER_LENGTH  50
 #define SNTP_TIMEOUT        50
 #define SNTP_API_TIMEOUT    0
 #define ASYNC_WAIT_TIMEOUT  60000
 #define DNS_TIMEOUT         20000
 #define MAX_DNS_RETRY_COUNT 5
+#define DNS_POOL_TTL        150 // Seconds DNS answers are trusted, the resolver does not report the TTL
 
+#define NTP_NATIVE_CLIENT         1    // 1: own NTP exchange over UDP, 0: NWP embedded SNTP client
+#define NTP_REPLY_TIMEOUT         2000 // ms to wait for one native reply
+#define NTP_LOCAL_PRECISION_US    1    // Calendar timestamps are interpolated to 1 us
+#define SNTP_BURST_COUNT          6    // Requests in an iburst train
+#define SNTP_BURST_SPACING        2000 // ms between iburst requests
+#define SNTP_BURST_AFTER_FAILURES 3    // Failed polls in a row that count as an outage
+#define SNTP_CALLBACK_DRAIN       30000 // ms a call given up may still answer before the next one is issued
+#define EMBEDDED_SNTP_PRECISION   1000000 // Embedded client reports whole seconds only
+#define NTP_BROADCAST_LISTEN      0      // 1: follow server broadcasts after one unicast delay calibration
+#define NTP_BROADCAST_GROUP       NTP_MULTICAST_GROUP // Multicast group to join, NULL for broadcasts only
+#define NTP_BROADCAST_TIMEOUT     200000 // ms without a broadcast before polling over unicast again
+
+#define NTP_LAN_SERVER            0      // 1: answer NTP requests from LAN peers at upstream stratum + 1
+#define SNTP_POLL_LOG2            10     // Poll interval as advertised to peers, log2 seconds
+#define LINK_REJOIN_WAIT          10000  // ms the module may rejoin on its own before a directed join
+#define SNTP_RSSI_GATE            80     // Weakest averaged RSSI a sample is taken at, -dBm
+#define SNTP_RSSI_DEFER           5000   // ms to put a sample off at a weaker RSSI
+#define SNTP_RSSI_DEFER_MAX       6      // Deferrals before sampling regardless
+
+#define SNTP_DUTY_CYCLE           0      // 1: join only for sync windows, radio asleep in between
+#define SNTP_ACCURACY_BUDGET      50000  // us of time error allowed to build up between windows
+#define SNTP_MIN_POLL             6      // Shortest window interval, log2 seconds
+#define SNTP_MAX_POLL             12     // Longest window interval, log2 seconds
+
+#define SNTP_TRACE                0      // 1: print "TR" capture lines for tools/trace_replay.c
+
+#if NTP_BROADCAST_LISTEN && !NTP_NATIVE_CLIENT
+#error "NTP_BROADCAST_LISTEN needs NTP_NATIVE_CLIENT"
+#endif
+#if NTP_LAN_SERVER && (NTP_BROADCAST_LISTEN || !NTP_NATIVE_CLIENT)
+#error "NTP_LAN_SERVER needs NTP_NATIVE_CLIENT and owns UDP port 123, disable NTP_BROADCAST_LISTEN"
+#endif
+#if SNTP_TRACE && !NTP_NATIVE_CLIENT
+#error "SNTP_TRACE captures the packets of NTP_NATIVE_CLIENT"
+#endif
+#if SNTP_DUTY_CYCLE && (!NTP_NATIVE_CLIENT || NTP_BROADCAST_LISTEN || NTP_LAN_SERVER)
+#error "SNTP_DUTY_CYCLE needs NTP_NATIVE_CLIENT, listening and serving need the link up"
+#endif
 
-#define TIME_NTP_EPOCH_SEC  (2208988800U)
 
 #define DELAY_HALF_MINUTES(n) ((uint8_t) n * 100000)
 /******************************************************
@@ -83,8 +133,9 @@ static const sl_wifi_device_configuration_t sntp_client_configuration = {
                    .coex_mode       = SL_SI91X_WLAN_ONLY_MODE,
                    .feature_bit_map = (SL_SI91X_FEAT_SECURITY_PSK | SL_SI91X_FEAT_AGGREGATION),
                    .tcp_ip_feature_bit_map =
-                     (SL_SI91X_TCP_IP_FEAT_DHCPV4_CLIENT | SL_SI91X_TCP_IP_FEAT_DNS_CLIENT | SL_SI91X_TCP_IP_FEAT_SSL
-                      | SL_SI91X_TCP_IP_FEAT_SNTP_CLIENT | SL_SI91X_TCP_IP_FEAT_EXTENSION_VALID),
+                     (SL_SI91X_TCP_IP_FEAT_DHCPV4_CLIENT | SL_SI91X_TCP_IP_FEAT_DHCPV6_CLIENT | SL_SI91X_TCP_IP_FEAT_IPV6
+                      | SL_SI91X_TCP_IP_FEAT_DNS_CLIENT | SL_SI91X_TCP_IP_FEAT_SSL | SL_SI91X_TCP_IP_FEAT_SNTP_CLIENT
+                      | SL_SI91X_TCP_IP_FEAT_EXTENSION_VALID),
                    .custom_feature_bit_map =
                      (SL_SI91X_CUSTOM_FEAT_EXTENTION_VALID | SL_SI91X_CUSTOM_FEAT_ASYNC_CONNECTION_STATUS),
                    .ext_custom_feature_bit_map = (SL_SI91X_EXT_FEAT_SSL_VERSIONS_SUPPORT | SL_SI91X_EXT_FEAT_XTAL_CLK
@@ -103,20 +154,58 @@ static const sl_wifi_device_configuration_t sntp_client_configuration = {
 };
 
 static time_t  start_time = 0;
-static uint8_t callback_event = 0;
-static sl_status_t cb_status  = SL_STATUS_FAIL;
-static uint8_t exec_status    = 0;
+static sntp_request_t sntp_request; // Embedded client call waiting for its callback
+#if !NTP_NATIVE_CLIENT
 static char *event_type[]     = { [SL_SNTP_CLIENT_START]           = "SNTP Client Start",
                                   [SL_SNTP_CLIENT_GET_TIME]        = "SNTP Client Get Time",
                                   [SL_SNTP_CLIENT_GET_TIME_DATE]   = "SNTP Client Get Time and Date",
                                   [SL_SNTP_CLIENT_GET_SERVER_INFO] = "SNTP Client Get Server Info",
                                   [SL_SNTP_CLIENT_STOP]            = "SNTP Client Stop" };
+#endif
 
 /******************************************************
  *               Function Declarations
  ******************************************************/
 sl_status_t embedded_sntp_client(void);
 static void sntp_task(void *argument);
+static uint64_t sntp_local_time_us(void);
+static uint32_t sntp_ms_to_ticks(uint32_t ms);
+static void sntp_print_address(const char *label, const sl_ip_address_t *address);
+static uint32_t sntp_uptime_s(void);
+static sl_status_t sntp_resolve(void);
+#if NTP_NATIVE_CLIENT
+static void sntp_select_server(void);
+#endif
+static sl_status_t sntp_take_sample(ntp_sample_t *sample);
+static void sntp_filter_reset(void);
+static void sntp_filter_check_step(void);
+static sl_status_t sntp_poll(uint8_t count, bool *updated);
+static uint32_t sntp_poll_wait_ms(uint32_t interval_ms);
+#if NTP_BROADCAST_LISTEN
+static sl_status_t sntp_listen(bool *updated);
+#endif
+#if NTP_LAN_SERVER
+static uint64_t sntp_server_time_us(void);
+static void sntp_server_publish(const clock_filter_stage_t *selected);
+#endif
+static void sntp_apply_sample(const clock_filter_stage_t *selected);
+static void sntp_calendar_stepped(int64_t step_us, void *context);
+static void sntp_quality_publish(const clock_filter_stage_t *selected);
+static void sntp_wait_link(void);
+static void sntp_wait_rssi(void);
+static uint32_t sntp_tick_ms(void);
+static void sntp_embedded_begin(uint8_t event);
+static sl_status_t sntp_embedded_wait(sl_status_t status);
+#if SNTP_DUTY_CYCLE
+static void sntp_radio_sleep(uint32_t window_start);
+#endif
+#if SNTP_TRACE
+static void sntp_trace_packet(uint32_t one_way_us);
+static void sntp_trace(char type, uint32_t value);
+#endif
+#if !NTP_NATIVE_CLIENT
+static void print_char_buffer(char *buffer, uint32_t buffer_length);
+#endif
 
 
 /******************************************************
@@ -125,38 +214,56 @@ static void sntp_task(void *argument);
 uint32_t sntp_get_time_to_calendar(char *get_time_str)
 {
   /// input format "Time: 3932164995. sec."
-  double ret = 0;
+  unix_time_t pivot = unix_time_from_s(TIME_PIVOT_UNIX_S);
+  unix_time_t time;
   char* token = strtok(get_time_str, " ");
   token = strtok(NULL, ".");
 
-  ret = atof(token);
-  ret -= TIME_NTP_EPOCH_SEC;
+  // The NTP seconds wrap in 2036, the era is the one nearest our own time
+  if (start_time != 0) {
+    pivot = unix_time_from_us((int64_t)calendar_get_utc_us());
+  }
+  time = ntp_time_to_unix(ntp_time_make((uint32_t)strtoul(token, NULL, 10), 0), pivot);
 #if 0
-  printf("Time: %.0f\r\n", ret);
+  printf("Time: %lld\r\n", unix_time_s(time));
 #endif
-  return (uint32_t)ret;
+  return (uint32_t)unix_time_s(time);
 }
 
+#if NTP_NATIVE_CLIENT
+static ntp_client_t ntp_client;
+#endif
+static dns_race_t dns_race;
+static server_pool_t server_pool;
+static clock_filter_t clock_filter;
+static uint32_t clock_filter_steps = 0; // calendar_step_count() the filter contents refer to
+#if NTP_LAN_SERVER
+static ntp_server_t ntp_server;
+#endif
+static ntp_sample_t upstream; // Latest reply, for the stratum and root distance served
+#if SNTP_DUTY_CYCLE
+static sync_plan_t sync_plan;
+#endif
+#if NTP_BROADCAST_LISTEN
+static bool broadcast_calibrated     = false;
+static uint32_t broadcast_one_way_us = 0;
+#endif
+
 static sl_status_t module_status_handler(sl_wifi_event_t event, void *data, uint32_t data_length, void *arg)
 {
   UNUSED_PARAMETER(event);
   UNUSED_PARAMETER(arg);
+  UNUSED_PARAMETER(data_length);
   sl_si91x_module_state_stats_response_t *notif = (sl_si91x_module_state_stats_response_t *)data;
 
-  SL_DEBUG_LOG("---> Module status handler event with length : %lu\r\n", data_length);
-  SL_DEBUG_LOG("  <> Timestamp : %lu, state_code : %u, reason_code : %u, channel : %u, rssi : %u.\r\n",
-               notif->timestamp,
-               notif->state_code,
-               notif->reason_code,
-               notif->channel,
-               notif->rssi);
-  SL_DEBUG_LOG("  <> BSSID : %x:%x:%x:%x:%x:%x.\r\n",
-               notif->bssid[0],
-               notif->bssid[1],
-               notif->bssid[2],
-               notif->bssid[3],
-               notif->bssid[4],
-               notif->bssid[5]);
+  // Keep the AP of the current association for the next join
+  wifi_cache_observe(notif);
+  // A rejoin done by the module itself raises no join event
+  if ((notif->state_code & WIFI_CACHE_STATE_MASK) == WIFI_CACHE_STATE_ASSOC) {
+    link_state_set(true);
+  }
+  // Aggregated, see link_quality_print()
+  link_quality_observe(notif);
   return SL_STATUS_OK;
 }
 
@@ -170,23 +277,37 @@ static void sntp_task(void *argument)
 {
   UNUSED_PARAMETER(argument);
   sl_status_t status;
+  wifi_cache_join_t join;
 
+  timeline_mark(TIMELINE_TASK_START, 0);
   printf("SNTP client execution Started \r\n");
 
   status = sl_net_init(SL_NET_WIFI_CLIENT_INTERFACE, &sntp_client_configuration, NULL, NULL);
+  timeline_mark(TIMELINE_NET_INIT, status);
   if (status != SL_STATUS_OK && status != SL_STATUS_ALREADY_INITIALIZED) {
     printf("Failed to start Wi-Fi client interface: 0x%lx\r\n", status);
     return;
   }
+  link_quality_init();
   sl_wifi_set_callback(SL_WIFI_STATS_RESPONSE_EVENTS, module_status_handler, NULL);
 
-  status = sl_net_up(SL_NET_WIFI_CLIENT_INTERFACE, SL_NET_DEFAULT_WIFI_CLIENT_PROFILE_ID);
+  wifi_cache_load();
+  status = wifi_cache_connect(SL_NET_WIFI_CLIENT_INTERFACE, SL_NET_DEFAULT_WIFI_CLIENT_PROFILE_ID, &join);
   if (status != SL_STATUS_OK) {
     printf("Failed to bring Wi-Fi client interface up: 0x%lx\r\n", status);
     return;
   }
+  timeline_mark(TIMELINE_NET_UP, join.directed);
 
-  printf("Wi-Fi client connected\r\n");
+  if (join.directed) {
+    printf("Wi-Fi client connected in %lu ms, directed join on channel %u\r\n", join.link_ms, join.channel);
+  } else {
+    printf("Wi-Fi client connected in %lu ms, full scan%s\r\n", join.link_ms, join.fell_back ? " after directed join" : "");
+  }
+  wifi_cache_save();
+  if (link_state_init(true) != SL_STATUS_OK) {
+    printf("Link state tracking not available\r\n");
+  }
 
   embedded_sntp_client();
 
@@ -198,6 +319,102 @@ static void sntp_task(void *argument)
 
 }
 
+// Local clock for the exchange timestamps: the calendar once it is set,
+// the kernel tick before that (only round trips matter then)
+static uint64_t sntp_local_time_us(void)
+{
+  if (start_time != 0) {
+    return calendar_get_utc_us();
+  }
+  return ((uint64_t)osKernelGetTickCount() * 1000000u) / osKernelGetTickFreq();
+}
+
+static uint32_t sntp_ms_to_ticks(uint32_t ms)
+{
+  return (uint32_t)(((uint64_t)ms * osKernelGetTickFreq()) / 1000u);
+}
+
+static void sntp_print_address(const char *label, const sl_ip_address_t *address)
+{
+  if (address->type == SL_IPV6) {
+    printf("%s : %lx:%lx:%lx:%lx\r\n",
+           label,
+           address->ip.v6.value[0],
+           address->ip.v6.value[1],
+           address->ip.v6.value[2],
+           address->ip.v6.value[3]);
+  } else {
+    printf("%s : %u.%u.%u.%u\r\n",
+           label,
+           address->ip.v4.bytes[0],
+           address->ip.v4.bytes[1],
+           address->ip.v4.bytes[2],
+           address->ip.v4.bytes[3]);
+  }
+}
+
+static uint32_t sntp_uptime_s(void)
+{
+  return osKernelGetTickCount() / osKernelGetTickFreq();
+}
+
+// Race A and AAAA once more and merge both answers into the server pool.
+// The pool name hands out different addresses on every query.
+static sl_status_t sntp_resolve(void)
+{
+  sl_ip_address_t address;
+  sl_status_t status;
+  uint8_t added = 0;
+
+  if (start_time == 0) {
+    timeline_mark(TIMELINE_DNS_START, 0);
+  }
+  status = dns_race_start(&dns_race, NTP_SERVER_IP, DNS_TIMEOUT, DNS_TIMEOUT);
+  if (status == SL_STATUS_OK) {
+    status = dns_race_wait(&dns_race, &address);
+  }
+  if (start_time == 0) {
+    // Every attempt until the time is valid, not the periodic refreshes
+    timeline_mark(TIMELINE_DNS_DONE, status);
+  }
+  if (status != SL_STATUS_OK) {
+    return status;
+  }
+  printf("DNS: IPv%u answer used after %lu ms\r\n",
+         (dns_race.winner == DNS_RACE_IPV6) ? 6u : 4u,
+         dns_race.answer[dns_race.winner].latency_ms);
+  added += server_pool_add(&server_pool, &address, sntp_uptime_s());
+  // The other family only if it is already in, a late answer comes next time
+  if (dns_race_fallback(&dns_race, DNS_RACE_RESOLUTION_DELAY, &address) == SL_STATUS_OK) {
+    added += server_pool_add(&server_pool, &address, sntp_uptime_s());
+  }
+  server_pool_resolved(&server_pool, sntp_uptime_s());
+  printf("Server pool: %u addresses, %u new\r\n", server_pool.count, added);
+  return SL_STATUS_OK;
+}
+
+#if NTP_NATIVE_CLIENT
+// Point the client at the current pool entry if it moved
+static void sntp_select_server(void)
+{
+  const sl_ip_address_t *address = &server_pool.entry[server_pool.current].address;
+
+  if ((server_pool.current >= server_pool.count)
+      || ((address->type == ntp_client.server.type)
+          && (memcmp(&address->ip, &ntp_client.server.ip, sizeof(address->ip)) == 0))) {
+    return;
+  }
+  ntp_client_close(&ntp_client);
+  if (ntp_client_open(&ntp_client, address, sntp_local_time_us, NTP_LOCAL_PRECISION_US) != SL_STATUS_OK) {
+    return;
+  }
+  sntp_print_address("Ip Address", address);
+  // Samples of the other server do not mix with this one
+  sntp_filter_reset();
+}
+#endif
+
+#if !NTP_NATIVE_CLIENT
 static void print_char_buffer(char *buffer, uint32_t buffer_length)
 {
   uint32_t i = 0;
@@ -210,11 +427,14 @@ static void print_char_buffer(char *buffer, uint32_t buffer_length)
   return;
 }
 
+// Late, repeated and out of order callbacks must not touch the next call:
+// the reply is copied only if it answers the call waiting in sntp_request
 static void sntp_client_event_handler(sl_sntp_client_response_t *response,
                                       uint8_t *user_data,
                                       uint16_t user_data_length)
 {
-  uint16_t length = 0;
+  UNUSED_PARAMETER(user_data);
+  UNUSED_PARAMETER(user_data_length);
   if(start_time == 0 && response->event_type == SL_SNTP_CLIENT_GET_TIME)
   {
     printf("\r\nReceived %s SNTP event with status %s\r\n",
@@ -222,163 +442,639 @@ static void sntp_client_event_handler(sl_sntp_client_response_t *response,
            (0 == response->status) ? "Success" : "Failed");
   }
 
-  if (0 == response->status) {
-    if (response->data_length > user_data_length) {
-      length = user_data_length;
-    } else {
-      length = response->data_length;
+  sntp_request_complete(&sntp_request, response->event_type, response->status, response->data, response->data_length);
+  return;
+}
+#endif
+
+// Mark an embedded client call as issued, after the callback of a call
+// given up has come or its drain time is over
+static void sntp_embedded_begin(uint8_t event)
+{
+  while (!sntp_request_ready(&sntp_request, sntp_tick_ms(), SNTP_CALLBACK_DRAIN)) {
+    osDelay(sntp_ms_to_ticks(100));
+  }
+  sntp_request_begin(&sntp_request, event, sntp_tick_ms());
+}
+
+// Wait for the callback of the call just issued, status is what the call returned
+static sl_status_t sntp_embedded_wait(sl_status_t status)
+{
+  if ((SNTP_API_TIMEOUT != 0) || (SL_STATUS_IN_PROGRESS != status)) {
+    // Synchronous, or refused: no callback follows
+    sntp_request_end(&sntp_request);
+    return status;
+  }
+  while (!sntp_request_done(&sntp_request)) {
+    if ((sntp_tick_ms() - sntp_request.issued_ms) > ASYNC_WAIT_TIMEOUT) {
+      sntp_request_abandon(&sntp_request, sntp_tick_ms());
+      return SL_STATUS_TIMEOUT;
     }
+    osThreadYield();
+  }
+  return (sl_status_t)sntp_request.status;
+}
+
+// One time sample from whichever client is in use
+static sl_status_t sntp_take_sample(ntp_sample_t *sample)
+{
+#if NTP_NATIVE_CLIENT
+  return ntp_client_exchange(&ntp_client, SNTP_POLL_LOG2, NTP_REPLY_TIMEOUT, sample);
+#else
+  char *data = (char *)sntp_request.data;
+  uint64_t t1;
+  uint64_t t4;
+  uint32_t server_time;
+  sl_status_t status;
 
-    memcpy(user_data, response->data, length);
+  sntp_embedded_begin(SL_SNTP_CLIENT_GET_TIME);
+  t1     = sntp_local_time_us();
+  status = sl_sntp_client_get_time(sntp_request.data, SNTP_REQUEST_DATA_LENGTH, SNTP_API_TIMEOUT);
+  status = sntp_embedded_wait(status);
+  if (status != SL_STATUS_OK) {
+    printf("Failed to get time from ntp server : 0x%lx\r\n", status);
+    return status;
   }
+  t4 = sntp_local_time_us();
+  if (start_time == 0) {
+    print_char_buffer(data, strlen(data));
+  }
+  // format "Time: 3932164995. sec.", whole seconds only, so the offset keeps
+  // up to a second of truncation and the delay is the local round trip
+  server_time = sntp_get_time_to_calendar(data);
+  memset(sample, 0, sizeof(*sample));
+  sample->offset_us     = (int64_t)server_time * 1000000 - (int64_t)((t1 + t4) / 2u);
+  sample->delay_us      = (uint32_t)(t4 - t1);
+  sample->dispersion_us = EMBEDDED_SNTP_PRECISION;
+  sample->local_us      = t4;
+  return SL_STATUS_OK;
+#endif
+}
 
-  callback_event = response->event_type;
-  cb_status      = response->status;
+static void sntp_filter_reset(void)
+{
+  clock_filter_reset(&clock_filter);
+#if SNTP_TRACE
+  sntp_trace('S', 0);
+#endif
+}
 
-  if (SL_SNTP_CLIENT_STOP == response->event_type) {
-    exec_status = 1;
+// Offsets measured before a calendar step no longer apply
+static void sntp_filter_check_step(void)
+{
+  if ((start_time != 0) && (calendar_step_count() != clock_filter_steps)) {
+    clock_filter_steps = calendar_step_count();
+    sntp_filter_reset();
+#if SNTP_DUTY_CYCLE
+    sync_plan_restart(&sync_plan);
+#endif
   }
-  return;
 }
 
+// Take count samples spaced SNTP_BURST_SPACING apart through the clock filter.
+// Returns SL_STATUS_NOT_READY if the server held us off without a sample.
+static sl_status_t sntp_poll(uint8_t count, bool *updated)
+{
+  ntp_sample_t sample;
+  uint32_t start  = osKernelGetTickCount();
+  uint8_t replies = 0;
+  bool held       = false;
+  sl_status_t status;
+  uint32_t wait_s;
+  uint8_t i;
+
+  *updated = false;
+  sntp_filter_check_step();
+#if SNTP_TRACE
+  if (start_time != 0) {
+    sntp_trace('C', (uint32_t)calendar_get_utc());
+  }
+#endif
+  for (i = 0; i < count; i++) {
+    wait_s = server_pool_wait_s(&server_pool, sntp_uptime_s());
+    if ((wait_s != 0) && (server_pool.count != 0)) {
+      // A server that asked for a longer interval cuts the burst short, one
+      // that was demobilized is sent nothing and counts as an outage
+      held = (wait_s != UINT32_MAX);
+      break;
+    }
+    if (i != 0) {
+      osDelay(sntp_ms_to_ticks(SNTP_BURST_SPACING));
+    }
+    if (!link_state_is_up()) {
+      // Not the server's fault, the pool score is left alone
+      link_state_count_skipped();
+      continue;
+    }
+    sntp_wait_rssi();
+    server_pool_sent(&server_pool, sntp_uptime_s());
+    status = sntp_take_sample(&sample);
+#if NTP_NATIVE_CLIENT
+    if (status == SL_STATUS_ABORT) {
+      // Kiss-o'-Death: the server is up but wants fewer or no requests
+      server_pool_kiss(&server_pool, ntp_client.kiss, ntp_client.server_poll);
+      printf("Kiss-o'-Death %c%c%c%c, %s\r\n",
+             (char)(ntp_client.kiss >> 24),
+             (char)(ntp_client.kiss >> 16),
+             (char)(ntp_client.kiss >> 8),
+             (char)ntp_client.kiss,
+             (ntp_client.kiss == NTP_KISS_RATE) ? "backing off" : "server demobilized");
+      held = true;
+      break;
+    }
+#endif
+    if (status != SL_STATUS_OK) {
+      server_pool_result(&server_pool, false, 0, 0);
+      continue;
+    }
+    timeline_mark_once(TIMELINE_FIRST_REPLY, 0);
+#if SNTP_TRACE
+    sntp_trace_packet(0);
+#endif
+    server_pool_result(&server_pool, true, sample.delay_us, sample.stratum);
+#if NTP_NATIVE_CLIENT
+    if (ntp_client.server_poll > SNTP_POLL_LOG2) {
+      server_pool_min_poll(&server_pool, ntp_client.server_poll);
+    }
+#endif
+    if (clock_filter_add(&clock_filter, &sample)) {
+      *updated = true;
+    }
+    upstream = sample;
+    replies++;
+  }
+  if (count > 1) {
+    printf("Burst: %u/%u replies, best delay %lu us, offset %ld ms, %lu ms to lock\r\n",
+           replies,
+           count,
+           clock_filter.selected.delay_us,
+           (int32_t)(clock_filter.selected.offset_us / 1000),
+           (uint32_t)(((uint64_t)(osKernelGetTickCount() - start) * 1000u) / osKernelGetTickFreq()));
+    link_quality_print();
+#if !NTP_NATIVE_CLIENT
+    printf("Callbacks: %lu matched, %lu timeouts, %lu late, %lu duplicate, %lu unexpected\r\n",
+           sntp_request.stats.completed,
+           sntp_request.stats.timeouts,
+           sntp_request.stats.late,
+           sntp_request.stats.duplicate,
+           sntp_request.stats.unexpected);
+#endif
+  }
+  if (replies != 0) {
+    return SL_STATUS_OK;
+  }
+  return held ? SL_STATUS_NOT_READY : SL_STATUS_TIMEOUT;
+}
+
+// The poll interval, or longer if the current server asked for it
+static uint32_t sntp_poll_wait_ms(uint32_t interval_ms)
+{
+  uint32_t wait_s = server_pool_wait_s(&server_pool, sntp_uptime_s());
+
+  // No usable server: the next pass resolves the name again
+  if ((wait_s == UINT32_MAX) || (wait_s <= interval_ms / 1000u)) {
+    return interval_ms;
+  }
+  printf("Server minimum interval, next poll in %lu s\r\n", wait_s);
+  return wait_s * 1000u;
+}
+
+#if NTP_BROADCAST_LISTEN
+// Wait for the next server broadcast, nothing is transmitted
+static sl_status_t sntp_listen(bool *updated)
+{
+  ntp_sample_t sample;
+  sl_status_t status;
+
+  *updated = false;
+  sntp_filter_check_step();
+  status = ntp_client_receive_broadcast(&ntp_client, NTP_BROADCAST_TIMEOUT, broadcast_one_way_us, &sample);
+  if (status == SL_STATUS_OK) {
+#if SNTP_TRACE
+    sntp_trace_packet(broadcast_one_way_us);
+#endif
+    *updated = clock_filter_add(&clock_filter, &sample);
+  }
+  return status;
+}
+#endif
+
+// Set the calendar from the first filtered sample, compare against it afterwards
+static void sntp_apply_sample(const clock_filter_stage_t *selected)
+{
+  uint64_t server_us = selected->local_us + (uint64_t)selected->offset_us;
+  uint32_t wait_ms;
+
+  if (start_time == 0) {
+    // The selected sample may be the burst's first, seconds old by now: apply
+    // its offset to the current local clock, not to its own T4
+    server_us = sntp_local_time_us() + (uint64_t)selected->offset_us;
+#if NTP_NATIVE_CLIENT
+    // Start the calendar on a second boundary instead of truncating
+    wait_ms = 1000u - (uint32_t)((server_us % 1000000u) / 1000u);
+    osDelay(sntp_ms_to_ticks(wait_ms));
+    server_us += (uint64_t)wait_ms * 1000u;
+#else
+    UNUSED_VARIABLE(wait_ms);
+#endif
+    start_time = (time_t)(server_us / 1000000u);
+    calendar_init(start_time);
+    calendar_on_step(sntp_calendar_stepped, NULL);
+    timeline_mark(TIMELINE_CALENDAR_INIT, 0);
+    timeline_report();
+    // The filter holds offsets against the boot tick clock
+    clock_filter_steps = calendar_step_count();
+    sntp_filter_reset();
+  } else {
+    printf("Filter: delay %lu us, jitter %lu us, dispersion %lu us\r\n",
+           selected->delay_us,
+           clock_filter.jitter_us,
+           clock_filter.dispersion_us);
+    calendar_compare_offset((uint32_t)(server_us / 1000000u), (int32_t)(-selected->offset_us / 1000));
+#if SNTP_DUTY_CYCLE
+    // Planned against the oscillator, the steering only hides its drift
+    sync_plan_update(&sync_plan, selected->local_us, selected->offset_us + calendar_correction_us());
+#endif
+    // Half the delay bounds the path asymmetry
+    calendar_adjust(selected->local_us,
+                    selected->offset_us,
+                    selected->delay_us / 2u + clock_filter.dispersion_us + clock_filter.jitter_us);
+  }
+  sntp_quality_publish(selected);
+#if NTP_LAN_SERVER
+  sntp_server_publish(selected);
+#endif
+}
+
+// Tell time consumers what the update is worth. The embedded client sees no
+// stratum or root distance, it reports stratum 0 and its own error only.
+static void sntp_quality_publish(const clock_filter_stage_t *selected)
+{
+  time_quality_t reference = { 0 };
+  uint64_t dispersion_us;
+  uint64_t error_us;
+
+  dispersion_us = (uint64_t)upstream.root_dispersion_us + clock_filter.dispersion_us + clock_filter.jitter_us;
+  // Half the delay bounds the path asymmetry, on top of the server's own distance
+  error_us = upstream.root_delay_us / 2u + dispersion_us + selected->delay_us / 2u;
+  reference.state              = (upstream.leap == NTP_LEAP_UNSYNC) ? TIME_QUALITY_UNSYNCED : TIME_QUALITY_SYNCED;
+  reference.leap               = upstream.leap;
+  reference.stratum            = (upstream.stratum == 0) ? 0u : (uint8_t)(upstream.stratum + 1u);
+#if NTP_NATIVE_CLIENT
+  reference.reference_id       = ntp_client_reference_id(&ntp_client);
+#endif
+  reference.sync_us            = selected->local_us + (uint64_t)selected->offset_us;
+  reference.root_delay_us      = upstream.root_delay_us + selected->delay_us;
+  reference.root_dispersion_us = (dispersion_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)dispersion_us;
+  reference.error_us           = (error_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)error_us;
+  calendar_update_quality(&reference);
+}
+
+// Time consumers already follow calendar_step_count(), this is for the log
+static void sntp_calendar_stepped(int64_t step_us, void *context)
+{
+  UNUSED_PARAMETER(context);
+  printf("Calendar stepped by %ld ms\r\n", (int32_t)(step_us / 1000));
+}
+
+// Polling pauses while the link is down, the calendar runs on in holdover.
+// Returns once the link is back, joining again if the module gives up.
+static void sntp_wait_link(void)
+{
+  const link_state_stats_t *stats = link_state_stats();
+  wifi_cache_join_t join;
+
+  printf("Wi-Fi link down, polling paused, calendar in holdover\r\n");
+#if SNTP_TRACE
+  sntp_trace('L', 0);
+#endif
+  while (!link_state_wait_up(LINK_REJOIN_WAIT)) {
+    calendar_holdover();
+    link_state_count_rejoin();
+    if (wifi_cache_connect(SL_NET_WIFI_CLIENT_INTERFACE, SL_NET_DEFAULT_WIFI_CLIENT_PROFILE_ID, &join)
+        == SL_STATUS_OK) {
+      link_state_set(true);
+      timeline_mark(TIMELINE_REJOIN, join.link_ms);
+      printf("Wi-Fi rejoined in %lu ms, %s%s\r\n",
+             join.link_ms,
+             join.directed ? "directed join" : "full scan",
+             join.fell_back ? " after directed join" : "");
+      wifi_cache_save();
+      timeline_report();
+    }
+  }
+#if SNTP_TRACE
+  sntp_trace('L', 1);
+#endif
+  printf("Wi-Fi link back after %lu ms, %lu losses, %lu rejoins, %lu polls skipped, uncertainty %lu us\r\n",
+         stats->last_down_ms,
+         stats->downs,
+         stats->rejoins,
+         stats->skipped,
+         calendar_uncertainty_us());
+}
+
+// Retransmissions at a weak signal stretch and skew the round trip,
+// put the sample off for a while, but not forever
+static void sntp_wait_rssi(void)
+{
+  uint8_t i;
+
+  for (i = 0; i < SNTP_RSSI_DEFER_MAX; i++) {
+    link_quality_sample_rssi(SL_WIFI_CLIENT_INTERFACE);
+    if (link_quality_good(SNTP_RSSI_GATE) || !link_state_is_up()) {
+      return;
+    }
+    link_quality_count_deferred();
+    osDelay(sntp_ms_to_ticks(SNTP_RSSI_DEFER));
+  }
+}
+
+#if SNTP_DUTY_CYCLE
+// Drop the link and put the radio to sleep until the planned window, then
+// join again with a directed join to the cached access point
+static void sntp_radio_sleep(uint32_t window_start)
+{
+  const sl_ip_address_t *address        = &server_pool.entry[server_pool.current].address;
+  sl_wifi_performance_profile_t profile = { 0 };
+  wifi_cache_join_t join;
+  uint32_t interval_s = sntp_poll_wait_ms(sync_plan.interval_s * 1000u) / 1000u;
+  uint32_t on_ms;
+
+  ntp_client_close(&ntp_client);
+  sl_net_down(SL_NET_WIFI_CLIENT_INTERFACE);
+  profile.profile = DEEP_SLEEP_WITH_RAM_RETENTION;
+  sl_wifi_set_performance_profile(&profile);
+  on_ms = (uint32_t)(((uint64_t)(osKernelGetTickCount() - window_start) * 1000u) / osKernelGetTickFreq());
+  sync_plan_account(&sync_plan, on_ms, on_ms / 1000u + interval_s);
+  printf("Radio on %lu ms, next window in %lu s (poll 2^%u, %ld ppb), %lu s/day on vs %u always connected\r\n",
+         on_ms,
+         interval_s,
+         sync_plan.poll,
+         sync_plan.freq_ppb,
+         sync_plan_radio_s_per_day(&sync_plan),
+         SYNC_PLAN_SECONDS_DAY);
+
+  osDelay(sntp_ms_to_ticks(interval_s * 1000u));
+
+  profile.profile = HIGH_PERFORMANCE;
+  sl_wifi_set_performance_profile(&profile);
+  if (wifi_cache_connect(SL_NET_WIFI_CLIENT_INTERFACE, SL_NET_DEFAULT_WIFI_CLIENT_PROFILE_ID, &join)
+      != SL_STATUS_OK) {
+    // The loop waits for the link and rejoins
+    link_state_set(false);
+    return;
+  }
+  link_state_set(true);
+  wifi_cache_save();
+  if (server_pool.current < server_pool.count) {
+    ntp_client_open(&ntp_client, address, sntp_local_time_us, NTP_LOCAL_PRECISION_US);
+  }
+}
+#endif
+
+static uint32_t sntp_tick_ms(void)
+{
+  return (uint32_t)(((uint64_t)osKernelGetTickCount() * 1000u) / osKernelGetTickFreq());
+}
+
+#if SNTP_TRACE
+// "TR R <tick ms> <T1> <T4> <packet hex>" for a unicast reply, T1 and T4 in
+// Unix seconds.microseconds. A broadcast is "TR B <tick ms> <one way us> <T4> <hex>".
+static void sntp_trace_packet(uint32_t one_way_us)
+{
+  uint8_t i;
+
+  if (ntp_client.t1 != 0) {
+    printf("TR R %lu %lu.%06lu ",
+           sntp_tick_ms(),
+           (uint32_t)(ntp_client.t1 / 1000000u),
+           (uint32_t)(ntp_client.t1 % 1000000u));
+  } else {
+    printf("TR B %lu %lu ", sntp_tick_ms(), one_way_us);
+  }
+  printf("%lu.%06lu ", (uint32_t)(ntp_client.t4 / 1000000u), (uint32_t)(ntp_client.t4 % 1000000u));
+  for (i = 0; i < NTP_PACKET_SIZE; i++) {
+    printf("%02x", ntp_client.packet[i]);
+  }
+  printf("\r\n");
+}
+
+// "TR C <tick ms> <calendar UTC s>", "TR L <tick ms> <0|1>", "TR S <tick ms> 0"
+static void sntp_trace(char type, uint32_t value)
+{
+  printf("TR %c %lu %lu\r\n", type, sntp_tick_ms(), value);
+}
+#endif
+
+#if NTP_LAN_SERVER
+// Served time: cycle counter interpolation, the RTC read is too slow per request
+static uint64_t sntp_server_time_us(void)
+{
+  uint64_t micros;
+
+  if (calendar_get_utc_us_interpolated(&micros)) {
+    return micros;
+  }
+  return calendar_get_utc_us();
+}
+
+// Advertise the state of the last update to LAN peers
+static void sntp_server_publish(const clock_filter_stage_t *selected)
+{
+  ntp_server_source_t source;
+  uint64_t error_us = (uint64_t)((selected->offset_us < 0) ? -selected->offset_us : selected->offset_us);
+  uint64_t dispersion_us;
+
+  if (start_time == 0) {
+    return;
+  }
+  // The offset is slewed out from now on, until then it is part of our error
+  dispersion_us = (uint64_t)upstream.root_dispersion_us + clock_filter.dispersion_us + clock_filter.jitter_us + error_us;
+  source.leap               = upstream.leap;
+  source.stratum            = upstream.stratum;
+  source.poll               = SNTP_POLL_LOG2;
+  source.reference_id       = ntp_client_reference_id(&ntp_client);
+  source.reference_us       = selected->local_us + (uint64_t)selected->offset_us;
+  source.root_delay_us      = upstream.root_delay_us + selected->delay_us;
+  source.root_dispersion_us = (dispersion_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)dispersion_us;
+  ntp_server_update(&ntp_server, &source);
+  printf("LAN server: stratum %u, %lu requests, %lu replies, max service %lu us\r\n",
+         source.stratum + 1u,
+         ntp_server.requests,
+         ntp_server.replies,
+         ntp_server.max_service_us);
+}
+#endif
+
 sl_status_t embedded_sntp_client(void)
 {
-  uint32_t start = 0;
   sl_status_t status;
   sl_ip_address_t address          = { 0 };
   sl_sntp_client_config_t config   = { 0 };
-  uint8_t data[DATA_BUFFER_LENGTH] = { 0 };
   sl_sntp_server_info_t serverInfo = { 0 };
   int32_t dns_retry_count          = MAX_DNS_RETRY_COUNT;
+  uint8_t failed_polls             = 0;
+#if SNTP_DUTY_CYCLE
+  uint32_t window_start = osKernelGetTickCount();
+#endif
+  bool burst;
+  bool updated;
 
   UNUSED_VARIABLE(serverInfo);
 
+  sntp_request_init(&sntp_request);
+  server_pool_init(&server_pool, DNS_POOL_TTL);
+#if SNTP_DUTY_CYCLE
+  sync_plan_init(&sync_plan, SNTP_ACCURACY_BUDGET, SNTP_MIN_POLL, SNTP_MAX_POLL);
+#endif
   do {
-    status = sl_net_host_get_by_name(NTP_SERVER_IP, DNS_TIMEOUT, SL_NET_DNS_TYPE_IPV4, &address);
+    status = sntp_resolve();
     dns_retry_count--;
   } while ((dns_retry_count != 0) && (status != SL_STATUS_OK));
 
-  printf("Ip Address : %u.%u.%u.%u\r\n",
-         address.ip.v4.bytes[0],
-         address.ip.v4.bytes[1],
-         address.ip.v4.bytes[2],
-         address.ip.v4.bytes[3]);
+  if (server_pool.count != 0) {
+    address = server_pool.entry[server_pool.current].address;
+  }
+  sntp_print_address("Ip Address", &address);
 
-  config.server_host_name = address.ip.v4.bytes;
+#if NTP_NATIVE_CLIENT
+  UNUSED_VARIABLE(config);
+  status = ntp_client_open(&ntp_client, &address, sntp_local_time_us, NTP_LOCAL_PRECISION_US);
+  if (status != SL_STATUS_OK) {
+    return status;
+  }
+#if NTP_LAN_SERVER
+  // Requests are dropped until the first update
+  if (ntp_server_start(&ntp_server, sntp_server_time_us, NTP_LOCAL_PRECISION_US) != SL_STATUS_OK) {
+    printf("LAN NTP server not started\r\n");
+  }
+#endif
+#else
+  config.server_host_name = (address.type == SL_IPV6) ? address.ip.v6.bytes : address.ip.v4.bytes;
   config.sntp_method      = SNTP_METHOD;
   config.sntp_timeout     = SNTP_TIMEOUT;
   config.event_handler    = sntp_client_event_handler;
-  config.flags            = FLAGS;
-
-  cb_status = SL_STATUS_FAIL;
-  status    = sl_sntp_client_start(&config, SNTP_API_TIMEOUT);
-  if ((SNTP_API_TIMEOUT == 0) && (SL_STATUS_IN_PROGRESS == status)) {
-    start = osKernelGetTickCount();
+  config.flags            = (address.type == SL_IPV6) ? SNTP_FLAG_IPV6 : 0;
 
-    while ((SL_SNTP_CLIENT_START != callback_event) && (osKernelGetTickCount() - start) <= ASYNC_WAIT_TIMEOUT) {
-      osThreadYield();
-    }
-
-    if (cb_status != SL_STATUS_OK) {
-      printf("Failed to start Async SNTP client: 0x%lx\r\n", status);
-      return cb_status;
-    }
-  } else {
-    if (status == SL_STATUS_OK) {
-      printf("SNTP Client started successfully\r\n");
-    } else {
-      printf("Failed to start SNTP client: 0x%lx\r\n", status);
-      return status;
-    }
+  sntp_embedded_begin(SL_SNTP_CLIENT_START);
+  status = sl_sntp_client_start(&config, SNTP_API_TIMEOUT);
+  status = sntp_embedded_wait(status);
+  if (status != SL_STATUS_OK) {
+    printf("Failed to start SNTP client: 0x%lx\r\n", status);
+    return status;
   }
+  printf("SNTP Client started successfully\r\n");
+
+#endif
+  timeline_mark(TIMELINE_SNTP_START, 0);
 
   while(1)
   {
-    cb_status = SL_STATUS_FAIL;
-    status    = sl_sntp_client_get_time(data, DATA_BUFFER_LENGTH, SNTP_API_TIMEOUT);
-    if ((SNTP_API_TIMEOUT == 0) && (SL_STATUS_IN_PROGRESS == status)) {
-      start = osKernelGetTickCount();
-
-      while ((SL_SNTP_CLIENT_GET_TIME != callback_event) && (osKernelGetTickCount() - start) <= ASYNC_WAIT_TIMEOUT) {
-        osThreadYield();
-      }
-
-      if (cb_status != SL_STATUS_OK) {
-        printf("Failed to get async time from ntp server : 0x%lx\r\n", status);
-        //return cb_status;
-      }
-    } else {
+    if (!link_state_is_up()) {
+      sntp_wait_link();
+      // Resume with a burst, the calendar drifted meanwhile
+      failed_polls = SNTP_BURST_AFTER_FAILURES;
+#if NTP_BROADCAST_LISTEN
+      broadcast_calibrated = false;
+#endif
+    }
+#if NTP_BROADCAST_LISTEN
+    if (broadcast_calibrated) {
+      status = sntp_listen(&updated);
       if (status == SL_STATUS_OK) {
-        printf("SNTP Client got TIME successfully\r\n");
-      } else {
-        printf("Failed to get time from ntp server : 0x%lx\r\n", status);
-        //return status;
+        if (updated) {
+          sntp_apply_sample(&clock_filter.selected);
+        }
+        continue;
       }
+      printf("No broadcast for %u ms, calibrating over unicast\r\n", NTP_BROADCAST_TIMEOUT);
+      broadcast_calibrated = false;
+      // Recalibrate on unicast samples only
+      sntp_filter_reset();
     }
-    if(start_time == 0)
-    {
-      print_char_buffer((char *)data, strlen((const char *)data));
-      // format "Time: 3932164995. sec."
-      uint32_t get_time = sntp_get_time_to_calendar((char *)data);
-      start_time = get_time;
-      calendar_init((time_t) get_time);
+#endif
+    // One sample is not trusted after boot or an outage: fire a burst
+    burst  = (start_time == 0) || (failed_polls >= SNTP_BURST_AFTER_FAILURES);
+#if NTP_BROADCAST_LISTEN
+    // The delay calibration takes the best of a burst as well
+    burst = burst || !broadcast_calibrated;
+#endif
+#if SNTP_DUTY_CYCLE
+    // Every window is a burst, the samples of the last one are old
+    burst = true;
+#endif
+    status = sntp_poll(burst ? SNTP_BURST_COUNT : 1, &updated);
+    if (status == SL_STATUS_OK) {
+      failed_polls = 0;
+      if (link_state_count_recovered()) {
+        printf("Synchronized %lu ms after the link came back\r\n", link_state_stats()->recovery_ms);
+      }
+      if (updated) {
+        sntp_apply_sample(&clock_filter.selected);
+      }
+#if NTP_BROADCAST_LISTEN
+      if ((start_time != 0) && (clock_filter.updates != 0)) {
+        // The filtered unicast delay stands in for the broadcast path delay
+        broadcast_one_way_us = clock_filter.selected.delay_us / 2u;
+        broadcast_calibrated = (ntp_client.listen_socket >= 0)
+                               || (ntp_client_listen(&ntp_client, NTP_BROADCAST_GROUP) == SL_STATUS_OK);
+        printf("Broadcast one way delay %lu us, %s\r\n",
+               broadcast_one_way_us,
+               broadcast_calibrated ? "listening" : "listen failed");
+        if (broadcast_calibrated) {
+          continue;
+        }
+      }
+#endif
+    } else if (status != SL_STATUS_NOT_READY) {
+      if (failed_polls < UINT8_MAX) {
+        failed_polls++;
+      }
+      // Server gone with the link up, run on the drift model as well
+      if (failed_polls >= SNTP_BURST_AFTER_FAILURES) {
+        calendar_holdover();
+      }
     }
-    else
-    {
-      if(cb_status == SL_STATUS_OK)
-      { calendar_compare_time((char *)data); }
+#if NTP_NATIVE_CLIENT
+    // Leave dead or slow servers, refresh the pool before its answers expire
+    if (server_pool_needs_resolve(&server_pool, sntp_uptime_s())) {
+      sntp_resolve();
     }
+    server_pool_rotate(&server_pool);
+    sntp_select_server();
+#endif
 
-    // wait for 5 minutes
-    osDelay(DELAY_HALF_MINUTES(10)); // 100000 ticks around 30 seconds
+#if SNTP_DUTY_CYCLE
+    sntp_radio_sleep(window_start);
+    window_start = osKernelGetTickCount();
+#else
+    // wait DELAY_HALF_MINUTES(10) ticks, 1000 s at the 1 kHz tick, or the server's
+    // minimum interval, a link loss ends the wait
+    link_state_wait_down(sntp_poll_wait_ms((uint32_t)(((uint64_t)DELAY_HALF_MINUTES(10) * 1000u) / osKernelGetTickFreq())));
+#endif
   }
 
 #if AMPACK_SNTP_FULL_RUN
-  cb_status = SL_STATUS_FAIL;
-  status    = sl_sntp_client_get_time_date(data, DATA_BUFFER_LENGTH, SNTP_API_TIMEOUT);
-  if ((SNTP_API_TIMEOUT == 0) && (SL_STATUS_IN_PROGRESS == status)) {
-    start = osKernelGetTickCount();
-
-    while ((SL_SNTP_CLIENT_GET_TIME_DATE != callback_event) && (osKernelGetTickCount() - start) <= ASYNC_WAIT_TIMEOUT) {
-      osThreadYield();
-    }
-
-    if (cb_status != SL_STATUS_OK) {
-      printf("Failed to get Async date and time from ntp server : 0x%lx\r\n", status);
-      return cb_status;
-    }
-  } else {
-    if (status == SL_STATUS_OK) {
-      printf("SNTP Client got TIME and DATE successfully\r\n");
-    } else {
-      printf("Failed to get date and time from ntp server : 0x%lx\r\n", status);
-      return status;
-    }
+  sntp_embedded_begin(SL_SNTP_CLIENT_GET_TIME_DATE);
+  status = sl_sntp_client_get_time_date(sntp_request.data, SNTP_REQUEST_DATA_LENGTH, SNTP_API_TIMEOUT);
+  status = sntp_embedded_wait(status);
+  if (status != SL_STATUS_OK) {
+    printf("Failed to get date and time from ntp server : 0x%lx\r\n", status);
+    return status;
   }
-  print_char_buffer((char *)data, strlen((const char *)data));
-
-  cb_status = SL_STATUS_FAIL;
-  status    = sl_sntp_client_get_server_info(&serverInfo, SNTP_API_TIMEOUT);
-  if ((SNTP_API_TIMEOUT == 0) && (SL_STATUS_IN_PROGRESS == status)) {
-    start = osKernelGetTickCount();
+  printf("SNTP Client got TIME and DATE successfully\r\n");
+  print_char_buffer((char *)sntp_request.data, strlen((const char *)sntp_request.data));
 
-    while ((SL_SNTP_CLIENT_GET_SERVER_INFO != callback_event)
-           && (osKernelGetTickCount() - start) <= ASYNC_WAIT_TIMEOUT) {
-      osThreadYield();
-    }
-
-    if (cb_status != SL_STATUS_OK) {
-      printf("Failed to get async ntp server info : 0x%lx\r\n", status);
-      return cb_status;
-    }
-  } else {
-    if (status == SL_STATUS_OK) {
-      printf("SNTP Client got server info successfully\r\n");
-    } else {
-      printf("Failed to get ntp server info : 0x%lx\r\n", status);
-      return status;
-    }
+  // The info is written by the SDK itself, the callback carries no data
+  sntp_embedded_begin(SL_SNTP_CLIENT_GET_SERVER_INFO);
+  status = sl_sntp_client_get_server_info(&serverInfo, SNTP_API_TIMEOUT);
+  status = sntp_embedded_wait(status);
+  if (status != SL_STATUS_OK) {
+    printf("Failed to get ntp server info : 0x%lx\r\n", status);
+    return status;
   }
+  printf("SNTP Client got server info successfully\r\n");
   printf("Got Server IP version as : %u\r\n", serverInfo.ip_version);
   if (4 == serverInfo.ip_version) {
     printf("IPv4 Address is : %u.%u.%u.%u\r\n",
@@ -395,36 +1091,17 @@ sl_status_t embedded_sntp_client(void)
   }
   printf("SNTP Server Method : %u\r\n", serverInfo.sntp_method);
 #endif
-  cb_status = SL_STATUS_FAIL;
-  status    = sl_sntp_client_stop(SNTP_API_TIMEOUT);
-  if ((SNTP_API_TIMEOUT == 0) && (SL_STATUS_IN_PROGRESS == status)) {
-    start = osKernelGetTickCount();
-
-    while ((SL_SNTP_CLIENT_STOP != callback_event) && (osKernelGetTickCount() - start) <= ASYNC_WAIT_TIMEOUT) {
-      osThreadYield();
-    }
-
-    if (cb_status != SL_STATUS_OK) {
-      printf("Failed to stop Async SNTP client: 0x%lx\r\n", status);
-      return cb_status;
-    }
-  } else {
-    if (status == SL_STATUS_OK) {
-      printf("SNTP Client stopped successfully\r\n");
-    } else {
-      printf("Failed to stop SNTP client: 0x%lx\r\n", status);
-      return status;
-    }
-
-    exec_status = 1;
+  sntp_embedded_begin(SL_SNTP_CLIENT_STOP);
+  status = sl_sntp_client_stop(SNTP_API_TIMEOUT);
+  status = sntp_embedded_wait(status);
+  if (status != SL_STATUS_OK) {
+    printf("Failed to stop SNTP client: 0x%lx\r\n", status);
+    return status;
   }
+  printf("SNTP Client stopped successfully\r\n");
 
   printf("Done\r\n");
 
-  while (0 == exec_status) {
-    osThreadYield();
-  }
-
   printf("SNTP client execution completed \r\n");
 
   return SL_STATUS_OK;
@@ -0,0 +1,143 @@
+/***************************************************************************/ /**
+ * @file sntp_request.c
+ * @brief Callback matching for the calls of the embedded SNTP client
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "string.h"
+#include "sntp_request.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+// Compiler barrier, the application and SDK event threads share one core
+#define SNTP_REQUEST_BARRIER() __asm__ volatile("" ::: "memory")
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static bool sntp_request_move(sntp_request_t *request, uint8_t from, uint8_t to);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void sntp_request_init(sntp_request_t *request)
+{
+  memset(request, 0, sizeof(*request));
+  request->state = SNTP_REQUEST_IDLE;
+}
+
+bool sntp_request_ready(sntp_request_t *request, uint32_t now_ms, uint32_t drain_ms)
+{
+  if (request->state != SNTP_REQUEST_DRAINING) {
+    return true;
+  }
+  if ((uint32_t)(now_ms - request->issued_ms) < drain_ms) {
+    return false;
+  }
+  // Lost, if it comes after all it is counted as late
+  if (sntp_request_move(request, SNTP_REQUEST_DRAINING, SNTP_REQUEST_IDLE)) {
+    request->stats.drain_expired++;
+  }
+  return true;
+}
+
+void sntp_request_begin(sntp_request_t *request, uint8_t event, uint32_t now_ms)
+{
+  request->status    = 0;
+  request->length    = 0;
+  request->data[0]   = 0;
+  request->issued_ms = now_ms;
+  request->sequence++;
+  request->event = event;
+  SNTP_REQUEST_BARRIER();
+  request->state = SNTP_REQUEST_PENDING;
+}
+
+// The callback runs on the SDK event thread. It claims a PENDING call before
+// writing to it, so abandoning the call at the same time is decided by
+// whichever moves the state first, and the data is complete before DONE.
+bool sntp_request_complete(sntp_request_t *request,
+                           uint8_t event,
+                           uint32_t status,
+                           const uint8_t *data,
+                           uint32_t length)
+{
+  if (event != request->event) {
+    // Out of order, or an event of an earlier phase
+    request->stats.unexpected++;
+    return false;
+  }
+  if (!sntp_request_move(request, SNTP_REQUEST_PENDING, SNTP_REQUEST_FILLING)) {
+    switch (request->state) {
+      case SNTP_REQUEST_DONE:
+      case SNTP_REQUEST_FILLING:
+        request->stats.duplicate++;
+        break;
+      case SNTP_REQUEST_DRAINING:
+        sntp_request_move(request, SNTP_REQUEST_DRAINING, SNTP_REQUEST_IDLE);
+        request->stats.late++;
+        break;
+      default:
+        // After the drain expired
+        request->stats.late++;
+        break;
+    }
+    return false;
+  }
+  if (length > SNTP_REQUEST_DATA_LENGTH - 1u) {
+    length = SNTP_REQUEST_DATA_LENGTH - 1u;
+  }
+  if ((status == 0) && (data != NULL)) {
+    memcpy(request->data, data, length);
+  } else {
+    length = 0;
+  }
+  request->data[length] = 0;
+  request->length       = (uint16_t)length;
+  request->status       = status;
+  request->stats.completed++;
+  // data and length are not volatile, they must not move past the state
+  SNTP_REQUEST_BARRIER();
+  request->state = SNTP_REQUEST_DONE;
+  return true;
+}
+
+bool sntp_request_done(const sntp_request_t *request)
+{
+  return request->state == SNTP_REQUEST_DONE;
+}
+
+void sntp_request_abandon(sntp_request_t *request, uint32_t now_ms)
+{
+  // Set first, the drain timer starts once the state reads DRAINING
+  request->issued_ms = now_ms;
+  SNTP_REQUEST_BARRIER();
+  if (sntp_request_move(request, SNTP_REQUEST_PENDING, SNTP_REQUEST_DRAINING)) {
+    request->stats.timeouts++;
+  }
+}
+
+void sntp_request_end(sntp_request_t *request)
+{
+  sntp_request_move(request, SNTP_REQUEST_PENDING, SNTP_REQUEST_IDLE);
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// Compare and swap of the state, LDREXB/STREXB on the Cortex-M4
+static bool sntp_request_move(sntp_request_t *request, uint8_t from, uint8_t to)
+{
+  return __atomic_compare_exchange_n(&request->state, &from, to, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,112 @@
+/***************************************************************************/ /**
+ * @file sntp_request.h
+ * @brief Callback matching for the calls of the embedded SNTP client
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef SNTP_REQUEST_H_
+#define SNTP_REQUEST_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+#define SNTP_REQUEST_DATA_LENGTH 50u ///< Reply bytes kept, including the terminating NUL
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef enum {
+  SNTP_REQUEST_IDLE = 0, ///< Nothing outstanding
+  SNTP_REQUEST_PENDING,  ///< Call issued, waiting for its callback
+  SNTP_REQUEST_DONE,     ///< Callback taken, data and status valid
+  SNTP_REQUEST_DRAINING, ///< Call given up, its callback may still come
+  SNTP_REQUEST_FILLING,  ///< Callback claimed the call, copying its data
+} sntp_request_state_t;
+
+typedef struct {
+  uint32_t completed;     ///< Callbacks matched to the pending call
+  uint32_t timeouts;      ///< Calls given up without a callback
+  uint32_t late;          ///< Callbacks of a call given up, dropped
+  uint32_t duplicate;     ///< Repeated callbacks of a completed call, dropped
+  uint32_t unexpected;    ///< Callbacks of an event nobody waits for, dropped
+  uint32_t drain_expired; ///< Calls given up whose callback never came
+} sntp_request_stats_t;
+
+typedef struct {
+  volatile uint8_t state;   ///< sntp_request_state_t, moved by compare and swap
+  volatile uint8_t event;   ///< Callback event the call is waiting for
+  uint32_t status;          ///< sl_status_t of the callback
+  uint32_t sequence;        ///< Calls issued
+  uint32_t issued_ms;       ///< Time the call was issued, or given up while draining
+  uint16_t length;          ///< Bytes in data, without the NUL
+  uint8_t data[SNTP_REQUEST_DATA_LENGTH];
+  sntp_request_stats_t stats;
+} sntp_request_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+void sntp_request_init(sntp_request_t *request);
+
+/***************************************************************************/ /**
+ * Check whether a new call may be issued. A call given up less than drain_ms
+ * ago may still answer and would be taken for the next one.
+ *
+ * @param[in] now_ms current time
+ * @param[in] drain_ms longest time a call given up is waited for
+ ******************************************************************************/
+bool sntp_request_ready(sntp_request_t *request, uint32_t now_ms, uint32_t drain_ms);
+
+/***************************************************************************/ /**
+ * Mark a call as issued. Call before the SDK function, its callback may run
+ * before the function returns.
+ *
+ * @param[in] event callback event that completes the call
+ * @param[in] now_ms current time
+ ******************************************************************************/
+void sntp_request_begin(sntp_request_t *request, uint8_t event, uint32_t now_ms);
+
+/***************************************************************************/ /**
+ * Offer a callback. Called from the SNTP event handler. The data is copied
+ * only if the callback answers the pending call, anything else is counted
+ * and dropped.
+ *
+ * @param[in] event callback event type
+ * @param[in] status callback status
+ * @param[in] data reply bytes
+ * @param[in] length reply length
+ * @return true if the callback completed the pending call
+ ******************************************************************************/
+bool sntp_request_complete(sntp_request_t *request,
+                           uint8_t event,
+                           uint32_t status,
+                           const uint8_t *data,
+                           uint32_t length);
+
+bool sntp_request_done(const sntp_request_t *request);
+
+/***************************************************************************/ /**
+ * Give up the pending call after its timeout. Its callback, if it still
+ * comes, is dropped as late.
+ *
+ * @param[in] now_ms current time
+ ******************************************************************************/
+void sntp_request_abandon(sntp_request_t *request, uint32_t now_ms);
+
+/***************************************************************************/ /**
+ * End a call that returned without a callback to follow: a synchronous call
+ * or one the SDK refused.
+ ******************************************************************************/
+void sntp_request_end(sntp_request_t *request);
+
+#endif /* SNTP_REQUEST_H_ */
@@ -0,0 +1,114 @@
+/***************************************************************************/ /**
+ * @file sync_plan.c
+ * @brief Adaptive poll interval and sync window planning
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "sync_plan.h"
+#include "time_types.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define SYNC_PLAN_MIN_BASELINE_US 1000000 // Windows closer than this give no frequency estimate
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void sync_plan_init(sync_plan_t *plan, uint32_t budget_us, uint8_t min_poll, uint8_t max_poll)
+{
+  plan->budget_us   = budget_us;
+  plan->min_poll    = min_poll;
+  plan->max_poll    = (max_poll < min_poll) ? min_poll : max_poll;
+  plan->poll        = min_poll;
+  plan->have_freq   = false;
+  plan->freq_ppb    = 0;
+  plan->interval_s  = 1u << min_poll;
+  plan->windows     = 0;
+  plan->radio_on_ms = 0;
+  plan->elapsed_s   = 0;
+  sync_plan_restart(plan);
+}
+
+uint32_t sync_plan_update(sync_plan_t *plan, uint64_t local_us, int64_t offset_us)
+{
+  int64_t baseline_us;
+  int64_t predicted_us;
+  int64_t error_us;
+  int64_t freq_ppb;
+  uint64_t limit_s;
+
+  baseline_us = (int64_t)(local_us - plan->last_local_us);
+  if (plan->have_last && (baseline_us >= SYNC_PLAN_MIN_BASELINE_US)) {
+    predicted_us = plan->last_offset_us;
+    if (plan->have_freq) {
+      predicted_us += time_scale_ppb(baseline_us, plan->freq_ppb);
+    }
+    error_us = offset_us - predicted_us;
+    if (error_us < 0) {
+      error_us = -error_us;
+    }
+    if ((error_us > (int64_t)plan->budget_us) && (plan->poll > plan->min_poll)) {
+      plan->poll--;
+    } else if ((error_us < (int64_t)(plan->budget_us / SYNC_PLAN_RELAX_DIVISOR)) && (plan->poll < plan->max_poll)) {
+      plan->poll++;
+    }
+    // The offset is server minus local, a fast local clock makes it fall
+    freq_ppb = time_ratio_ppb(offset_us - plan->last_offset_us, baseline_us);
+    if (plan->have_freq) {
+      plan->freq_ppb += (int32_t)((freq_ppb - plan->freq_ppb) >> SYNC_PLAN_FREQ_SHIFT);
+    } else {
+      plan->freq_ppb  = (int32_t)freq_ppb;
+      plan->have_freq = true;
+    }
+  }
+  plan->have_last      = true;
+  plan->last_local_us  = local_us;
+  plan->last_offset_us = offset_us;
+
+  plan->interval_s = 1u << plan->poll;
+  if (plan->have_freq && (plan->freq_ppb != 0)) {
+    // error_us = freq_ppb * seconds / 1000
+    limit_s = ((uint64_t)plan->budget_us * 1000u)
+              / (uint64_t)((plan->freq_ppb < 0) ? -(int64_t)plan->freq_ppb : plan->freq_ppb);
+    if (limit_s < (1u << plan->min_poll)) {
+      limit_s = 1u << plan->min_poll;
+    }
+    if (limit_s < plan->interval_s) {
+      plan->interval_s = (uint32_t)limit_s;
+    }
+  }
+  return plan->interval_s;
+}
+
+void sync_plan_restart(sync_plan_t *plan)
+{
+  plan->have_last      = false;
+  plan->last_local_us  = 0;
+  plan->last_offset_us = 0;
+}
+
+void sync_plan_account(sync_plan_t *plan, uint32_t radio_on_ms, uint32_t elapsed_s)
+{
+  plan->windows++;
+  plan->radio_on_ms += radio_on_ms;
+  plan->elapsed_s += elapsed_s;
+}
+
+uint32_t sync_plan_radio_s_per_day(const sync_plan_t *plan)
+{
+  if (plan->elapsed_s == 0) {
+    return SYNC_PLAN_SECONDS_DAY;
+  }
+  return (uint32_t)(((uint64_t)plan->radio_on_ms * SYNC_PLAN_SECONDS_DAY) / ((uint64_t)plan->elapsed_s * 1000u));
+}
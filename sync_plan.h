@@ -0,0 +1,90 @@
+/***************************************************************************/ /**
+ * @file sync_plan.h
+ * @brief Adaptive poll interval and sync window planning
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef SYNC_PLAN_H_
+#define SYNC_PLAN_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+#define SYNC_PLAN_RELAX_DIVISOR 4u ///< Prediction error below budget / 4 lengthens the poll interval
+#define SYNC_PLAN_FREQ_SHIFT    2u ///< Frequency average gain 1/4 per window
+#define SYNC_PLAN_SECONDS_DAY   86400u
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef struct {
+  uint32_t budget_us;     ///< Time error allowed to build up between windows
+  uint8_t min_poll;       ///< log2 seconds
+  uint8_t max_poll;       ///< log2 seconds
+  uint8_t poll;           ///< Current poll exponent
+  bool have_last;
+  bool have_freq;
+  uint64_t last_local_us; ///< Local clock of the last sample
+  int64_t last_offset_us; ///< Offset of the last sample, server minus local
+  int32_t freq_ppb;       ///< Averaged local clock frequency error
+  uint32_t interval_s;    ///< Planned time to the next window
+  uint32_t windows;       ///< Sync windows run
+  uint32_t radio_on_ms;   ///< Radio on time summed over the windows
+  uint32_t elapsed_s;     ///< Time covered by the windows and the gaps between them
+} sync_plan_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Start planning at the shortest interval.
+ *
+ * @param[in] budget_us time error allowed between two windows
+ * @param[in] min_poll shortest interval, log2 seconds
+ * @param[in] max_poll longest interval, log2 seconds
+ ******************************************************************************/
+void sync_plan_init(sync_plan_t *plan, uint32_t budget_us, uint8_t min_poll, uint8_t max_poll);
+
+/***************************************************************************/ /**
+ * Feed the filtered offset of a window and plan the next one. The error of
+ * the offset predicted from the last frequency estimate moves the poll
+ * exponent: over budget shortens it, under a quarter of it lengthens it.
+ * The interval is then capped where the frequency error alone would use up
+ * the budget.
+ *
+ * @param[in] local_us local clock of the sample
+ * @param[in] offset_us server minus local clock
+ * @return seconds to the next window
+ ******************************************************************************/
+uint32_t sync_plan_update(sync_plan_t *plan, uint64_t local_us, int64_t offset_us);
+
+/***************************************************************************/ /**
+ * Forget the last offset, e.g. after the local clock was stepped. The
+ * frequency estimate and poll exponent are kept.
+ ******************************************************************************/
+void sync_plan_restart(sync_plan_t *plan);
+
+/***************************************************************************/ /**
+ * Account for one window of radio activity and the gap that followed it.
+ *
+ * @param[in] radio_on_ms wake to link down
+ * @param[in] elapsed_s wake to the next wake
+ ******************************************************************************/
+void sync_plan_account(sync_plan_t *plan, uint32_t radio_on_ms, uint32_t elapsed_s);
+
+/***************************************************************************/ /**
+ * Radio on seconds per day at the duty cycle seen so far.
+ ******************************************************************************/
+uint32_t sync_plan_radio_s_per_day(const sync_plan_t *plan);
+
+#endif /* SYNC_PLAN_H_ */
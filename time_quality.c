@@ -0,0 +1,101 @@
+/***************************************************************************/ /**
+ * @file time_quality.c
+ * @brief Snapshot of how good the local time is, readable from any context
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "time_quality.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define MICROS_PER_SECOND 1000000u
+
+// Single core: keeping the compiler from reordering around the sequence is enough
+#define TIME_QUALITY_BARRIER() __asm__ volatile("" ::: "memory")
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static uint32_t time_quality_grow(uint32_t base_us, uint32_t rate_ppb, uint64_t from_us, uint64_t now_us);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void time_quality_publish(time_quality_store_t *store, const time_quality_t *quality)
+{
+  uint32_t next = store->sequence + 1u;
+
+  // Readers stay on the other copy until the sequence moves
+  store->copy[next & 1u] = *quality;
+  TIME_QUALITY_BARRIER();
+  store->sequence = next;
+}
+
+void time_quality_read(const time_quality_store_t *store, time_quality_t *quality)
+{
+  uint32_t sequence;
+
+  do {
+    sequence = store->sequence;
+    TIME_QUALITY_BARRIER();
+    *quality = store->copy[sequence & 1u];
+    TIME_QUALITY_BARRIER();
+  } while (sequence != store->sequence);
+}
+
+uint32_t time_quality_age_s(const time_quality_t *quality, uint64_t now_us)
+{
+  uint64_t age_s;
+
+  if (quality->state == TIME_QUALITY_UNSYNCED) {
+    return UINT32_MAX;
+  }
+  age_s = (now_us > quality->sync_us) ? ((now_us - quality->sync_us) / MICROS_PER_SECOND) : 0u;
+  return (age_s > UINT32_MAX) ? UINT32_MAX : (uint32_t)age_s;
+}
+
+uint32_t time_quality_root_distance_us(const time_quality_t *quality, uint64_t now_us)
+{
+  if (quality->state == TIME_QUALITY_UNSYNCED) {
+    return UINT32_MAX;
+  }
+  return time_quality_grow(quality->root_delay_us / 2u + quality->root_dispersion_us,
+                           TIME_QUALITY_PHI_PPB,
+                           quality->sync_us,
+                           now_us);
+}
+
+uint32_t time_quality_error_us(const time_quality_t *quality, uint64_t now_us)
+{
+  if (quality->state == TIME_QUALITY_UNSYNCED) {
+    return UINT32_MAX;
+  }
+  return time_quality_grow(quality->error_us, quality->growth_ppb, quality->update_us, now_us);
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static uint32_t time_quality_grow(uint32_t base_us, uint32_t rate_ppb, uint64_t from_us, uint64_t now_us)
+{
+  uint64_t elapsed_ms = (now_us > from_us) ? ((now_us - from_us) / 1000u) : 0u;
+  uint64_t grown_us;
+
+  // Within 2^32 ms (~49 days) the product fits 64 bits
+  if (elapsed_ms > UINT32_MAX) {
+    return UINT32_MAX;
+  }
+  grown_us = (uint64_t)base_us + (elapsed_ms * rate_ppb) / 1000000u;
+  return (grown_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)grown_us;
+}
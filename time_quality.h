@@ -0,0 +1,96 @@
+/***************************************************************************/ /**
+ * @file time_quality.h
+ * @brief Snapshot of how good the local time is, readable from any context
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef TIME_QUALITY_H_
+#define TIME_QUALITY_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+#define TIME_QUALITY_PHI_PPB     15000u ///< RFC 5905 dispersion growth after an update
+#define TIME_QUALITY_STRATUM_MAX 16u    ///< Unsynchronized
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef enum {
+  TIME_QUALITY_UNSYNCED = 0, ///< Never set from a reference, or its source is unsynchronized
+  TIME_QUALITY_SYNCED,       ///< Following a reference
+  TIME_QUALITY_HOLDOVER,     ///< Reference lost, running on the drift model
+} time_quality_state_t;
+
+typedef struct {
+  uint8_t state;               ///< time_quality_state_t
+  uint8_t leap;                ///< Leap indicator of the reference
+  uint8_t stratum;             ///< Of this device, the reference stratum plus one
+  uint32_t reference_id;
+  uint64_t sync_us;            ///< Local time of the last reference update
+  uint32_t root_delay_us;      ///< Round trip to the primary reference
+  uint32_t root_dispersion_us; ///< Dispersion to the primary reference at sync_us
+  uint64_t update_us;          ///< Local time error_us applies to
+  uint32_t error_us;           ///< Bound of the local time error at update_us
+  uint32_t growth_ppb;         ///< Growth of the bound after update_us
+} time_quality_t;
+
+/// Two copies, readers take the one the writer is not in. A reader that
+/// interrupts the writer therefore finishes in one pass.
+typedef struct {
+  volatile uint32_t sequence; ///< Updates so far, its low bit picks the current copy
+  time_quality_t copy[2];
+} time_quality_store_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Publish a snapshot. One writer at a time.
+ ******************************************************************************/
+void time_quality_publish(time_quality_store_t *store, const time_quality_t *quality);
+
+/***************************************************************************/ /**
+ * Copy the current snapshot without locking. It retries only when two
+ * publishes complete during the copy.
+ *
+ * @param[out] quality all zero (TIME_QUALITY_UNSYNCED) before the first publish
+ ******************************************************************************/
+void time_quality_read(const time_quality_store_t *store, time_quality_t *quality);
+
+/***************************************************************************/ /**
+ * Seconds since the last reference update.
+ *
+ * @param[in] now_us local time now
+ * @return UINT32_MAX while unsynchronized
+ ******************************************************************************/
+uint32_t time_quality_age_s(const time_quality_t *quality, uint64_t now_us);
+
+/***************************************************************************/ /**
+ * RFC 5905 root distance: half the root delay plus the root dispersion,
+ * which grows by TIME_QUALITY_PHI_PPB after the last update.
+ *
+ * @param[in] now_us local time now
+ * @return microseconds, UINT32_MAX while unsynchronized
+ ******************************************************************************/
+uint32_t time_quality_root_distance_us(const time_quality_t *quality, uint64_t now_us);
+
+/***************************************************************************/ /**
+ * Bound of the local time error, from the snapshot's bound and growth.
+ *
+ * @param[in] now_us local time now
+ * @return microseconds, UINT32_MAX while unsynchronized
+ ******************************************************************************/
+uint32_t time_quality_error_us(const time_quality_t *quality, uint64_t now_us);
+
+#endif /* TIME_QUALITY_H_ */
@@ -0,0 +1,149 @@
+/***************************************************************************/ /**
+ * @file time_slew.c
+ * @brief Monotonic steering of a raw clock by bounded slew and rare steps
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "time_slew.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define MICROS_PER_SECOND 1000000u
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static int64_t time_slew_progress(const time_slew_t *slew, uint64_t raw_us);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void time_slew_init(time_slew_t *slew, uint32_t rate_ppm, uint32_t step_us)
+{
+  slew->rate_ppm     = (rate_ppm >= MICROS_PER_SECOND) ? (MICROS_PER_SECOND - 1u) : rate_ppm;
+  slew->step_us      = step_us;
+  slew->base_us      = 0;
+  slew->pending_us   = 0;
+  slew->start_raw_us = 0;
+  slew->adjusted_us  = 0;
+  slew->last_us      = 0;
+  slew->slews        = 0;
+  slew->steps        = 0;
+  slew->stale        = 0;
+  slew->clamped      = 0;
+}
+
+uint64_t time_slew_read(time_slew_t *slew, uint64_t raw_us)
+{
+  uint64_t now_us = (uint64_t)((int64_t)raw_us + time_slew_correction_us(slew, raw_us));
+
+  // The rate stays positive while slewing, only a raw clock that went back
+  // (RTC and interpolation disagreeing by a little) is held here
+  if (now_us < slew->last_us) {
+    slew->clamped++;
+    return slew->last_us;
+  }
+  slew->last_us = now_us;
+  return now_us;
+}
+
+int64_t time_slew_correction_us(const time_slew_t *slew, uint64_t raw_us)
+{
+  return slew->base_us + time_slew_progress(slew, raw_us);
+}
+
+time_slew_action_t time_slew_adjust(time_slew_t *slew, uint64_t raw_us, uint64_t sample_us, int64_t offset_us)
+{
+  int64_t now_correction = time_slew_correction_us(slew, raw_us);
+  uint64_t now_us        = (uint64_t)((int64_t)raw_us + now_correction);
+  uint64_t age_us;
+  int64_t residual_us;
+
+  if (sample_us < slew->adjusted_us) {
+    // Measured against the clock before the last correction
+    slew->stale++;
+    return TIME_SLEW_STALE;
+  }
+  // The previous slew went on since the sample, that part is already in
+  age_us      = (now_us > sample_us) ? (now_us - sample_us) : 0u;
+  residual_us = offset_us;
+  if (age_us <= raw_us) {
+    residual_us -= now_correction - time_slew_correction_us(slew, raw_us - age_us);
+  }
+
+  slew->base_us      = now_correction;
+  slew->start_raw_us = raw_us;
+  if ((residual_us > (int64_t)slew->step_us) || (residual_us < -(int64_t)slew->step_us)) {
+    slew->base_us += residual_us;
+    slew->pending_us  = 0;
+    slew->last_us     = (uint64_t)((int64_t)raw_us + slew->base_us);
+    slew->adjusted_us = slew->last_us;
+    slew->steps++;
+    return TIME_SLEW_STEPPED;
+  }
+  slew->pending_us  = residual_us;
+  slew->adjusted_us = now_us;
+  slew->slews++;
+  return TIME_SLEW_SLEWING;
+}
+
+void time_slew_rebase(time_slew_t *slew, uint64_t raw_us, uint64_t now_us)
+{
+  slew->base_us      = (int64_t)(now_us - raw_us);
+  slew->pending_us   = 0;
+  slew->start_raw_us = raw_us;
+  slew->last_us      = now_us;
+  slew->adjusted_us  = now_us;
+}
+
+void time_slew_shift(time_slew_t *slew, int64_t raw_shift_us)
+{
+  slew->base_us -= raw_shift_us;
+  slew->start_raw_us = (uint64_t)((int64_t)slew->start_raw_us + raw_shift_us);
+}
+
+int64_t time_slew_remaining_us(const time_slew_t *slew, uint64_t raw_us, uint32_t *remaining_ms)
+{
+  int64_t remaining_us = slew->pending_us - time_slew_progress(slew, raw_us);
+  uint64_t magnitude   = (uint64_t)((remaining_us < 0) ? -remaining_us : remaining_us);
+
+  if (remaining_ms != 0) {
+    // Slewing by rate_ppm takes 1000000 / rate_ppm times the correction
+    magnitude     = (magnitude * 1000u) / ((slew->rate_ppm != 0) ? slew->rate_ppm : 1u);
+    *remaining_ms = (magnitude > UINT32_MAX) ? UINT32_MAX : (uint32_t)magnitude;
+  }
+  return remaining_us;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// Part of pending_us slewed in by raw_us, rate_ppm of the raw time elapsed
+static int64_t time_slew_progress(const time_slew_t *slew, uint64_t raw_us)
+{
+  uint64_t elapsed_us = (raw_us > slew->start_raw_us) ? (raw_us - slew->start_raw_us) : 0u;
+  uint64_t magnitude  = (uint64_t)((slew->pending_us < 0) ? -slew->pending_us : slew->pending_us);
+  uint64_t done_us;
+
+  // Saturates long before the product overflows: a full step threshold
+  // takes minutes, the cap keeps a stale start from multiplying out
+  if (elapsed_us > magnitude * (MICROS_PER_SECOND / ((slew->rate_ppm != 0) ? slew->rate_ppm : 1u))) {
+    return slew->pending_us;
+  }
+  done_us = (elapsed_us * slew->rate_ppm) / MICROS_PER_SECOND;
+  if (done_us >= magnitude) {
+    return slew->pending_us;
+  }
+  return (slew->pending_us < 0) ? -(int64_t)done_us : (int64_t)done_us;
+}
@@ -0,0 +1,113 @@
+/***************************************************************************/ /**
+ * @file time_slew.h
+ * @brief Monotonic steering of a raw clock by bounded slew and rare steps
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef TIME_SLEW_H_
+#define TIME_SLEW_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+#define TIME_SLEW_RATE_PPM 500u    ///< Default slew rate, the clock runs at most 0.05 % fast or slow
+#define TIME_SLEW_STEP_US  128000u ///< Default step threshold, RFC 5905 STEPT
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef enum {
+  TIME_SLEW_STALE = 0, ///< Sample taken before the last correction, ignored
+  TIME_SLEW_SLEWING,   ///< Correction is slewed in
+  TIME_SLEW_STEPPED,   ///< Correction was applied at once
+} time_slew_action_t;
+
+typedef struct {
+  uint32_t rate_ppm;      ///< Largest rate change while slewing
+  uint32_t step_us;       ///< Offsets beyond this are stepped
+  int64_t base_us;        ///< Correction complete before the current slew
+  int64_t pending_us;     ///< Correction of the current slew, in full
+  uint64_t start_raw_us;  ///< Raw clock when the current slew started
+  uint64_t adjusted_us;   ///< Steered clock at the last correction
+  uint64_t last_us;       ///< Last time read, the next read is not earlier
+  uint32_t slews;
+  uint32_t steps;
+  uint32_t stale;
+  uint32_t clamped;       ///< Reads held at the last value, the raw clock went back
+} time_slew_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Start without correction.
+ *
+ * @param[in] rate_ppm slew rate, below 1000000
+ * @param[in] step_us step threshold
+ ******************************************************************************/
+void time_slew_init(time_slew_t *slew, uint32_t rate_ppm, uint32_t step_us);
+
+/***************************************************************************/ /**
+ * Steered time at a raw clock reading. Between steps the result never
+ * decreases, across calls from any caller, so concurrent callers must
+ * serialize.
+ *
+ * @param[in] raw_us raw clock
+ * @return raw_us plus the correction applied so far
+ ******************************************************************************/
+uint64_t time_slew_read(time_slew_t *slew, uint64_t raw_us);
+
+/***************************************************************************/ /**
+ * Correction applied at a raw clock reading, steered minus raw.
+ ******************************************************************************/
+int64_t time_slew_correction_us(const time_slew_t *slew, uint64_t raw_us);
+
+/***************************************************************************/ /**
+ * Feed a measured offset. It replaces the remaining part of the previous
+ * correction, less what was slewed in since the sample was taken.
+ *
+ * @param[in] raw_us raw clock now
+ * @param[in] sample_us steered clock when the offset was measured
+ * @param[in] offset_us reference minus steered clock
+ * @return TIME_SLEW_STEPPED if the steered time jumped, the caller should
+ *         notify its time consumers
+ ******************************************************************************/
+time_slew_action_t time_slew_adjust(time_slew_t *slew, uint64_t raw_us, uint64_t sample_us, int64_t offset_us);
+
+/***************************************************************************/ /**
+ * Continue from a known time after the raw clock itself was set. Any
+ * remaining slew is dropped.
+ *
+ * @param[in] raw_us raw clock after it was set
+ * @param[in] now_us steered time to continue from
+ ******************************************************************************/
+void time_slew_rebase(time_slew_t *slew, uint64_t raw_us, uint64_t now_us);
+
+/***************************************************************************/ /**
+ * Follow a jump of the raw clock that was already counted in the
+ * correction, the steered time and the slew in progress carry on.
+ *
+ * @param[in] raw_shift_us raw clock after the jump minus before
+ ******************************************************************************/
+void time_slew_shift(time_slew_t *slew, int64_t raw_shift_us);
+
+/***************************************************************************/ /**
+ * Correction still to be slewed in, and the time it takes.
+ *
+ * @param[in] raw_us raw clock now
+ * @param[out] remaining_ms time until the slew is complete, may be NULL
+ * @return correction left, microseconds
+ ******************************************************************************/
+int64_t time_slew_remaining_us(const time_slew_t *slew, uint64_t raw_us, uint32_t *remaining_ms);
+
+#endif /* TIME_SLEW_H_ */
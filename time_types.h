@@ -0,0 +1,314 @@
+/***************************************************************************/ /**
+ * @file time_types.h
+ * @brief Era-safe NTP, Unix and calendar time types, header only
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef TIME_TYPES_H_
+#define TIME_TYPES_H_
+#include <stdint.h>
+
+// The types wrap one integer so they cannot be mixed up, and are passed in
+// registers like the integer. The conversions are integer only and inline:
+// with constant arguments the compiler folds them at -O1 and above.
+
+// -----------------------------------------------------------------------------
+// Macros
+#define TIME_NS_PER_SECOND   1000000000
+#define TIME_SECONDS_DAY     86400
+#define TIME_NTP_UNIX_EPOCH  2208988800u ///< Seconds from 1900 to 1970, NTP era 0
+#define TIME_PIVOT_UNIX_S    1704067200  ///< 2024-01-01, resolves NTP eras until a clock is set
+
+/// Integer constant expressions, for static initializers and #if
+#define UNIX_TIME_NS_FROM_S(s)  ((int64_t)(s) * TIME_NS_PER_SECOND)
+#define NTP_TIME_VALUE(s, frac) (((uint64_t)(uint32_t)(s) << 32) | (uint32_t)(frac))
+
+// -----------------------------------------------------------------------------
+// Data Types
+/// NTP 32.32 timestamp, seconds of its era in the upper half. Each era is
+/// 2^32 s (136 years), era 1 starts in February 2036.
+typedef struct {
+  uint64_t value;
+} ntp_time_t;
+
+/// Nanoseconds since 1970 UTC, +-292 years
+typedef struct {
+  int64_t ns;
+} unix_time_t;
+
+/// Signed duration, Q32.32 seconds: +-68 years at 2^-32 s
+typedef struct {
+  int64_t value;
+} time_q32_t;
+
+/// Broken down UTC date and time, proleptic Gregorian
+typedef struct {
+  int32_t year;    ///< Full year, e.g. 2036
+  uint8_t month;   ///< 1 to 12
+  uint8_t day;     ///< 1 to 31
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+  uint8_t weekday; ///< 0 is Sunday
+  uint32_t ns;     ///< Within the second
+} civil_time_t;
+
+// -----------------------------------------------------------------------------
+// Inline functions
+static inline int64_t time_floor_div(int64_t value, int64_t divisor)
+{
+  return (value / divisor) - (((value % divisor) != 0) && ((value < 0) != (divisor < 0)));
+}
+
+static inline ntp_time_t ntp_time_make(uint32_t seconds, uint32_t fraction)
+{
+  ntp_time_t time = { NTP_TIME_VALUE(seconds, fraction) };
+
+  return time;
+}
+
+static inline uint32_t ntp_time_seconds(ntp_time_t time)
+{
+  return (uint32_t)(time.value >> 32);
+}
+
+static inline uint32_t ntp_time_fraction(ntp_time_t time)
+{
+  return (uint32_t)time.value;
+}
+
+static inline unix_time_t unix_time_from_s(int64_t seconds)
+{
+  unix_time_t time = { UNIX_TIME_NS_FROM_S(seconds) };
+
+  return time;
+}
+
+static inline unix_time_t unix_time_from_us(int64_t micros)
+{
+  unix_time_t time = { micros * 1000 };
+
+  return time;
+}
+
+/// Whole seconds, rounded down also before 1970
+static inline int64_t unix_time_s(unix_time_t time)
+{
+  return time_floor_div(time.ns, TIME_NS_PER_SECOND);
+}
+
+static inline int64_t unix_time_us(unix_time_t time)
+{
+  return time_floor_div(time.ns, 1000);
+}
+
+/***************************************************************************/ /**
+ * NTP timestamp of a Unix time. The era does not fit the timestamp and is
+ * dropped, ntp_time_to_unix() recovers it.
+ ******************************************************************************/
+static inline ntp_time_t ntp_time_from_unix(unix_time_t time)
+{
+  int64_t seconds = unix_time_s(time);
+  uint64_t ns     = (uint64_t)(time.ns - seconds * TIME_NS_PER_SECOND);
+
+  return ntp_time_make((uint32_t)((uint64_t)seconds + TIME_NTP_UNIX_EPOCH),
+                       (uint32_t)((ns << 32) / TIME_NS_PER_SECOND));
+}
+
+/***************************************************************************/ /**
+ * Unix time of an NTP timestamp, in the era that puts it within 68 years of
+ * @p pivot. The difference is taken modulo 2^32 s as a signed 32.32 value,
+ * so timestamps on both sides of an era rollover come out in order.
+ *
+ * @param[in] time NTP timestamp
+ * @param[in] pivot a time known to be close, e.g. the local clock or
+ *            TIME_PIVOT_UNIX_S
+ ******************************************************************************/
+static inline unix_time_t ntp_time_to_unix(ntp_time_t time, unix_time_t pivot)
+{
+  int64_t difference = (int64_t)(time.value - ntp_time_from_unix(pivot).value);
+  unix_time_t result;
+
+  // Seconds round down, the fraction adds up from there
+  result.ns = pivot.ns + (difference >> 32) * TIME_NS_PER_SECOND
+              + (int64_t)(((uint64_t)(uint32_t)difference * TIME_NS_PER_SECOND) >> 32);
+  return result;
+}
+
+/***************************************************************************/ /**
+ * @p later minus @p earlier. Taken modulo 2^64, so it is exact across an era
+ * rollover as long as the two are within 68 years.
+ ******************************************************************************/
+static inline time_q32_t ntp_time_diff(ntp_time_t later, ntp_time_t earlier)
+{
+  time_q32_t difference = { (int64_t)(later.value - earlier.value) };
+
+  return difference;
+}
+
+/// Within +-2^31 s
+static inline time_q32_t time_q32_from_us(int64_t micros)
+{
+  int64_t seconds   = time_floor_div(micros, 1000000);
+  uint64_t fraction = (uint64_t)(micros - seconds * 1000000);
+  time_q32_t time   = { (int64_t)((uint64_t)seconds << 32) + (int64_t)(((fraction << 32) + 500000u) / 1000000u) };
+
+  return time;
+}
+
+/// Rounded to the nearest microsecond
+static inline int64_t time_q32_to_us(time_q32_t time)
+{
+  return (time.value >> 32) * 1000000 + (int64_t)(((uint64_t)(uint32_t)time.value * 1000000u + 0x80000000u) >> 32);
+}
+
+static inline time_q32_t time_q32_sub(time_q32_t a, time_q32_t b)
+{
+  time_q32_t difference = { (int64_t)((uint64_t)a.value - (uint64_t)b.value) };
+
+  return difference;
+}
+
+/// (a + b) / 2 without overflow, rounded down
+static inline time_q32_t time_q32_mean(time_q32_t a, time_q32_t b)
+{
+  time_q32_t mean = { (a.value >> 1) + (b.value >> 1) + (a.value & b.value & 1) };
+
+  return mean;
+}
+
+/***************************************************************************/ /**
+ * @p value scaled by @p ppb parts per billion, rounded toward zero as the
+ * exact product would be. The product never needs more than 64 bits, the
+ * result saturates.
+ ******************************************************************************/
+static inline int64_t time_scale_ppb(int64_t value, int32_t ppb)
+{
+  int64_t whole     = value / TIME_NS_PER_SECOND;
+  int64_t remainder = value % TIME_NS_PER_SECOND;
+  int64_t scaled;
+
+  // remainder * ppb is below 10^9 * 2^31, whole * ppb only overflows with the result
+  if (__builtin_mul_overflow(whole, (int64_t)ppb, &scaled)) {
+    return ((value < 0) != (ppb < 0)) ? INT64_MIN : INT64_MAX;
+  }
+  return scaled + (remainder * ppb) / TIME_NS_PER_SECOND;
+}
+
+/***************************************************************************/ /**
+ * @p change over @p baseline in parts per billion, e.g. a frequency error
+ * from an offset change over the time it took. Rounded toward zero,
+ * saturated to int32_t.
+ *
+ * @param[in] baseline non-zero, same unit as @p change
+ ******************************************************************************/
+static inline int32_t time_ratio_ppb(int64_t change, int64_t baseline)
+{
+  int64_t whole;
+  int64_t remainder;
+  int64_t ratio;
+
+  if (baseline < 0) {
+    baseline = -baseline;
+    change   = -change;
+  }
+  whole     = change / baseline;
+  remainder = change % baseline;
+  if ((whole > INT32_MAX / TIME_NS_PER_SECOND + 1) || (whole < INT32_MIN / TIME_NS_PER_SECOND - 1)) {
+    return (whole < 0) ? INT32_MIN : INT32_MAX;
+  }
+  // remainder * 10^9 fits while the baseline is below 2^33, beyond that
+  // both lose low bits, a relative error of 2^-33 at most
+  while (baseline >= (1ll << 33)) {
+    baseline >>= 1;
+    remainder /= 2;
+  }
+  ratio = whole * TIME_NS_PER_SECOND + (remainder * TIME_NS_PER_SECOND) / baseline;
+  if (ratio > INT32_MAX) {
+    return INT32_MAX;
+  }
+  return (ratio < INT32_MIN) ? INT32_MIN : (int32_t)ratio;
+}
+
+/// Integer square root, rounded down, bit by bit
+static inline uint32_t time_isqrt(uint64_t value)
+{
+  uint64_t root = 0;
+  uint64_t bit  = 1ull << 62;
+
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
+
+/***************************************************************************/ /**
+ * Days from 1970-01-01 to a date, negative before.
+ * H. Hinnant's days_from_civil, in 400 year eras of 146097 days.
+ ******************************************************************************/
+static inline int64_t civil_days_from_date(int32_t year, uint32_t month, uint32_t day)
+{
+  int64_t y         = (int64_t)year - (month <= 2u);
+  int64_t era       = time_floor_div(y, 400);
+  uint32_t year_era = (uint32_t)(y - era * 400);
+  uint32_t day_year = (153u * ((month > 2u) ? (month - 3u) : (month + 9u)) + 2u) / 5u + day - 1u;
+  uint32_t day_era  = year_era * 365u + year_era / 4u - year_era / 100u + day_year;
+
+  return era * 146097 + (int64_t)day_era - 719468;
+}
+
+static inline civil_time_t civil_from_unix(unix_time_t time)
+{
+  int64_t seconds  = unix_time_s(time);
+  int64_t days     = time_floor_div(seconds, TIME_SECONDS_DAY);
+  uint32_t in_day  = (uint32_t)(seconds - days * TIME_SECONDS_DAY);
+  int64_t shifted  = days + 719468;
+  int64_t era      = time_floor_div(shifted, 146097);
+  uint32_t day_era = (uint32_t)(shifted - era * 146097);
+  uint32_t year_era = (day_era - day_era / 1460u + day_era / 36524u - day_era / 146096u) / 365u;
+  uint32_t day_year = day_era - (365u * year_era + year_era / 4u - year_era / 100u);
+  uint32_t month_shifted = (5u * day_year + 2u) / 153u;
+  civil_time_t civil;
+
+  civil.day     = (uint8_t)(day_year - (153u * month_shifted + 2u) / 5u + 1u);
+  civil.month   = (uint8_t)((month_shifted < 10u) ? (month_shifted + 3u) : (month_shifted - 9u));
+  civil.year    = (int32_t)((int64_t)year_era + era * 400 + (civil.month <= 2u));
+  civil.hour    = (uint8_t)(in_day / 3600u);
+  civil.minute  = (uint8_t)((in_day / 60u) % 60u);
+  civil.second  = (uint8_t)(in_day % 60u);
+  // 1970-01-01 was a Thursday
+  civil.weekday = (uint8_t)((days + 4) - time_floor_div(days + 4, 7) * 7);
+  civil.ns      = (uint32_t)(time.ns - seconds * TIME_NS_PER_SECOND);
+  return civil;
+}
+
+static inline unix_time_t civil_to_unix(civil_time_t civil)
+{
+  int64_t seconds = civil_days_from_date(civil.year, civil.month, civil.day) * TIME_SECONDS_DAY
+                    + (int64_t)civil.hour * 3600 + (int64_t)civil.minute * 60 + civil.second;
+  unix_time_t time = { UNIX_TIME_NS_FROM_S(seconds) + civil.ns };
+
+  return time;
+}
+
+#endif /* TIME_TYPES_H_ */
@@ -0,0 +1,185 @@
+/***************************************************************************/ /**
+ * @file timeline.c
+ * @brief Boot and sync phase markers with a compact report
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include <inttypes.h>
+#include "stdio.h"
+#include "timeline.h"
+#ifdef TIMELINE_HOST
+#include <time.h>
+#else
+#include "cmsis_os2.h"
+#include "si91x_device.h"
+#endif
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#ifdef TIMELINE_HOST
+// Host tools keep stdout for their CSV, the report goes with the summary
+#define TIMELINE_PRINT(...) fprintf(stderr, __VA_ARGS__)
+#else
+#define TIMELINE_PRINT(...) printf(__VA_ARGS__)
+#endif
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+static const char *const timeline_name[TIMELINE_MARK_TYPES] = {
+  [TIMELINE_RESET]         = "reset",
+  [TIMELINE_SYSTEM_INIT]   = "system_init",
+  [TIMELINE_TASK_START]    = "task_start",
+  [TIMELINE_NET_INIT]      = "net_init",
+  [TIMELINE_NET_UP]        = "net_up",
+  [TIMELINE_DNS_START]     = "dns_start",
+  [TIMELINE_DNS_DONE]      = "dns_done",
+  [TIMELINE_SNTP_START]    = "sntp_start",
+  [TIMELINE_FIRST_REPLY]   = "first_reply",
+  [TIMELINE_CALENDAR_INIT] = "calendar_init",
+  [TIMELINE_REJOIN]        = "rejoin",
+};
+
+static timeline_entry_t timeline[TIMELINE_MAX_MARKS];
+static uint8_t timeline_count    = 0;
+static uint32_t timeline_dropped = 0;
+static uint32_t timeline_seen    = 0; // Bit per timeline_mark_t recorded
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static void timeline_counter_start(void);
+static void timeline_read(timeline_entry_t *entry);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+void timeline_init(void)
+{
+  timeline_counter_start();
+  timeline_count   = 0;
+  timeline_dropped = 0;
+  timeline_seen    = 0;
+  timeline_mark(TIMELINE_RESET, 0);
+}
+
+void timeline_mark(timeline_mark_t mark, uint32_t arg)
+{
+  timeline_entry_t *entry;
+
+  if (timeline_count >= TIMELINE_MAX_MARKS) {
+    timeline_dropped++;
+    return;
+  }
+  entry = &timeline[timeline_count++];
+  timeline_read(entry);
+  entry->mark = (uint8_t)mark;
+  entry->arg  = arg;
+  timeline_seen |= 1u << mark;
+}
+
+void timeline_mark_once(timeline_mark_t mark, uint32_t arg)
+{
+  if (!(timeline_seen & (1u << mark))) {
+    timeline_mark(mark, arg);
+  }
+}
+
+uint32_t timeline_span_us(uint8_t from, uint8_t to)
+{
+  const timeline_entry_t *a = &timeline[from];
+  const timeline_entry_t *b = &timeline[to];
+  uint64_t micros           = 0;
+  uint8_t i;
+
+  if ((from >= timeline_count) || (to >= timeline_count) || (to <= from)) {
+    return 0;
+  }
+  if (to != from + 1u) {
+    // Sum the steps, each short enough for the cycle counter
+    for (i = from; i < to; i++) {
+      micros += timeline_span_us(i, i + 1u);
+    }
+    return (micros > UINT32_MAX) ? UINT32_MAX : (uint32_t)micros;
+  }
+#ifndef TIMELINE_HOST
+  // The cycle counter wraps within seconds at full speed
+  if (a->kernel && b->kernel) {
+    micros = ((uint64_t)(b->tick - a->tick) * 1000000u) / osKernelGetTickFreq();
+    if (micros >= TIMELINE_WRAP_GUARD_US) {
+      return (micros > UINT32_MAX) ? UINT32_MAX : (uint32_t)micros;
+    }
+  }
+#endif
+  // The rate at the end of the phase, clock switches happen early in a phase
+  return (uint32_t)(((uint64_t)(b->cycles - a->cycles) * 1000000u) / ((b->hz != 0) ? b->hz : 1u));
+}
+
+void timeline_report(void)
+{
+  const timeline_entry_t *entry;
+  uint32_t total_us = 0;
+  uint32_t step_us;
+  uint8_t i;
+
+  TIMELINE_PRINT("Timeline, us: step / since reset\r\n");
+  for (i = 0; i < timeline_count; i++) {
+    entry    = &timeline[i];
+    step_us  = (i == 0) ? 0u : timeline_span_us(i - 1u, i);
+    total_us = (total_us > UINT32_MAX - step_us) ? UINT32_MAX : total_us + step_us;
+    TIMELINE_PRINT("  %-13s %10" PRIu32 " %10" PRIu32, timeline_name[entry->mark], step_us, total_us);
+    if (entry->arg != 0) {
+      TIMELINE_PRINT("  (0x%" PRIx32 ")", entry->arg);
+    }
+    TIMELINE_PRINT("\r\n");
+  }
+  if (timeline_dropped != 0) {
+    TIMELINE_PRINT("  %" PRIu32 " marks dropped\r\n", timeline_dropped);
+  }
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+#ifdef TIMELINE_HOST
+// Host builds count microseconds
+static void timeline_counter_start(void)
+{
+}
+
+static void timeline_read(timeline_entry_t *entry)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  entry->cycles = (uint32_t)((uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u);
+  entry->hz     = 1000000u;
+  entry->tick   = 0;
+  entry->kernel = false;
+}
+#else
+static void timeline_counter_start(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static void timeline_read(timeline_entry_t *entry)
+{
+  entry->cycles = DWT->CYCCNT;
+  entry->hz     = SystemCoreClock;
+  entry->kernel = (osKernelGetState() == osKernelRunning);
+  entry->tick   = entry->kernel ? osKernelGetTickCount() : 0u;
+}
+#endif
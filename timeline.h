@@ -0,0 +1,88 @@
+/***************************************************************************/ /**
+ * @file timeline.h
+ * @brief Boot and sync phase markers with a compact report
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef TIMELINE_H_
+#define TIMELINE_H_
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+#define TIMELINE_MAX_MARKS     24u       ///< Marks kept, later ones are counted as dropped
+#define TIMELINE_WRAP_GUARD_US 10000000u ///< Phases longer than this are timed by the kernel tick
+
+// -----------------------------------------------------------------------------
+// Data Types
+typedef enum {
+  TIMELINE_RESET = 0,     ///< main() entered
+  TIMELINE_SYSTEM_INIT,   ///< sl_system_init() returned
+  TIMELINE_TASK_START,    ///< Kernel running, SNTP task started
+  TIMELINE_NET_INIT,      ///< sl_net_init() returned, arg status
+  TIMELINE_NET_UP,        ///< Link up, arg 1 for a directed join
+  TIMELINE_DNS_START,     ///< Resolve attempt started
+  TIMELINE_DNS_DONE,      ///< Resolve attempt ended, arg status
+  TIMELINE_SNTP_START,    ///< Client ready to send
+  TIMELINE_FIRST_REPLY,   ///< First usable reply
+  TIMELINE_CALENDAR_INIT, ///< calendar_init() returned, time valid
+  TIMELINE_REJOIN,        ///< Link back after a loss, arg join time in ms
+  TIMELINE_MARK_TYPES,
+} timeline_mark_t;
+
+typedef struct {
+  uint8_t mark;    ///< timeline_mark_t
+  bool kernel;     ///< tick is valid
+  uint32_t arg;    ///< Mark specific value
+  uint32_t cycles; ///< Cycle counter
+  uint32_t hz;     ///< Cycle counter rate at the mark
+  uint32_t tick;   ///< Kernel tick
+} timeline_entry_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Start the cycle counter and record TIMELINE_RESET. Call first in main().
+ ******************************************************************************/
+void timeline_init(void);
+
+/***************************************************************************/ /**
+ * Record a mark. Not thread safe, marks are taken by main() and the SNTP
+ * task only.
+ *
+ * @param[in] mark phase reached
+ * @param[in] arg mark specific value
+ ******************************************************************************/
+void timeline_mark(timeline_mark_t mark, uint32_t arg);
+
+/***************************************************************************/ /**
+ * Record a mark unless it was recorded before.
+ ******************************************************************************/
+void timeline_mark_once(timeline_mark_t mark, uint32_t arg);
+
+/***************************************************************************/ /**
+ * Microseconds between two recorded entries.
+ *
+ * @param[in] from earlier entry index
+ * @param[in] to later entry index
+ ******************************************************************************/
+uint32_t timeline_span_us(uint8_t from, uint8_t to);
+
+/***************************************************************************/ /**
+ * Print every mark with the time since the previous one and since reset.
+ ******************************************************************************/
+void timeline_report(void);
+
+#endif /* TIMELINE_H_ */
@@ -0,0 +1,217 @@
+/***************************************************************************/ /**
+ * @file alarm_wheel_bench.c
+ * @brief Insert, cancel and expire cost of alarm_wheel.c with many timers
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory:
+ *   cc -O2 -I.. -o alarm_wheel_bench alarm_wheel_bench.c ../alarm_wheel.c
+ *
+ *   alarm_wheel_bench [-n timers] [-s span s] [-r rounds] [-S seed]
+ *
+ * Each round starts -n timers at random UTC seconds up to -s ahead, cancels
+ * every other one and starts those again, steps the clock back an hour, and
+ * then runs the wheel the way calendar_app.c does: advance to the next expiry
+ * the RTC alarm would be programmed for, until nothing is pending. The
+ * default span of 400 days puts some timers on the overflow list.
+ *
+ * Printed per operation is the mean host time, and for the expiry phase the
+ * number of alarms programmed. Every callback checks that it ran at its own
+ * expiry, the exit status is 1 if one ran early, late or not at all.
+ *
+ * Last a timer whose callback re-arms it at the current second is advanced
+ * through BENCH_REARM_CALLS seconds. It has to fire once per
+ * alarm_wheel_advance() call, the exit status is 1 otherwise.
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "alarm_wheel.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define BENCH_EPOCH_S     1704067200u // 2024-01-01
+#define BENCH_STEP_S      3600u       // Clock stepped back once per round
+#define BENCH_REARM_CALLS 100u        // Advance calls of the self re-arming timer
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef struct {
+  alarm_wheel_t *wheel;
+  uint32_t fired;
+  uint32_t wrong;
+} bench_t;
+
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static uint32_t bench_random(uint32_t span);
+static double bench_now_ns(void);
+static void bench_fire(alarm_wheel_timer_t *timer, void *context);
+static void bench_rearm(alarm_wheel_timer_t *timer, void *context);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  static alarm_wheel_t wheel;
+  uint32_t count  = 10000;
+  uint32_t span_s = 400u * 86400u;
+  uint32_t rounds = 20;
+  double insert_ns = 0.0;
+  double cancel_ns = 0.0;
+  double step_ns   = 0.0;
+  double expire_ns = 0.0;
+  uint64_t alarms  = 0;
+  alarm_wheel_timer_t *timers;
+  bench_t bench = { &wheel, 0, 0 };
+  bench_t rearm = { &wheel, 0, 0 };
+  alarm_wheel_timer_t rearm_timer = { 0 };
+  uint32_t next;
+  uint32_t round;
+  uint32_t i;
+  double start;
+  int arg;
+
+  for (arg = 1; arg + 1 < argc; arg += 2) {
+    if (strcmp(argv[arg], "-n") == 0) {
+      count = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-s") == 0) {
+      span_s = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-r") == 0) {
+      rounds = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-S") == 0) {
+      rng = strtoull(argv[arg + 1], NULL, 0) | 1u;
+    } else {
+      break;
+    }
+  }
+  if ((arg != argc) || (count == 0) || (span_s == 0) || (rounds == 0)) {
+    fprintf(stderr, "usage: see the file header of alarm_wheel_bench.c\n");
+    return 2;
+  }
+  timers = calloc(count, sizeof(timers[0]));
+  if (timers == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  for (round = 0; round < rounds; round++) {
+    alarm_wheel_init(&wheel, BENCH_EPOCH_S);
+    for (i = 0; i < count; i++) {
+      timers[i].expiry = BENCH_EPOCH_S + 1u + bench_random(span_s);
+    }
+
+    start = bench_now_ns();
+    for (i = 0; i < count; i++) {
+      alarm_wheel_insert(&wheel, &timers[i], timers[i].expiry, bench_fire, &bench);
+    }
+    insert_ns += bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (i = 0; i < count; i += 2u) {
+      alarm_wheel_cancel(&wheel, &timers[i]);
+    }
+    cancel_ns += bench_now_ns() - start;
+    for (i = 0; i < count; i += 2u) {
+      alarm_wheel_insert(&wheel, &timers[i], timers[i].expiry, bench_fire, &bench);
+    }
+
+    // A step back keeps every timer in the future
+    start = bench_now_ns();
+    alarm_wheel_step(&wheel, BENCH_EPOCH_S - BENCH_STEP_S);
+    step_ns += bench_now_ns() - start;
+
+    start = bench_now_ns();
+    while (alarm_wheel_next_expiry(&wheel, &next)) {
+      alarm_wheel_advance(&wheel, next);
+      alarms++;
+    }
+    expire_ns += bench_now_ns() - start;
+  }
+
+  printf("%u timers over %u s, %u rounds\n", count, span_s, rounds);
+  printf("insert  %8.1f ns per timer\n", insert_ns / ((double)rounds * count));
+  printf("cancel  %8.1f ns per timer\n", cancel_ns / ((double)rounds * ((count + 1u) / 2u)));
+  printf("step    %8.1f ns per timer\n", step_ns / ((double)rounds * count));
+  printf("expire  %8.1f ns per timer, %.1f alarms programmed per timer\n",
+         expire_ns / ((double)rounds * count),
+         (double)alarms / ((double)rounds * count));
+  printf("fired %u of %u, %u not at their expiry\n", bench.fired, rounds * count, bench.wrong);
+
+  // Re-armed at or before the current second, it must wait for the next call
+  alarm_wheel_init(&wheel, BENCH_EPOCH_S);
+  alarm_wheel_insert(&wheel, &rearm_timer, BENCH_EPOCH_S + 1u, bench_rearm, &rearm);
+  for (i = 1; i <= BENCH_REARM_CALLS; i++) {
+    if (alarm_wheel_advance(&wheel, BENCH_EPOCH_S + i) != 1u) {
+      rearm.wrong++;
+    }
+  }
+  alarm_wheel_cancel(&wheel, &rearm_timer);
+  printf("re-armed at now: fired %u in %u advance calls, %u calls not firing once\n",
+         rearm.fired,
+         BENCH_REARM_CALLS,
+         rearm.wrong);
+  free(timers);
+  return ((bench.fired != rounds * count) || (bench.wrong != 0) || (rearm.fired != BENCH_REARM_CALLS)
+          || (rearm.wrong != 0))
+         ? 1
+         : 0;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// xorshift64*, uniform in [0, span)
+static uint32_t bench_random(uint32_t span)
+{
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return (uint32_t)((rng * 0x2545F4914F6CDD1Dull) % span);
+}
+
+static double bench_now_ns(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+static void bench_fire(alarm_wheel_timer_t *timer, void *context)
+{
+  bench_t *bench = (bench_t *)context;
+
+  bench->fired++;
+  if (timer->expiry != bench->wheel->now) {
+    bench->wrong++;
+  }
+}
+
+static void bench_rearm(alarm_wheel_timer_t *timer, void *context)
+{
+  bench_t *bench = (bench_t *)context;
+
+  bench->fired++;
+  alarm_wheel_insert(bench->wheel, timer, bench->wheel->now, bench_rearm, bench);
+}
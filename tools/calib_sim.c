@@ -0,0 +1,291 @@
+/***************************************************************************/ /**
+ * @file calib_sim.c
+ * @brief Calibration energy against residual frequency error of calib_ctrl.c
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory:
+ *   cc -O2 -I.. -o calib_sim calib_sim.c ../calib_ctrl.c -lm
+ *
+ *   calib_sim [-d days] [-k tempco ppb/C] [-c calibration noise ppb]
+ *             [-p poll s] [-m sample noise ms] [-b budget ppb]
+ *             [-E RC calibration uJ] [-e RO calibration uJ] [-S seed]
+ *
+ * The calendar runs on the RO clock. Its frequency error follows temperature
+ * by -k since the last RO calibration, which leaves -c of noise. RC and RO
+ * are calibrated at the trigger periods of the calendar_app.c levels, each
+ * calibration costs -E or -e; the defaults are placeholders, replace them
+ * with board measurements like the *_CURRENT_NA figures in calendar_app.c.
+ *
+ * Every profile runs once per fixed level and once with calib_ctrl.c fed an
+ * NTP comparison every -p seconds with -m ms of noise, the way
+ * calendar_calibration_sample() does. Profiles:
+ *   still    constant temperature
+ *   daily    10 C day/night swing
+ *   moves    20 C steps over 10 min, every 3 h (carried in and out)
+ *   cycling  5 C swing every 30 min (HVAC)
+ * Printed per run: calibration energy per day, and the residual frequency
+ * error as rms, 99th percentile and share of time over -b.
+ ******************************************************************************/
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calib_ctrl.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define SIM_EPOCH_S       1700000000u
+#define SIM_INITIAL_LEVEL 4u     // calendar_app.c CALIBRATION_INITIAL_LEVEL
+#define SIM_MIN_BASELINE  3600u  // calendar_app.c CALIBRATION_MIN_BASELINE
+#define SIM_LEVELS        7u
+#define SIM_PROFILES      4u
+#define SIM_CONTROLLER    SIM_LEVELS // Run index of the controller after the fixed levels
+#define SIM_BINS          4096u      // Error histogram, 100 ppb bins
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef struct {
+  uint32_t rc_s; // 0 is on demand only
+  uint32_t ro_s;
+} sim_level_t;
+
+typedef struct {
+  double tempco_ppb;
+  double cal_noise_ppb;
+  double sample_noise_ms;
+  double rc_uj;
+  double ro_uj;
+  uint32_t poll_s;
+  uint32_t budget_ppb;
+  uint32_t days;
+} sim_config_t;
+
+typedef struct {
+  double energy_uj;
+  double square_sum;
+  uint32_t over;
+  uint32_t histogram[SIM_BINS];
+  uint8_t final_level;
+} sim_result_t;
+
+// calendar_app.c calibration_level[], trigger periods in seconds
+static const sim_level_t sim_level[SIM_LEVELS] = {
+  { 0, 0 }, { 240, 8 }, { 120, 4 }, { 60, 2 }, { 30, 1 }, { 15, 1 }, { 5, 1 },
+};
+static const char *const sim_profile[SIM_PROFILES] = { "still", "daily", "moves", "cycling" };
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static double sim_uniform(double span);
+static double sim_normal(void);
+static double sim_temperature(uint32_t profile, uint32_t second);
+static void sim_run(const sim_config_t *config, uint32_t profile, uint32_t run, sim_result_t *result);
+static uint32_t sim_percentile(const sim_result_t *result, uint32_t samples, uint32_t percent);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  sim_config_t config = { 2000.0, 500.0, 2.0, 10.0, 2.0, 300, 20000, 3 };
+  static sim_result_t result;
+  uint32_t profile;
+  uint32_t run;
+  int arg;
+
+  for (arg = 1; arg + 1 < argc; arg += 2) {
+    if (strcmp(argv[arg], "-d") == 0) {
+      config.days = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-k") == 0) {
+      config.tempco_ppb = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-c") == 0) {
+      config.cal_noise_ppb = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-p") == 0) {
+      config.poll_s = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-m") == 0) {
+      config.sample_noise_ms = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-b") == 0) {
+      config.budget_ppb = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-E") == 0) {
+      config.rc_uj = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-e") == 0) {
+      config.ro_uj = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-S") == 0) {
+      rng = strtoull(argv[arg + 1], NULL, 0) | 1u;
+    } else {
+      break;
+    }
+  }
+  if ((arg != argc) || (config.days == 0) || (config.poll_s == 0)) {
+    fprintf(stderr, "usage: see the file header of calib_sim.c\n");
+    return 2;
+  }
+
+  printf("%u days, %.0f ppb/C, %.0f ppb calibration noise, %u s polls, %.1f ms noise, %u ppb budget\n",
+         config.days,
+         config.tempco_ppb,
+         config.cal_noise_ppb,
+         config.poll_s,
+         config.sample_noise_ms,
+         config.budget_ppb);
+  printf("profile,calibration,energy_mj_day,rms_ppb,p99_ppb,over_budget\n");
+  for (profile = 0; profile < SIM_PROFILES; profile++) {
+    for (run = 0; run <= SIM_CONTROLLER; run++) {
+      sim_run(&config, profile, run, &result);
+      if (run == SIM_CONTROLLER) {
+        printf("%s,controller (ends at %u)", sim_profile[profile], result.final_level);
+      } else {
+        printf("%s,level %u", sim_profile[profile], run);
+      }
+      printf(",%.2f,%.0f,%u,%.4f\n",
+             result.energy_uj / 1000.0 / config.days,
+             sqrt(result.square_sum / (config.days * 86400.0)),
+             sim_percentile(&result, config.days * 86400u, 99),
+             (double)result.over / (config.days * 86400.0));
+    }
+  }
+  return 0;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// xorshift64*, uniform in [-span, span]
+static double sim_uniform(double span)
+{
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return span * (2.0 * (double)((rng * 0x2545F4914F6CDD1Dull) >> 11) / 9007199254740992.0 - 1.0);
+}
+
+// Box-Muller
+static double sim_normal(void)
+{
+  double u = (sim_uniform(0.5) + 0.5) + 1e-12;
+  double v = sim_uniform(0.5) + 0.5;
+
+  return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static double sim_temperature(uint32_t profile, uint32_t second)
+{
+  uint32_t in_cycle;
+
+  switch (profile) {
+    case 1:
+      return 25.0 + 10.0 * sin(2.0 * M_PI * second / 86400.0);
+    case 2:
+      // Out at 5 C for half of each 3 h, 10 min ramps both ways
+      in_cycle = second % 10800u;
+      if (in_cycle < 600u) {
+        return 25.0 - 20.0 * in_cycle / 600.0;
+      }
+      if (in_cycle < 5400u) {
+        return 5.0;
+      }
+      if (in_cycle < 6000u) {
+        return 5.0 + 20.0 * (in_cycle - 5400u) / 600.0;
+      }
+      return 25.0;
+    case 3:
+      return 25.0 + 2.5 * sin(2.0 * M_PI * second / 1800.0);
+    default:
+      return 25.0;
+  }
+}
+
+/*******************************************************************************
+ * One run at a fixed level, or with the controller for run SIM_CONTROLLER.
+ ******************************************************************************/
+static void sim_run(const sim_config_t *config, uint32_t profile, uint32_t run, sim_result_t *result)
+{
+  calib_ctrl_t ctrl;
+  calib_ctrl_action_t action;
+  uint8_t level = (run == SIM_CONTROLLER) ? SIM_INITIAL_LEVEL : (uint8_t)run;
+  double cal_temperature;
+  double residual_ppb;
+  double freq_ppb;
+  double phase_ns = 0.0;
+  double temperature;
+  uint32_t bin;
+  uint32_t s;
+  bool calibrate;
+
+  memset(result, 0, sizeof(*result));
+  calib_ctrl_init(&ctrl, config->budget_ppb, SIM_MIN_BASELINE, SIM_INITIAL_LEVEL, SIM_LEVELS - 1u);
+  cal_temperature = sim_temperature(profile, 0);
+  residual_ppb    = config->cal_noise_ppb * sim_normal();
+  result->energy_uj += config->rc_uj + config->ro_uj;
+
+  for (s = 0; s < config->days * 86400u; s++) {
+    temperature = sim_temperature(profile, s);
+    calibrate   = false;
+    if ((sim_level[level].rc_s != 0) && ((s % sim_level[level].rc_s) == 0)) {
+      result->energy_uj += config->rc_uj;
+    }
+    if ((sim_level[level].ro_s != 0) && ((s % sim_level[level].ro_s) == 0)) {
+      calibrate = true;
+    }
+
+    if ((run == SIM_CONTROLLER) && ((s % config->poll_s) == 0)) {
+      action = calib_ctrl_add_sample(&ctrl,
+                                     SIM_EPOCH_S + s,
+                                     (int32_t)lround(phase_ns / 1e6 + config->sample_noise_ms * sim_normal()));
+      if (action != CALIB_CTRL_KEEP) {
+        // calendar_apply_calibration() calibrates both at once
+        level = ctrl.level;
+        result->energy_uj += config->rc_uj;
+        calibrate = true;
+      }
+    }
+    if (calibrate) {
+      result->energy_uj += config->ro_uj;
+      cal_temperature = temperature;
+      residual_ppb    = config->cal_noise_ppb * sim_normal();
+    }
+
+    freq_ppb = residual_ppb + config->tempco_ppb * (temperature - cal_temperature);
+    phase_ns += freq_ppb;
+    result->square_sum += freq_ppb * freq_ppb;
+    if (fabs(freq_ppb) > config->budget_ppb) {
+      result->over++;
+    }
+    bin = (uint32_t)(fabs(freq_ppb) / 100.0);
+    result->histogram[(bin < SIM_BINS) ? bin : (SIM_BINS - 1u)]++;
+  }
+  result->final_level = level;
+}
+
+static uint32_t sim_percentile(const sim_result_t *result, uint32_t samples, uint32_t percent)
+{
+  uint64_t target = ((uint64_t)samples * percent) / 100u;
+  uint64_t seen   = 0;
+  uint32_t bin;
+
+  for (bin = 0; bin < SIM_BINS; bin++) {
+    seen += result->histogram[bin];
+    if (seen > target) {
+      break;
+    }
+  }
+  return (bin + 1u) * 100u;
+}
@@ -0,0 +1,499 @@
+/***************************************************************************/ /**
+ * @file dns_standin.c
+ * @brief Host DNS server with per family delays, and a resolution latency probe
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory:
+ *   cc -O2 -o dns_standin dns_standin.c -lm
+ *
+ *   dns_standin [-p port] [key=value ...]
+ *   dns_standin -Q address [-p port] [-n rounds] [-T timeout ms] [name]
+ *
+ * Answers every A and AAAA query, whatever the name, as configured by:
+ *   a=a.b.c.d       address of A answers, none for an empty answer
+ *   aaaa=x:y::z     address of AAAA answers, none for an empty answer
+ *   adelay=ms       delay of A answers
+ *   aaaadelay=ms    delay of AAAA answers
+ *   jitter=ms       scale of an exponential random part added to each delay
+ *   aloss=p         probability an A query is dropped
+ *   aaaaloss=p      probability an AAAA query is dropped
+ *   seed=n          random seed
+ * Point the DNS server of the access point, or its upstream, at the host to
+ * see how dns_race.c copes with a slow or missing family. Each query is
+ * logged to stdout with its type, delay and action.
+ *
+ * With -Q the program probes a DNS server instead, this one or a real
+ * resolver. Each of -n rounds resolves the name (pool.ntp.org by default) the
+ * way dns_race.c does, both queries at once, each waiting up to -T ms. For
+ * comparison it also sends AAAA and then A, one after the other. Printed are the
+ * percentiles of the time to the first usable address and to both answers,
+ * and the number of rounds in which no address was found.
+ ******************************************************************************/
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define STANDIN_DNS_PORT   53u
+#define STANDIN_PACKET_MAX 512u
+#define STANDIN_HEADER     12u
+#define STANDIN_PENDING    256u  // Answers held back for their delay
+#define STANDIN_TYPE_A     1u
+#define STANDIN_TYPE_AAAA  28u
+#define STANDIN_TTL_S      300u
+#define STANDIN_MODES      2u    // One after the other, and both at once as dns_race.c
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef struct {
+  bool have_a;
+  bool have_aaaa;
+  uint8_t a[4];
+  uint8_t aaaa[16];
+  double a_delay_ms;
+  double aaaa_delay_ms;
+  double jitter_ms;
+  double a_loss;
+  double aaaa_loss;
+} standin_params_t;
+
+typedef struct {
+  uint64_t send_us; // 0 for a free slot
+  struct sockaddr_in peer;
+  uint16_t length;
+  uint8_t packet[STANDIN_PACKET_MAX];
+} standin_answer_t;
+
+typedef struct {
+  uint32_t first_us; // Query start to the first usable address, 0 for none
+  uint32_t both_us;  // Query start to the second answer or timeout
+} standin_probe_t;
+
+static standin_params_t params = { true, true, { 192, 0, 2, 1 }, { 0x20, 0x01, 0x0d, 0xb8, [15] = 1 },
+                                   0.0, 0.0, 0.0, 0.0, 0.0 };
+static standin_answer_t pending[STANDIN_PENDING];
+static const char *const mode_name[STANDIN_MODES] = { "sequential", "concurrent" };
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static uint64_t standin_now_us(void);
+static double standin_random(void);
+static bool standin_apply(const char *assignment);
+static size_t standin_question_end(const uint8_t *packet, size_t length);
+static void standin_query(const uint8_t *packet, size_t length, const struct sockaddr_in *peer, uint32_t number);
+static int standin_serve(uint16_t port);
+static size_t standin_encode_query(const char *name, uint16_t id, uint16_t type, uint8_t *packet);
+static bool standin_usable(const uint8_t *packet, ssize_t length);
+static void standin_probe_round(int sock, const struct sockaddr_in *server, const char *name, uint32_t round,
+                                bool concurrent, uint32_t timeout_ms, standin_probe_t *probe);
+static int standin_compare_u32(const void *a, const void *b);
+static int standin_probe(const char *target, uint16_t port, const char *name, uint32_t rounds, uint32_t timeout_ms);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  uint16_t port       = STANDIN_DNS_PORT;
+  const char *target  = NULL;
+  const char *name    = "pool.ntp.org";
+  uint32_t rounds     = 100;
+  uint32_t timeout_ms = 2000;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "-p") == 0) && (i + 1 < argc)) {
+      port = (uint16_t)strtoul(argv[++i], NULL, 0);
+    } else if ((strcmp(argv[i], "-Q") == 0) && (i + 1 < argc)) {
+      target = argv[++i];
+    } else if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) {
+      rounds = (uint32_t)strtoul(argv[++i], NULL, 0);
+    } else if ((strcmp(argv[i], "-T") == 0) && (i + 1 < argc)) {
+      timeout_ms = (uint32_t)strtoul(argv[++i], NULL, 0);
+    } else if ((target != NULL) && (strchr(argv[i], '=') == NULL)) {
+      name = argv[i];
+    } else if (!standin_apply(argv[i])) {
+      fprintf(stderr, "usage: see the file header of dns_standin.c, bad argument %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (target != NULL) {
+    return standin_probe(target, port, name, rounds, timeout_ms);
+  }
+  return standin_serve(port);
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static uint64_t standin_now_us(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+// xorshift64*, uniform in (0, 1)
+static double standin_random(void)
+{
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return ((double)((rng * 0x2545F4914F6CDD1Dull) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static bool standin_apply(const char *assignment)
+{
+  const char *value = strchr(assignment, '=');
+  size_t key_length;
+
+  if (value == NULL) {
+    return false;
+  }
+  key_length = (size_t)(value - assignment);
+  value++;
+  if ((key_length == 1) && (strncmp(assignment, "a", 1) == 0)) {
+    params.have_a = (strcmp(value, "none") != 0);
+    return !params.have_a || (inet_pton(AF_INET, value, params.a) == 1);
+  }
+  if ((key_length == 4) && (strncmp(assignment, "aaaa", 4) == 0)) {
+    params.have_aaaa = (strcmp(value, "none") != 0);
+    return !params.have_aaaa || (inet_pton(AF_INET6, value, params.aaaa) == 1);
+  }
+  if ((key_length == 6) && (strncmp(assignment, "adelay", 6) == 0)) {
+    params.a_delay_ms = atof(value);
+  } else if ((key_length == 9) && (strncmp(assignment, "aaaadelay", 9) == 0)) {
+    params.aaaa_delay_ms = atof(value);
+  } else if ((key_length == 6) && (strncmp(assignment, "jitter", 6) == 0)) {
+    params.jitter_ms = atof(value);
+  } else if ((key_length == 5) && (strncmp(assignment, "aloss", 5) == 0)) {
+    params.a_loss = atof(value);
+  } else if ((key_length == 8) && (strncmp(assignment, "aaaaloss", 8) == 0)) {
+    params.aaaa_loss = atof(value);
+  } else if ((key_length == 4) && (strncmp(assignment, "seed", 4) == 0)) {
+    rng = strtoull(value, NULL, 0) | 1u;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Offset after QNAME, QTYPE and QCLASS of the only question, 0 if malformed
+static size_t standin_question_end(const uint8_t *packet, size_t length)
+{
+  size_t offset = STANDIN_HEADER;
+
+  while ((offset < length) && (packet[offset] != 0)) {
+    if ((packet[offset] & 0xC0u) != 0) {
+      return 0;
+    }
+    offset += packet[offset] + 1u;
+  }
+  offset += 1u + 4u;
+  return (offset <= length) ? offset : 0;
+}
+
+static void standin_query(const uint8_t *packet, size_t length, const struct sockaddr_in *peer, uint32_t number)
+{
+  standin_answer_t *answer = NULL;
+  size_t end               = standin_question_end(packet, length);
+  uint16_t type;
+  bool is_aaaa;
+  bool have;
+  double delay_ms;
+  uint32_t i;
+
+  if ((end == 0) || ((packet[2] & 0x80u) != 0) || (packet[4] != 0) || (packet[5] != 1)) {
+    return;
+  }
+  type = (uint16_t)((packet[end - 4u] << 8) | packet[end - 3u]);
+  if ((type != STANDIN_TYPE_A) && (type != STANDIN_TYPE_AAAA)) {
+    printf("%u type %u ignored\n", number, type);
+    return;
+  }
+  is_aaaa = (type == STANDIN_TYPE_AAAA);
+  if (standin_random() < (is_aaaa ? params.aaaa_loss : params.a_loss)) {
+    printf("%u %s dropped\n", number, is_aaaa ? "AAAA" : "A");
+    return;
+  }
+  for (i = 0; i < STANDIN_PENDING; i++) {
+    if (pending[i].send_us == 0) {
+      answer = &pending[i];
+      break;
+    }
+  }
+  if (answer == NULL) {
+    printf("%u %s dropped, too many pending\n", number, is_aaaa ? "AAAA" : "A");
+    return;
+  }
+
+  have = is_aaaa ? params.have_aaaa : params.have_a;
+  memcpy(answer->packet, packet, end);
+  answer->packet[2] = 0x81u; // Response, recursion desired
+  answer->packet[3] = 0x80u; // Recursion available, no error
+  answer->packet[6] = 0;
+  answer->packet[7] = have ? 1u : 0u;
+  memset(&answer->packet[8], 0, 4u);
+  answer->length = (uint16_t)end;
+  if (have) {
+    static const uint8_t pointer[2] = { 0xC0u, STANDIN_HEADER };
+    uint8_t *record = &answer->packet[end];
+
+    memcpy(record, pointer, sizeof(pointer));
+    record[2]  = (uint8_t)(type >> 8);
+    record[3]  = (uint8_t)type;
+    record[4]  = 0;
+    record[5]  = 1; // IN
+    record[6]  = 0;
+    record[7]  = 0;
+    record[8]  = (uint8_t)(STANDIN_TTL_S >> 8);
+    record[9]  = (uint8_t)STANDIN_TTL_S;
+    record[10] = 0;
+    record[11] = is_aaaa ? 16u : 4u;
+    memcpy(&record[12], is_aaaa ? params.aaaa : params.a, record[11]);
+    answer->length = (uint16_t)(end + 12u + record[11]);
+  }
+  delay_ms        = (is_aaaa ? params.aaaa_delay_ms : params.a_delay_ms) - log(standin_random()) * params.jitter_ms;
+  answer->peer    = *peer;
+  answer->send_us = standin_now_us() + (uint64_t)llround(delay_ms * 1000.0);
+  printf("%u %s %s after %.1f ms\n", number, is_aaaa ? "AAAA" : "A", have ? "answer" : "empty", delay_ms);
+  fflush(stdout);
+}
+
+static int standin_serve(uint16_t port)
+{
+  struct sockaddr_in local = { 0 };
+  struct sockaddr_in peer;
+  socklen_t peer_length;
+  struct pollfd descriptor;
+  uint8_t buffer[STANDIN_PACKET_MAX];
+  uint32_t queries = 0;
+  uint64_t next_us;
+  uint64_t now;
+  ssize_t length;
+  uint32_t i;
+  int sock;
+
+  sock                  = socket(AF_INET, SOCK_DGRAM, 0);
+  local.sin_family      = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port        = htons(port);
+  if ((sock < 0) || (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0)) {
+    perror("bind");
+    return 1;
+  }
+  fprintf(stderr, "DNS stand-in on UDP port %u\n", port);
+
+  descriptor.fd     = sock;
+  descriptor.events = POLLIN;
+  while (1) {
+    now     = standin_now_us();
+    next_us = now + 1000000u;
+    for (i = 0; i < STANDIN_PENDING; i++) {
+      if (pending[i].send_us == 0) {
+        continue;
+      }
+      if (pending[i].send_us <= now) {
+        sendto(sock, pending[i].packet, pending[i].length, 0, (struct sockaddr *)&pending[i].peer,
+               sizeof(pending[i].peer));
+        pending[i].send_us = 0;
+      } else if (pending[i].send_us < next_us) {
+        next_us = pending[i].send_us;
+      }
+    }
+    if (poll(&descriptor, 1, (int)((next_us - now + 999u) / 1000u)) <= 0) {
+      continue;
+    }
+    peer_length = sizeof(peer);
+    length      = recvfrom(sock, buffer, sizeof(buffer), 0, (struct sockaddr *)&peer, &peer_length);
+    if (length > (ssize_t)STANDIN_HEADER) {
+      standin_query(buffer, (size_t)length, &peer, ++queries);
+    }
+  }
+  return 0;
+}
+
+static size_t standin_encode_query(const char *name, uint16_t id, uint16_t type, uint8_t *packet)
+{
+  size_t offset = STANDIN_HEADER;
+  const char *dot;
+  size_t label;
+
+  memset(packet, 0, STANDIN_HEADER);
+  packet[0] = (uint8_t)(id >> 8);
+  packet[1] = (uint8_t)id;
+  packet[2] = 0x01u; // Recursion desired
+  packet[5] = 1;     // One question
+  while (*name != '\0') {
+    dot   = strchr(name, '.');
+    label = (dot != NULL) ? (size_t)(dot - name) : strlen(name);
+    if ((label == 0) || (label > 63u) || (offset + label + 6u > STANDIN_PACKET_MAX)) {
+      return 0;
+    }
+    packet[offset++] = (uint8_t)label;
+    memcpy(&packet[offset], name, label);
+    offset += label;
+    name += label + ((dot != NULL) ? 1u : 0u);
+  }
+  packet[offset++] = 0;
+  packet[offset++] = (uint8_t)(type >> 8);
+  packet[offset++] = (uint8_t)type;
+  packet[offset++] = 0;
+  packet[offset++] = 1; // IN
+  return offset;
+}
+
+// A reply with no error and at least one answer record
+static bool standin_usable(const uint8_t *packet, ssize_t length)
+{
+  return (length > (ssize_t)STANDIN_HEADER) && ((packet[3] & 0x0Fu) == 0)
+         && (((packet[6] << 8) | packet[7]) != 0);
+}
+
+/*******************************************************************************
+ * One resolution. Sequential sends AAAA, waits for its answer or the timeout,
+ * then sends A. Concurrent sends both at once, as dns_race.c does.
+ ******************************************************************************/
+static void standin_probe_round(int sock, const struct sockaddr_in *server, const char *name, uint32_t round,
+                                bool concurrent, uint32_t timeout_ms, standin_probe_t *probe)
+{
+  static const uint16_t types[2] = { STANDIN_TYPE_AAAA, STANDIN_TYPE_A };
+  struct pollfd descriptor       = { sock, POLLIN, 0 };
+  uint8_t packet[STANDIN_PACKET_MAX];
+  uint64_t start = standin_now_us();
+  uint64_t deadline_us;
+  uint64_t now;
+  bool answered[2] = { false, false };
+  uint16_t id[2];
+  uint16_t reply_id;
+  uint32_t next = 0;
+  uint32_t i;
+  ssize_t length;
+  size_t size;
+
+  probe->first_us = 0;
+  for (i = 0; i < 2u; i++) {
+    id[i] = (uint16_t)((round << 2) | (concurrent ? 2u : 0u) | i);
+  }
+  while (next < 2u) {
+    for (i = next; i < (concurrent ? 2u : next + 1u); i++) {
+      size = standin_encode_query(name, id[i], types[i], packet);
+      sendto(sock, packet, size, 0, (const struct sockaddr *)server, sizeof(*server));
+    }
+    deadline_us = standin_now_us() + (uint64_t)timeout_ms * 1000u;
+    while (!answered[next] || (concurrent && !answered[1])) {
+      now = standin_now_us();
+      if ((now >= deadline_us)
+          || (poll(&descriptor, 1, (int)((deadline_us - now + 999u) / 1000u)) <= 0)) {
+        break;
+      }
+      length = recv(sock, packet, sizeof(packet), 0);
+      if (length < (ssize_t)STANDIN_HEADER) {
+        continue;
+      }
+      reply_id = (uint16_t)((packet[0] << 8) | packet[1]);
+      for (i = 0; i < 2u; i++) {
+        if ((reply_id == id[i]) && !answered[i]) {
+          answered[i] = true;
+          if ((probe->first_us == 0) && standin_usable(packet, length)) {
+            probe->first_us = (uint32_t)(standin_now_us() - start);
+          }
+        }
+      }
+    }
+    next = concurrent ? 2u : (next + 1u);
+  }
+  probe->both_us = (uint32_t)(standin_now_us() - start);
+}
+
+static int standin_compare_u32(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static int standin_probe(const char *target, uint16_t port, const char *name, uint32_t rounds, uint32_t timeout_ms)
+{
+  struct sockaddr_in server = { 0 };
+  uint8_t packet[STANDIN_PACKET_MAX];
+  standin_probe_t probe;
+  uint32_t *first;
+  uint32_t *both;
+  uint32_t found;
+  uint32_t mode;
+  uint32_t round;
+  int sock;
+
+  server.sin_family = AF_INET;
+  server.sin_port   = htons(port);
+  first             = calloc(rounds, sizeof(first[0]));
+  both              = calloc(rounds, sizeof(both[0]));
+  sock              = socket(AF_INET, SOCK_DGRAM, 0);
+  if ((rounds == 0) || (inet_pton(AF_INET, target, &server.sin_addr) != 1) || (first == NULL) || (both == NULL)
+      || (sock < 0) || (standin_encode_query(name, 0, STANDIN_TYPE_A, packet) == 0)) {
+    fprintf(stderr, "usage: see the file header of dns_standin.c\n");
+    return 2;
+  }
+
+  printf("%u rounds of %s at %s:%u, %u ms per query\n", rounds, name, target, port, timeout_ms);
+  printf("mode,found,first_p50_ms,first_p90_ms,first_max_ms,both_p50_ms,both_p90_ms,both_max_ms\n");
+  for (mode = 0; mode < STANDIN_MODES; mode++) {
+    found = 0;
+    for (round = 0; round < rounds; round++) {
+      standin_probe_round(sock, &server, name, round, mode != 0, timeout_ms, &probe);
+      both[round] = probe.both_us;
+      if (probe.first_us != 0) {
+        first[found++] = probe.first_us;
+      }
+    }
+    qsort(first, found, sizeof(first[0]), standin_compare_u32);
+    qsort(both, rounds, sizeof(both[0]), standin_compare_u32);
+    if (found == 0) {
+      printf("%s,0,,,", mode_name[mode]);
+    } else {
+      printf("%s,%u,%.1f,%.1f,%.1f",
+             mode_name[mode],
+             found,
+             first[found / 2u] / 1000.0,
+             first[(found * 9u) / 10u] / 1000.0,
+             first[found - 1u] / 1000.0);
+    }
+    printf(",%.1f,%.1f,%.1f\n",
+           both[rounds / 2u] / 1000.0,
+           both[(rounds * 9u) / 10u] / 1000.0,
+           both[rounds - 1u] / 1000.0);
+  }
+  close(sock);
+  free(first);
+  free(both);
+  return 0;
+}
@@ -0,0 +1,247 @@
+/***************************************************************************/ /**
+ * @file duty_sim.c
+ * @brief Radio on time and charge of SNTP_DUTY_CYCLE against always connected
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory:
+ *   cc -O2 -I.. -o duty_sim duty_sim.c ../sync_plan.c -lm
+ *
+ *   duty_sim [-d days] [-f frequency ppm] [-t temperature ppm] [-w wander ppb]
+ *            [-m sample noise ms] [-b budget us] [-j join ms]
+ *            [-I radio on mA] [-s sleep uA] [-c connected mA] [-S seed]
+ *
+ * The sync windows of sntp_app.c with SNTP_DUTY_CYCLE are planned by
+ * sync_plan.c, fed the filtered burst offset of each window with -m ms of
+ * noise. The oscillator has a frequency error of -f, plus per profile:
+ *   still    nothing else
+ *   daily    a daily temperature swing of -t
+ *   wander   a random walk of -w per hour
+ * A window is on for the directed join of -j plus the burst of sntp_app.c,
+ * SNTP_BURST_COUNT requests SNTP_BURST_SPACING apart. The budget, poll range
+ * and burst default to the sntp_app.c settings.
+ *
+ * Printed per profile: windows per day, radio on seconds per day as
+ * sync_plan_radio_s_per_day() projects them against the 86400 of the always
+ * connected mode, the average current of both modes, and the error of the
+ * offset predicted at each window, which the calendar built up in the gap:
+ * 99th percentile, largest and share of windows over -b. The currents are
+ * placeholders like the *_CURRENT_NA figures in calendar_app.c, replace them
+ * with board measurements.
+ ******************************************************************************/
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sync_plan.h"
+#include "time_types.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define SIM_MIN_POLL      6u     // sntp_app.c SNTP_MIN_POLL
+#define SIM_MAX_POLL      12u    // sntp_app.c SNTP_MAX_POLL
+#define SIM_BURST_COUNT   6u     // sntp_app.c SNTP_BURST_COUNT
+#define SIM_BURST_SPACING 2000u  // sntp_app.c SNTP_BURST_SPACING, ms
+#define SIM_ROUND_TRIP_MS 50u    // Last reply of the burst
+#define SIM_STEP_S        10u    // Oscillator integration step
+#define SIM_PROFILES      3u
+#define SIM_WINDOWS_MAX   100000u
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef struct {
+  uint32_t days;
+  double freq_ppm;
+  double temperature_ppm;
+  double wander_ppb;
+  double noise_ms;
+  uint32_t budget_us;
+  uint32_t join_ms;
+  double on_ma;
+  double sleep_ua;
+  double connected_ma;
+} sim_config_t;
+
+static const char *const sim_profile[SIM_PROFILES] = { "still", "daily", "wander" };
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static double sim_uniform(void);
+static double sim_normal(void);
+static int sim_compare(const void *a, const void *b);
+static void sim_run(const sim_config_t *config, uint32_t profile, uint32_t *errors, uint32_t *count,
+                    sync_plan_t *plan);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  sim_config_t config = { 7, 20.0, 10.0, 20.0, 1.0, 50000, 1000, 70.0, 15.0, 1.5 };
+  static uint32_t errors[SIM_WINDOWS_MAX];
+  sync_plan_t plan;
+  uint32_t radio_s;
+  uint32_t profile;
+  uint32_t count;
+  uint32_t over;
+  uint32_t i;
+  int arg;
+
+  for (arg = 1; arg + 1 < argc; arg += 2) {
+    if (strcmp(argv[arg], "-d") == 0) {
+      config.days = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-f") == 0) {
+      config.freq_ppm = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-t") == 0) {
+      config.temperature_ppm = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-w") == 0) {
+      config.wander_ppb = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-m") == 0) {
+      config.noise_ms = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-b") == 0) {
+      config.budget_us = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-j") == 0) {
+      config.join_ms = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-I") == 0) {
+      config.on_ma = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-s") == 0) {
+      config.sleep_ua = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-c") == 0) {
+      config.connected_ma = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-S") == 0) {
+      rng = strtoull(argv[arg + 1], NULL, 0) | 1u;
+    } else {
+      break;
+    }
+  }
+  if ((arg != argc) || (config.days == 0) || (config.days > 365u) || (config.budget_us == 0)) {
+    fprintf(stderr, "usage: see the file header of duty_sim.c\n");
+    return 2;
+  }
+
+  printf("%u days, %.1f ppm, %.1f ppm daily swing, %.0f ppb/h wander, %.1f ms noise, %u us budget, %u ms join\n",
+         config.days,
+         config.freq_ppm,
+         config.temperature_ppm,
+         config.wander_ppb,
+         config.noise_ms,
+         config.budget_us,
+         config.join_ms);
+  printf("profile,windows_day,radio_s_day,connected_s_day,duty_ma,connected_ma,p99_error_us,max_error_us,"
+         "over_budget\n");
+  for (profile = 0; profile < SIM_PROFILES; profile++) {
+    sim_run(&config, profile, errors, &count, &plan);
+    radio_s = sync_plan_radio_s_per_day(&plan);
+    over    = 0;
+    for (i = 0; i < count; i++) {
+      over += (errors[i] > config.budget_us) ? 1u : 0u;
+    }
+    qsort(errors, count, sizeof(errors[0]), sim_compare);
+    printf("%s,%.1f,%u,%u,%.3f,%.3f,%u,%u,%.4f\n",
+           sim_profile[profile],
+           (double)plan.windows / config.days,
+           radio_s,
+           SYNC_PLAN_SECONDS_DAY,
+           (radio_s * config.on_ma + (SYNC_PLAN_SECONDS_DAY - radio_s) * config.sleep_ua / 1000.0)
+             / SYNC_PLAN_SECONDS_DAY,
+           config.connected_ma,
+           (count != 0) ? errors[(count * 99u) / 100u] : 0u,
+           (count != 0) ? errors[count - 1u] : 0u,
+           (count != 0) ? (double)over / count : 0.0);
+  }
+  return 0;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// xorshift64*, uniform in (0, 1)
+static double sim_uniform(void)
+{
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return ((double)((rng * 0x2545F4914F6CDD1Dull) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+// Box-Muller
+static double sim_normal(void)
+{
+  return sqrt(-2.0 * log(sim_uniform())) * cos(2.0 * M_PI * sim_uniform());
+}
+
+static int sim_compare(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+/*******************************************************************************
+ * One profile. The local clock is the free running oscillator, sync_plan.c
+ * sees it that way too: sntp_app.c adds the calendar correction back.
+ ******************************************************************************/
+static void sim_run(const sim_config_t *config, uint32_t profile, uint32_t *errors, uint32_t *count,
+                    sync_plan_t *plan)
+{
+  uint32_t on_ms     = config->join_ms + (SIM_BURST_COUNT - 1u) * SIM_BURST_SPACING + SIM_ROUND_TRIP_MS;
+  uint64_t end_s     = (uint64_t)config->days * SYNC_PLAN_SECONDS_DAY;
+  uint64_t now_s     = 0;
+  double phase_us    = 0.0; // Local minus true time
+  double wander_ppb  = 0.0;
+  double freq_ppb;
+  int64_t offset_us;
+  int64_t predicted_us;
+  uint64_t local_us;
+  uint64_t gap_s;
+  uint32_t interval_s;
+  uint32_t s;
+
+  *count = 0;
+  sync_plan_init(plan, config->budget_us, SIM_MIN_POLL, SIM_MAX_POLL);
+  while (now_s < end_s) {
+    local_us  = now_s * 1000000u + (uint64_t)llround(phase_us);
+    offset_us = llround(-phase_us + config->noise_ms * 1000.0 * sim_normal());
+    // What the calendar drifted to since the last window, as sync_plan.c sees it
+    if (plan->have_last && (*count < SIM_WINDOWS_MAX)) {
+      predicted_us = plan->last_offset_us;
+      if (plan->have_freq) {
+        predicted_us += time_scale_ppb((int64_t)(local_us - plan->last_local_us), plan->freq_ppb);
+      }
+      errors[(*count)++] = (uint32_t)llabs(offset_us - predicted_us);
+    }
+    interval_s = sync_plan_update(plan, local_us, offset_us);
+    sync_plan_account(plan, on_ms, on_ms / 1000u + interval_s);
+
+    gap_s = on_ms / 1000u + interval_s;
+    for (s = 0; s < gap_s; s += SIM_STEP_S) {
+      freq_ppb = config->freq_ppm * 1000.0;
+      if (profile == 1) {
+        freq_ppb += config->temperature_ppm * 1000.0 * sin(2.0 * M_PI * (double)(now_s + s) / 86400.0);
+      } else if (profile == 2) {
+        wander_ppb += config->wander_ppb * sqrt(SIM_STEP_S / 3600.0) * sim_normal();
+        freq_ppb += wander_ppb;
+      }
+      phase_us += freq_ppb * ((gap_s - s < SIM_STEP_S) ? (double)(gap_s - s) : SIM_STEP_S) / 1000.0;
+    }
+    now_s += gap_s;
+  }
+}
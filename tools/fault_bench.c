@@ -0,0 +1,521 @@
+/***************************************************************************/ /**
+ * @file fault_bench.c
+ * @brief Recovery latency of the embedded SNTP client flow under injected faults
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory:
+ *   cc -O2 -I.. -o fault_bench fault_bench.c ../sntp_request.c
+ *
+ *   fault_bench [-d days] [-p poll s] [-w callback timeout ms] [-D drain ms]
+ *               [-L latest late callback ms] [-P fault probability] [-f faults]
+ *               [-S seed] [-u]
+ *
+ * The SDK calls the embedded client path of sntp_app.c makes are faked on a
+ * simulated millisecond clock: sl_sntp_client_get_time() queues its callback
+ * on a schedule drawn from the seed, sl_net_up() fails while an injected
+ * outage lasts. Each request may get one fault, -f picks them by letter:
+ *   l late       the callback comes up to -L ms after the client gave up
+ *   d duplicate  the callback comes twice, the copy up to 5 s later
+ *   o order      a failed callback of another event follows the real one
+ *   m missing    no callback
+ *   n network    the link is down for 10 to 120 s, sl_net_up() fails meanwhile
+ * The client follows sntp_app.c: a burst of SNTP_BURST_COUNT requests at boot
+ * and after SNTP_BURST_AFTER_FAILURES failed polls, one request per poll
+ * otherwise, a rejoin every LINK_REJOIN_WAIT ms while the link is down. Its
+ * callbacks go through sntp_request_complete(). With -u they set the global
+ * event, status and buffer the way sntp_app.c did before sntp_request.h.
+ *
+ * A sample is valid if the server time it carries was read within its own
+ * round trip. Per fault type the time from the faulted request to the next
+ * valid sample is printed, with the samples taken from the wrong reply.
+ * Late callbacks are only caught while -L stays within the drain time -D.
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sntp_request.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+// Subset of the SDK the embedded client path uses
+#define SL_STATUS_OK          0x0000u
+#define SL_STATUS_FAIL        0x0001u
+#define SL_STATUS_IN_PROGRESS 0x0005u
+#define SL_STATUS_TIMEOUT     0x0007u
+
+#define BENCH_NTP_EPOCH_SEC    2208988800u // sntp_app.c TIME_NTP_EPOCH_SEC
+#define BENCH_UNIX_START       1700000000u // Server time at simulation start
+#define BENCH_BURST_COUNT      6u          // sntp_app.c SNTP_BURST_COUNT
+#define BENCH_BURST_SPACING    2000u       // sntp_app.c SNTP_BURST_SPACING
+#define BENCH_BURST_FAILURES   3u          // sntp_app.c SNTP_BURST_AFTER_FAILURES
+#define BENCH_REJOIN_WAIT      10000u      // sntp_app.c LINK_REJOIN_WAIT
+#define BENCH_CALLBACKS        64u         // Callbacks in flight
+#define BENCH_LATENCIES        4096u       // Recovery times kept per fault type
+#define BENCH_MAX_FAULTS       64u         // Faults waiting for a valid sample
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef enum {
+  SL_SNTP_CLIENT_START,
+  SL_SNTP_CLIENT_GET_TIME,
+  SL_SNTP_CLIENT_GET_TIME_DATE,
+  SL_SNTP_CLIENT_GET_SERVER_INFO,
+  SL_SNTP_CLIENT_STOP,
+} sl_sntp_client_event_t;
+
+typedef uint32_t sl_status_t;
+
+typedef struct {
+  uint8_t event_type;
+  sl_status_t status;
+  uint8_t *data;
+  uint32_t data_length;
+} sl_sntp_client_response_t;
+
+typedef enum {
+  FAULT_LATE = 0,
+  FAULT_DUPLICATE,
+  FAULT_ORDER,
+  FAULT_MISSING,
+  FAULT_NETWORK,
+  FAULT_TYPES,
+} bench_fault_t;
+
+typedef struct {
+  uint32_t due_ms;
+  uint8_t event;
+  sl_status_t status;
+  char data[SNTP_REQUEST_DATA_LENGTH];
+} bench_callback_t;
+
+typedef struct {
+  uint32_t injected;
+  uint32_t recovered;
+  uint32_t corrupt; // Wrong samples taken while this fault was the latest
+  uint32_t count;
+  uint32_t latency_ms[BENCH_LATENCIES];
+} bench_result_t;
+
+typedef struct {
+  uint8_t type;
+  uint32_t at_ms;
+} bench_open_fault_t;
+
+static const char fault_letter[FAULT_TYPES]      = { 'l', 'd', 'o', 'm', 'n' };
+static const char *const fault_name[FAULT_TYPES] = { "late", "duplicate", "order", "missing", "network" };
+
+static uint32_t now_ms = 0;
+static uint64_t rng    = 0x9E3779B97F4A7C15ull;
+static double fault_p  = 0.2;
+static bool fault_on[FAULT_TYPES] = { true, true, true, true, true };
+static uint32_t callback_timeout_ms = 60000; // sntp_app.c ASYNC_WAIT_TIMEOUT
+static uint32_t drain_ms            = 30000; // sntp_app.c SNTP_CALLBACK_DRAIN
+static uint32_t late_ms             = 30000;
+static bool legacy                  = false;
+
+static bench_callback_t queue[BENCH_CALLBACKS];
+static uint32_t queue_count = 0;
+static uint32_t link_down_until = 0;
+static bool link_down           = false;
+static bench_open_fault_t open_fault[BENCH_MAX_FAULTS];
+static uint32_t open_count = 0;
+static int8_t last_fault   = -1;
+static bench_result_t result[FAULT_TYPES];
+static uint32_t samples = 0;
+static uint32_t corrupt = 0;
+
+// Client side, sntp_app.c
+static sntp_request_t request;
+static volatile uint8_t callback_event = 0xFF;  // Before sntp_request.h
+static volatile sl_status_t cb_status  = SL_STATUS_FAIL;
+static uint8_t legacy_data[SNTP_REQUEST_DATA_LENGTH];
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static uint32_t bench_random(uint32_t range);
+static void bench_schedule(uint32_t due_ms, uint8_t event, sl_status_t status, uint32_t server_ms);
+static void bench_run_until(uint32_t until_ms, bool (*done)(void));
+static bool bench_request_done(void);
+static bool bench_never(void);
+static sl_status_t sl_sntp_client_get_time(uint8_t *data, uint16_t data_length, uint32_t timeout);
+static sl_status_t sl_net_up(void);
+static void sntp_client_event_handler(sl_sntp_client_response_t *response, uint8_t *user_data, uint16_t user_data_length);
+static sl_status_t bench_take_sample(void);
+static void bench_valid_sample(void);
+static int bench_compare(const void *a, const void *b);
+static void bench_report(uint32_t days);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  uint32_t days   = 2;
+  uint32_t poll_s = 300;
+  uint32_t end_ms;
+  uint32_t failed = BENCH_BURST_FAILURES;
+  uint32_t count;
+  uint32_t replies;
+  uint32_t i;
+  int arg;
+
+  for (arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "-u") == 0) {
+      legacy = true;
+      continue;
+    }
+    if (arg + 1 >= argc) {
+      fprintf(stderr, "usage: see the file header of fault_bench.c\n");
+      return 2;
+    }
+    if (strcmp(argv[arg], "-d") == 0) {
+      days = (uint32_t)strtoul(argv[++arg], NULL, 0);
+    } else if (strcmp(argv[arg], "-p") == 0) {
+      poll_s = (uint32_t)strtoul(argv[++arg], NULL, 0);
+    } else if (strcmp(argv[arg], "-w") == 0) {
+      callback_timeout_ms = (uint32_t)strtoul(argv[++arg], NULL, 0);
+    } else if (strcmp(argv[arg], "-D") == 0) {
+      drain_ms = (uint32_t)strtoul(argv[++arg], NULL, 0);
+    } else if (strcmp(argv[arg], "-L") == 0) {
+      late_ms = (uint32_t)strtoul(argv[++arg], NULL, 0);
+    } else if (strcmp(argv[arg], "-P") == 0) {
+      fault_p = atof(argv[++arg]);
+    } else if (strcmp(argv[arg], "-f") == 0) {
+      arg++;
+      for (i = 0; i < FAULT_TYPES; i++) {
+        fault_on[i] = (strchr(argv[arg], fault_letter[i]) != NULL);
+      }
+    } else if (strcmp(argv[arg], "-S") == 0) {
+      rng = strtoull(argv[++arg], NULL, 0) | 1u;
+    } else {
+      fprintf(stderr, "usage: see the file header of fault_bench.c\n");
+      return 2;
+    }
+  }
+  if (days > 40u) {
+    days = 40u; // The millisecond clock is 32 bits
+  }
+  end_ms = days * 86400000u;
+  sntp_request_init(&request);
+
+  // The poll loop of embedded_sntp_client()
+  while (now_ms < end_ms) {
+    if (link_down) {
+      // sntp_wait_link(): the module does not come back on its own here
+      bench_run_until(now_ms + BENCH_REJOIN_WAIT, bench_never);
+      link_down = (sl_net_up() != SL_STATUS_OK);
+      continue;
+    }
+    count   = (failed >= BENCH_BURST_FAILURES) ? BENCH_BURST_COUNT : 1u;
+    replies = 0;
+    for (i = 0; i < count; i++) {
+      if (i != 0) {
+        bench_run_until(now_ms + BENCH_BURST_SPACING, bench_never);
+      }
+      if (!link_down && (bench_take_sample() == SL_STATUS_OK)) {
+        replies++;
+      }
+    }
+    failed = (replies != 0) ? 0u : failed + 1u;
+    bench_run_until(now_ms + poll_s * 1000u, bench_never);
+  }
+  bench_report(days);
+  return 0;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// xorshift64*, uniform in [0, range)
+static uint32_t bench_random(uint32_t range)
+{
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return (uint32_t)(((rng * 0x2545F4914F6CDD1Dull) >> 32) % range);
+}
+
+// server_ms is the simulated time the server read its clock
+static void bench_schedule(uint32_t due_ms, uint8_t event, sl_status_t status, uint32_t server_ms)
+{
+  bench_callback_t *callback;
+  uint32_t i;
+
+  if (queue_count >= BENCH_CALLBACKS) {
+    return;
+  }
+  // Sorted on due time, equal times keep their order
+  for (i = queue_count; (i != 0) && (queue[i - 1u].due_ms > due_ms); i--) {
+    queue[i] = queue[i - 1u];
+  }
+  callback         = &queue[i];
+  callback->due_ms = due_ms;
+  callback->event  = event;
+  callback->status = status;
+  snprintf(callback->data,
+           sizeof(callback->data),
+           "Time: %lu. sec.",
+           (unsigned long)(BENCH_NTP_EPOCH_SEC + BENCH_UNIX_START + server_ms / 1000u));
+  queue_count++;
+}
+
+// Advance simulated time, delivering callbacks as they fall due. Callbacks
+// due at the same millisecond all run before the client looks again.
+static void bench_run_until(uint32_t until_ms, bool (*done)(void))
+{
+  sl_sntp_client_response_t response;
+  bench_callback_t callback;
+  uint32_t due_ms;
+
+  while (!done()) {
+    if ((queue_count == 0) || (queue[0].due_ms > until_ms)) {
+      now_ms = until_ms;
+      return;
+    }
+    due_ms = queue[0].due_ms;
+    now_ms = (due_ms > now_ms) ? due_ms : now_ms;
+    while ((queue_count != 0) && (queue[0].due_ms == due_ms)) {
+      callback = queue[0];
+      memmove(&queue[0], &queue[1], (queue_count - 1u) * sizeof(queue[0]));
+      queue_count--;
+      response.event_type  = callback.event;
+      response.status      = callback.status;
+      response.data        = (uint8_t *)callback.data;
+      response.data_length = (uint32_t)strlen(callback.data) + 1u;
+      sntp_client_event_handler(&response, legacy ? legacy_data : request.data, SNTP_REQUEST_DATA_LENGTH);
+    }
+  }
+}
+
+static bool bench_request_done(void)
+{
+  if (legacy) {
+    return callback_event == SL_SNTP_CLIENT_GET_TIME;
+  }
+  return sntp_request_done(&request);
+}
+
+static bool bench_never(void)
+{
+  return false;
+}
+
+// Fake of the SDK call: the server reads its clock after a random path
+// delay, the callback is queued on the fault drawn for this request
+static sl_status_t sl_sntp_client_get_time(uint8_t *data, uint16_t data_length, uint32_t timeout)
+{
+  uint32_t path_ms   = 20u + bench_random(180u);
+  uint32_t server_ms = now_ms + path_ms / 2u;
+  uint8_t fault      = FAULT_TYPES;
+  uint8_t other;
+
+  (void)data;
+  (void)data_length;
+  (void)timeout;
+  if (link_down) {
+    return SL_STATUS_FAIL;
+  }
+  if (bench_random(1000000u) < (uint32_t)(fault_p * 1000000.0)) {
+    fault = (uint8_t)bench_random(FAULT_TYPES);
+    if (!fault_on[fault]) {
+      fault = FAULT_TYPES;
+    }
+  }
+  if (fault != FAULT_TYPES) {
+    last_fault = (int8_t)fault;
+    result[fault].injected++;
+    if (open_count < BENCH_MAX_FAULTS) {
+      open_fault[open_count].type  = fault;
+      open_fault[open_count].at_ms = now_ms;
+      open_count++;
+    }
+  }
+  switch (fault) {
+    case FAULT_LATE:
+      bench_schedule(now_ms + callback_timeout_ms + 1u + bench_random(late_ms),
+                     SL_SNTP_CLIENT_GET_TIME,
+                     SL_STATUS_OK,
+                     server_ms);
+      break;
+    case FAULT_DUPLICATE:
+      bench_schedule(now_ms + path_ms, SL_SNTP_CLIENT_GET_TIME, SL_STATUS_OK, server_ms);
+      bench_schedule(now_ms + path_ms + 100u + bench_random(5000u), SL_SNTP_CLIENT_GET_TIME, SL_STATUS_OK, server_ms);
+      break;
+    case FAULT_ORDER:
+      other = (uint8_t)bench_random(4u);
+      other = (other >= SL_SNTP_CLIENT_GET_TIME) ? other + 1u : other;
+      bench_schedule(now_ms + path_ms, SL_SNTP_CLIENT_GET_TIME, SL_STATUS_OK, server_ms);
+      bench_schedule(now_ms + path_ms, other, SL_STATUS_FAIL, server_ms);
+      break;
+    case FAULT_MISSING:
+      break;
+    case FAULT_NETWORK:
+      link_down       = true;
+      link_down_until = now_ms + 10000u + bench_random(110000u);
+      return SL_STATUS_FAIL;
+    default:
+      bench_schedule(now_ms + path_ms, SL_SNTP_CLIENT_GET_TIME, SL_STATUS_OK, server_ms);
+      break;
+  }
+  return SL_STATUS_IN_PROGRESS;
+}
+
+static sl_status_t sl_net_up(void)
+{
+  return (now_ms >= link_down_until) ? SL_STATUS_OK : SL_STATUS_FAIL;
+}
+
+static void sntp_client_event_handler(sl_sntp_client_response_t *response, uint8_t *user_data, uint16_t user_data_length)
+{
+  uint32_t length;
+
+  if (!legacy) {
+    sntp_request_complete(&request, response->event_type, response->status, response->data, response->data_length);
+    return;
+  }
+  // sntp_app.c before sntp_request.h: whatever comes last wins
+  if (response->status == SL_STATUS_OK) {
+    length = (response->data_length > user_data_length) ? user_data_length : response->data_length;
+    memcpy(user_data, response->data, length);
+  }
+  callback_event = response->event_type;
+  cb_status      = response->status;
+}
+
+// sntp_take_sample() of the embedded client
+static sl_status_t bench_take_sample(void)
+{
+  const char *text;
+  uint32_t t1;
+  uint32_t t4;
+  uint64_t server_ms;
+  sl_status_t status;
+
+  if (legacy) {
+    callback_event = 0xFF;
+    cb_status      = SL_STATUS_FAIL;
+    text           = (const char *)legacy_data;
+  } else {
+    while (!sntp_request_ready(&request, now_ms, drain_ms)) {
+      bench_run_until(now_ms + 100u, bench_never);
+    }
+    sntp_request_begin(&request, SL_SNTP_CLIENT_GET_TIME, now_ms);
+    text = (const char *)request.data;
+  }
+  t1     = now_ms;
+  status = sl_sntp_client_get_time(legacy ? legacy_data : request.data, SNTP_REQUEST_DATA_LENGTH, 0);
+  if (status != SL_STATUS_IN_PROGRESS) {
+    if (!legacy) {
+      sntp_request_end(&request);
+    }
+    return status;
+  }
+  bench_run_until(now_ms + callback_timeout_ms, bench_request_done);
+  if (!bench_request_done()) {
+    if (!legacy) {
+      sntp_request_abandon(&request, now_ms);
+    }
+    return SL_STATUS_TIMEOUT;
+  }
+  if ((legacy ? cb_status : request.status) != SL_STATUS_OK) {
+    return SL_STATUS_FAIL;
+  }
+  t4 = now_ms;
+
+  // "Time: <NTP seconds>. sec.", whole seconds read between t1 and t4
+  server_ms = (strtoull(text + 6, NULL, 10) - BENCH_NTP_EPOCH_SEC - BENCH_UNIX_START) * 1000u;
+  samples++;
+  if ((server_ms + 1000u <= t1) || (server_ms > t4)) {
+    corrupt++;
+    if (last_fault >= 0) {
+      result[last_fault].corrupt++;
+    }
+    return SL_STATUS_OK;
+  }
+  bench_valid_sample();
+  return SL_STATUS_OK;
+}
+
+// Every fault still open is recovered by this sample
+static void bench_valid_sample(void)
+{
+  bench_result_t *entry;
+  uint32_t i;
+
+  for (i = 0; i < open_count; i++) {
+    entry = &result[open_fault[i].type];
+    entry->recovered++;
+    if (entry->count < BENCH_LATENCIES) {
+      entry->latency_ms[entry->count++] = now_ms - open_fault[i].at_ms;
+    }
+  }
+  open_count = 0;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void bench_report(uint32_t days)
+{
+  bench_result_t *entry;
+  uint64_t sum;
+  uint32_t i;
+  uint32_t j;
+
+  printf("%s callbacks, %lu days, %lu samples, %lu from the wrong reply\n",
+         legacy ? "Global" : "Matched",
+         (unsigned long)days,
+         (unsigned long)samples,
+         (unsigned long)corrupt);
+  if (!legacy) {
+    printf("Dropped: %lu late, %lu duplicate, %lu unexpected, %lu timeouts, %lu drains expired\n",
+           (unsigned long)request.stats.late,
+           (unsigned long)request.stats.duplicate,
+           (unsigned long)request.stats.unexpected,
+           (unsigned long)request.stats.timeouts,
+           (unsigned long)request.stats.drain_expired);
+  }
+  printf("fault      injected recovered  wrong   mean_ms    p50_ms    p95_ms    max_ms\n");
+  for (i = 0; i < FAULT_TYPES; i++) {
+    entry = &result[i];
+    if (!fault_on[i]) {
+      continue;
+    }
+    sum = 0;
+    for (j = 0; j < entry->count; j++) {
+      sum += entry->latency_ms[j];
+    }
+    qsort(entry->latency_ms, entry->count, sizeof(entry->latency_ms[0]), bench_compare);
+    printf("%-10s %8lu %9lu %6lu %9lu %9lu %9lu %9lu\n",
+           fault_name[i],
+           (unsigned long)entry->injected,
+           (unsigned long)entry->recovered,
+           (unsigned long)entry->corrupt,
+           (unsigned long)((entry->count != 0) ? sum / entry->count : 0u),
+           (unsigned long)((entry->count != 0) ? entry->latency_ms[entry->count / 2u] : 0u),
+           (unsigned long)((entry->count != 0) ? entry->latency_ms[(entry->count * 95u) / 100u] : 0u),
+           (unsigned long)((entry->count != 0) ? entry->latency_ms[entry->count - 1u] : 0u));
+  }
+}
@@ -0,0 +1,296 @@
+/***************************************************************************/ /**
+ * @file filter_bench.c
+ * @brief Per-sample cost and offset noise of clock_filter.c under bufferbloat
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory:
+ *   cc -O2 -I.. -o filter_bench filter_bench.c ../clock_filter.c -lm
+ *
+ *   filter_bench [-n samples] [-p poll s] [-l delay ms] [-D drift ppm]
+ *                [-b benchmark samples] [-S seed]
+ *
+ * Each trace runs -n exchanges every -p seconds against a clock with a
+ * random phase and -D of drift. Each leg of the path takes -l plus a little
+ * jitter, and on top:
+ *   clean        nothing
+ *   asymmetric   20 ms more on the way back, all the time
+ *   retries      one leg in five, 50 to 300 ms of Wi-Fi retries
+ *   bufferbloat  queueing episodes of 5 to 30 exchanges, one in twenty
+ *                exchanges starts one, up to 500 ms on the uplink
+ * Per trace the error of every raw sample offset and of every filter update
+ * against the true offset when it was taken is printed: rms, 95th percentile
+ * and largest, in microseconds. Path asymmetry shifts every sample the same
+ * way, no filter can see it.
+ *
+ * Then clock_filter_add() is timed over -b samples of the bufferbloat trace,
+ * the mean cost per sample on this host is printed.
+ ******************************************************************************/
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "clock_filter.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define BENCH_EPOCH_US      1700000000000000ll
+#define BENCH_JITTER_US     500        // Per leg, always
+#define BENCH_PRECISION_US  20u        // Sample dispersion, sntp_app.c NTP_LOCAL_PRECISION_US
+#define BENCH_TRACES        4u
+#define BENCH_HISTORY       CLOCK_FILTER_STAGES
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef struct {
+  int64_t phase_us;   // Local minus true time at the start
+  int32_t drift_ppb;
+  uint32_t queue_left; // Exchanges left in the current queueing episode
+  uint32_t queue_us;
+  uint64_t local_us[BENCH_HISTORY];
+  int64_t offset_us[BENCH_HISTORY]; // True offset at local_us
+  uint8_t next;
+} trace_t;
+
+typedef struct {
+  uint32_t samples;
+  uint32_t poll_s;
+  uint32_t delay_us;
+  int32_t drift_ppb;
+  uint32_t bench;
+} bench_config_t;
+
+static const char *const trace_name[BENCH_TRACES] = { "clean", "asymmetric", "retries", "bufferbloat" };
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static uint32_t bench_random(uint32_t span);
+static int64_t bench_local_us(const trace_t *trace, int64_t true_us);
+static void bench_sample(const bench_config_t *config, trace_t *trace, uint32_t kind, uint32_t index, ntp_sample_t *sample);
+static bool bench_true_offset(const trace_t *trace, uint64_t local_us, int64_t *offset_us);
+static int bench_compare(const void *a, const void *b);
+static void bench_print(const char *name, const char *label, int64_t *errors, uint32_t count);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  bench_config_t config = { 10000, 64, 5000, 20000, 1000000 };
+  clock_filter_t filter;
+  ntp_sample_t sample;
+  ntp_sample_t *samples;
+  trace_t trace;
+  int64_t *raw;
+  int64_t *filtered;
+  int64_t true_offset_us = 0;
+  uint32_t updates;
+  uint32_t kind;
+  uint32_t i;
+  struct timespec start;
+  struct timespec end;
+  int arg;
+
+  for (arg = 1; arg + 1 < argc; arg += 2) {
+    if (strcmp(argv[arg], "-n") == 0) {
+      config.samples = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-p") == 0) {
+      config.poll_s = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-l") == 0) {
+      config.delay_us = (uint32_t)strtoul(argv[arg + 1], NULL, 0) * 1000u;
+    } else if (strcmp(argv[arg], "-D") == 0) {
+      config.drift_ppb = (int32_t)(atof(argv[arg + 1]) * 1000.0);
+    } else if (strcmp(argv[arg], "-b") == 0) {
+      config.bench = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-S") == 0) {
+      rng = strtoull(argv[arg + 1], NULL, 0) | 1u;
+    } else {
+      break;
+    }
+  }
+  if ((arg != argc) || (config.samples == 0) || (config.poll_s == 0) || (config.bench == 0)) {
+    fprintf(stderr, "usage: see the file header of filter_bench.c\n");
+    return 2;
+  }
+  raw      = calloc(config.samples, sizeof(raw[0]));
+  filtered = calloc(config.samples, sizeof(filtered[0]));
+  samples  = calloc(config.bench, sizeof(samples[0]));
+  if ((raw == NULL) || (filtered == NULL) || (samples == NULL)) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  printf("%u exchanges every %u s, %u ms path delay, %.1f ppm drift\n",
+         config.samples,
+         config.poll_s,
+         config.delay_us / 1000u,
+         config.drift_ppb / 1000.0);
+  printf("trace,offsets,count,rms_us,p95_us,max_us\n");
+  for (kind = 0; kind < BENCH_TRACES; kind++) {
+    memset(&trace, 0, sizeof(trace));
+    trace.phase_us  = (int64_t)bench_random(2000000u) - 1000000;
+    trace.drift_ppb = config.drift_ppb;
+    clock_filter_reset(&filter);
+    updates = 0;
+    for (i = 0; i < config.samples; i++) {
+      bench_sample(&config, &trace, kind, i, &sample);
+      bench_true_offset(&trace, sample.local_us, &true_offset_us);
+      raw[i] = sample.offset_us - true_offset_us;
+      if (clock_filter_add(&filter, &sample) && bench_true_offset(&trace, filter.selected.local_us, &true_offset_us)) {
+        filtered[updates++] = filter.selected.offset_us - true_offset_us;
+      }
+    }
+    bench_print(trace_name[kind], "raw", raw, config.samples);
+    bench_print(trace_name[kind], "filtered", filtered, updates);
+  }
+
+  memset(&trace, 0, sizeof(trace));
+  trace.drift_ppb = config.drift_ppb;
+  for (i = 0; i < config.bench; i++) {
+    bench_sample(&config, &trace, BENCH_TRACES - 1u, i, &samples[i]);
+  }
+  clock_filter_reset(&filter);
+  updates = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < config.bench; i++) {
+    updates += clock_filter_add(&filter, &samples[i]) ? 1u : 0u;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  printf("clock_filter_add: %.1f ns per sample on this host, %u of %u samples passed on\n",
+         ((double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec)) / config.bench,
+         updates,
+         config.bench);
+  free(raw);
+  free(filtered);
+  free(samples);
+  return 0;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// xorshift64*, uniform in [0, span)
+static uint32_t bench_random(uint32_t span)
+{
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return (uint32_t)((rng * 0x2545F4914F6CDD1Dull) % span);
+}
+
+static int64_t bench_local_us(const trace_t *trace, int64_t true_us)
+{
+  return true_us + trace->phase_us + ((true_us - BENCH_EPOCH_US) / 1000) * trace->drift_ppb / 1000000;
+}
+
+// One exchange of trace @p kind, reduced the way ntp_sample_compute() does
+static void bench_sample(const bench_config_t *config, trace_t *trace, uint32_t kind, uint32_t index, ntp_sample_t *sample)
+{
+  int64_t t1_true = BENCH_EPOCH_US + (int64_t)index * config->poll_s * 1000000;
+  int64_t fwd_us  = config->delay_us + bench_random(BENCH_JITTER_US);
+  int64_t back_us = config->delay_us + bench_random(BENCH_JITTER_US);
+  int64_t t1;
+  int64_t t2;
+  int64_t t4;
+
+  switch (kind) {
+    case 1:
+      back_us += 20000;
+      break;
+    case 2:
+      if (bench_random(5u) == 0) {
+        if (bench_random(2u) == 0) {
+          fwd_us += 50000 + bench_random(250000u);
+        } else {
+          back_us += 50000 + bench_random(250000u);
+        }
+      }
+      break;
+    case 3:
+      if ((trace->queue_left == 0) && (bench_random(20u) == 0)) {
+        trace->queue_left = 5u + bench_random(26u);
+        trace->queue_us   = 100000u + bench_random(400000u);
+      }
+      if (trace->queue_left != 0) {
+        trace->queue_left--;
+        fwd_us += trace->queue_us / 2u + bench_random(trace->queue_us / 2u);
+      }
+      break;
+    default:
+      break;
+  }
+
+  t1 = bench_local_us(trace, t1_true);
+  t2 = t1_true + fwd_us; // Server time, T3 equals T2
+  t4 = bench_local_us(trace, t1_true + fwd_us + back_us);
+  memset(sample, 0, sizeof(*sample));
+  sample->offset_us     = ((t2 - t1) + (t2 - t4)) / 2;
+  sample->delay_us      = (uint32_t)(t4 - t1);
+  sample->dispersion_us = BENCH_PRECISION_US;
+  sample->local_us      = (uint64_t)t4;
+
+  trace->local_us[trace->next]  = (uint64_t)t4;
+  trace->offset_us[trace->next] = (t1_true + fwd_us + back_us) - t4;
+  trace->next                   = (uint8_t)((trace->next + 1u) % BENCH_HISTORY);
+}
+
+static bool bench_true_offset(const trace_t *trace, uint64_t local_us, int64_t *offset_us)
+{
+  uint32_t i;
+
+  for (i = 0; i < BENCH_HISTORY; i++) {
+    if (trace->local_us[i] == local_us) {
+      *offset_us = trace->offset_us[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+  int64_t x = llabs(*(const int64_t *)a);
+  int64_t y = llabs(*(const int64_t *)b);
+
+  return (x > y) - (x < y);
+}
+
+static void bench_print(const char *name, const char *label, int64_t *errors, uint32_t count)
+{
+  double square_sum = 0.0;
+  uint32_t i;
+
+  if (count == 0) {
+    printf("%s,%s,0,,,\n", name, label);
+    return;
+  }
+  for (i = 0; i < count; i++) {
+    square_sum += (double)errors[i] * (double)errors[i];
+  }
+  qsort(errors, count, sizeof(errors[0]), bench_compare);
+  printf("%s,%s,%u,%.0f,%lld,%lld\n",
+         name,
+         label,
+         count,
+         sqrt(square_sum / count),
+         (long long)llabs(errors[(count * 95u) / 100u]),
+         (long long)llabs(errors[count - 1u]));
+}
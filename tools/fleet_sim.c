@@ -0,0 +1,648 @@
+/***************************************************************************/ /**
+ * @file fleet_sim.c
+ * @brief Host load simulation of a device fleet against a local NTP stand-in
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory:
+ *   cc -O2 -pthread -DTIMELINE_HOST -I.. -o fleet_sim fleet_sim.c ../ntp_packet.c \
+ *      ../clock_filter.c ../time_slew.c ../timeline.c
+ *
+ *   fleet_sim [-n devices] [-t threads] [-d seconds] [-p poll s] [-b boot spread s]
+ *             [-r reboot at s] [-R reboot spread s] [-D drift ppm] [-l delay ms]
+ *             [-j jitter ms] [-B burst count] [-L lock ms] [-S seed] > rate.csv
+ *
+ * Every device runs the poll policy of sntp_app.c with its own virtual clock,
+ * drift and boot time: an iburst of -B requests at boot, one request per poll
+ * interval of -p, a burst again after SNTP_BURST_AFTER_FAILURES failures, the
+ * clock set from the filter output at the end of the first burst and slewed
+ * by time_slew_adjust() afterwards. -p defaults to the wait of sntp_app.c,
+ * DELAY_HALF_MINUTES(10) kernel ticks, which is 1000 s at the 1 kHz tick. Each leg of the path takes -l plus up to -j.
+ * Requests are real UDP datagrams to a stand-in responder on 127.0.0.1 that
+ * stamps the simulated time, replies go through ntp_sample_compute() and
+ * clock_filter_add().
+ *
+ * Simulated time advances in SIM_STEP_US steps. The devices due in a step are
+ * spread over per-thread deques, idle threads steal from the others.
+ * Requests per simulated minute, with the busiest second, go to stdout,
+ * accuracy and slew percentiles to stderr, with the reads of the steered
+ * clock that went back outside a step.
+ *
+ * Time to lock is from the last boot to the first request from which on the
+ * steered clock stayed within -L of the true time at every request. -B 1
+ * gives the former single sample at boot for comparison.
+ *
+ * The run itself is profiled with timeline.c: stand-in up, workers started,
+ * first step, first request answered. The report ends the stderr summary.
+ ******************************************************************************/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "ntp_packet.h"
+#include "clock_filter.h"
+#include "time_slew.h"
+#include "timeline.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define SIM_STEP_US          100000u          // Simulated time per step
+#define SIM_EPOCH_US         1700000000000000ull // Simulation start, Unix microseconds
+#define SIM_BURST_COUNT      6u               // sntp_app.c SNTP_BURST_COUNT
+#define SIM_BURST_SPACING_US 2000000u         // sntp_app.c SNTP_BURST_SPACING
+#define SIM_BURST_FAILURES   3u               // sntp_app.c SNTP_BURST_AFTER_FAILURES
+#define SIM_KERNEL_TICK_HZ   1000u            // Kernel tick of the firmware, osKernelGetTickFreq()
+#define SIM_POLL_S           (10u * 100000u / SIM_KERNEL_TICK_HZ) // sntp_app.c DELAY_HALF_MINUTES(10) ticks
+#define SIM_REPLY_TIMEOUT_MS 200              // Real time, the stand-in is local
+#define SIM_SERVER_THREADS   2
+#define SIM_MAX_THREADS      64
+#define SIM_SAMPLE_HISTORY   8u               // Sent samples kept to look up the true offset, CLOCK_FILTER_STAGES
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef struct {
+  uint64_t boot_us;       // Simulated time of the boot
+  uint64_t next_us;       // Next request due
+  int64_t phase_us;       // Local minus true time at boot
+  int64_t set_us;         // Correction applied when the clock was set
+  int32_t drift_ppb;      // Local clock rate error
+  uint32_t rng;
+  uint8_t burst_left;
+  uint8_t failed;
+  bool synced;
+  bool locked;
+  uint64_t lock_us;       // Time to lock, from the boot
+  int64_t set_error_us;   // Clock error right after it was set
+  int64_t error_us;       // Filtered offset minus true offset, last update
+  bool have_error;
+  clock_filter_t filter;
+  time_slew_t slew;
+  uint64_t last_read_us;  // Steered clock at the previous exchange, unclamped
+  uint32_t slew_ms;       // Longest slew started
+  uint64_t sample_local_us[SIM_SAMPLE_HISTORY];
+  int64_t sample_offset_us[SIM_SAMPLE_HISTORY]; // True minus steered clock at sample_local_us
+  uint8_t sample_next;
+} device_t;
+
+typedef struct {
+  uint32_t *item;
+  uint32_t head;
+  uint32_t tail;
+  pthread_mutex_t lock;
+} deque_t;
+
+typedef struct {
+  uint32_t devices;
+  uint32_t threads;
+  uint32_t duration_s;
+  uint32_t poll_s;
+  uint32_t boot_spread_s;
+  uint32_t reboot_s;
+  uint32_t reboot_spread_s;
+  uint32_t drift_ppm;
+  uint32_t delay_ms;
+  uint32_t jitter_ms;
+  uint32_t burst;
+  uint32_t lock_ms;
+  uint32_t seed;
+} sim_config_t;
+
+static sim_config_t config = { 1000, 4, 7200, SIM_POLL_S, 60, 3600, 5, 50, 5, 2, SIM_BURST_COUNT, 5, 1 };
+static device_t *device;
+static deque_t deque[SIM_MAX_THREADS];
+static pthread_barrier_t step_start;
+static pthread_barrier_t step_done;
+static _Atomic uint64_t sim_now_us;     // Time the stand-in stamps
+static _Atomic uint32_t *server_rate;   // Requests per simulated second
+static _Atomic uint32_t timeouts;
+static _Atomic uint32_t steals;
+static _Atomic uint32_t backwards;     // Steered reads earlier than the one before, no step between
+static volatile bool sim_running = true;
+static struct sockaddr_in server_address;
+static int server_socket;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static uint32_t sim_random(uint32_t *state);
+static int32_t sim_uniform(uint32_t *state, int32_t span);
+static uint64_t sim_local_us(const device_t *dev, uint64_t true_us);
+static uint64_t sim_steered_us(const device_t *dev, uint64_t true_us);
+static bool sim_true_offset(const device_t *dev, uint64_t local_us, int64_t *offset_us);
+static void sim_boot(device_t *dev, uint64_t boot_us);
+static void sim_exchange(uint32_t index, int sock);
+static bool sim_pop(uint32_t worker, uint32_t *index);
+static void *sim_worker(void *argument);
+static void *sim_server(void *argument);
+static int sim_compare(const void *a, const void *b);
+static void sim_percentiles(const char *label, int64_t *values, uint32_t count);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  pthread_t worker[SIM_MAX_THREADS];
+  pthread_t server[SIM_SERVER_THREADS];
+  socklen_t length = sizeof(server_address);
+  uint32_t *value  = NULL;
+  int64_t *errors;
+  uint32_t count;
+  uint32_t i;
+  uint32_t w;
+  uint64_t end_us;
+  uint64_t now;
+  uint32_t second;
+  uint32_t minute_total;
+  uint32_t minute_peak;
+  uint32_t peak          = 0;
+  uint32_t peak_second   = 0;
+  uint32_t reboot_peak   = 0;
+  uint64_t total         = 0;
+
+  timeline_init();
+  for (i = 1; i + 1 < (uint32_t)argc; i += 2) {
+    switch ((argv[i][0] == '-') ? argv[i][1] : 0) {
+      case 'n': value = &config.devices; break;
+      case 't': value = &config.threads; break;
+      case 'd': value = &config.duration_s; break;
+      case 'p': value = &config.poll_s; break;
+      case 'b': value = &config.boot_spread_s; break;
+      case 'r': value = &config.reboot_s; break;
+      case 'R': value = &config.reboot_spread_s; break;
+      case 'D': value = &config.drift_ppm; break;
+      case 'l': value = &config.delay_ms; break;
+      case 'j': value = &config.jitter_ms; break;
+      case 'B': value = &config.burst; break;
+      case 'L': value = &config.lock_ms; break;
+      case 'S': value = &config.seed; break;
+      default: value = NULL; break;
+    }
+    if (value == NULL) {
+      break;
+    }
+    *value = (uint32_t)strtoul(argv[i + 1], NULL, 0);
+  }
+  if ((i != (uint32_t)argc) || (config.devices == 0) || (config.threads == 0) || (config.poll_s == 0)
+      || (config.burst == 0) || (config.burst > UINT8_MAX)) {
+    fprintf(stderr, "usage: see the file header of fleet_sim.c\n");
+    return 2;
+  }
+  if (config.threads > SIM_MAX_THREADS) {
+    config.threads = SIM_MAX_THREADS;
+  }
+
+  device      = calloc(config.devices, sizeof(*device));
+  server_rate = calloc(config.duration_s + 1u, sizeof(*server_rate));
+  errors      = calloc(config.devices, sizeof(*errors));
+  if ((device == NULL) || (server_rate == NULL) || (errors == NULL)) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  atomic_store(&sim_now_us, SIM_EPOCH_US);
+  for (i = 0; i < config.devices; i++) {
+    device[i].rng = config.seed * 2654435761u + i + 1u;
+    sim_boot(&device[i],
+             SIM_EPOCH_US + (uint64_t)(sim_random(&device[i].rng) % (config.boot_spread_s * 1000u + 1u)) * 1000u);
+  }
+
+  // Stand-in responder on an ephemeral local port
+  server_socket                  = socket(AF_INET, SOCK_DGRAM, 0);
+  server_address.sin_family      = AF_INET;
+  server_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  server_address.sin_port        = 0;
+  if ((server_socket < 0) || (bind(server_socket, (struct sockaddr *)&server_address, sizeof(server_address)) < 0)
+      || (getsockname(server_socket, (struct sockaddr *)&server_address, &length) < 0)) {
+    perror("stand-in socket");
+    return 1;
+  }
+  for (i = 0; i < SIM_SERVER_THREADS; i++) {
+    pthread_create(&server[i], NULL, sim_server, NULL);
+  }
+  timeline_mark(TIMELINE_NET_INIT, 0);
+
+  pthread_barrier_init(&step_start, NULL, config.threads + 1u);
+  pthread_barrier_init(&step_done, NULL, config.threads + 1u);
+  for (w = 0; w < config.threads; w++) {
+    deque[w].item = malloc(config.devices * sizeof(uint32_t));
+    pthread_mutex_init(&deque[w].lock, NULL);
+    pthread_create(&worker[w], NULL, sim_worker, (void *)(uintptr_t)w);
+  }
+  timeline_mark(TIMELINE_TASK_START, config.threads);
+
+  end_us = SIM_EPOCH_US + (uint64_t)config.duration_s * 1000000u;
+  timeline_mark(TIMELINE_SNTP_START, 0);
+  for (now = SIM_EPOCH_US; now < end_us; now += SIM_STEP_US) {
+    atomic_store(&sim_now_us, now);
+    // A power cut: the whole fleet comes back within the reboot spread
+    if ((config.reboot_s != 0) && (now == SIM_EPOCH_US + (uint64_t)config.reboot_s * 1000000u)) {
+      for (i = 0; i < config.devices; i++) {
+        sim_boot(&device[i], now + (uint64_t)(sim_random(&device[i].rng) % (config.reboot_spread_s * 1000u + 1u)) * 1000u);
+      }
+    }
+    w = 0;
+    for (i = 0; i < config.devices; i++) {
+      if (device[i].next_us <= now) {
+        deque[w].item[deque[w].tail++] = i;
+        w                              = (w + 1u) % config.threads;
+      }
+    }
+    pthread_barrier_wait(&step_start);
+    pthread_barrier_wait(&step_done);
+    // Marks stay on this thread, timeline.c is not thread safe
+    if (atomic_load(&server_rate[(now - SIM_EPOCH_US) / 1000000u]) != 0) {
+      timeline_mark_once(TIMELINE_FIRST_REPLY, 0);
+    }
+    for (w = 0; w < config.threads; w++) {
+      deque[w].head = 0;
+      deque[w].tail = 0;
+    }
+  }
+  sim_running = false;
+  pthread_barrier_wait(&step_start);
+  for (w = 0; w < config.threads; w++) {
+    pthread_join(worker[w], NULL);
+  }
+
+  printf("minute,requests,peak_per_s\n");
+  for (second = 0; second < config.duration_s; second += 60u) {
+    minute_total = 0;
+    minute_peak  = 0;
+    for (i = second; (i < second + 60u) && (i < config.duration_s); i++) {
+      minute_total += server_rate[i];
+      if (server_rate[i] > minute_peak) {
+        minute_peak = server_rate[i];
+      }
+      if (server_rate[i] > peak) {
+        peak        = server_rate[i];
+        peak_second = i;
+      }
+      if ((config.reboot_s != 0) && (i >= config.reboot_s) && (server_rate[i] > reboot_peak)) {
+        reboot_peak = server_rate[i];
+      }
+    }
+    total += minute_total;
+    printf("%u,%u,%u\n", second / 60u, minute_total, minute_peak);
+  }
+
+  fprintf(stderr, "%u devices, %u threads, %u s simulated\n", config.devices, config.threads, config.duration_s);
+  fprintf(stderr, "%llu requests, %.2f per s on average, peak %u per s at %u s\n",
+          (unsigned long long)total,
+          (double)total / config.duration_s,
+          peak,
+          peak_second);
+  if (config.reboot_s != 0) {
+    fprintf(stderr, "peak after the synchronized reboot at %u s: %u per s\n", config.reboot_s, reboot_peak);
+  }
+  fprintf(stderr, "%u timeouts, %u steals\n", atomic_load(&timeouts), atomic_load(&steals));
+  fprintf(stderr, "%u steered reads went back\n", atomic_load(&backwards));
+  for (i = 0, count = 0; i < config.devices; i++) {
+    if (device[i].have_error) {
+      errors[count++] = device[i].error_us;
+    }
+  }
+  sim_percentiles("offset estimate error", errors, count);
+  for (i = 0, count = 0; i < config.devices; i++) {
+    if (device[i].synced) {
+      errors[count++] = (int64_t)(sim_steered_us(&device[i], end_us) - end_us);
+    }
+  }
+  sim_percentiles("clock error at the end", errors, count);
+  for (i = 0, count = 0; i < config.devices; i++) {
+    if (device[i].synced) {
+      errors[count++] = (int64_t)device[i].slew_ms * 1000;
+    }
+  }
+  sim_percentiles("longest slew", errors, count);
+  for (i = 0, count = 0; i < config.devices; i++) {
+    if (device[i].synced) {
+      errors[count++] = device[i].set_error_us;
+    }
+  }
+  sim_percentiles("clock error when set", errors, count);
+  for (i = 0, count = 0; i < config.devices; i++) {
+    if (device[i].locked) {
+      errors[count++] = (int64_t)device[i].lock_us;
+    }
+  }
+  fprintf(stderr, "%u of %u devices locked within %u ms, burst of %u, %u ms jitter\n",
+          count,
+          config.devices,
+          config.lock_ms,
+          config.burst,
+          config.jitter_ms);
+  sim_percentiles("time to lock", errors, count);
+  timeline_report();
+  return 0;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static uint32_t sim_random(uint32_t *state)
+{
+  uint32_t x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+static int32_t sim_uniform(uint32_t *state, int32_t span)
+{
+  if (span <= 0) {
+    return 0;
+  }
+  return (int32_t)(sim_random(state) % (2u * (uint32_t)span + 1u)) - span;
+}
+
+static uint64_t sim_local_us(const device_t *dev, uint64_t true_us)
+{
+  int64_t since_boot = (int64_t)(true_us - dev->boot_us);
+
+  return (uint64_t)((int64_t)true_us + dev->phase_us + (since_boot / 1000) * dev->drift_ppb / 1000000 + dev->set_us);
+}
+
+// Local clock with the correction, what calendar_get_utc_us() returns
+static uint64_t sim_steered_us(const device_t *dev, uint64_t true_us)
+{
+  uint64_t raw_us = sim_local_us(dev, true_us);
+
+  return (uint64_t)((int64_t)raw_us + time_slew_correction_us(&dev->slew, raw_us));
+}
+
+static bool sim_true_offset(const device_t *dev, uint64_t local_us, int64_t *offset_us)
+{
+  uint32_t i;
+
+  for (i = 0; i < SIM_SAMPLE_HISTORY; i++) {
+    if (dev->sample_local_us[i] == local_us) {
+      *offset_us = dev->sample_offset_us[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+// Power on: a clock that starts anywhere, a fresh filter and an iburst
+static void sim_boot(device_t *dev, uint64_t boot_us)
+{
+  dev->boot_us    = boot_us;
+  dev->next_us    = boot_us;
+  dev->phase_us   = (int64_t)(sim_random(&dev->rng) % 1000000000u) * 1000;
+  dev->set_us     = 0;
+  dev->drift_ppb  = sim_uniform(&dev->rng, (int32_t)config.drift_ppm * 1000);
+  dev->burst_left = (uint8_t)config.burst;
+  dev->failed     = 0;
+  dev->synced     = false;
+  dev->locked     = false;
+  dev->lock_us    = 0;
+  dev->last_read_us = 0;
+  dev->sample_next  = 0;
+  memset(dev->sample_local_us, 0, sizeof(dev->sample_local_us));
+  clock_filter_reset(&dev->filter);
+  time_slew_init(&dev->slew, TIME_SLEW_RATE_PPM, TIME_SLEW_STEP_US);
+}
+
+// One request of one device in the current step. Path delays are simulated,
+// the request leaves fwd before the step time the stand-in stamps.
+static void sim_exchange(uint32_t index, int sock)
+{
+  device_t *dev = &device[index];
+  uint64_t now  = atomic_load(&sim_now_us);
+  uint8_t buffer[NTP_PACKET_SIZE];
+  ntp_packet_t request = { 0 };
+  ntp_packet_t reply;
+  ntp_sample_t sample;
+  int64_t fwd_us;
+  int64_t back_us;
+  int64_t true_offset_us;
+  uint64_t read_us;
+  uint64_t raw_us;
+  uint32_t slew_ms;
+  time_slew_action_t action;
+  uint64_t t1;
+  uint64_t t4;
+  ssize_t length;
+  bool replied = false;
+
+  fwd_us  = (int64_t)config.delay_ms * 1000 + (sim_uniform(&dev->rng, (int32_t)config.jitter_ms * 1000) + (int32_t)config.jitter_ms * 1000) / 2;
+  back_us = (int64_t)config.delay_ms * 1000 + (sim_uniform(&dev->rng, (int32_t)config.jitter_ms * 1000) + (int32_t)config.jitter_ms * 1000) / 2;
+  t1      = sim_steered_us(dev, now - (uint64_t)fwd_us);
+  t4      = sim_steered_us(dev, now + (uint64_t)back_us);
+
+  read_us = sim_steered_us(dev, now);
+  if (read_us < dev->last_read_us) {
+    atomic_fetch_add(&backwards, 1u);
+  }
+  dev->last_read_us = read_us;
+
+  request.version  = NTP_VERSION;
+  request.mode     = NTP_MODE_CLIENT;
+  request.transmit = ntp_time_from_unix(unix_time_from_us((int64_t)t1));
+  ntp_packet_encode(&request, buffer);
+  if (sendto(sock, buffer, sizeof(buffer), 0, (struct sockaddr *)&server_address, sizeof(server_address)) >= 0) {
+    length = recv(sock, buffer, sizeof(buffer), 0);
+    replied = (length == (ssize_t)NTP_PACKET_SIZE) && ntp_packet_decode(buffer, (size_t)length, &reply)
+              && (reply.origin.value == request.transmit.value);
+  }
+  if (!replied) {
+    atomic_fetch_add(&timeouts, 1u);
+    if (dev->failed < UINT8_MAX) {
+      dev->failed++;
+    }
+  } else {
+    dev->failed = 0;
+    ntp_sample_compute(t1, t4, &reply, 1u, &sample);
+    dev->sample_local_us[dev->sample_next]  = t4;
+    dev->sample_offset_us[dev->sample_next] = (int64_t)(now + (uint64_t)back_us) - (int64_t)t4;
+    dev->sample_next                        = (uint8_t)((dev->sample_next + 1u) % SIM_SAMPLE_HISTORY);
+    if (clock_filter_add(&dev->filter, &sample) && dev->synced) {
+      // The selected stage may be several polls old, compare with the true
+      // offset when it was taken
+      if (sim_true_offset(dev, dev->filter.selected.local_us, &true_offset_us)) {
+        dev->error_us   = dev->filter.selected.offset_us - true_offset_us;
+        dev->have_error = true;
+      }
+      // calendar_adjust(), the correction must not move the clock at once
+      raw_us = sim_local_us(dev, now);
+      action = time_slew_adjust(&dev->slew, raw_us, dev->filter.selected.local_us, dev->filter.selected.offset_us);
+      if (action == TIME_SLEW_STEPPED) {
+        dev->last_read_us = 0;
+        clock_filter_reset(&dev->filter);
+      } else if (sim_steered_us(dev, now) != read_us) {
+        atomic_fetch_add(&backwards, 1u);
+      }
+      time_slew_remaining_us(&dev->slew, raw_us, &slew_ms);
+      if (slew_ms > dev->slew_ms) {
+        dev->slew_ms = slew_ms;
+      }
+    }
+  }
+
+  // calendar_init() from the filter output once the first burst is over, its
+  // offset applied to the clock now
+  if (!dev->synced && (dev->burst_left <= 1u) && (dev->filter.updates != 0)) {
+    dev->set_us += dev->filter.selected.offset_us;
+    dev->synced       = true;
+    dev->last_read_us = 0;
+    time_slew_init(&dev->slew, TIME_SLEW_RATE_PPM, TIME_SLEW_STEP_US);
+    clock_filter_reset(&dev->filter);
+    dev->set_error_us = (int64_t)(sim_steered_us(dev, now) - now);
+  }
+  if (dev->synced && (llabs((int64_t)(sim_steered_us(dev, now) - now)) <= (int64_t)config.lock_ms * 1000)) {
+    if (!dev->locked) {
+      dev->locked  = true;
+      dev->lock_us = now - dev->boot_us;
+    }
+  } else {
+    dev->locked = false;
+  }
+
+  // sntp_app.c: bursts at boot and after an outage, single polls otherwise
+  if (dev->burst_left > 1u) {
+    dev->burst_left--;
+    dev->next_us = now + SIM_BURST_SPACING_US;
+    return;
+  }
+  dev->burst_left = (!dev->synced || (dev->failed >= SIM_BURST_FAILURES)) ? (uint8_t)config.burst : 1u;
+  dev->next_us    = now + (uint64_t)config.poll_s * 1000000u;
+}
+
+// Own deque from the tail, the others from the head
+static bool sim_pop(uint32_t worker, uint32_t *index)
+{
+  deque_t *queue;
+  uint32_t i;
+
+  queue = &deque[worker];
+  pthread_mutex_lock(&queue->lock);
+  if (queue->tail > queue->head) {
+    *index = queue->item[--queue->tail];
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+  }
+  pthread_mutex_unlock(&queue->lock);
+  for (i = 1; i < config.threads; i++) {
+    queue = &deque[(worker + i) % config.threads];
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail > queue->head) {
+      *index = queue->item[queue->head++];
+      pthread_mutex_unlock(&queue->lock);
+      atomic_fetch_add(&steals, 1u);
+      return true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+  }
+  return false;
+}
+
+static void *sim_worker(void *argument)
+{
+  uint32_t worker = (uint32_t)(uintptr_t)argument;
+  struct timeval timeout = { 0, SIM_REPLY_TIMEOUT_MS * 1000 };
+  uint32_t index;
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  while (1) {
+    pthread_barrier_wait(&step_start);
+    if (!sim_running) {
+      break;
+    }
+    while (sim_pop(worker, &index)) {
+      sim_exchange(index, sock);
+    }
+    pthread_barrier_wait(&step_done);
+  }
+  close(sock);
+  return NULL;
+}
+
+// Stand-in stratum 1 server on the simulated clock
+static void *sim_server(void *argument)
+{
+  struct sockaddr_in peer;
+  socklen_t peer_length;
+  uint8_t buffer[NTP_PACKET_SIZE];
+  ntp_packet_t request;
+  ntp_packet_t reply = { 0 };
+  uint64_t now;
+  ssize_t length;
+
+  (void)argument;
+  while (1) {
+    peer_length = sizeof(peer);
+    length      = recvfrom(server_socket, buffer, sizeof(buffer), 0, (struct sockaddr *)&peer, &peer_length);
+    if ((length < (ssize_t)NTP_PACKET_SIZE) || !ntp_packet_decode(buffer, (size_t)length, &request)
+        || (request.mode != NTP_MODE_CLIENT)) {
+      continue;
+    }
+    now = atomic_load(&sim_now_us);
+    if ((now - SIM_EPOCH_US) / 1000000u <= config.duration_s) {
+      atomic_fetch_add(&server_rate[(now - SIM_EPOCH_US) / 1000000u], 1u);
+    }
+    reply.version      = request.version;
+    reply.mode         = NTP_MODE_SERVER;
+    reply.stratum      = 1;
+    reply.poll         = request.poll;
+    reply.precision    = -20;
+    reply.reference_id = 0x53494D00u; // "SIM"
+    reply.reference    = ntp_time_from_unix(unix_time_from_us((int64_t)(now - 1000000u)));
+    reply.origin       = request.transmit;
+    reply.receive      = ntp_time_from_unix(unix_time_from_us((int64_t)now));
+    reply.transmit     = reply.receive;
+    ntp_packet_encode(&reply, buffer);
+    sendto(server_socket, buffer, sizeof(buffer), 0, (struct sockaddr *)&peer, peer_length);
+  }
+  return NULL;
+}
+
+static int sim_compare(const void *a, const void *b)
+{
+  int64_t x = *(const int64_t *)a;
+  int64_t y = *(const int64_t *)b;
+
+  x = (x < 0) ? -x : x;
+  y = (y < 0) ? -y : y;
+  return (x > y) - (x < y);
+}
+
+// Percentiles of the magnitude
+static void sim_percentiles(const char *label, int64_t *values, uint32_t count)
+{
+  if (count == 0) {
+    fprintf(stderr, "%s: no devices\n", label);
+    return;
+  }
+  qsort(values, count, sizeof(values[0]), sim_compare);
+  fprintf(stderr, "%s over %u devices, us: p50 %lld, p90 %lld, p99 %lld, max %lld\n",
+          label,
+          count,
+          (long long)llabs(values[count / 2u]),
+          (long long)llabs(values[(count * 9u) / 10u]),
+          (long long)llabs(values[(count * 99u) / 100u]),
+          (long long)llabs(values[count - 1u]));
+}
@@ -0,0 +1,260 @@
+/***************************************************************************/ /**
+ * @file holdover_sim.c
+ * @brief Holdover error and bound of holdover.c over simulated oscillators
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory:
+ *   cc -O2 -I.. -o holdover_sim holdover_sim.c ../holdover.c -lm
+ *
+ *   holdover_sim [-n runs] [-l learn hours] [-o outage hours] [-p poll s]
+ *                [-f frequency ppm] [-a aging ppb/day] [-t temperature ppb]
+ *                [-w wander ppb] [-m sample noise us] [-S seed]
+ *
+ * Every run draws an oscillator: a frequency error up to -f, aging up to -a
+ * per day, a daily temperature swing of -t with a random phase, and a random
+ * walk of -w per hour. It is synchronized every -p seconds for -l hours with
+ * samples of -m us standard deviation, error bound 3 -m, through
+ * holdover_update(). Then the reference is lost for -o hours.
+ *
+ * At each checkpoint of the outage the error of holdover_predict() and of
+ * free running on the last sample are printed as percentiles over the runs,
+ * with the holdover_bound_us() percentiles and the share of runs the bound
+ * covered. The exit status is 1 if the bound covered less than 95 % at 24 h.
+ ******************************************************************************/
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "holdover.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define SIM_STEP_S         10u              // Oscillator integration step
+#define SIM_EPOCH_US       1700000000000000ull
+#define SIM_TOLERANCE_PPB  100000u          // calendar_app.c CALENDAR_HOLDOVER_TOLERANCE_PPB
+#define SIM_MIN_BASELINE_S 3600u            // calendar_app.c CALENDAR_HOLDOVER_BASELINE
+#define SIM_CHECKPOINTS    7u
+#define SIM_COVERAGE_HOURS 24u
+#define SIM_COVERAGE_MIN   0.95
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef struct {
+  double freq_ppb;     // Fixed part, positive is slow
+  double aging_ppb;    // Per day
+  double swing_ppb;    // Daily temperature swing amplitude
+  double swing_phase;
+  double walk_ppb;     // Random walk state
+  double phase_us;     // Local minus true time
+} oscillator_t;
+
+static const uint32_t checkpoint_h[SIM_CHECKPOINTS] = { 1, 2, 4, 8, 12, 24, 48 };
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static double sim_uniform(double span);
+static double sim_normal(void);
+static void sim_advance(oscillator_t *osc, double *elapsed_s, double step_s, double wander_ppb);
+static int sim_compare(const void *a, const void *b);
+static double sim_percentile(double *values, uint32_t count, uint32_t percent);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  uint32_t runs        = 500;
+  uint32_t learn_h     = 24;
+  uint32_t outage_h    = 24;
+  uint32_t poll_s      = 300;
+  double freq_ppm      = 20.0;
+  double aging_ppb     = 20.0;
+  double swing_ppb     = 100.0;
+  double wander_ppb    = 5.0;
+  double noise_us      = 500.0;
+  double *holdover_err[SIM_CHECKPOINTS];
+  double *free_err[SIM_CHECKPOINTS];
+  double *bound[SIM_CHECKPOINTS];
+  uint32_t covered[SIM_CHECKPOINTS] = { 0 };
+  holdover_t holdover;
+  oscillator_t osc;
+  double elapsed_s;
+  double coverage_24h = 1.0;
+  int64_t predicted_us;
+  int64_t last_offset_us = 0;
+  int64_t true_offset_us;
+  uint64_t local_us;
+  uint32_t run;
+  uint32_t c;
+  uint32_t s;
+  int arg;
+
+  for (arg = 1; arg + 1 < argc; arg += 2) {
+    if (strcmp(argv[arg], "-n") == 0) {
+      runs = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-l") == 0) {
+      learn_h = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-o") == 0) {
+      outage_h = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-p") == 0) {
+      poll_s = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-f") == 0) {
+      freq_ppm = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-a") == 0) {
+      aging_ppb = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-t") == 0) {
+      swing_ppb = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-w") == 0) {
+      wander_ppb = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-m") == 0) {
+      noise_us = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-S") == 0) {
+      rng = strtoull(argv[arg + 1], NULL, 0) | 1u;
+    } else {
+      break;
+    }
+  }
+  if ((arg != argc) || (runs == 0) || (poll_s < SIM_STEP_S)) {
+    fprintf(stderr, "usage: see the file header of holdover_sim.c\n");
+    return 2;
+  }
+  for (c = 0; c < SIM_CHECKPOINTS; c++) {
+    holdover_err[c] = calloc(runs, sizeof(double));
+    free_err[c]     = calloc(runs, sizeof(double));
+    bound[c]        = calloc(runs, sizeof(double));
+    if ((holdover_err[c] == NULL) || (free_err[c] == NULL) || (bound[c] == NULL)) {
+      fprintf(stderr, "out of memory\n");
+      return 1;
+    }
+  }
+
+  for (run = 0; run < runs; run++) {
+    osc.freq_ppb    = sim_uniform(freq_ppm * 1000.0);
+    osc.aging_ppb   = sim_uniform(aging_ppb);
+    osc.swing_ppb   = swing_ppb;
+    osc.swing_phase = sim_uniform(M_PI);
+    osc.walk_ppb    = 0.0;
+    osc.phase_us    = sim_uniform(500000.0);
+    elapsed_s       = 0.0;
+    holdover_init(&holdover, SIM_TOLERANCE_PPB, SIM_MIN_BASELINE_S);
+
+    // Synchronized: one filtered sample per poll, against the raw clock
+    for (s = 0; s < learn_h * 3600u; s += poll_s) {
+      sim_advance(&osc, &elapsed_s, poll_s, wander_ppb);
+      local_us       = SIM_EPOCH_US + (uint64_t)(elapsed_s * 1e6 + osc.phase_us);
+      last_offset_us = (int64_t)llround(-osc.phase_us + noise_us * sim_normal());
+      holdover_update(&holdover, local_us, last_offset_us, (uint32_t)(3.0 * noise_us));
+    }
+
+    // Outage
+    s = 0;
+    for (c = 0; (c < SIM_CHECKPOINTS) && (checkpoint_h[c] <= outage_h); c++) {
+      for (; s < checkpoint_h[c] * 3600u; s += SIM_STEP_S) {
+        sim_advance(&osc, &elapsed_s, SIM_STEP_S, wander_ppb);
+      }
+      local_us       = SIM_EPOCH_US + (uint64_t)(elapsed_s * 1e6 + osc.phase_us);
+      true_offset_us = (int64_t)llround(-osc.phase_us);
+      holdover_predict(&holdover, local_us, &predicted_us);
+      holdover_err[c][run] = fabs((double)(predicted_us - true_offset_us));
+      free_err[c][run]     = fabs((double)(last_offset_us - true_offset_us));
+      bound[c][run]        = holdover_bound_us(&holdover, local_us);
+      if (bound[c][run] >= holdover_err[c][run]) {
+        covered[c]++;
+      }
+    }
+  }
+
+  printf("%u runs, %u h learned at %u s polls, %.0f ppm, %.0f ppb/day aging, %.0f ppb swing, %.1f ppb/h wander, %.0f us noise\n",
+         runs,
+         learn_h,
+         poll_s,
+         freq_ppm,
+         aging_ppb,
+         swing_ppb,
+         wander_ppb,
+         noise_us);
+  printf("outage_h,holdover_p50_ms,holdover_p95_ms,holdover_max_ms,free_p50_ms,free_p95_ms,bound_p50_ms,covered\n");
+  for (c = 0; (c < SIM_CHECKPOINTS) && (checkpoint_h[c] <= outage_h); c++) {
+    printf("%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+           checkpoint_h[c],
+           sim_percentile(holdover_err[c], runs, 50) / 1000.0,
+           sim_percentile(holdover_err[c], runs, 95) / 1000.0,
+           sim_percentile(holdover_err[c], runs, 100) / 1000.0,
+           sim_percentile(free_err[c], runs, 50) / 1000.0,
+           sim_percentile(free_err[c], runs, 95) / 1000.0,
+           sim_percentile(bound[c], runs, 50) / 1000.0,
+           (double)covered[c] / runs);
+    if (checkpoint_h[c] == SIM_COVERAGE_HOURS) {
+      coverage_24h = (double)covered[c] / runs;
+    }
+  }
+  return (coverage_24h < SIM_COVERAGE_MIN) ? 1 : 0;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// xorshift64*, uniform in [-span, span]
+static double sim_uniform(double span)
+{
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return span * (2.0 * (double)((rng * 0x2545F4914F6CDD1Dull) >> 11) / 9007199254740992.0 - 1.0);
+}
+
+// Box-Muller
+static double sim_normal(void)
+{
+  double u = (sim_uniform(0.5) + 0.5) + 1e-12;
+  double v = sim_uniform(0.5) + 0.5;
+
+  return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+// Integrate the local clock error, the rate is reference minus local time,
+// a positive frequency error is a slow clock
+static void sim_advance(oscillator_t *osc, double *elapsed_s, double step_s, double wander_ppb)
+{
+  double freq_ppb;
+
+  osc->walk_ppb += wander_ppb * sqrt(step_s / 3600.0) * sim_normal();
+  freq_ppb = osc->freq_ppb + osc->aging_ppb * (*elapsed_s / 86400.0) + osc->walk_ppb
+             + osc->swing_ppb * sin(2.0 * M_PI * (*elapsed_s / 86400.0) + osc->swing_phase);
+  osc->phase_us -= freq_ppb * step_s / 1000.0;
+  *elapsed_s += step_s;
+}
+
+static int sim_compare(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+static double sim_percentile(double *values, uint32_t count, uint32_t percent)
+{
+  uint32_t index = (count * percent) / 100u;
+
+  qsort(values, count, sizeof(values[0]), sim_compare);
+  return values[(index >= count) ? (count - 1u) : index];
+}
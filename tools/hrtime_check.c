@@ -0,0 +1,302 @@
+/***************************************************************************/ /**
+ * @file hrtime_check.c
+ * @brief Interpolation error of hrtime.c over simulated second edges
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory:
+ *   cc -O2 -I.. -o hrtime_check hrtime_check.c ../hrtime.c -lm
+ *
+ *   hrtime_check [-h hours] [-c counter Hz] [-j latency us] [-f frequency ppm]
+ *                [-t temperature ppm] [-m missed edge ppm] [-z sleeps per hour]
+ *                [-l sleep s] [-r reads per s] [-S seed]
+ *
+ * A 32 bit counter of nominally -c Hz, the DWT CYCCNT of calendar_app.c, runs
+ * against the RTC, which is true time here. The second interrupt latches the
+ * counter up to -j us late and calls hrtime_second_edge(), -r times per second
+ * hrtime_read_us() is compared with true time. Per scenario:
+ *   ideal    nothing but the counter
+ *   jitter   interrupt latency
+ *   drift    a counter frequency error of -f plus a daily swing of -t
+ *   missed   -m per million second interrupts are lost
+ *   sleep    -z deep sleeps per hour of -l s on average, the counter halts
+ *            and the edges of the sleep are not taken
+ *   all      everything at once
+ *
+ * Printed per scenario: edges taken and rejected, the interrupts a 1 ms
+ * trigger (MILLI_SEC_INTR) takes over the same time, which also has to wake
+ * the core from every sleep, and the ones avoided. Then the reads refused,
+ * the 50th/99th percentile and largest error of the accepted ones, and the
+ * error of the calendar_read_raw_us() path, which falls back to the
+ * millisecond RTC when the two disagree by HRTIME_RTC_AGREEMENT. Last the
+ * calibrated rate against the true counter frequency.
+ ******************************************************************************/
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hrtime.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define CHECK_EPOCH_S     1700000000u
+#define CHECK_AGREEMENT   2000u // calendar_app.c HRTIME_RTC_AGREEMENT, us
+#define CHECK_MS_TRIGGER  1000u // MILLI_SEC_INTR interrupts per second
+#define CHECK_READS_MAX   4000000u
+#define CHECK_SCENARIOS   6u
+
+#define CHECK_JITTER 0x1u
+#define CHECK_DRIFT  0x2u
+#define CHECK_MISSED 0x4u
+#define CHECK_SLEEP  0x8u
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef struct {
+  uint32_t hours;
+  uint32_t counter_hz;
+  double latency_us;
+  double freq_ppm;
+  double temperature_ppm;
+  double missed_ppm;
+  double sleeps_per_hour;
+  double sleep_s;
+  uint32_t reads;
+} check_config_t;
+
+typedef struct {
+  uint32_t edges;
+  uint32_t rejected;
+  uint64_t ms_interrupts;
+  uint32_t reads;
+  uint32_t refused;
+  uint32_t fallback;
+  uint32_t fw_max_us;
+  double rate_ppm;
+} check_result_t;
+
+static const char *const check_scenario[CHECK_SCENARIOS] = { "ideal", "jitter", "drift", "missed", "sleep", "all" };
+static const uint32_t check_flags[CHECK_SCENARIOS]       = {
+  0, CHECK_JITTER, CHECK_DRIFT, CHECK_MISSED, CHECK_SLEEP, CHECK_JITTER | CHECK_DRIFT | CHECK_MISSED | CHECK_SLEEP
+};
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static double check_uniform(void);
+static int check_compare(const void *a, const void *b);
+static double check_awake(double from, double to, double sleep_start, double sleep_end);
+static void check_edge(hrtime_t *hrtime, uint32_t second, double counter);
+static void check_run(const check_config_t *config, uint32_t flags, uint32_t *errors, check_result_t *result);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  check_config_t config = { 24, 180000000u, 20.0, 30.0, 10.0, 1000.0, 6.0, 30.0, 4 };
+  static uint32_t errors[CHECK_READS_MAX];
+  check_result_t result;
+  uint32_t scenario;
+  uint32_t count;
+  int arg;
+
+  for (arg = 1; arg + 1 < argc; arg += 2) {
+    if (strcmp(argv[arg], "-h") == 0) {
+      config.hours = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-c") == 0) {
+      config.counter_hz = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-j") == 0) {
+      config.latency_us = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-f") == 0) {
+      config.freq_ppm = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-t") == 0) {
+      config.temperature_ppm = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-m") == 0) {
+      config.missed_ppm = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-z") == 0) {
+      config.sleeps_per_hour = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-l") == 0) {
+      config.sleep_s = atof(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-r") == 0) {
+      config.reads = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-S") == 0) {
+      rng = strtoull(argv[arg + 1], NULL, 0) | 1u;
+    } else {
+      break;
+    }
+  }
+  if ((arg != argc) || (config.hours == 0) || (config.counter_hz < 1000u) || (config.reads == 0)
+      || ((uint64_t)config.hours * 3600u * config.reads > CHECK_READS_MAX)) {
+    fprintf(stderr, "usage: see the file header of hrtime_check.c\n");
+    return 2;
+  }
+
+  printf("%u h, %u Hz, %.0f us latency, %.1f ppm, %.1f ppm daily swing, %.0f ppm missed, %.1f sleeps/h of %.0f s\n",
+         config.hours,
+         config.counter_hz,
+         config.latency_us,
+         config.freq_ppm,
+         config.temperature_ppm,
+         config.missed_ppm,
+         config.sleeps_per_hour,
+         config.sleep_s);
+  printf("scenario,edges,rejected,ms_trigger,avoided,reads,refused,p50_us,p99_us,max_us,fallback,read_max_us,"
+         "rate_ppm\n");
+  for (scenario = 0; scenario < CHECK_SCENARIOS; scenario++) {
+    check_run(&config, check_flags[scenario], errors, &result);
+    count = result.reads - result.refused;
+    qsort(errors, count, sizeof(errors[0]), check_compare);
+    printf("%s,%u,%u,%llu,%llu,%u,%u,%u,%u,%u,%u,%u,%.3f\n",
+           check_scenario[scenario],
+           result.edges,
+           result.rejected,
+           (unsigned long long)result.ms_interrupts,
+           (unsigned long long)(result.ms_interrupts - result.edges),
+           result.reads,
+           result.refused,
+           (count != 0) ? errors[count / 2u] : 0u,
+           (count != 0) ? errors[(count * 99u) / 100u] : 0u,
+           (count != 0) ? errors[count - 1u] : 0u,
+           result.fallback,
+           result.fw_max_us,
+           result.rate_ppm);
+  }
+  return 0;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// xorshift64*, uniform in (0, 1)
+static double check_uniform(void)
+{
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return ((double)((rng * 0x2545F4914F6CDD1Dull) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static int check_compare(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+// Seconds of [from, to) the core is awake and the counter runs
+static double check_awake(double from, double to, double sleep_start, double sleep_end)
+{
+  double start = (from > sleep_start) ? from : sleep_start;
+  double end   = (to < sleep_end) ? to : sleep_end;
+
+  return (to - from) - ((end > start) ? (end - start) : 0.0);
+}
+
+// The second interrupt, counter is unwrapped
+static void check_edge(hrtime_t *hrtime, uint32_t second, double counter)
+{
+  hrtime_second_edge(hrtime, CHECK_EPOCH_S + second, (uint32_t)(uint64_t)counter);
+}
+
+/*******************************************************************************
+ * One scenario. Within each RTC second the counter frequency is constant, the
+ * counter at a time of the second is its value at the edge plus the awake part
+ * of the second so far.
+ ******************************************************************************/
+static void check_run(const check_config_t *config, uint32_t flags, uint32_t *errors, check_result_t *result)
+{
+  uint32_t seconds   = config->hours * 3600u;
+  double counter     = 0.0; // Counter at the edge of the current second, unwrapped
+  double sleep_start = -1.0;
+  double sleep_end   = -1.0;
+  double freq_hz     = config->counter_hz;
+  hrtime_t hrtime;
+  uint32_t second;
+  uint32_t read;
+  uint64_t micros;
+  uint64_t rtc_us;
+  uint64_t true_us;
+  uint64_t error_us;
+  double latch;
+  double t;
+  bool pending;
+
+  memset(result, 0, sizeof(*result));
+  hrtime_init(&hrtime, config->counter_hz);
+  for (second = 0; second < seconds; second++) {
+    if (flags & CHECK_DRIFT) {
+      freq_hz = config->counter_hz
+                * (1.0
+                   + (config->freq_ppm + config->temperature_ppm * sin(2.0 * M_PI * second / 86400.0)) * 1e-6);
+    }
+    if ((flags & CHECK_SLEEP) && (second >= sleep_end) && (check_uniform() < config->sleeps_per_hour / 3600.0)) {
+      sleep_start = second + check_uniform();
+      sleep_end   = sleep_start + config->sleep_s * 2.0 * check_uniform();
+    }
+    // The 1 ms trigger runs through sleeps, it has to wake the core
+    result->ms_interrupts += CHECK_MS_TRIGGER;
+
+    // Second edge, not taken while asleep or when lost. Reads before the
+    // latch still see the previous edge.
+    pending = ((second < sleep_start) || (second >= sleep_end))
+              && (!(flags & CHECK_MISSED) || (check_uniform() >= config->missed_ppm * 1e-6));
+    latch   = (flags & CHECK_JITTER) ? config->latency_us * 1e-6 * check_uniform() : 0.0;
+
+    for (read = 0; read < config->reads; read++) {
+      t = second + (read + check_uniform()) / config->reads;
+      if (pending && (t >= second + latch)) {
+        pending = false;
+        check_edge(&hrtime, second, counter + freq_hz * check_awake(second, second + latch, sleep_start, sleep_end));
+      }
+      if ((t >= sleep_start) && (t < sleep_end)) {
+        continue;
+      }
+      result->reads++;
+      true_us = (uint64_t)CHECK_EPOCH_S * 1000000u + (uint64_t)llround(t * 1e6);
+      rtc_us  = (uint64_t)CHECK_EPOCH_S * 1000000u + (uint64_t)floor(t * 1e3) * 1000u;
+      if (!hrtime_read_us(&hrtime,
+                          (uint32_t)(uint64_t)(counter + freq_hz * check_awake(second, t, sleep_start, sleep_end)),
+                          &micros)) {
+        result->refused++;
+        micros = rtc_us;
+      } else {
+        error_us                                      = (micros > true_us) ? micros - true_us : true_us - micros;
+        errors[result->reads - result->refused - 1u] = (error_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)error_us;
+      }
+      // calendar_read_raw_us() keeps the interpolation only while it agrees with the RTC
+      if ((micros + CHECK_AGREEMENT <= rtc_us) || (micros >= rtc_us + CHECK_AGREEMENT)) {
+        result->fallback++;
+        micros = rtc_us;
+      }
+      error_us = (micros > true_us) ? micros - true_us : true_us - micros;
+      if (error_us > result->fw_max_us) {
+        result->fw_max_us = (uint32_t)error_us;
+      }
+    }
+    if (pending) {
+      check_edge(&hrtime, second, counter + freq_hz * check_awake(second, second + latch, sleep_start, sleep_end));
+    }
+    counter += freq_hz * check_awake(second, second + 1.0, sleep_start, sleep_end);
+  }
+  result->edges    = hrtime.edges;
+  result->rejected = hrtime.rejected;
+  result->rate_ppm = (hrtime.rate - freq_hz) / freq_hz * 1e6;
+}
@@ -0,0 +1,729 @@
+/***************************************************************************/ /**
+ * @file ntp_standin.c
+ * @brief Local NTP responder with programmable impairments for offline tests
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory:
+ *   cc -O2 -I.. -o ntp_standin ntp_standin.c ../ntp_packet.c -lm
+ *
+ *   ntp_standin [-p port] [-x script] [key=value ...]
+ *   ntp_standin -L address [-p port] [-r requests/s] [-d seconds]
+ *
+ * Serves the host clock (CLOCK_REALTIME) as a stratum 1 server, or as
+ * configured by the keys below. Point NTP_SERVER_IP of the device at the host
+ * running it. Keys, given on the command line or in a script:
+ *   delay=ms        one way path delay, both directions
+ *   jitter=ms       scale of the random part of each one way delay
+ *   dist=name       uniform, normal, exp or pareto (heavy tail), default exp
+ *   asym=ms         extra delay of the client to server direction only
+ *   loss=p          probability a request is dropped
+ *   dup=p           probability a reply is sent twice
+ *   offset=ms       served time minus host time, a falseticker
+ *   freq=ppm        served clock rate error, accumulates from the start
+ *   stratum=n       stratum of the replies
+ *   leap=n          leap indicator, 1 insert, 2 delete, 3 unsynchronized
+ *   kod=code        RATE, DENY or RSTR Kiss-o'-Death instead of time, none to stop
+ *   kodp=p          probability of the Kiss-o'-Death, 1 by default
+ *   poll=n          poll exponent the replies carry at least, the request's
+ *                   is echoed when higher
+ *   limit=n         a request less than 2^n s after the last one from the
+ *                   same address gets a RATE Kiss-o'-Death with poll n, 0 off
+ *   seed=n          random seed
+ *   bcast=a.b.c.d   also send mode 5 broadcasts to that address on port 123
+ *   bint=s          seconds between broadcasts, 64 by default
+ * A script holds one "<request number> key=value ..." per line, the keys take
+ * effect from that request on. Lines starting with # are skipped.
+ *
+ * Per request one line goes to stdout: number, served T2, applied delays and
+ * the action. The delays are applied around T2/T3, so a client's offset error
+ * is (forward - return) / 2 plus offset=.
+ *
+ * With -L the program is a load generator instead, e.g. for a device running
+ * NTP_LAN_SERVER. It sends -r client requests per second to the address for
+ * -d seconds, paced evenly, and waits one more second for replies. The transmit timestamp carries the request number, so replies are
+ * matched through their origin. Per second the requests sent and answered go
+ * to stdout as CSV. stderr gets the totals: replies, losses, duplicates,
+ * replies that were not a synchronized server reply, the reply rate, the
+ * round trip percentiles and the longest T3 - T2 the server reported.
+ ******************************************************************************/
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "ntp_packet.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define STANDIN_PENDING     4096u // Replies held back for their delay
+#define STANDIN_SCRIPT_MAX  256u
+#define STANDIN_LINE_LENGTH 256
+#define STANDIN_PRECISION   -20   // About 1 us, CLOCK_REALTIME
+#define STANDIN_REFID       0x4C4F434Cu // "LOCL"
+#define STANDIN_CLIENTS     64u   // Addresses the limit= check remembers
+#define STANDIN_LOAD_MAGIC  0x4C4F4144u // "LOAD", transmit fraction of load requests
+#define STANDIN_LOAD_DRAIN  1000000u    // Microseconds to wait for replies after the last request
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef enum {
+  STANDIN_UNIFORM = 0,
+  STANDIN_NORMAL,
+  STANDIN_EXP,
+  STANDIN_PARETO,
+} standin_dist_t;
+
+typedef struct {
+  double delay_ms;
+  double jitter_ms;
+  standin_dist_t dist;
+  double asym_ms;
+  double loss;
+  double dup;
+  double offset_ms;
+  double freq_ppm;
+  uint8_t stratum;
+  uint8_t leap;
+  uint32_t kod;     // Kiss code as reference ID, 0 for none
+  double kod_p;
+  int8_t poll;
+  int8_t limit;     // log2 seconds, 0 for none
+  uint32_t bcast;   // Broadcast address, network order, 0 for none
+  uint32_t bint_s;
+} standin_params_t;
+
+typedef struct {
+  uint64_t send_us;
+  struct sockaddr_in peer;
+  uint8_t packet[NTP_PACKET_SIZE];
+} standin_reply_t;
+
+typedef struct {
+  uint32_t address; // Network order, 0 for a free slot
+  uint64_t last_us; // Host time of its last request
+} standin_client_t;
+
+typedef struct {
+  uint32_t at;                       // Request number the line applies from
+  char text[STANDIN_LINE_LENGTH];
+} standin_step_t;
+
+static standin_params_t params = { 0.0, 0.0, STANDIN_EXP, 0.0, 0.0, 0.0, 0.0, 0.0, 1, 0, 0, 1.0, 0, 0, 0, 64 };
+static standin_reply_t pending[STANDIN_PENDING]; // Min-heap on send_us
+static uint32_t pending_count = 0;
+static standin_client_t clients[STANDIN_CLIENTS];
+static standin_step_t script[STANDIN_SCRIPT_MAX];
+static uint32_t script_count = 0;
+static uint32_t script_next  = 0;
+static uint64_t start_us;
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+// Load generator state, indexed by request number
+static struct {
+  uint32_t sent;
+  uint32_t replies;
+  uint32_t duplicates;
+  uint32_t unsynced;
+  uint32_t bad;
+  uint32_t max_service_us;
+  uint64_t start_us;
+  uint64_t *sent_us;
+  uint32_t *round_trip_us; // In order of arrival
+  uint32_t *answered;      // Per second of sending
+  uint8_t *seen;
+} load;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static uint64_t standin_host_us(void);
+static uint64_t standin_served_us(uint64_t host_us);
+static double standin_random(void);
+static double standin_one_way_ms(void);
+static bool standin_apply(const char *assignment);
+static bool standin_apply_line(const char *line);
+static bool standin_load_script(const char *path);
+static void standin_push(const standin_reply_t *reply);
+static void standin_pop(standin_reply_t *reply);
+static bool standin_limited(const struct sockaddr_in *peer, uint64_t host_us);
+static void standin_request(const uint8_t *buffer, const struct sockaddr_in *peer, uint32_t number);
+static void standin_broadcast(int sock);
+static uint64_t standin_monotonic_us(void);
+static int standin_compare_u32(const void *a, const void *b);
+static void standin_load_reply(const uint8_t *buffer, ssize_t length, uint64_t now);
+static int standin_load(const char *target, uint16_t port, uint32_t rate, uint32_t seconds);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  struct sockaddr_in local = { 0 };
+  struct sockaddr_in peer;
+  socklen_t peer_length;
+  struct pollfd descriptor;
+  standin_reply_t reply;
+  uint8_t buffer[NTP_PACKET_SIZE * 2u];
+  uint16_t port       = NTP_PORT;
+  uint32_t requests   = 0;
+  const char *target  = NULL;
+  uint32_t load_rate  = 1000;
+  uint32_t load_s     = 10;
+  uint64_t next_bcast = 0;
+  uint64_t now;
+  int64_t wait_ms;
+  int enable = 1;
+  int sock;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "-p") == 0) && (i + 1 < argc)) {
+      port = (uint16_t)strtoul(argv[++i], NULL, 0);
+    } else if ((strcmp(argv[i], "-L") == 0) && (i + 1 < argc)) {
+      target = argv[++i];
+    } else if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) {
+      load_rate = (uint32_t)strtoul(argv[++i], NULL, 0);
+    } else if ((strcmp(argv[i], "-d") == 0) && (i + 1 < argc)) {
+      load_s = (uint32_t)strtoul(argv[++i], NULL, 0);
+    } else if ((strcmp(argv[i], "-x") == 0) && (i + 1 < argc)) {
+      if (!standin_load_script(argv[++i])) {
+        return 2;
+      }
+    } else if (!standin_apply(argv[i])) {
+      fprintf(stderr, "usage: see the file header of ntp_standin.c, bad argument %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  if (target != NULL) {
+    return standin_load(target, port, load_rate, load_s);
+  }
+
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+  local.sin_family      = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port        = htons(port);
+  if ((sock < 0) || (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0)) {
+    perror("bind");
+    return 1;
+  }
+  start_us = standin_host_us();
+  fprintf(stderr, "NTP stand-in on UDP port %u\n", port);
+
+  descriptor.fd     = sock;
+  descriptor.events = POLLIN;
+  while (1) {
+    now = standin_host_us();
+    while ((pending_count != 0) && (pending[0].send_us <= now)) {
+      standin_pop(&reply);
+      sendto(sock, reply.packet, NTP_PACKET_SIZE, 0, (struct sockaddr *)&reply.peer, sizeof(reply.peer));
+    }
+    if ((params.bcast != 0) && (now >= next_bcast)) {
+      standin_broadcast(sock);
+      next_bcast = now + (uint64_t)params.bint_s * 1000000u;
+    }
+    wait_ms = (pending_count != 0) ? (int64_t)((pending[0].send_us - now) / 1000u) : 1000;
+    if ((params.bcast != 0) && ((int64_t)((next_bcast - now) / 1000u) < wait_ms)) {
+      wait_ms = (int64_t)((next_bcast - now) / 1000u);
+    }
+    if (poll(&descriptor, 1, (int)wait_ms) <= 0) {
+      continue;
+    }
+    peer_length = sizeof(peer);
+    if (recvfrom(sock, buffer, sizeof(buffer), 0, (struct sockaddr *)&peer, &peer_length)
+        < (ssize_t)NTP_PACKET_SIZE) {
+      continue;
+    }
+    requests++;
+    while ((script_next < script_count) && (script[script_next].at <= requests)) {
+      standin_apply_line(script[script_next++].text);
+    }
+    standin_request(buffer, &peer, requests);
+  }
+  return 0;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static uint64_t standin_host_us(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+// The clock the clients see: host time, offset and a rate error since start
+static uint64_t standin_served_us(uint64_t host_us)
+{
+  double skew_us = params.offset_ms * 1000.0 + (double)(host_us - start_us) * params.freq_ppm / 1e6;
+
+  return (uint64_t)((int64_t)host_us + (int64_t)llround(skew_us));
+}
+
+// xorshift64*, uniform in (0, 1)
+static double standin_random(void)
+{
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return ((double)((rng * 0x2545F4914F6CDD1Dull) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double standin_one_way_ms(void)
+{
+  double u = standin_random();
+  double v;
+  double extra;
+
+  switch (params.dist) {
+    case STANDIN_UNIFORM:
+      extra = u * params.jitter_ms;
+      break;
+    case STANDIN_NORMAL:
+      // Half normal, delays only add
+      v     = standin_random();
+      extra = fabs(sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v)) * params.jitter_ms;
+      break;
+    case STANDIN_PARETO:
+      // Shape 1.5: rare very long queues, as with bufferbloat
+      extra = params.jitter_ms * (pow(u, -1.0 / 1.5) - 1.0);
+      break;
+    case STANDIN_EXP:
+    default:
+      extra = -log(u) * params.jitter_ms;
+      break;
+  }
+  return params.delay_ms + extra;
+}
+
+static bool standin_apply(const char *assignment)
+{
+  const char *value = strchr(assignment, '=');
+  size_t key_length;
+
+  if (value == NULL) {
+    return false;
+  }
+  key_length = (size_t)(value - assignment);
+  value++;
+#define STANDIN_KEY(name) ((key_length == sizeof(name) - 1u) && (strncmp(assignment, name, key_length) == 0))
+  if (STANDIN_KEY("delay")) {
+    params.delay_ms = atof(value);
+  } else if (STANDIN_KEY("jitter")) {
+    params.jitter_ms = atof(value);
+  } else if (STANDIN_KEY("dist")) {
+    if (strcmp(value, "uniform") == 0) {
+      params.dist = STANDIN_UNIFORM;
+    } else if (strcmp(value, "normal") == 0) {
+      params.dist = STANDIN_NORMAL;
+    } else if (strcmp(value, "pareto") == 0) {
+      params.dist = STANDIN_PARETO;
+    } else if (strcmp(value, "exp") == 0) {
+      params.dist = STANDIN_EXP;
+    } else {
+      return false;
+    }
+  } else if (STANDIN_KEY("asym")) {
+    params.asym_ms = atof(value);
+  } else if (STANDIN_KEY("loss")) {
+    params.loss = atof(value);
+  } else if (STANDIN_KEY("dup")) {
+    params.dup = atof(value);
+  } else if (STANDIN_KEY("offset")) {
+    params.offset_ms = atof(value);
+  } else if (STANDIN_KEY("freq")) {
+    params.freq_ppm = atof(value);
+  } else if (STANDIN_KEY("stratum")) {
+    params.stratum = (uint8_t)atoi(value);
+  } else if (STANDIN_KEY("leap")) {
+    params.leap = (uint8_t)(atoi(value) & 0x3);
+  } else if (STANDIN_KEY("kod")) {
+    if (strcmp(value, "none") == 0) {
+      params.kod = 0;
+    } else if (strlen(value) == 4u) {
+      params.kod = ((uint32_t)(uint8_t)value[0] << 24) | ((uint32_t)(uint8_t)value[1] << 16)
+                   | ((uint32_t)(uint8_t)value[2] << 8) | (uint32_t)(uint8_t)value[3];
+    } else {
+      return false;
+    }
+  } else if (STANDIN_KEY("kodp")) {
+    params.kod_p = atof(value);
+  } else if (STANDIN_KEY("poll")) {
+    params.poll = (int8_t)atoi(value);
+  } else if (STANDIN_KEY("limit")) {
+    params.limit = (int8_t)atoi(value);
+  } else if (STANDIN_KEY("seed")) {
+    rng = strtoull(value, NULL, 0) | 1u;
+  } else if (STANDIN_KEY("bcast")) {
+    return inet_pton(AF_INET, value, &params.bcast) == 1;
+  } else if (STANDIN_KEY("bint")) {
+    params.bint_s = (uint32_t)strtoul(value, NULL, 0);
+  } else {
+    return false;
+  }
+#undef STANDIN_KEY
+  return true;
+}
+
+static bool standin_apply_line(const char *line)
+{
+  char copy[STANDIN_LINE_LENGTH];
+  char *token;
+  bool ok = true;
+
+  strncpy(copy, line, sizeof(copy) - 1u);
+  copy[sizeof(copy) - 1u] = '\0';
+  for (token = strtok(copy, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n")) {
+    if (!standin_apply(token)) {
+      fprintf(stderr, "script: bad assignment %s\n", token);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+static bool standin_load_script(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  char line[STANDIN_LINE_LENGTH];
+  char *rest;
+  unsigned long at;
+
+  if (file == NULL) {
+    perror(path);
+    return false;
+  }
+  while ((fgets(line, sizeof(line), file) != NULL) && (script_count < STANDIN_SCRIPT_MAX)) {
+    if ((line[0] == '#') || (line[0] == '\n')) {
+      continue;
+    }
+    at = strtoul(line, &rest, 10);
+    if (rest == line) {
+      continue;
+    }
+    script[script_count].at = (uint32_t)at;
+    strncpy(script[script_count].text, rest, STANDIN_LINE_LENGTH - 1u);
+    script_count++;
+  }
+  fclose(file);
+  return true;
+}
+
+static void standin_push(const standin_reply_t *reply)
+{
+  standin_reply_t swap;
+  uint32_t i = pending_count++;
+
+  pending[i] = *reply;
+  while ((i != 0) && (pending[(i - 1u) / 2u].send_us > pending[i].send_us)) {
+    swap                   = pending[i];
+    pending[i]             = pending[(i - 1u) / 2u];
+    pending[(i - 1u) / 2u] = swap;
+    i                      = (i - 1u) / 2u;
+  }
+}
+
+static void standin_pop(standin_reply_t *reply)
+{
+  standin_reply_t swap;
+  uint32_t i = 0;
+  uint32_t child;
+
+  *reply     = pending[0];
+  pending[0] = pending[--pending_count];
+  while ((child = 2u * i + 1u) < pending_count) {
+    if ((child + 1u < pending_count) && (pending[child + 1u].send_us < pending[child].send_us)) {
+      child++;
+    }
+    if (pending[i].send_us <= pending[child].send_us) {
+      break;
+    }
+    swap           = pending[i];
+    pending[i]     = pending[child];
+    pending[child] = swap;
+    i              = child;
+  }
+}
+
+// Whether the peer polled within 2^limit s. Every request counts, a client
+// that ignores the kiss keeps being kissed.
+static bool standin_limited(const struct sockaddr_in *peer, uint64_t host_us)
+{
+  standin_client_t *slot = &clients[0];
+  bool limited;
+  uint32_t i;
+
+  for (i = 0; i < STANDIN_CLIENTS; i++) {
+    if (clients[i].address == peer->sin_addr.s_addr) {
+      slot = &clients[i];
+      break;
+    }
+    // Otherwise a free slot, or the least recent client
+    if ((slot->address != 0) && ((clients[i].address == 0) || (clients[i].last_us < slot->last_us))) {
+      slot = &clients[i];
+    }
+  }
+  limited = (params.limit > 0) && (slot->address == peer->sin_addr.s_addr)
+            && ((host_us - slot->last_us) < (1000000ull << params.limit));
+  slot->address = peer->sin_addr.s_addr;
+  slot->last_us = host_us;
+  return limited;
+}
+
+// The request is taken to arrive after the forward delay: T2 and T3 are
+// stamped that far ahead, the reply leaves after the return delay on top
+static void standin_request(const uint8_t *buffer, const struct sockaddr_in *peer, uint32_t number)
+{
+  ntp_packet_t request;
+  ntp_packet_t reply = { 0 };
+  standin_reply_t held;
+  uint64_t host_us = standin_host_us();
+  double forward_ms;
+  double return_ms;
+  uint32_t kiss = 0;
+
+  if (!ntp_packet_decode(buffer, NTP_PACKET_SIZE, &request) || (request.mode != NTP_MODE_CLIENT)) {
+    return;
+  }
+  if (standin_random() < params.loss) {
+    printf("%u lost\n", number);
+    fflush(stdout);
+    return;
+  }
+  forward_ms = standin_one_way_ms() + params.asym_ms;
+  return_ms  = standin_one_way_ms();
+  if ((params.kod != 0) && (standin_random() < params.kod_p)) {
+    kiss = params.kod;
+  }
+
+  reply.version   = request.version;
+  reply.mode      = NTP_MODE_SERVER;
+  reply.poll      = (request.poll > params.poll) ? request.poll : params.poll;
+  reply.precision = STANDIN_PRECISION;
+  reply.origin    = request.transmit;
+  if (standin_limited(peer, host_us) && (kiss == 0)) {
+    kiss = NTP_KISS_RATE;
+    if (reply.poll < params.limit) {
+      reply.poll = params.limit;
+    }
+  }
+  if (kiss != 0) {
+    reply.leap         = NTP_LEAP_UNSYNC;
+    reply.stratum      = 0;
+    reply.reference_id = kiss;
+  } else {
+    reply.leap         = params.leap;
+    reply.stratum      = params.stratum;
+    reply.reference_id = STANDIN_REFID;
+    reply.reference    = ntp_time_from_unix(unix_time_from_us((int64_t)(standin_served_us(host_us) - 1000000u)));
+    reply.receive      = ntp_time_from_unix(
+      unix_time_from_us((int64_t)standin_served_us(host_us + (uint64_t)llround(forward_ms * 1000.0))));
+    reply.transmit     = reply.receive;
+  }
+  ntp_packet_encode(&reply, held.packet);
+  held.peer    = *peer;
+  held.send_us = host_us + (uint64_t)llround((forward_ms + return_ms) * 1000.0);
+  if (pending_count < STANDIN_PENDING) {
+    standin_push(&held);
+  }
+  if ((standin_random() < params.dup) && (pending_count < STANDIN_PENDING)) {
+    held.send_us += 1000u;
+    standin_push(&held);
+  }
+  printf("%u %s:%u fwd %.3f ms ret %.3f ms%s%s\n",
+         number,
+         inet_ntoa(peer->sin_addr),
+         ntohs(peer->sin_port),
+         forward_ms,
+         return_ms,
+         (kiss != 0) ? " kod" : "",
+         (pending_count >= STANDIN_PENDING) ? " queue full" : "");
+  fflush(stdout);
+}
+
+static void standin_broadcast(int sock)
+{
+  struct sockaddr_in target = { 0 };
+  ntp_packet_t packet       = { 0 };
+  uint8_t buffer[NTP_PACKET_SIZE];
+  uint64_t host_us = standin_host_us();
+
+  target.sin_family      = AF_INET;
+  target.sin_addr.s_addr = params.bcast;
+  target.sin_port        = htons(NTP_PORT);
+  packet.leap            = params.leap;
+  packet.version         = NTP_VERSION;
+  packet.mode            = NTP_MODE_BROADCAST;
+  packet.stratum         = params.stratum;
+  packet.poll            = 6;
+  packet.precision       = STANDIN_PRECISION;
+  packet.reference_id    = STANDIN_REFID;
+  packet.reference       = ntp_time_from_unix(unix_time_from_us((int64_t)(standin_served_us(host_us) - 1000000u)));
+  packet.transmit        = ntp_time_from_unix(unix_time_from_us((int64_t)standin_served_us(host_us)));
+  ntp_packet_encode(&packet, buffer);
+  sendto(sock, buffer, sizeof(buffer), 0, (struct sockaddr *)&target, sizeof(target));
+}
+
+static uint64_t standin_monotonic_us(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+static int standin_compare_u32(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void standin_load_reply(const uint8_t *buffer, ssize_t length, uint64_t now)
+{
+  ntp_packet_t reply;
+  uint32_t index;
+  int64_t service_us;
+
+  if ((length < (ssize_t)NTP_PACKET_SIZE) || !ntp_packet_decode(buffer, (size_t)length, &reply)
+      || (reply.mode != NTP_MODE_SERVER) || (ntp_time_fraction(reply.origin) != STANDIN_LOAD_MAGIC)
+      || (ntp_time_seconds(reply.origin) >= load.sent)) {
+    load.bad++;
+    return;
+  }
+  index = ntp_time_seconds(reply.origin);
+  if (load.seen[index] != 0) {
+    load.duplicates++;
+    return;
+  }
+  load.seen[index]                    = 1;
+  load.round_trip_us[load.replies++] = (uint32_t)(now - load.sent_us[index]);
+  load.answered[(load.sent_us[index] - load.start_us) / 1000000u]++;
+  if ((reply.leap == NTP_LEAP_UNSYNC) || (reply.stratum == 0) || (reply.stratum > NTP_STRATUM_MAX)) {
+    load.unsynced++;
+    return;
+  }
+  service_us = time_q32_to_us(ntp_time_diff(reply.transmit, reply.receive));
+  if (service_us > (int64_t)load.max_service_us) {
+    load.max_service_us = (service_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)service_us;
+  }
+}
+
+// Paced client requests, the request number travels in the transmit stamp
+static int standin_load(const char *target, uint16_t port, uint32_t rate, uint32_t seconds)
+{
+  struct sockaddr_in server = { 0 };
+  struct pollfd descriptor;
+  ntp_packet_t request = { 0 };
+  uint8_t packet[NTP_PACKET_SIZE];
+  uint8_t buffer[NTP_PACKET_SIZE * 2u];
+  uint32_t total = rate * seconds;
+  uint32_t sent_in_second;
+  uint64_t due_us;
+  uint64_t end_us;
+  uint64_t now;
+  ssize_t length;
+  uint32_t second;
+  int timeout_ms;
+  int sock;
+
+  server.sin_family = AF_INET;
+  server.sin_port   = htons(port);
+  if ((rate == 0) || (seconds == 0) || (inet_pton(AF_INET, target, &server.sin_addr) != 1)) {
+    fprintf(stderr, "usage: see the file header of ntp_standin.c\n");
+    return 2;
+  }
+  load.sent_us       = calloc(total, sizeof(load.sent_us[0]));
+  load.round_trip_us = calloc(total, sizeof(load.round_trip_us[0]));
+  load.answered      = calloc(seconds, sizeof(load.answered[0]));
+  load.seen          = calloc(total, sizeof(load.seen[0]));
+  sock               = socket(AF_INET, SOCK_DGRAM, 0);
+  if ((load.sent_us == NULL) || (load.round_trip_us == NULL) || (load.answered == NULL) || (load.seen == NULL)
+      || (sock < 0)) {
+    fprintf(stderr, "out of memory or sockets\n");
+    return 1;
+  }
+  request.version   = NTP_VERSION;
+  request.mode      = NTP_MODE_CLIENT;
+  descriptor.fd     = sock;
+  descriptor.events = POLLIN;
+  load.start_us     = standin_monotonic_us();
+  end_us            = load.start_us + (uint64_t)seconds * 1000000u + STANDIN_LOAD_DRAIN;
+
+  while ((now = standin_monotonic_us()) < end_us) {
+    while (load.sent < total) {
+      due_us = load.start_us + ((uint64_t)load.sent * 1000000u) / rate;
+      if (due_us > now) {
+        break;
+      }
+      request.transmit = ntp_time_make(load.sent, STANDIN_LOAD_MAGIC);
+      ntp_packet_encode(&request, packet);
+      load.sent_us[load.sent] = standin_monotonic_us();
+      sendto(sock, packet, sizeof(packet), 0, (struct sockaddr *)&server, sizeof(server));
+      load.sent++;
+    }
+    // Wait for a reply or the next request, whichever comes first
+    timeout_ms = (load.sent < total)
+                   ? (int)((load.start_us + ((uint64_t)load.sent * 1000000u) / rate - now) / 1000u)
+                   : (int)((end_us - now) / 1000u);
+    if (poll(&descriptor, 1, timeout_ms) <= 0) {
+      continue;
+    }
+    while ((length = recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+      standin_load_reply(buffer, length, standin_monotonic_us());
+    }
+  }
+  close(sock);
+
+  printf("second,sent,answered\n");
+  for (second = 0; second < seconds; second++) {
+    sent_in_second = (load.sent > second * rate) ? (load.sent - second * rate) : 0u;
+    sent_in_second = (sent_in_second > rate) ? rate : sent_in_second;
+    printf("%u,%u,%u\n", second, sent_in_second, load.answered[second]);
+  }
+  fprintf(stderr, "%u requests to %s:%u at %u per s, %u replies, %u lost, %u duplicates, %u unsynchronized, %u bad\n",
+          load.sent,
+          target,
+          port,
+          rate,
+          load.replies,
+          load.sent - load.replies,
+          load.duplicates,
+          load.unsynced,
+          load.bad);
+  fprintf(stderr, "%.0f replies per s\n", (double)load.replies / seconds);
+  if (load.replies != 0) {
+    qsort(load.round_trip_us, load.replies, sizeof(load.round_trip_us[0]), standin_compare_u32);
+    fprintf(stderr, "round trip us: p50 %u, p90 %u, p99 %u, max %u; server T3 - T2 at most %u us\n",
+            load.round_trip_us[load.replies / 2u],
+            load.round_trip_us[(load.replies * 9u) / 10u],
+            load.round_trip_us[(load.replies * 99u) / 100u],
+            load.round_trip_us[load.replies - 1u],
+            load.max_service_us);
+  }
+  return (load.replies == 0) ? 1 : 0;
+}
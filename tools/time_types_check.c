@@ -0,0 +1,298 @@
+/***************************************************************************/ /**
+ * @file time_types_check.c
+ * @brief Host check of the time_types.h conversions and fixed point helpers
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory, a 64 bit host for __int128:
+ *   cc -O2 -I.. -o time_types_check time_types_check.c ../ntp_packet.c
+ *
+ *   time_types_check [-n cases] [-S seed]
+ *
+ * Every helper runs on -n random inputs plus the edge cases, against the
+ * host's gmtime_r() or 128 bit integer arithmetic: calendar conversions over
+ * 1900 to 2260, NTP era resolution on both sides of the 2036 rollover, the
+ * Q32.32 conversions, time_scale_ppb() and time_ratio_ppb() with saturation,
+ * time_isqrt(), and ntp_sample_compute() against the exact offset and delay,
+ * also with the local clock still at the boot tick and the server up to 2090.
+ * One line per helper gives the cases and mismatches, the exit status is 1 on
+ * any.
+ ******************************************************************************/
+#define _DEFAULT_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ntp_packet.h"
+#include "time_types.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define CHECK_FIRST_S  (-2208988800ll) // 1900-01-01
+#define CHECK_LAST_S   9151488000ll    // 2260-01-01
+#define CHECK_ERA_S    2085978496ll    // 2036-02-07 06:28:16, NTP era 1
+#define CHECK_PIVOT_S  3786825600ll    // 2090-01-01, within 68 years of TIME_PIVOT_UNIX_S
+#define CHECK_BOOT_S   2592000ll       // Uptime range of a local clock not yet set, 30 days
+#define CHECK_PRINT    3u              // Mismatches printed per helper
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef struct {
+  const char *name;
+  uint64_t cases;
+  uint64_t failed;
+} check_t;
+
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static uint64_t check_random(void);
+static int64_t check_range(int64_t low, int64_t high);
+static void check(check_t *check, bool ok, const char *format, long long a, long long b);
+static void check_civil(check_t *result, int64_t seconds);
+static void check_era(check_t *result, int64_t ns, int64_t pivot_s);
+static void check_q32(check_t *result, int64_t micros);
+static void check_scale(check_t *result, int64_t value, int32_t ppb);
+static void check_ratio(check_t *result, int64_t change, int64_t baseline);
+static void check_isqrt(check_t *result, uint64_t value);
+static void check_sample(check_t *result, int64_t t1_us, int64_t offset_ns, uint32_t delay_ns);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  static const int64_t edges[] = { 0, 1, -1, 999999999, 1000000000, -1000000000, INT32_MAX, INT32_MIN,
+                                   INT64_MAX / 2, INT64_MIN / 2, INT64_MAX, INT64_MIN + 1 };
+  static const int32_t edge_ppb[] = { 0, 1, -1, 1000000000, -1000000000, INT32_MAX, INT32_MIN };
+  check_t checks[] = { { "civil", 0, 0 }, { "era", 0, 0 },   { "q32", 0, 0 },
+                       { "scale_ppb", 0, 0 }, { "ratio_ppb", 0, 0 }, { "sample", 0, 0 },
+                       { "isqrt", 0, 0 } };
+  uint64_t cases = 1000000;
+  uint64_t failed = 0;
+  int64_t boot_us;
+  uint64_t n;
+  size_t i;
+  size_t j;
+  int arg;
+
+  for (arg = 1; arg + 1 < argc; arg += 2) {
+    if (strcmp(argv[arg], "-n") == 0) {
+      cases = strtoull(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-S") == 0) {
+      rng = strtoull(argv[arg + 1], NULL, 0) | 1u;
+    } else {
+      break;
+    }
+  }
+  if (arg != argc) {
+    fprintf(stderr, "usage: see the file header of time_types_check.c\n");
+    return 2;
+  }
+
+  for (i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+    for (j = 0; j < sizeof(edge_ppb) / sizeof(edge_ppb[0]); j++) {
+      check_scale(&checks[3], edges[i], edge_ppb[j]);
+    }
+    for (j = 0; j < sizeof(edges) / sizeof(edges[0]); j++) {
+      if (edges[j] != 0) {
+        check_ratio(&checks[4], edges[i], edges[j]);
+      }
+    }
+    check_isqrt(&checks[6], (uint64_t)edges[i]);
+  }
+  check_isqrt(&checks[6], UINT64_MAX);
+  check_isqrt(&checks[6], (uint64_t)UINT32_MAX * UINT32_MAX);
+  check_isqrt(&checks[6], (uint64_t)UINT32_MAX * UINT32_MAX - 1u);
+  check_civil(&checks[0], CHECK_ERA_S - 1);
+  check_civil(&checks[0], CHECK_ERA_S);
+  check_era(&checks[1], (CHECK_ERA_S - 1) * TIME_NS_PER_SECOND, TIME_PIVOT_UNIX_S);
+  check_era(&checks[1], CHECK_ERA_S * TIME_NS_PER_SECOND, TIME_PIVOT_UNIX_S);
+  check_sample(&checks[5], (CHECK_ERA_S - 1) * 1000000, 1500000000, 40000000);
+  // Before the first sync the local clock counts from the boot tick near 1970
+  check_sample(&checks[5], 3600ll * 1000000, (CHECK_ERA_S + 1 - 3600) * TIME_NS_PER_SECOND, 40000000);
+  check_sample(&checks[5], 3600ll * 1000000, (CHECK_PIVOT_S - 3600) * TIME_NS_PER_SECOND, 40000000);
+
+  for (n = 0; n < cases; n++) {
+    check_civil(&checks[0], check_range(CHECK_FIRST_S, CHECK_LAST_S));
+    // Any time in 1900 to 2260 against a pivot up to 60 years away
+    check_era(&checks[1],
+              check_range(CHECK_FIRST_S, CHECK_LAST_S) * TIME_NS_PER_SECOND + check_range(0, TIME_NS_PER_SECOND - 1),
+              0);
+    check_q32(&checks[2], check_range(-(1ll << 31) * 1000000 + 1, ((1ll << 31) - 1) * 1000000));
+    check_scale(&checks[3], (int64_t)check_random() >> check_range(0, 63), (int32_t)check_random());
+    check_ratio(&checks[4], (int64_t)check_random() >> check_range(0, 63), ((int64_t)check_random() >> check_range(0, 62)) | 1);
+    check_sample(&checks[5],
+                 check_range(0, CHECK_LAST_S - 100000) * 1000000,
+                 check_range(-3600ll * TIME_NS_PER_SECOND, 3600ll * TIME_NS_PER_SECOND),
+                 (uint32_t)check_range(0, 2000000000));
+    boot_us = check_range(0, CHECK_BOOT_S * 1000000);
+    check_sample(&checks[5],
+                 boot_us,
+                 check_range(UNIX_TIME_NS_FROM_S(TIME_PIVOT_UNIX_S), UNIX_TIME_NS_FROM_S(CHECK_PIVOT_S)) - boot_us * 1000,
+                 (uint32_t)check_range(0, 2000000000));
+    check_isqrt(&checks[6], check_random() >> check_range(0, 63));
+  }
+
+  for (i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+    printf("%-10s %10llu cases %llu mismatches\n",
+           checks[i].name,
+           (unsigned long long)checks[i].cases,
+           (unsigned long long)checks[i].failed);
+    failed += checks[i].failed;
+  }
+  return (failed != 0) ? 1 : 0;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// xorshift64*
+static uint64_t check_random(void)
+{
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return rng * 0x2545F4914F6CDD1Dull;
+}
+
+static int64_t check_range(int64_t low, int64_t high)
+{
+  return low + (int64_t)(check_random() % (uint64_t)(high - low + 1));
+}
+
+static void check(check_t *check, bool ok, const char *format, long long a, long long b)
+{
+  check->cases++;
+  if (ok) {
+    return;
+  }
+  if (check->failed++ < CHECK_PRINT) {
+    printf("%s: ", check->name);
+    printf(format, a, b);
+    printf("\n");
+  }
+}
+
+static void check_civil(check_t *result, int64_t seconds)
+{
+  time_t host    = (time_t)seconds;
+  civil_time_t civil = civil_from_unix(unix_time_from_s(seconds));
+  struct tm expected;
+
+  gmtime_r(&host, &expected);
+  check(result,
+        (civil.year == expected.tm_year + 1900) && (civil.month == expected.tm_mon + 1)
+          && (civil.day == expected.tm_mday) && (civil.hour == expected.tm_hour)
+          && (civil.minute == expected.tm_min) && (civil.second == expected.tm_sec)
+          && (civil.weekday == expected.tm_wday) && (unix_time_s(civil_to_unix(civil)) == seconds),
+        "%lld s, year %lld",
+        (long long)seconds,
+        (long long)civil.year);
+}
+
+static void check_era(check_t *result, int64_t ns, int64_t pivot_s)
+{
+  unix_time_t time = { ns };
+  unix_time_t back;
+
+  if (pivot_s == 0) {
+    pivot_s = unix_time_s(time) + check_range(-60ll * 365 * TIME_SECONDS_DAY, 60ll * 365 * TIME_SECONDS_DAY);
+  }
+  back = ntp_time_to_unix(ntp_time_from_unix(time), unix_time_from_s(pivot_s));
+  // The fraction holds 2^-32 s, both conversions round down
+  check(result, (back.ns <= ns) && (ns - back.ns <= 1), "%lld ns came back as %lld", (long long)ns, (long long)back.ns);
+}
+
+static void check_q32(check_t *result, int64_t micros)
+{
+  time_q32_t q32     = time_q32_from_us(micros);
+  __int128 exact     = ((__int128)micros << 32) / 1000000;
+  __int128 error     = (__int128)q32.value - exact;
+
+  check(result,
+        (time_q32_to_us(q32) == micros) && (error >= -1) && (error <= 1),
+        "%lld us came back as %lld",
+        (long long)micros,
+        (long long)time_q32_to_us(q32));
+}
+
+static void check_scale(check_t *result, int64_t value, int32_t ppb)
+{
+  __int128 exact = ((__int128)value * ppb) / TIME_NS_PER_SECOND;
+
+  if (exact > INT64_MAX) {
+    exact = INT64_MAX;
+  } else if (exact < INT64_MIN) {
+    exact = INT64_MIN;
+  }
+  check(result, time_scale_ppb(value, ppb) == (int64_t)exact, "%lld scaled by %lld ppb", (long long)value, (long long)ppb);
+}
+
+static void check_ratio(check_t *result, int64_t change, int64_t baseline)
+{
+  __int128 exact = ((__int128)change * TIME_NS_PER_SECOND) / baseline;
+  int32_t ratio  = time_ratio_ppb(change, baseline);
+  __int128 error;
+
+  if (exact > INT32_MAX) {
+    exact = INT32_MAX;
+  } else if (exact < INT32_MIN) {
+    exact = INT32_MIN;
+  }
+  // Baselines beyond 2^33 drop low bits, relative error 2^-33 plus rounding
+  error = (__int128)ratio - exact;
+  check(result, (error >= -2) && (error <= 2), "%lld over %lld", (long long)change, (long long)baseline);
+}
+
+// A server offset_ns ahead with a symmetric path, its T2/T3 rounded to the
+// wire format. The sample must match to the microsecond.
+static void check_sample(check_t *result, int64_t t1_us, int64_t offset_ns, uint32_t delay_ns)
+{
+  int64_t t1_ns = t1_us * 1000;
+  int64_t t2_ns = t1_ns + offset_ns + delay_ns / 2u;
+  int64_t t4_us = (t2_ns - offset_ns + (int64_t)(delay_ns - delay_ns / 2u)) / 1000;
+  ntp_packet_t reply = { 0 };
+  ntp_sample_t sample;
+  ntp_time_t wire;
+  int64_t expected_us;
+
+  wire           = ntp_time_from_unix((unix_time_t){ t2_ns });
+  reply.receive  = wire;
+  reply.transmit = wire;
+  ntp_sample_compute((uint64_t)t1_us, (uint64_t)t4_us, &reply, 1, &sample);
+  expected_us = ((t2_ns - t1_ns) + (t2_ns - t4_us * 1000)) / 2000;
+  check(result,
+        (llabs(sample.offset_us - expected_us) <= 1) && (llabs((long long)sample.delay_us - (t4_us - t1_us)) <= 1),
+        "offset %lld us, expected %lld",
+        (long long)sample.offset_us,
+        (long long)expected_us);
+}
+
+static void check_isqrt(check_t *result, uint64_t value)
+{
+  unsigned __int128 root = time_isqrt(value);
+
+  check(result,
+        (root * root <= value) && ((root + 1u) * (root + 1u) > value),
+        "root of %lld came out as %lld",
+        (long long)value,
+        (long long)root);
+}
@@ -0,0 +1,310 @@
+/***************************************************************************/ /**
+ * @file trace_replay.c
+ * @brief Host replay of captured SNTP traces through the client, filter and
+ *        discipline code
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ *******************************************************************************
+ *
+ * Build on the host from this directory:
+ *   cc -O2 -I.. -o trace_replay trace_replay.c ../ntp_packet.c \
+ *      ../clock_filter.c ../sync_plan.c ../calib_ctrl.c -lm
+ *
+ * Capture with SNTP_TRACE set to 1 in sntp_app.c and feed the UART log:
+ *   trace_replay [-b budget_us] [-c calib_budget_ppb] < uart.log > offsets.csv
+ *
+ * Lines without "TR " are skipped, so a raw console log can be replayed.
+ *   TR R <tick ms> <T1> <T4> <packet hex>     unicast reply, T1/T4 Unix s.us
+ *   TR B <tick ms> <one way us> <T4> <hex>    broadcast
+ *   TR C <tick ms> <calendar UTC s>           RTC reading
+ *   TR L <tick ms> <0|1>                      link down/up
+ *   TR S <tick ms> 0                          filter reset on the device
+ *
+ * One CSV row per packet goes to stdout, a summary to stderr. The run is
+ * deterministic, all time comes from the trace.
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "ntp_packet.h"
+#include "clock_filter.h"
+#include "sync_plan.h"
+#include "calib_ctrl.h"
+
+/*******************************************************************************
+ ***************************  Defines / Macros  ********************************
+ ******************************************************************************/
+#define REPLAY_LINE_LENGTH     512
+#define REPLAY_LOCAL_PRECISION 1u      // sntp_app.c NTP_LOCAL_PRECISION_US
+#define REPLAY_BUDGET_US       50000u  // sntp_app.c SNTP_ACCURACY_BUDGET
+#define REPLAY_MIN_POLL        6u
+#define REPLAY_MAX_POLL        12u
+#define REPLAY_CALIB_BUDGET    20000u  // calendar_app.c CALIBRATION_BUDGET_PPB
+#define REPLAY_CALIB_BASELINE  3600u   // calendar_app.c CALIBRATION_MIN_BASELINE
+#define REPLAY_CALIB_LEVELS    6u
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+typedef struct {
+  clock_filter_t filter;
+  sync_plan_t plan;
+  calib_ctrl_t calib;
+  uint32_t packets;
+  uint32_t updates;
+  uint32_t resets;
+  uint32_t link_downs;
+  uint32_t calib_actions;
+  double offset_sum_sq;    // Filtered offsets, for the RMS
+  double offset_max;
+  uint32_t first_tick_ms;
+  uint32_t last_tick_ms;
+  bool have_tick;
+  bool have_rtc;
+  uint32_t rtc_first_tick;
+  uint32_t rtc_first_second;
+  uint32_t rtc_last_tick;
+  uint32_t rtc_last_second;
+} replay_t;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static bool replay_parse_us(const char *text, uint64_t *micros);
+static bool replay_parse_hex(const char *text, uint8_t *packet);
+static void replay_packet(replay_t *replay, uint32_t tick_ms, uint64_t t1, uint64_t t4, uint32_t one_way_us, const uint8_t *raw);
+static void replay_line(replay_t *replay, const char *line);
+static void replay_summary(const replay_t *replay, double wall_s);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+int main(int argc, char **argv)
+{
+  static replay_t replay;
+  char line[REPLAY_LINE_LENGTH];
+  uint32_t budget_us       = REPLAY_BUDGET_US;
+  uint32_t calib_budget    = REPLAY_CALIB_BUDGET;
+  struct timespec start;
+  struct timespec end;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "-b") == 0) && (i + 1 < argc)) {
+      budget_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+    } else if ((strcmp(argv[i], "-c") == 0) && (i + 1 < argc)) {
+      calib_budget = (uint32_t)strtoul(argv[++i], NULL, 0);
+    } else {
+      fprintf(stderr, "usage: %s [-b budget_us] [-c calib_budget_ppb] < trace\n", argv[0]);
+      return 2;
+    }
+  }
+  clock_filter_reset(&replay.filter);
+  sync_plan_init(&replay.plan, budget_us, REPLAY_MIN_POLL, REPLAY_MAX_POLL);
+  calib_ctrl_init(&replay.calib, calib_budget, REPLAY_CALIB_BASELINE, 0, REPLAY_CALIB_LEVELS - 1u);
+
+  printf("tick_ms,kind,offset_us,delay_us,stratum,updated,filter_offset_us,filter_delay_us,jitter_us,"
+         "dispersion_us,freq_ppb,poll,interval_s,calib_level\n");
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (fgets(line, sizeof(line), stdin) != NULL) {
+    replay_line(&replay, line);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  replay_summary(&replay, (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9);
+  return 0;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+// "seconds.micros" as printed by sntp_trace_packet()
+static bool replay_parse_us(const char *text, uint64_t *micros)
+{
+  unsigned long seconds;
+  unsigned long fraction;
+
+  if (sscanf(text, "%lu.%lu", &seconds, &fraction) != 2) {
+    return false;
+  }
+  *micros = (uint64_t)seconds * 1000000u + fraction;
+  return true;
+}
+
+static bool replay_parse_hex(const char *text, uint8_t *packet)
+{
+  unsigned int byte;
+  uint32_t i;
+
+  for (i = 0; i < NTP_PACKET_SIZE; i++) {
+    if (sscanf(&text[2u * i], "%2x", &byte) != 1) {
+      return false;
+    }
+    packet[i] = (uint8_t)byte;
+  }
+  return true;
+}
+
+// The same reduction as ntp_client.c and the same filter and planning as
+// sntp_app.c, the device accepted these packets already
+static void replay_packet(replay_t *replay, uint32_t tick_ms, uint64_t t1, uint64_t t4, uint32_t one_way_us, const uint8_t *raw)
+{
+  ntp_packet_t packet;
+  ntp_sample_t sample;
+  calib_ctrl_action_t action;
+  const clock_filter_stage_t *selected = &replay->filter.selected;
+  bool updated;
+  double offset;
+
+  if (!ntp_packet_decode(raw, NTP_PACKET_SIZE, &packet)) {
+    return;
+  }
+  if (t1 != 0) {
+    ntp_sample_compute(t1, t4, &packet, REPLAY_LOCAL_PRECISION, &sample);
+  } else {
+    ntp_sample_from_broadcast(t4, &packet, one_way_us, REPLAY_LOCAL_PRECISION, &sample);
+  }
+  replay->packets++;
+  updated = clock_filter_add(&replay->filter, &sample);
+  if (updated) {
+    replay->updates++;
+    sync_plan_update(&replay->plan, selected->local_us, selected->offset_us);
+    // calendar_compare_offset() gets calendar minus NTP in ms
+    action = calib_ctrl_add_sample(&replay->calib,
+                                   (uint32_t)((selected->local_us + (uint64_t)selected->offset_us) / 1000000u),
+                                   (int32_t)(-selected->offset_us / 1000));
+    if (action != CALIB_CTRL_KEEP) {
+      replay->calib_actions++;
+    }
+    offset = (double)selected->offset_us;
+    replay->offset_sum_sq += offset * offset;
+    if ((offset < 0 ? -offset : offset) > replay->offset_max) {
+      replay->offset_max = (offset < 0) ? -offset : offset;
+    }
+  }
+  printf("%u,%c,%lld,%u,%u,%u,%lld,%u,%u,%u,%d,%u,%u,%u\n",
+         tick_ms,
+         (t1 != 0) ? 'R' : 'B',
+         (long long)sample.offset_us,
+         sample.delay_us,
+         sample.stratum,
+         updated ? 1u : 0u,
+         (long long)selected->offset_us,
+         selected->delay_us,
+         replay->filter.jitter_us,
+         replay->filter.dispersion_us,
+         replay->plan.freq_ppb,
+         replay->plan.poll,
+         replay->plan.interval_s,
+         replay->calib.level);
+}
+
+static void replay_line(replay_t *replay, const char *line)
+{
+  const char *record = strstr(line, "TR ");
+  char type;
+  unsigned long tick_ms;
+  unsigned long value;
+  char first[32];
+  char second[32];
+  char hex[2u * NTP_PACKET_SIZE + 1u];
+  uint8_t raw[NTP_PACKET_SIZE];
+  uint64_t t1;
+  uint64_t t4;
+
+  if ((record == NULL) || (sscanf(record, "TR %c %lu", &type, &tick_ms) != 2)) {
+    return;
+  }
+  if (!replay->have_tick) {
+    replay->have_tick     = true;
+    replay->first_tick_ms = (uint32_t)tick_ms;
+  }
+  replay->last_tick_ms = (uint32_t)tick_ms;
+
+  switch (type) {
+    case 'R':
+    case 'B':
+      if ((sscanf(record, "TR %*c %*u %31s %31s %96s", first, second, hex) != 3) || !replay_parse_hex(hex, raw)
+          || !replay_parse_us(second, &t4)) {
+        return;
+      }
+      if (type == 'R') {
+        if (!replay_parse_us(first, &t1)) {
+          return;
+        }
+        replay_packet(replay, (uint32_t)tick_ms, t1, t4, 0, raw);
+      } else {
+        replay_packet(replay, (uint32_t)tick_ms, 0, t4, (uint32_t)strtoul(first, NULL, 10), raw);
+      }
+      break;
+    case 'C':
+      if (sscanf(record, "TR C %*u %lu", &value) != 1) {
+        return;
+      }
+      if (!replay->have_rtc) {
+        replay->have_rtc         = true;
+        replay->rtc_first_tick   = (uint32_t)tick_ms;
+        replay->rtc_first_second = (uint32_t)value;
+      }
+      replay->rtc_last_tick   = (uint32_t)tick_ms;
+      replay->rtc_last_second = (uint32_t)value;
+      break;
+    case 'L':
+      if ((sscanf(record, "TR L %*u %lu", &value) == 1) && (value == 0)) {
+        replay->link_downs++;
+      }
+      break;
+    case 'S':
+      // The device clock moved under the filter
+      clock_filter_reset(&replay->filter);
+      sync_plan_restart(&replay->plan);
+      calib_ctrl_restart(&replay->calib);
+      replay->resets++;
+      break;
+    default:
+      break;
+  }
+}
+
+static void replay_summary(const replay_t *replay, double wall_s)
+{
+  double span_s = (double)(replay->last_tick_ms - replay->first_tick_ms) / 1000.0;
+  double rtc_ppm;
+
+  fprintf(stderr, "%u packets, %u filter updates, %u resets, %u link losses, %u calibration actions\n",
+          replay->packets,
+          replay->updates,
+          replay->resets,
+          replay->link_downs,
+          replay->calib_actions);
+  if (replay->updates != 0) {
+    fprintf(stderr, "filtered offset: RMS %.0f us, max %.0f us, frequency %d ppb\n",
+            sqrt(replay->offset_sum_sq / replay->updates),
+            replay->offset_max,
+            replay->plan.freq_ppb);
+  }
+  if (replay->have_rtc && (replay->rtc_last_tick - replay->rtc_first_tick) >= 60000u) {
+    // Whole RTC seconds, only long captures give a usable figure
+    rtc_ppm = ((double)(replay->rtc_last_second - replay->rtc_first_second) * 1000.0
+               - (double)(replay->rtc_last_tick - replay->rtc_first_tick))
+              / (double)(replay->rtc_last_tick - replay->rtc_first_tick) * 1e6;
+    fprintf(stderr, "RTC against the kernel tick: %.0f ppm\n", rtc_ppm);
+  }
+  fprintf(stderr, "%.0f s of trace replayed in %.3f s", span_s, wall_s);
+  if (wall_s > 0.0) {
+    fprintf(stderr, ", %.0fx real time", span_s / wall_s);
+  }
+  fprintf(stderr, "\n");
+}
@@ -0,0 +1,134 @@
+/***************************************************************************/ /**
+ * @file wifi_cache.c
+ * @brief Last good access point, cached for directed joins
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "cmsis_os2.h"
+#include "string.h"
+#include "stdio.h"
+#include "nvm_store.h"
+#include "wifi_cache.h"
+
+/*******************************************************************************
+ *****************************  Local Variable  ********************************
+ ******************************************************************************/
+static wifi_cache_record_t wifi_cache;
+static volatile bool wifi_cache_valid = false;
+static volatile bool wifi_cache_dirty = false;
+
+/*******************************************************************************
+ **********************  Local Function prototypes   ***************************
+ ******************************************************************************/
+static uint32_t wifi_cache_elapsed_ms(uint32_t start);
+
+/*******************************************************************************
+ **************************   GLOBAL FUNCTIONS   *******************************
+ ******************************************************************************/
+sl_status_t wifi_cache_load(void)
+{
+  wifi_cache_record_t record;
+  sl_status_t status = nvm_store_read(NVM_STORE_KEY_WIFI_CACHE, &record, sizeof(record));
+
+  if (status != SL_STATUS_OK) {
+    return status;
+  }
+  if ((record.version != WIFI_CACHE_RECORD_VERSION) || (record.channel == 0)) {
+    return SL_STATUS_NOT_FOUND;
+  }
+  wifi_cache       = record;
+  wifi_cache_valid = true;
+  return SL_STATUS_OK;
+}
+
+void wifi_cache_observe(const sl_si91x_module_state_stats_response_t *notification)
+{
+  if (((notification->state_code & WIFI_CACHE_STATE_MASK) != WIFI_CACHE_STATE_ASSOC) || (notification->channel == 0)) {
+    return;
+  }
+  if (!wifi_cache_valid || (wifi_cache.channel != notification->channel)
+      || (memcmp(wifi_cache.bssid, notification->bssid, sizeof(wifi_cache.bssid)) != 0)) {
+    wifi_cache_dirty = true;
+  }
+  wifi_cache.version = WIFI_CACHE_RECORD_VERSION;
+  wifi_cache.channel = notification->channel;
+  wifi_cache.rssi    = notification->rssi;
+  memcpy(wifi_cache.bssid, notification->bssid, sizeof(wifi_cache.bssid));
+  wifi_cache_valid = true;
+}
+
+sl_status_t wifi_cache_save(void)
+{
+  wifi_cache_record_t record;
+
+  if (!wifi_cache_dirty || !wifi_cache_valid) {
+    return SL_STATUS_OK;
+  }
+  wifi_cache_dirty = false;
+  record           = wifi_cache;
+  return nvm_store_write(NVM_STORE_KEY_WIFI_CACHE, &record, sizeof(record));
+}
+
+sl_status_t wifi_cache_connect(sl_net_interface_t interface, sl_net_profile_id_t profile_id, wifi_cache_join_t *join)
+{
+  sl_net_wifi_client_profile_t profile;
+  sl_net_wifi_client_profile_t directed;
+  wifi_cache_join_t result = { 0 };
+  sl_status_t status       = SL_STATUS_FAIL;
+  uint32_t start;
+
+  if (wifi_cache_valid && (sl_net_get_profile(interface, profile_id, &profile) == SL_STATUS_OK)) {
+    directed                        = profile;
+    directed.config.channel.channel = wifi_cache.channel;
+    memcpy(directed.config.bssid.octet, wifi_cache.bssid, sizeof(directed.config.bssid.octet));
+    result.channel = wifi_cache.channel;
+    if (sl_net_set_profile(interface, profile_id, &directed) == SL_STATUS_OK) {
+      start           = osKernelGetTickCount();
+      status          = sl_net_up(interface, profile_id);
+      result.link_ms  = wifi_cache_elapsed_ms(start);
+      result.directed = (status == SL_STATUS_OK);
+      // Later joins by the network manager must not stick to this AP
+      sl_net_set_profile(interface, profile_id, &profile);
+    }
+    if (status != SL_STATUS_OK) {
+      // The AP moved or is gone, a new association caches its successor
+      printf("Directed join to channel %u failed: 0x%lx\r\n", wifi_cache.channel, status);
+      wifi_cache_invalidate();
+      result.fell_back = true;
+    }
+  }
+  if (status != SL_STATUS_OK) {
+    start          = osKernelGetTickCount();
+    status = sl_net_up(interface, profile_id);
+    // A failed directed join is part of the time to link
+    result.link_ms += wifi_cache_elapsed_ms(start);
+    result.channel = 0;
+  }
+  if (join != NULL) {
+    *join = result;
+  }
+  return status;
+}
+
+void wifi_cache_invalidate(void)
+{
+  wifi_cache_valid = false;
+}
+
+/*******************************************************************************
+ **************************   LOCAL FUNCTIONS   ********************************
+ ******************************************************************************/
+static uint32_t wifi_cache_elapsed_ms(uint32_t start)
+{
+  return (uint32_t)(((uint64_t)(osKernelGetTickCount() - start) * 1000u) / osKernelGetTickFreq());
+}
@@ -0,0 +1,92 @@
+/***************************************************************************/ /**
+ * @file wifi_cache.h
+ * @brief Last good access point, cached for directed joins
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2024 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc. Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement. This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+
+#ifndef WIFI_CACHE_H_
+#define WIFI_CACHE_H_
+#include "sl_status.h"
+#include "sl_net.h"
+#include "sl_wifi.h"
+#include "sl_si91x_types.h"
+
+// -----------------------------------------------------------------------------
+// Macros
+#define WIFI_CACHE_RECORD_VERSION 1u
+#define WIFI_CACHE_STATE_MASK     0xF0u ///< Module state code, the low nibble carries flags
+#define WIFI_CACHE_STATE_ASSOC    0x80u ///< Module state "Associated"
+
+// -----------------------------------------------------------------------------
+// Data Types
+/// Persisted parameters of the last association
+typedef struct {
+  uint32_t version;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t rssi;
+} wifi_cache_record_t;
+
+/// Outcome of the last wifi_cache_connect()
+typedef struct {
+  uint32_t link_ms;   ///< sl_net_up() call to link up, both attempts after a fall back
+  uint8_t channel;    ///< Channel of the directed join, 0 for a full scan
+  bool directed;      ///< Link came up on the directed join
+  bool fell_back;     ///< Directed join failed, a full scan followed
+} wifi_cache_join_t;
+
+// -----------------------------------------------------------------------------
+// Prototypes
+/***************************************************************************/ /**
+ * Load the cached access point from NVM3.
+ *
+ * @param none
+ * @return SL_STATUS_NOT_FOUND if nothing is cached
+ ******************************************************************************/
+sl_status_t wifi_cache_load(void);
+
+/***************************************************************************/ /**
+ * Take the access point from a module state notification when it reports an
+ * association. Only RAM is updated, safe from the Wi-Fi event callback.
+ *
+ * @param[in] notification module state statistics
+ ******************************************************************************/
+void wifi_cache_observe(const sl_si91x_module_state_stats_response_t *notification);
+
+/***************************************************************************/ /**
+ * Write the cache to NVM3 if it changed since the last save.
+ *
+ * @param none
+ * @return status of the NVM3 write
+ ******************************************************************************/
+sl_status_t wifi_cache_save(void);
+
+/***************************************************************************/ /**
+ * Bring the interface up, first with a directed join to the cached BSSID on
+ * its channel, then with the unmodified profile (full scan) if that fails.
+ * The profile is restored in either case.
+ *
+ * @param[in] interface network interface
+ * @param[in] profile_id Wi-Fi client profile
+ * @param[out] join how the link came up, may be NULL
+ * @return status of the last sl_net_up()
+ ******************************************************************************/
+sl_status_t wifi_cache_connect(sl_net_interface_t interface, sl_net_profile_id_t profile_id, wifi_cache_join_t *join);
+
+/***************************************************************************/ /**
+ * Forget the cached access point, e.g. after the directed join failed.
+ ******************************************************************************/
+void wifi_cache_invalidate(void);
+
+#endif /* WIFI_CACHE_H_ */